@@ -70,6 +70,14 @@ macro(jss_tests)
         NAME "TestBufferPRFD"
         COMMAND "${BIN_OUTPUT_DIR}/TestBufferPRFD"
     )
+    jss_test_exec(
+        NAME "TestBufferPool"
+        COMMAND "${BIN_OUTPUT_DIR}/TestBufferPool"
+    )
+    jss_test_exec(
+        NAME "TestBufferSPSC"
+        COMMAND "${BIN_OUTPUT_DIR}/TestBufferSPSC"
+    )
     jss_test_java(
         NAME "Test_UTF-8_Converter"
         COMMAND "org.mozilla.jss.tests.UTF8ConverterTest"
@@ -152,6 +160,11 @@ macro(jss_tests)
         COMMAND "${BIN_OUTPUT_DIR}/buffer_size_4"
         DEPENDS "generate_c_buffer_size_4"
     )
+    jss_test_exec(
+        NAME "jss_bench_buffer"
+        COMMAND "${BIN_OUTPUT_DIR}/jss_bench_buffer"
+        DEPENDS "generate_c_jss_bench_buffer"
+    )
     jss_test_java(
         NAME "JUnit_CertificateChainTest"
         COMMAND "org.junit.runner.JUnitCore" "org.mozilla.jss.tests.CertificateChainTest"
@@ -325,6 +338,11 @@ macro(jss_tests)
             COMMAND "${BIN_OUTPUT_DIR}/TestBufferPRFDSSL" "${RESULTS_NSSDB_OUTPUT_DIR}" "${DB_PWD}" "Server_ECDSA"
             DEPENDS "List_CA_certs" "generate_c_TestBufferPRFDSSL"
         )
+        jss_test_exec(
+            NAME "jss_bench_buffer_TLS"
+            COMMAND "${BIN_OUTPUT_DIR}/jss_bench_buffer" "${RESULTS_NSSDB_OUTPUT_DIR}" "${DB_PWD}" "Server_RSA"
+            DEPENDS "List_CA_certs" "generate_c_jss_bench_buffer"
+        )
         jss_test_java(
             NAME "JSS_Test_BufferPRFD"
             COMMAND "org.mozilla.jss.tests.TestBufferPRFD" "${RESULTS_NSSDB_OUTPUT_DIR}" "${DB_PWD}"
@@ -462,7 +480,10 @@ macro(jss_tests_compile)
     jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/buffer_size_1.c" "${BIN_OUTPUT_DIR}/buffer_size_1" "buffer_size_1")
     jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/buffer_size_4.c" "${BIN_OUTPUT_DIR}/buffer_size_4" "buffer_size_4")
     jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/TestBufferPRFD.c" "${BIN_OUTPUT_DIR}/TestBufferPRFD" "TestBufferPRFD")
+    jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/TestBufferPool.c" "${BIN_OUTPUT_DIR}/TestBufferPool" "TestBufferPool")
+    jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/TestBufferSPSC.c" "${BIN_OUTPUT_DIR}/TestBufferSPSC" "TestBufferSPSC")
     jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/TestBufferPRFDSSL.c" "${BIN_OUTPUT_DIR}/TestBufferPRFDSSL" "TestBufferPRFDSSL")
+    jss_tests_compile_c("${PROJECT_SOURCE_DIR}/src/test/java/org/mozilla/jss/tests/jss_bench_buffer.c" "${BIN_OUTPUT_DIR}/jss_bench_buffer" "jss_bench_buffer")
 endmacro()
 
 macro(jss_tests_compile_c C_FILE C_OUTPUT C_TARGET)
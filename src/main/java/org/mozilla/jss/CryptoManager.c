@@ -614,7 +614,7 @@ getPWFromCallback(PK11SlotInfo *slot, PRBool retry, void *arg)
     }
 
     /* Get the JNI environment */
-    if((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != 0){
+    if(JSS_attachCurrentThread(&env) != PR_SUCCESS){
         PR_ASSERT(PR_FALSE);
         goto finish;
     }
@@ -937,6 +937,37 @@ Java_org_mozilla_jss_CryptoManager_FIPSEnabled(JNIEnv *env, jobject this)
     }
 }
 
+/***********************************************************************
+ * CryptoManager.getThreadAttachStatsNative
+ *
+ * Returns the counters kept by JSS_attachCurrentThread: attaches,
+ * detaches and hits, in that order.
+ */
+JNIEXPORT jlongArray JNICALL
+Java_org_mozilla_jss_CryptoManager_getThreadAttachStatsNative(JNIEnv *env,
+    jclass clazz)
+{
+    JSS_AttachStats stats;
+    jlong values[3];
+    jlongArray result = NULL;
+
+    PR_ASSERT(env != NULL);
+
+    JSS_getAttachStats(&stats);
+    values[0] = stats.attaches;
+    values[1] = stats.detaches;
+    values[2] = stats.hits;
+
+    result = (*env)->NewLongArray(env, 3);
+    if (result == NULL) {
+        ASSERT_OUTOFMEM(env);
+        return NULL;
+    }
+
+    (*env)->SetLongArrayRegion(env, result, 0, 3, values);
+    return result;
+}
+
 /***********************************************************************
  * DatabaseCloser.closeDatabases
  *
@@ -37,6 +37,7 @@ import org.mozilla.jss.provider.java.security.JSSMessageDigestSpi;
 import org.mozilla.jss.util.InvalidNicknameException;
 import org.mozilla.jss.util.NativeProxy;
 import org.mozilla.jss.util.PasswordCallback;
+import org.mozilla.jss.util.ThreadAttachStats;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
 
@@ -435,6 +436,17 @@ public final class CryptoManager implements TokenSupplier
      */
     public synchronized native boolean FIPSEnabled();
 
+    /**
+     * Get a snapshot of the counters for threads attached to the JVM so
+     * that NSS callbacks can call back into Java. A thread is attached at
+     * most once; later callbacks on the same thread count as hits.
+     */
+    public static ThreadAttachStats getThreadAttachStats() {
+        long[] stats = getThreadAttachStatsNative();
+        return new ThreadAttachStats(stats[0], stats[1], stats[2]);
+    }
+    private static native long[] getThreadAttachStatsNative();
+
 
     ///////////////////////////////////////////////////////////////////////
     // Password Callback management
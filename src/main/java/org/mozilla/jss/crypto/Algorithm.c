@@ -178,6 +178,9 @@ JSS_AlgInfo JSS_AlgTable[NUM_ALGS] = {
 /* 81 */    {SEC_OID_AES_128_KEY_WRAP_KWP, SEC_OID_TAG},
 /* 82 */    {SEC_OID_AES_192_KEY_WRAP_KWP, SEC_OID_TAG},
 /* 83 */    {SEC_OID_AES_256_KEY_WRAP_KWP, SEC_OID_TAG},
+/* 84 */    {CKM_AES_GCM, PK11_MECH},
+/* 85 */    {CKM_CHACHA20_POLY1305, PK11_MECH},
+/* 86 */    {CKM_CHACHA20_KEY_GEN, PK11_MECH},
 
 
 /* REMEMBER TO UPDATE NUM_ALGS!!! (in Algorithm.h) */
@@ -282,36 +285,17 @@ JSS_getOidTagFromAlg(JNIEnv *env, jobject alg)
 static jint
 getAlgIndex(JNIEnv *env, jobject alg)
 {
-    jclass algClass;
     jint index=-1;
-    jfieldID indexField;
 
     PR_ASSERT(env!=NULL && alg!=NULL);
+    PR_ASSERT(JSS_javaIDs.algorithmOidIndex != NULL);
 
-    algClass = (*env)->GetObjectClass(env, alg);
-
-#ifdef DEBUG
     /* Make sure this really is an Algorithm. */
-    {
-    jclass realClass = ((*env)->FindClass(env, ALGORITHM_CLASS_NAME));
-    PR_ASSERT( (*env)->IsInstanceOf(env, alg, realClass) );
-    }
-#endif
+    PR_ASSERT( (*env)->IsInstanceOf(env, alg, JSS_javaIDs.algorithmClass) );
 
-    indexField = (*env)->GetFieldID(
-                                    env,
-                                    algClass,
-                                    OID_INDEX_FIELD_NAME,
-                                    OID_INDEX_FIELD_SIG);
-    if(indexField==NULL) {
-        ASSERT_OUTOFMEM(env);
-        goto finish;
-    }
-
-    index = (*env)->GetIntField(env, alg, indexField);
+    index = (*env)->GetIntField(env, alg, JSS_javaIDs.algorithmOidIndex);
     PR_ASSERT( (index >= 0) && (index < NUM_ALGS) );
 
-finish:
     return index;
 }
 
@@ -264,4 +264,9 @@ public class Algorithm {
     protected static final int SEC_OID_AES_128_KEY_WRAP_KWP = 81;
     protected static final int SEC_OID_AES_192_KEY_WRAP_KWP = 82;
     protected static final int SEC_OID_AES_256_KEY_WRAP_KWP = 83;
+
+    // PKCS#11 AEAD ciphers
+    protected static final int CKM_AES_GCM = 84;
+    protected static final int CKM_CHACHA20_POLY1305 = 85;
+    protected static final int CKM_CHACHA20_KEY_GEN = 86;
 }
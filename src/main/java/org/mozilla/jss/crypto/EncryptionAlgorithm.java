@@ -8,6 +8,7 @@ import java.security.NoSuchAlgorithmException;
 import java.util.Hashtable;
 import java.util.Vector;
 
+import javax.crypto.spec.GCMParameterSpec;
 import javax.crypto.spec.IvParameterSpec;
 import javax.crypto.spec.RC2ParameterSpec;
 
@@ -49,6 +50,7 @@ public class EncryptionAlgorithm extends Algorithm {
         public static final Mode NONE = new Mode("NONE");
         public static final Mode ECB = new Mode("ECB");
         public static final Mode CBC = new Mode("CBC");
+        public static final Mode GCM = new Mode("GCM");
     }
 
     public static class Alg {
@@ -84,6 +86,7 @@ public class EncryptionAlgorithm extends Algorithm {
         public static final Alg DESede = new Alg("DESede");
         public static final Alg AES = new Alg("AES");
         public static final Alg RC2 = new Alg("RC2");
+        public static final Alg ChaCha20Poly1305 = new Alg("ChaCha20-Poly1305");
     }
 
     public static class Padding {
@@ -330,6 +333,16 @@ public class EncryptionAlgorithm extends Algorithm {
         return padding;
     }
 
+    /**
+     * @return <code>true</code> if this is an authenticated encryption
+     *         (AEAD) algorithm, such as AES-GCM or ChaCha20-Poly1305. These
+     *         produce an authentication tag and take a fresh nonce for each
+     *         message.
+     */
+    public boolean isAEAD() {
+        return mode == Mode.GCM || alg == Alg.ChaCha20Poly1305;
+    }
+
     private static Class<?>[] IVParameterSpecClasses = null;
     static {
         IVParameterSpecClasses = new Class[2];
@@ -337,6 +350,13 @@ public class EncryptionAlgorithm extends Algorithm {
         IVParameterSpecClasses[1] = IvParameterSpec.class;
     }
 
+    private static Class<?>[] GCMParameterSpecClasses = null;
+    static {
+        GCMParameterSpecClasses = new Class[2];
+        GCMParameterSpecClasses[0] = GCMParameterSpec.class;
+        GCMParameterSpecClasses[1] = IvParameterSpec.class;
+    }
+
     /**
      * Returns the number of bytes that this algorithm expects in
      * its initialization vector.
@@ -449,4 +469,23 @@ public class EncryptionAlgorithm extends Algorithm {
         Padding.PKCS5, IVParameterSpecClasses, 16,
         AES_ROOT_OID.subBranch(48), 256,"AES/None/PKCS5Padding/Kwp/256");
 
+    public static final EncryptionAlgorithm AES_128_GCM = new EncryptionAlgorithm(CKM_AES_GCM,
+            Alg.AES, Mode.GCM,
+            Padding.NONE, GCMParameterSpecClasses, 16,
+            AES_ROOT_OID.subBranch(6), 128);
+
+    public static final EncryptionAlgorithm AES_192_GCM = new EncryptionAlgorithm(CKM_AES_GCM,
+            Alg.AES, Mode.GCM,
+            Padding.NONE, GCMParameterSpecClasses, 16,
+            AES_ROOT_OID.subBranch(26), 192);
+
+    public static final EncryptionAlgorithm AES_256_GCM = new EncryptionAlgorithm(CKM_AES_GCM,
+            Alg.AES, Mode.GCM,
+            Padding.NONE, GCMParameterSpecClasses, 16,
+            AES_ROOT_OID.subBranch(46), 256);
+
+    public static final EncryptionAlgorithm CHACHA20_POLY1305 = new EncryptionAlgorithm(CKM_CHACHA20_POLY1305,
+            Alg.ChaCha20Poly1305, Mode.NONE,
+            Padding.NONE, IVParameterSpecClasses, 1,
+            null, 256); // no oid
 }
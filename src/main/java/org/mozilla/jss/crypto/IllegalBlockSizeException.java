@@ -5,4 +5,10 @@ package org.mozilla.jss.crypto;
 
 public class IllegalBlockSizeException extends Exception {
     private static final long serialVersionUID = 1L;
+
+    public IllegalBlockSizeException() { super(); }
+
+    public IllegalBlockSizeException(String mesg) {
+        super(mesg);
+    }
 }
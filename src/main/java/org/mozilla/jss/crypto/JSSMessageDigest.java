@@ -106,6 +106,18 @@ public abstract class JSSMessageDigest {
      */
     public abstract DigestAlgorithm getAlgorithm();
 
+    /**
+     * Returns a copy of this digest, including any input digested so far,
+     * so that inputs sharing a prefix need only digest it once.
+     *
+     * @throws CloneNotSupportedException If this implementation, or its
+     *         token, cannot copy the digest.
+     */
+    @Override
+    public Object clone() throws CloneNotSupportedException {
+        return super.clone();
+    }
+
     /**
      * Returns the length of the digest created by this digest's
      * digest algorithm.
@@ -167,6 +167,13 @@ public class KeyGenAlgorithm extends Algorithm {
             null,
             null);
     //////////////////////////////////////////////////////////////
+    public static final KeyGenAlgorithm CHACHA20 = new KeyGenAlgorithm(
+            CKM_CHACHA20_KEY_GEN,
+            "ChaCha20",
+            new FixedKeyStrengthValidator(256),
+            null,
+            null);
+    //////////////////////////////////////////////////////////////
     public static final KeyGenAlgorithm RC2 = new KeyGenAlgorithm(
             CKM_RC2_KEY_GEN,
             "RC2",
@@ -26,6 +26,9 @@ public enum PKCS11Algorithm {
     CKM_SHA_384_HMAC (Algorithm.CKM_SHA384_HMAC, PKCS11Constants.CKM_SHA384_HMAC),
     CKM_SHA_512_HMAC (Algorithm.CKM_SHA512_HMAC, PKCS11Constants.CKM_SHA512_HMAC),
     CKM_AES_CMAC (Algorithm.CKM_AES_CMAC, PKCS11Constants.CKM_AES_CMAC),
+    CKM_AES_GCM (Algorithm.CKM_AES_GCM, PKCS11Constants.CKM_AES_GCM),
+    CKM_CHACHA20_KEY_GEN (Algorithm.CKM_CHACHA20_KEY_GEN, PKCS11Constants.CKM_CHACHA20_KEY_GEN),
+    CKM_CHACHA20_POLY1305 (Algorithm.CKM_CHACHA20_POLY1305, PKCS11Constants.CKM_CHACHA20_POLY1305),
     CKM_SP800_108_COUNTER_KDF (Algorithm.CKM_SP800_108_COUNTER_KDF, PKCS11Constants.CKM_SP800_108_COUNTER_KDF),
     CKM_SP800_108_FEEDBACK_KDF (Algorithm.CKM_SP800_108_FEEDBACK_KDF, PKCS11Constants.CKM_SP800_108_FEEDBACK_KDF),
     CKM_SP800_108_DOUBLE_PIPELINE_KDF (Algorithm.CKM_SP800_108_DOUBLE_PIPELINE_KDF, PKCS11Constants.CKM_SP800_108_DOUBLE_PIPELINE_KDF),
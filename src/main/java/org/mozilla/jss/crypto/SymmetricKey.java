@@ -105,6 +105,8 @@ public interface SymmetricKey extends javax.crypto.SecretKey {
         public static final Type PBA_SHA1_HMAC = new Type(new String[] { "PBA_SHA1_HMAC" },
                 KeyGenAlgorithm.PBA_SHA1_HMAC, null);
         public static final Type AES = new Type(new String[] { "AES" }, KeyGenAlgorithm.AES, KeyType.AES);
+        public static final Type CHACHA20 = new Type(new String[] { "ChaCha20", "CHACHA20" },
+                KeyGenAlgorithm.CHACHA20, KeyType.CHACHA20);
 
         @Override
         public String toString() {
@@ -4,8 +4,10 @@
 #include <jni.h>
 
 #include "jssutil.h"
+#include "jss_exceptions.h"
 #include "BufferProxy.h"
 #include "j_buffer.h"
+#include "j_buffer_pool.h"
 
 #include "_jni/org_mozilla_jss_nss_Buffer.h"
 
@@ -16,7 +18,39 @@ Java_org_mozilla_jss_nss_Buffer_Create(JNIEnv *env, jclass clazz, jlong length)
 
     PR_ASSERT(env != NULL && length > 0);
 
-    buf = jb_alloc((size_t) length);
+    buf = jb_pool_lease((size_t) length);
+    PR_ASSERT(buf != NULL);
+
+    return JSS_PR_wrapJBuffer(env, &buf);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_nss_Buffer_CreateSPSC(JNIEnv *env, jclass clazz,
+    jlong length)
+{
+    j_buffer *buf = NULL;
+
+    PR_ASSERT(env != NULL);
+
+    if (length <= 0) {
+        return NULL;
+    }
+
+    buf = jb_pool_lease_spsc((size_t) length);
+    PR_ASSERT(buf != NULL);
+
+    return JSS_PR_wrapJBuffer(env, &buf);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_nss_Buffer_CreateElastic(JNIEnv *env, jclass clazz,
+    jlong chunk_size, jlong max_capacity)
+{
+    j_buffer *buf = NULL;
+
+    PR_ASSERT(env != NULL && chunk_size > 0 && max_capacity > 0);
+
+    buf = jb_pool_lease_elastic((size_t) chunk_size, (size_t) max_capacity);
     PR_ASSERT(buf != NULL);
 
     return JSS_PR_wrapJBuffer(env, &buf);
@@ -139,6 +173,223 @@ Java_org_mozilla_jss_nss_Buffer_Write(JNIEnv *env, jclass clazz, jobject buf, jb
     return write_amount;
 }
 
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_ReadDirect(JNIEnv *env, jclass clazz,
+    jobject buf, jobject dst, jint offset, jint length)
+{
+    j_buffer *real_buf = NULL;
+    uint8_t *dst_addr = NULL;
+
+    PR_ASSERT(env != NULL && buf != NULL && dst != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return -1;
+    }
+
+    if (offset < 0 || length < 0 ||
+            offset + (jlong) length > (*env)->GetDirectBufferCapacity(env, dst)) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return -1;
+    }
+
+    dst_addr = (*env)->GetDirectBufferAddress(env, dst);
+    if (dst_addr == NULL) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Expected a direct ByteBuffer");
+        return -1;
+    }
+
+    return jb_read(real_buf, dst_addr + offset, (size_t) length);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_ReadArray(JNIEnv *env, jclass clazz,
+    jobject buf, jbyteArray dst, jint offset, jint length)
+{
+    j_buffer *real_buf = NULL;
+    size_t read_amount = 0;
+
+    PR_ASSERT(env != NULL && buf != NULL && dst != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return -1;
+    }
+
+    if (offset < 0 || length < 0 ||
+            offset + (jlong) length > (*env)->GetArrayLength(env, dst)) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return -1;
+    }
+
+    /* Copy each contiguous span of the ring straight into the array;
+     * there are at most two of them. */
+    while (read_amount < (size_t) length) {
+        size_t span_size = 0;
+        const uint8_t *span = jb_peek_read(real_buf, &span_size);
+        if (span == NULL) {
+            break;
+        }
+
+        if (span_size > (size_t) length - read_amount) {
+            span_size = (size_t) length - read_amount;
+        }
+
+        (*env)->SetByteArrayRegion(env, dst, offset + read_amount, span_size,
+            (const jbyte *) span);
+        if ((*env)->ExceptionCheck(env)) {
+            return -1;
+        }
+
+        read_amount += jb_consume(real_buf, span_size);
+    }
+
+    return read_amount;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_WriteDirect(JNIEnv *env, jclass clazz,
+    jobject buf, jobject src, jint offset, jint length)
+{
+    j_buffer *real_buf = NULL;
+    uint8_t *src_addr = NULL;
+
+    PR_ASSERT(env != NULL && buf != NULL && src != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return -1;
+    }
+
+    if (offset < 0 || length < 0 ||
+            offset + (jlong) length > (*env)->GetDirectBufferCapacity(env, src)) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return -1;
+    }
+
+    src_addr = (*env)->GetDirectBufferAddress(env, src);
+    if (src_addr == NULL) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Expected a direct ByteBuffer");
+        return -1;
+    }
+
+    return jb_write(real_buf, src_addr + offset, (size_t) length);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_WriteArray(JNIEnv *env, jclass clazz,
+    jobject buf, jbyteArray src, jint offset, jint length)
+{
+    j_buffer *real_buf = NULL;
+    size_t write_amount = 0;
+
+    PR_ASSERT(env != NULL && buf != NULL && src != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return -1;
+    }
+
+    if (offset < 0 || length < 0 ||
+            offset + (jlong) length > (*env)->GetArrayLength(env, src)) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return -1;
+    }
+
+    /* See note in ReadArray; at most two spans are filled. */
+    while (write_amount < (size_t) length) {
+        size_t span_size = 0;
+        uint8_t *span = jb_peek_write(real_buf, &span_size);
+        if (span == NULL) {
+            break;
+        }
+
+        if (span_size > (size_t) length - write_amount) {
+            span_size = (size_t) length - write_amount;
+        }
+
+        (*env)->GetByteArrayRegion(env, src, offset + write_amount, span_size,
+            (jbyte *) span);
+        if ((*env)->ExceptionCheck(env)) {
+            return -1;
+        }
+
+        write_amount += jb_commit(real_buf, span_size);
+    }
+
+    return write_amount;
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_nss_Buffer_PeekRead(JNIEnv *env, jclass clazz, jobject buf)
+{
+    j_buffer *real_buf = NULL;
+    const uint8_t *span = NULL;
+    size_t span_size = 0;
+
+    PR_ASSERT(env != NULL && buf != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return NULL;
+    }
+
+    span = jb_peek_read(real_buf, &span_size);
+    if (span == NULL) {
+        return NULL;
+    }
+
+    return (*env)->NewDirectByteBuffer(env, (void *) span, span_size);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_Consume(JNIEnv *env, jclass clazz, jobject buf,
+    jlong amount)
+{
+    j_buffer *real_buf = NULL;
+
+    PR_ASSERT(env != NULL && buf != NULL && amount >= 0);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return 0;
+    }
+
+    return jb_consume(real_buf, (size_t) amount);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_nss_Buffer_PeekWrite(JNIEnv *env, jclass clazz, jobject buf)
+{
+    j_buffer *real_buf = NULL;
+    uint8_t *span = NULL;
+    size_t span_size = 0;
+
+    PR_ASSERT(env != NULL && buf != NULL);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return NULL;
+    }
+
+    span = jb_peek_write(real_buf, &span_size);
+    if (span == NULL) {
+        return NULL;
+    }
+
+    return (*env)->NewDirectByteBuffer(env, span, span_size);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_Commit(JNIEnv *env, jclass clazz, jobject buf,
+    jlong amount)
+{
+    j_buffer *real_buf = NULL;
+
+    PR_ASSERT(env != NULL && buf != NULL && amount >= 0);
+
+    if (JSS_PR_unwrapJBuffer(env, buf, &real_buf) != PR_SUCCESS) {
+        return 0;
+    }
+
+    return jb_commit(real_buf, (size_t) amount);
+}
+
 JNIEXPORT jint JNICALL
 Java_org_mozilla_jss_nss_Buffer_Get(JNIEnv *env, jclass clazz, jobject buf)
 {
@@ -179,6 +430,54 @@ Java_org_mozilla_jss_nss_Buffer_Free(JNIEnv *env, jclass clazz, jobject buf)
         return;
     }
 
-    jb_free(real_buf);
+    jb_pool_return(real_buf);
     JSS_clearPtrFromProxy(env, buf);
 }
+
+JNIEXPORT jlong JNICALL
+Java_org_mozilla_jss_nss_Buffer_GetPoolLimit(JNIEnv *env, jclass clazz)
+{
+    return jb_pool_get_limit();
+}
+
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_nss_Buffer_SetPoolLimit(JNIEnv *env, jclass clazz,
+    jlong limit)
+{
+    PR_ASSERT(env != NULL);
+
+    if (limit < 0) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+                     "Pool limit must be non-negative");
+        return;
+    }
+
+    jb_pool_set_limit((size_t) limit);
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_org_mozilla_jss_nss_Buffer_GetPoolStatsNative(JNIEnv *env, jclass clazz)
+{
+    j_buffer_pool_stats stats;
+    jlong values[6];
+    jlongArray result = NULL;
+
+    PR_ASSERT(env != NULL);
+
+    jb_pool_get_stats(&stats);
+    values[0] = stats.leased;
+    values[1] = stats.leased_high_water;
+    values[2] = stats.idle;
+    values[3] = stats.idle_high_water;
+    values[4] = stats.hits;
+    values[5] = stats.misses;
+
+    result = (*env)->NewLongArray(env, 6);
+    if (result == NULL) {
+        ASSERT_OUTOFMEM(env);
+        return NULL;
+    }
+
+    (*env)->SetLongArrayRegion(env, result, 0, 6, values);
+    return result;
+}
@@ -1,13 +1,48 @@
 package org.mozilla.jss.nss;
 
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
+
 public class Buffer {
     /**
      * Create a new j_buffer object with the specified number of bytes.
      *
-     * See also: jb_alloc in org/mozilla/jss/ssl/javax/j_buffer.h
+     * The buffer is leased from a pool shared by all threads, reusing a
+     * previously freed buffer of the same size when one is available.
+     *
+     * See also: jb_pool_lease in org/mozilla/jss/ssl/javax/j_buffer_pool.h
      */
     public static native BufferProxy Create(long length);
 
+    /**
+     * Create a new single-producer/single-consumer j_buffer object with the
+     * specified number of bytes. One thread may write to the buffer (Write,
+     * WriteFrom, Put, PeekWrite and Commit) while another concurrently reads
+     * from it (Read, ReadInto, Get, PeekRead and Consume) without any
+     * further synchronization. Free(...) must not race with either side.
+     *
+     * As with Create(...), the buffer is leased from the shared pool.
+     * Returns null when length isn't positive.
+     *
+     * See also: jb_pool_lease_spsc in
+     * org/mozilla/jss/ssl/javax/j_buffer_pool.h
+     */
+    public static native BufferProxy CreateSPSC(long length);
+
+    /**
+     * Create a new elastic j_buffer object. Storage is allocated in chunks
+     * of chunk_size bytes as the buffer fills, up to max_capacity bytes
+     * (rounded up to a whole number of chunks), and released again as the
+     * buffer drains. Capacity(...) reports the ceiling.
+     *
+     * As with Create(...), the buffer is leased from the shared pool.
+     *
+     * See also: jb_pool_lease_elastic in
+     * org/mozilla/jss/ssl/javax/j_buffer_pool.h
+     */
+    public static native BufferProxy CreateElastic(long chunk_size,
+                                                   long max_capacity);
+
     /**
      * Check the total capacity of a buffer object.
      *
@@ -59,6 +94,143 @@ public class Buffer {
      */
     public static native long Write(BufferProxy buf, byte[] input);
 
+    /**
+     * Read bytes from the buffer into the remaining space of the specified
+     * ByteBuffer, advancing its position by the number of bytes read.
+     *
+     * When dst is a direct ByteBuffer, bytes are copied straight from the
+     * buffer into native memory without an intermediate byte array. Heap
+     * ByteBuffers are filled in place through region copies into their
+     * backing array. Returns the number of bytes read; zero when the buffer
+     * is empty or dst has no space remaining.
+     *
+     * Throws ReadOnlyBufferException when dst is read-only; no bytes are
+     * removed from the buffer in that case.
+     *
+     * See also: jb_read in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static long ReadInto(BufferProxy buf, ByteBuffer dst) {
+        int position = dst.position();
+        int length = dst.remaining();
+        long read_amount;
+
+        // Check before reading anything: once bytes leave the ring there's
+        // no way to put them back.
+        if (dst.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+
+        if (length == 0) {
+            return 0;
+        }
+
+        if (dst.isDirect()) {
+            read_amount = ReadDirect(buf, dst, position, length);
+        } else if (dst.hasArray()) {
+            read_amount = ReadArray(buf, dst.array(), dst.arrayOffset() + position, length);
+        } else {
+            // Writable buffers without an accessible backing array: stage
+            // the bytes through a temporary array.
+            byte[] data = Read(buf, length);
+            dst.put(data);
+            return data.length;
+        }
+
+        if (read_amount > 0) {
+            dst.position(position + (int) read_amount);
+        }
+
+        return read_amount;
+    }
+
+    /**
+     * Write the remaining bytes of the specified ByteBuffer into the buffer,
+     * advancing its position by the number of bytes written.
+     *
+     * When src is a direct ByteBuffer, bytes are copied straight from native
+     * memory into the buffer without an intermediate byte array. Heap
+     * ByteBuffers are consumed in place through region copies from their
+     * backing array. Returns
+     * the number of bytes written; zero when the buffer is full.
+     *
+     * See also: jb_write in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static long WriteFrom(BufferProxy buf, ByteBuffer src) {
+        int position = src.position();
+        int length = src.remaining();
+        long write_amount;
+
+        if (length == 0) {
+            return 0;
+        }
+
+        if (src.isDirect()) {
+            write_amount = WriteDirect(buf, src, position, length);
+        } else if (src.hasArray()) {
+            write_amount = WriteArray(buf, src.array(), src.arrayOffset() + position, length);
+        } else {
+            // Read-only heap buffers don't expose their backing array; copy
+            // out only as much as the buffer can currently accept.
+            length = (int) Math.min(length, WriteCapacity(buf));
+            byte[] data = new byte[length];
+            src.get(data);
+            write_amount = Write(buf, data);
+            src.position(position + (int) Math.max(0, write_amount));
+            return write_amount;
+        }
+
+        if (write_amount > 0) {
+            src.position(position + (int) write_amount);
+        }
+
+        return write_amount;
+    }
+
+    private static native long ReadDirect(BufferProxy buf, ByteBuffer dst, int offset, int length);
+    private static native long ReadArray(BufferProxy buf, byte[] dst, int offset, int length);
+    private static native long WriteDirect(BufferProxy buf, ByteBuffer src, int offset, int length);
+    private static native long WriteArray(BufferProxy buf, byte[] src, int offset, int length);
+
+    /**
+     * Get a view of the largest contiguous span of readable bytes in the
+     * buffer, without copying them. Returns null when the buffer is empty.
+     *
+     * The returned direct ByteBuffer aliases native memory owned by the
+     * buffer: it must not be used after any other call modifies the buffer,
+     * or after the buffer is freed. Call Consume(...) to mark bytes from
+     * the span as read.
+     *
+     * See also: jb_peek_read in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static native ByteBuffer PeekRead(BufferProxy buf);
+
+    /**
+     * Mark up to the specified number of bytes of the current readable span
+     * as read. Returns the number of bytes consumed.
+     *
+     * See also: jb_consume in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static native long Consume(BufferProxy buf, long amount);
+
+    /**
+     * Get a view of the largest contiguous span of writable space in the
+     * buffer. Returns null when the buffer is full.
+     *
+     * The same lifetime restrictions as PeekRead(...) apply. Bytes placed
+     * into the span only become readable after a call to Commit(...).
+     *
+     * See also: jb_peek_write in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static native ByteBuffer PeekWrite(BufferProxy buf);
+
+    /**
+     * Mark up to the specified number of bytes at the start of the current
+     * writable span as written. Returns the number of bytes committed.
+     *
+     * See also: jb_commit in org/mozilla/jss/ssl/javax/j_buffer.h
+     */
+    public static native long Commit(BufferProxy buf, long amount);
+
     /**
      * Get a single character from the buffer.
      *
@@ -74,9 +246,41 @@ public class Buffer {
     public static native int Put(BufferProxy buf, byte input);
 
     /**
-     * Destroy a buffer object, freeing its resources.
+     * Destroy a buffer object, returning it to the shared pool. Its
+     * contents are wiped first; when the pool is already full, the buffer
+     * is freed instead.
      *
-     * See also: jb_free in org/mozilla/jss/ssl/javax/j_buffer.h
+     * See also: jb_pool_return in org/mozilla/jss/ssl/javax/j_buffer_pool.h
      */
     public static native void Free(BufferProxy buf);
+
+    /**
+     * Get the maximum number of idle buffers kept by the shared pool.
+     *
+     * See also: jb_pool_get_limit in
+     * org/mozilla/jss/ssl/javax/j_buffer_pool.h
+     */
+    public static native long GetPoolLimit();
+
+    /**
+     * Set the maximum number of idle buffers kept by the shared pool; zero
+     * disables pooling.
+     *
+     * See also: jb_pool_set_limit in
+     * org/mozilla/jss/ssl/javax/j_buffer_pool.h
+     */
+    public static native void SetPoolLimit(long limit);
+
+    /**
+     * Get a snapshot of the shared pool's usage counters.
+     *
+     * See also: jb_pool_get_stats in
+     * org/mozilla/jss/ssl/javax/j_buffer_pool.h
+     */
+    public static BufferPoolStats GetPoolStats() {
+        long[] stats = GetPoolStatsNative();
+        return new BufferPoolStats(stats[0], stats[1], stats[2], stats[3],
+                                   stats[4], stats[5]);
+    }
+    private static native long[] GetPoolStatsNative();
 }
@@ -0,0 +1,82 @@
+package org.mozilla.jss.nss;
+
+/**
+ * Class representing the j_buffer_pool_stats struct from
+ * org/mozilla/jss/ssl/javax/j_buffer_pool.h.
+ *
+ * This class is a data class; it contains public getters and no setters.
+ * It usually should be constructed via a call to Buffer.GetPoolStats()
+ * rather than directly constructing an instance. The values are a snapshot
+ * and are not updated afterwards.
+ */
+public class BufferPoolStats {
+    private long leased;
+    private long leasedHighWater;
+    private long idle;
+    private long idleHighWater;
+    private long hits;
+    private long misses;
+
+    public BufferPoolStats(long leased, long leasedHighWater, long idle,
+                           long idleHighWater, long hits, long misses)
+    {
+        this.leased = leased;
+        this.leasedHighWater = leasedHighWater;
+        this.idle = idle;
+        this.idleHighWater = idleHighWater;
+        this.hits = hits;
+        this.misses = misses;
+    }
+
+    /**
+     * Number of buffers currently leased out of the pool.
+     */
+    public long getLeased() {
+        return leased;
+    }
+
+    /**
+     * Largest number of buffers ever leased out of the pool at once.
+     */
+    public long getLeasedHighWater() {
+        return leasedHighWater;
+    }
+
+    /**
+     * Number of idle buffers currently held by the pool.
+     */
+    public long getIdle() {
+        return idle;
+    }
+
+    /**
+     * Largest number of idle buffers ever held by the pool.
+     */
+    public long getIdleHighWater() {
+        return idleHighWater;
+    }
+
+    /**
+     * Number of leases satisfied by reusing an idle buffer.
+     */
+    public long getHits() {
+        return hits;
+    }
+
+    /**
+     * Number of leases which required allocating a new buffer.
+     */
+    public long getMisses() {
+        return misses;
+    }
+
+    @Override
+    public String toString() {
+        return "BufferPoolStats [leased=" + leased +
+               ", leasedHighWater=" + leasedHighWater +
+               ", idle=" + idle +
+               ", idleHighWater=" + idleHighWater +
+               ", hits=" + hits +
+               ", misses=" + misses + "]";
+    }
+}
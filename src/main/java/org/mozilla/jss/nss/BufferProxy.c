@@ -4,40 +4,21 @@
 #include "java_ids.h"
 #include "jssutil.h"
 #include "BufferProxy.h"
+#include "j_buffer_pool.h"
 
 jobject
 JSS_PR_wrapJBuffer(JNIEnv *env, j_buffer **buffer)
 {
-    jbyteArray pointer = NULL;
-    jclass proxyClass;
-    jmethodID constructor;
     jobject bufferObj = NULL;
 
     PR_ASSERT(env != NULL && buffer != NULL && *buffer != NULL);
-
-    /* convert pointer to byte array */
-    pointer = JSS_ptrToByteArray(env, *buffer);
-
-    /*
-     * Lookup the class and constructor
-     */
-    proxyClass = (*env)->FindClass(env, BUFFER_PROXY_CLASS_NAME);
-    if(proxyClass == NULL) {
-        ASSERT_OUTOFMEM(env);
-        goto finish;
-    }
-    constructor = (*env)->GetMethodID(env, proxyClass,
-                            PLAIN_CONSTRUCTOR,
-                            BUFFER_PROXY_CONSTRUCTOR_SIG);
-    if(constructor == NULL) {
-        ASSERT_OUTOFMEM(env);
-        goto finish;
-    }
+    PR_ASSERT(JSS_javaIDs.bufferProxyConstructor != NULL);
 
     /* call the constructor */
-    bufferObj = (*env)->NewObject(env, proxyClass, constructor, pointer);
+    bufferObj = (*env)->NewObject(env, JSS_javaIDs.bufferProxyClass,
+                                  JSS_javaIDs.bufferProxyConstructor,
+                                  JSS_ptrToHandle(*buffer));
 
-finish:
     *buffer = NULL;
 
     PR_ASSERT(bufferObj || (*env)->ExceptionOccurred(env));
@@ -49,3 +30,11 @@ JSS_PR_unwrapJBuffer(JNIEnv *env, jobject buffer_proxy, j_buffer **buffer)
 {
     return JSS_getPtrFromProxy(env, buffer_proxy, (void**)buffer);
 }
+
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_nss_BufferProxy_releaseHandle(JNIEnv *env, jclass clazz,
+    jlong handle)
+{
+    /* Buffers are always leased from the pool by Buffer.Create*. */
+    jb_pool_return(JSS_handleToPtr(handle));
+}
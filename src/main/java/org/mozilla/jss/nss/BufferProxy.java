@@ -2,7 +2,11 @@ package org.mozilla.jss.nss;
 
 public class BufferProxy extends org.mozilla.jss.util.NativeProxy {
     public BufferProxy(byte[] pointer) {
-        super(pointer);
+        super(pointer, BufferProxy::releaseHandle);
+    }
+
+    public BufferProxy(long handle) {
+        super(handle, BufferProxy::releaseHandle);
     }
 
     /**
@@ -16,8 +20,5 @@ public class BufferProxy extends org.mozilla.jss.util.NativeProxy {
         Buffer.Free(this);
     }
 
-    @Override
-    protected void finalize() throws Throwable {
-        super.finalize();
-    }
+    private static native void releaseHandle(long handle);
 }
@@ -22,9 +22,10 @@ public abstract class CertAuthHandler implements Runnable {
 
     /**
      * Whether or not the check operation has been executed
-     * yet, when invoked via run().
+     * yet, when invoked via run(). Volatile as run() may be
+     * invoked from another thread; result is set beforehand.
      */
-    public boolean finished;
+    public volatile boolean finished;
 
     /**
      * SSLFDProxy instance.
@@ -0,0 +1,81 @@
+package org.mozilla.jss.nss;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Scratch space describing the regions of a set of ByteBuffers gathered
+ * into a single PR_Writev call; see PR.Writev and SSL.WrapStep.
+ *
+ * Each region is either a direct ByteBuffer or a byte array, with the
+ * offset and length of the bytes to write. An IOVector may be reused for
+ * successive writes, but not shared between threads.
+ */
+class IOVector {
+    Object[] buffers = new Object[PR.MAX_IOVECTOR_SIZE];
+    int[] offsets = new int[PR.MAX_IOVECTOR_SIZE];
+    int[] lengths = new int[PR.MAX_IOVECTOR_SIZE];
+    int[] indices = new int[PR.MAX_IOVECTOR_SIZE];
+
+    /**
+     * Gather the remaining bytes of srcs[offset] through
+     * srcs[offset + length - 1], skipping null and empty buffers, up to
+     * MAX_IOVECTOR_SIZE buffers and max_amount bytes. Returns the number of
+     * regions gathered.
+     */
+    int gather(ByteBuffer[] srcs, int offset, int length, int max_amount) {
+        int count = 0;
+        int gathered = 0;
+
+        for (int index = offset; index < offset + length; index++) {
+            if (count == PR.MAX_IOVECTOR_SIZE || gathered >= max_amount) {
+                break;
+            }
+
+            ByteBuffer src = srcs[index];
+            if (src == null || !src.hasRemaining()) {
+                continue;
+            }
+
+            int amount = Math.min(src.remaining(), max_amount - gathered);
+            if (src.isDirect()) {
+                buffers[count] = src;
+                offsets[count] = src.position();
+            } else if (src.hasArray()) {
+                buffers[count] = src.array();
+                offsets[count] = src.arrayOffset() + src.position();
+            } else {
+                // Read-only heap buffers don't expose their backing array;
+                // copy out the region without disturbing the position.
+                byte[] copy = new byte[amount];
+                src.duplicate().get(copy);
+                buffers[count] = copy;
+                offsets[count] = 0;
+            }
+
+            lengths[count] = amount;
+            indices[count] = index;
+            gathered += amount;
+            count += 1;
+        }
+
+        return count;
+    }
+
+    /**
+     * Advance the position of each of the count gathered source buffers
+     * past the bytes actually written, and drop our references to them.
+     */
+    void advance(ByteBuffer[] srcs, int count, int written) {
+        int remaining = written;
+        for (int i = 0; i < count; i++) {
+            if (remaining > 0) {
+                ByteBuffer src = srcs[indices[i]];
+                int advance = Math.min(remaining, lengths[i]);
+                src.position(src.position() + advance);
+                remaining -= advance;
+            }
+
+            buffers[i] = null;
+        }
+    }
+}
@@ -284,6 +284,123 @@ done:
     return result;
 }
 
+PRInt32
+JSS_PR_Writev(JNIEnv *env, PRFileDesc *real_fd, jobjectArray buffers,
+    jintArray offsets, jintArray lengths, jint count)
+{
+    PRIOVec iov[PR_MAX_IOVECTOR_SIZE];
+    jint iov_offsets[PR_MAX_IOVECTOR_SIZE];
+    jint iov_lengths[PR_MAX_IOVECTOR_SIZE];
+    PRBool is_heap[PR_MAX_IOVECTOR_SIZE];
+    size_t heap_length = 0;
+    uint8_t *scratch = NULL;
+    PRInt32 result = -1;
+
+    PR_ASSERT(env != NULL && real_fd != NULL && buffers != NULL &&
+              offsets != NULL && lengths != NULL);
+
+    if (count < 0 || count > PR_MAX_IOVECTOR_SIZE) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return -1;
+    }
+
+    (*env)->GetIntArrayRegion(env, offsets, 0, count, iov_offsets);
+    (*env)->GetIntArrayRegion(env, lengths, 0, count, iov_lengths);
+    if ((*env)->ExceptionCheck(env)) {
+        return -1;
+    }
+
+    /* First pass: resolve direct buffers in place and size the scratch
+     * space needed to hold the contents of every heap array. */
+    for (jint i = 0; i < count; i++) {
+        jobject buffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        uint8_t *address = NULL;
+
+        if (buffer == NULL || iov_offsets[i] < 0 || iov_lengths[i] < 0) {
+            JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+            return -1;
+        }
+
+        address = (*env)->GetDirectBufferAddress(env, buffer);
+        is_heap[i] = address == NULL;
+
+        if (is_heap[i]) {
+            heap_length += iov_lengths[i];
+        } else {
+            jlong capacity = (*env)->GetDirectBufferCapacity(env, buffer);
+            if ((jlong)iov_offsets[i] + iov_lengths[i] > capacity) {
+                (*env)->DeleteLocalRef(env, buffer);
+                JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+                return -1;
+            }
+
+            iov[i].iov_base = (char *)(address + iov_offsets[i]);
+            iov[i].iov_len = iov_lengths[i];
+        }
+
+        (*env)->DeleteLocalRef(env, buffer);
+    }
+
+    /* Second pass: copy each heap array region into the scratch space. We
+     * can't pin the arrays with GetPrimitiveArrayCritical here, as NSS may
+     * call back into Java (e.g., alert callbacks) during PR_Writev. */
+    if (heap_length > 0) {
+        size_t cursor = 0;
+
+        scratch = PR_Malloc(heap_length);
+        if (scratch == NULL) {
+            JSS_throw(env, OUT_OF_MEMORY_ERROR);
+            return -1;
+        }
+
+        for (jint i = 0; i < count; i++) {
+            jbyteArray array = NULL;
+
+            if (!is_heap[i]) {
+                continue;
+            }
+
+            array = (*env)->GetObjectArrayElement(env, buffers, i);
+            (*env)->GetByteArrayRegion(env, array, iov_offsets[i],
+                                       iov_lengths[i],
+                                       (jbyte *)(scratch + cursor));
+            (*env)->DeleteLocalRef(env, array);
+            if ((*env)->ExceptionCheck(env)) {
+                goto done;
+            }
+
+            iov[i].iov_base = (char *)(scratch + cursor);
+            iov[i].iov_len = iov_lengths[i];
+            cursor += iov_lengths[i];
+        }
+    }
+
+    result = PR_Writev(real_fd, iov, count, PR_INTERVAL_NO_TIMEOUT);
+
+done:
+    PR_Free(scratch);
+    return result;
+}
+
+JNIEXPORT int JNICALL
+Java_org_mozilla_jss_nss_PR_WritevNative(JNIEnv *env, jclass clazz, jobject fd,
+    jobjectArray buffers, jintArray offsets, jintArray lengths, jint count)
+{
+    PRFileDesc *real_fd = NULL;
+
+    PR_ASSERT(env != NULL && fd != NULL && buffers != NULL &&
+              offsets != NULL && lengths != NULL);
+    PR_SetError(0, 0);
+
+    if (JSS_PR_getPRFileDesc(env, fd, &real_fd) != PR_SUCCESS) {
+        return -1;
+    }
+
+    PR_ASSERT(real_fd != NULL);
+
+    return JSS_PR_Writev(env, real_fd, buffers, offsets, lengths, count);
+}
+
 JNIEXPORT int JNICALL
 Java_org_mozilla_jss_nss_PR_Send(JNIEnv *env, jclass clazz, jobject fd,
     jbyteArray buf, jint flags, jlong timeout)
@@ -396,3 +513,9 @@ Java_org_mozilla_jss_nss_PR_getPRFailure(JNIEnv *env, jclass clazz)
 {
     return PR_FAILURE;
 }
+
+JNIEXPORT int JNICALL
+Java_org_mozilla_jss_nss_PR_getPRMaxIOVectorSize(JNIEnv *env, jclass clazz)
+{
+    return PR_MAX_IOVECTOR_SIZE;
+}
@@ -1,5 +1,7 @@
 package org.mozilla.jss.nss;
 
+import java.nio.ByteBuffer;
+
 /**
  * This class provides static access to raw NSPS calls with the PR prefix,
  * and handles the usage of NativeProxy objects.
@@ -41,6 +43,14 @@ public class PR {
      */
     public static final int FAILURE = getPRFailure();
 
+    /**
+     * Maximum number of buffers which can be gathered in a single Writev
+     * call.
+     *
+     * See also: PR_MAX_IOVECTOR_SIZE in /usr/include/nspr4/prio.h
+     */
+    public static final int MAX_IOVECTOR_SIZE = getPRMaxIOVectorSize();
+
     /**
      * Open the file at name (with the specified flags and mode) and create
      * a new PRFDProxy (to a NSPR PRFileDesc *) for that file.
@@ -136,6 +146,40 @@ public class PR {
      */
     public static native int Write(PRFDProxy fd, byte[] buf);
 
+    /**
+     * Gather the remaining bytes of srcs[offset] through
+     * srcs[offset + length - 1] and write them to the PRFDProxy with a
+     * single PR_Writev call, crossing the JNI boundary once. Null and empty
+     * buffers are skipped; at most MAX_IOVECTOR_SIZE buffers and max_amount
+     * bytes are gathered per call.
+     *
+     * Direct buffers are handed to NSPR without copying; heap buffers are
+     * copied once on the native side. The position of each source buffer
+     * is advanced past the bytes actually written; when the write fails
+     * (a negative return value), no positions are changed and GetError()
+     * describes the failure. Returns zero without calling into NSPR when
+     * there is nothing to write.
+     *
+     * See also: PR_Writev in /usr/include/nspr4/prio.h
+     */
+    public static int Writev(PRFDProxy fd, ByteBuffer[] srcs, int offset,
+                             int length, int max_amount)
+    {
+        IOVector iov = new IOVector();
+        int count = iov.gather(srcs, offset, length, max_amount);
+        if (count == 0) {
+            return 0;
+        }
+
+        int result = WritevNative(fd, iov.buffers, iov.offsets, iov.lengths,
+                                  count);
+        iov.advance(srcs, count, result);
+        return result;
+    }
+    private static native int WritevNative(PRFDProxy fd, Object[] buffers,
+                                           int[] offsets, int[] lengths,
+                                           int count);
+
     /**
      * Send the specified bytes via the PRFDProxy, given the specified
      * send flags and timeout value.
@@ -191,4 +235,5 @@ public class PR {
     private static native int getPRShutdownBoth();
     private static native int getPRSuccess();
     private static native int getPRFailure();
+    private static native int getPRMaxIOVectorSize();
 }
@@ -11,3 +11,9 @@ jobject JSS_PR_wrapSSLFDProxy(JNIEnv *env, PRFileDesc **fd);
 
 /* Extract the C/NSPR PRFileDesc from an instance of a Java PRFDProxy. */
 PRStatus JSS_PR_getPRFileDesc(JNIEnv *env, jobject prfd_proxy, PRFileDesc **fd);
+
+/* Gather count regions of direct ByteBuffers and byte arrays, as described
+ * by PR.Writev, and write them to fd with a single PR_Writev call. Returns
+ * the result of PR_Writev, or -1 with a Java exception pending. */
+PRInt32 JSS_PR_Writev(JNIEnv *env, PRFileDesc *fd, jobjectArray buffers,
+                      jintArray offsets, jintArray lengths, jint count);
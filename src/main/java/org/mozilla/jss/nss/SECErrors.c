@@ -54,3 +54,9 @@ Java_org_mozilla_jss_nss_SECErrors_getUntrustedCert(JNIEnv *env, jclass clazz)
 {
     return SEC_ERROR_UNTRUSTED_CERT;
 }
+
+JNIEXPORT int JNICALL
+Java_org_mozilla_jss_nss_SECErrors_getBadSignature(JNIEnv *env, jclass clazz)
+{
+    return SEC_ERROR_BAD_SIGNATURE;
+}
@@ -57,6 +57,13 @@ public class SECErrors {
      */
     public static final int UNTRUSTED_CERT = getUntrustedCert();
 
+    /**
+     * Signature did not verify.
+     *
+     * See also: SEC_ERROR_BAD_SIGNATURE in /usr/include/nss3/secerr.h
+     */
+    public static final int BAD_SIGNATURE = getBadSignature();
+
     private static native int getBadDER();
     private static native int getExpiredCertificate();
     private static native int getCertNotValid();
@@ -64,4 +71,5 @@ public class SECErrors {
     private static native int getRevokedCertificate();
     private static native int getUntrustedIssuer();
     private static native int getUntrustedCert();
+    private static native int getBadSignature();
 }
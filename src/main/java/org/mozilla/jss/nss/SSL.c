@@ -13,6 +13,7 @@
 #include "jss_exceptions.h"
 #include "jssutil.h"
 #include "pk11util.h"
+#include "BufferProxy.h"
 #include "PRFDProxy.h"
 #include "SSLFDProxy.h"
 #include "SSLVersionRange.h"
@@ -1030,6 +1031,289 @@ Java_org_mozilla_jss_nss_SSL_EnableHandshakeCallback(JNIEnv *env, jclass clazz,
     return SSL_HandshakeCallback(real_fd, JSSL_SSLFDHandshakeComplete, fd_ref);
 }
 
+/* Indices into the status array of an SSLStepResult; these must match the
+ * constants in SSLStepResult.java. */
+#define STEP_CONSUMED 0
+#define STEP_PRODUCED 1
+#define STEP_HANDSHAKE_RESULT 2
+#define STEP_HANDSHAKE_ERROR 3
+#define STEP_ERROR 4
+#define STEP_READ_PENDING 5
+#define STEP_WRITE_PENDING 6
+#define STEP_STATUS_SIZE 7
+
+/* Largest amount of plaintext a single TLS record carries; application
+ * data bound for a byte array is read through a scratch buffer this big. */
+#define STEP_SCRATCH_SIZE 16384
+
+/* Check the region [offset, offset + length) of a direct ByteBuffer or
+ * byte array passed to UnwrapStep or WrapStep. For a direct ByteBuffer,
+ * *addr is set to the start of the region; for a byte array, it is left
+ * NULL and the region is copied with Get/SetByteArrayRegion instead. */
+static PRStatus
+JSS_SSL_getStepRegion(JNIEnv *env, jobject buffer, jint offset, jint length,
+    uint8_t **addr)
+{
+    jlong capacity = 0;
+
+    *addr = NULL;
+    if (buffer == NULL || length == 0) {
+        return PR_SUCCESS;
+    }
+
+    if (offset < 0 || length < 0) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return PR_FAILURE;
+    }
+
+    *addr = (*env)->GetDirectBufferAddress(env, buffer);
+    if (*addr != NULL) {
+        capacity = (*env)->GetDirectBufferCapacity(env, buffer);
+    } else {
+        capacity = (*env)->GetArrayLength(env, buffer);
+    }
+
+    if (offset + (jlong) length > capacity) {
+        JSS_throw(env, INDEX_OUT_OF_BOUNDS_EXCEPTION);
+        return PR_FAILURE;
+    }
+
+    if (*addr != NULL) {
+        *addr += offset;
+    }
+
+    return PR_SUCCESS;
+}
+
+/* Step the handshake when asked to, then record how much data is left in
+ * each buffer; common to UnwrapStep and WrapStep. */
+static void
+JSS_SSL_stepHandshake(PRFileDesc *real_fd, j_buffer *read_buf,
+    j_buffer *write_buf, jboolean step_handshake, jint *result)
+{
+    result[STEP_HANDSHAKE_RESULT] = SECSuccess;
+    result[STEP_HANDSHAKE_ERROR] = 0;
+
+    if (step_handshake) {
+        PR_SetError(0, 0);
+        if (SSL_ForceHandshake(real_fd) != SECSuccess) {
+            result[STEP_HANDSHAKE_RESULT] = SECFailure;
+            result[STEP_HANDSHAKE_ERROR] = PR_GetError();
+        }
+    }
+
+    result[STEP_READ_PENDING] = jb_read_capacity(read_buf);
+    result[STEP_WRITE_PENDING] = jb_read_capacity(write_buf);
+}
+
+/* Store result into the Java status array, even when an exception is
+ * pending: UnwrapStep and WrapStep need to know how much data reached NSS
+ * before the throw, or they would hand the same bytes to NSS again. */
+static void
+JSS_SSL_setStepStatus(JNIEnv *env, jintArray status, const jint *result)
+{
+    jthrowable pending = (*env)->ExceptionOccurred(env);
+
+    if (pending != NULL) {
+        (*env)->ExceptionClear(env);
+    }
+
+    (*env)->SetIntArrayRegion(env, status, 0, STEP_STATUS_SIZE, result);
+
+    if (pending != NULL) {
+        (*env)->Throw(env, pending);
+        (*env)->DeleteLocalRef(env, pending);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_nss_SSL_UnwrapStepNative(JNIEnv *env, jclass clazz,
+    jobject fd, jobject read_buf, jobject write_buf, jobject src,
+    jint src_offset, jint src_length, jobject dst, jint dst_offset,
+    jint dst_length, jboolean step_handshake, jintArray status)
+{
+    PRFileDesc *real_fd = NULL;
+    j_buffer *real_read_buf = NULL;
+    j_buffer *real_write_buf = NULL;
+    uint8_t *src_addr = NULL;
+    uint8_t *dst_addr = NULL;
+    uint8_t scratch[STEP_SCRATCH_SIZE];
+    jint result[STEP_STATUS_SIZE] = { 0 };
+    jint read_amount = 0;
+
+    PR_ASSERT(env != NULL && fd != NULL && read_buf != NULL &&
+              write_buf != NULL && status != NULL);
+    PR_SetError(0, 0);
+
+    if (JSS_PR_getPRFileDesc(env, fd, &real_fd) != PR_SUCCESS ||
+            JSS_PR_unwrapJBuffer(env, read_buf, &real_read_buf) != PR_SUCCESS ||
+            JSS_PR_unwrapJBuffer(env, write_buf, &real_write_buf) != PR_SUCCESS) {
+        goto done;
+    }
+
+    if (JSS_SSL_getStepRegion(env, src, src_offset, src_length, &src_addr) != PR_SUCCESS ||
+            JSS_SSL_getStepRegion(env, dst, dst_offset, dst_length, &dst_addr) != PR_SUCCESS) {
+        goto done;
+    }
+
+    /* Hand NSS as much of the peer's wire data as read_buf can hold. */
+    if (src_addr != NULL) {
+        result[STEP_CONSUMED] = jb_write(real_read_buf, src_addr, src_length);
+    } else if (src != NULL) {
+        while (result[STEP_CONSUMED] < src_length) {
+            size_t span_size = 0;
+            uint8_t *span = jb_peek_write(real_read_buf, &span_size);
+            if (span == NULL) {
+                break;
+            }
+
+            if (span_size > (size_t) (src_length - result[STEP_CONSUMED])) {
+                span_size = src_length - result[STEP_CONSUMED];
+            }
+
+            (*env)->GetByteArrayRegion(env, src,
+                src_offset + result[STEP_CONSUMED], span_size, (jbyte *) span);
+            if ((*env)->ExceptionCheck(env)) {
+                goto done;
+            }
+
+            result[STEP_CONSUMED] += jb_commit(real_read_buf, span_size);
+        }
+    }
+
+    JSS_SSL_stepHandshake(real_fd, real_read_buf, real_write_buf,
+                          step_handshake, result);
+
+    /* Read application data until dst is full or NSS would block. Like
+     * PR.Read, we keep reading after a short read, as NSS only returns a
+     * single record's worth of data at a time. */
+    PR_SetError(0, 0);
+    while (read_amount < dst_length) {
+        jint amount = dst_length - read_amount;
+        uint8_t *target = dst_addr != NULL ? dst_addr + read_amount : scratch;
+        PRInt32 this_read = 0;
+
+        if (dst_addr == NULL && amount > STEP_SCRATCH_SIZE) {
+            amount = STEP_SCRATCH_SIZE;
+        }
+
+        this_read = PR_Read(real_fd, target, amount);
+        if (this_read <= 0) {
+            PRErrorCode error = PR_GetError();
+
+            /* Blocking after we've read something just means that we've
+             * read everything available. */
+            if (this_read < 0 &&
+                    !(error == PR_WOULD_BLOCK_ERROR && read_amount > 0)) {
+                result[STEP_ERROR] = error;
+            }
+
+            if (read_amount == 0) {
+                result[STEP_PRODUCED] = this_read;
+            }
+
+            break;
+        }
+
+        if (dst_addr == NULL) {
+            (*env)->SetByteArrayRegion(env, dst, dst_offset + read_amount,
+                this_read, (const jbyte *) scratch);
+            if ((*env)->ExceptionCheck(env)) {
+                goto done;
+            }
+        }
+
+        read_amount += this_read;
+        result[STEP_PRODUCED] = read_amount;
+    }
+
+done:
+    JSS_SSL_setStepStatus(env, status, result);
+}
+
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_nss_SSL_WrapStepNative(JNIEnv *env, jclass clazz,
+    jobject fd, jobject read_buf, jobject write_buf, jobjectArray buffers,
+    jintArray offsets, jintArray lengths, jint count, jobject dst,
+    jint dst_offset, jint dst_length, jboolean step_handshake,
+    jintArray status)
+{
+    PRFileDesc *real_fd = NULL;
+    j_buffer *real_read_buf = NULL;
+    j_buffer *real_write_buf = NULL;
+    uint8_t *dst_addr = NULL;
+    uint8_t dummy_buffer = 0;
+    jint result[STEP_STATUS_SIZE] = { 0 };
+
+    PR_ASSERT(env != NULL && fd != NULL && read_buf != NULL &&
+              write_buf != NULL && buffers != NULL && offsets != NULL &&
+              lengths != NULL && status != NULL);
+    PR_SetError(0, 0);
+
+    if (JSS_PR_getPRFileDesc(env, fd, &real_fd) != PR_SUCCESS ||
+            JSS_PR_unwrapJBuffer(env, read_buf, &real_read_buf) != PR_SUCCESS ||
+            JSS_PR_unwrapJBuffer(env, write_buf, &real_write_buf) != PR_SUCCESS) {
+        goto done;
+    }
+
+    if (JSS_SSL_getStepRegion(env, dst, dst_offset, dst_length, &dst_addr) != PR_SUCCESS) {
+        goto done;
+    }
+
+    JSS_SSL_stepHandshake(real_fd, real_read_buf, real_write_buf,
+                          step_handshake, result);
+
+    /* Hand NSS the application data to send. */
+    PR_SetError(0, 0);
+    if (count > 0) {
+        result[STEP_CONSUMED] = JSS_PR_Writev(env, real_fd, buffers, offsets,
+                                              lengths, count);
+        if ((*env)->ExceptionCheck(env)) {
+            /* A callback may have thrown after NSS accepted the data. */
+            goto done;
+        }
+
+        if (result[STEP_CONSUMED] < 0) {
+            result[STEP_ERROR] = PR_GetError();
+        }
+    }
+
+    /* When nothing was written, make an empty write anyways so that NSS
+     * flushes any records (such as alerts) it has buffered internally. */
+    if (result[STEP_CONSUMED] == 0) {
+        PR_Write(real_fd, &dummy_buffer, 0);
+    }
+
+    /* Move as much of the resulting wire data as fits into dst. */
+    if (dst_addr != NULL) {
+        result[STEP_PRODUCED] = jb_read(real_write_buf, dst_addr, dst_length);
+    } else if (dst != NULL) {
+        while (result[STEP_PRODUCED] < dst_length) {
+            size_t span_size = 0;
+            const uint8_t *span = jb_peek_read(real_write_buf, &span_size);
+            if (span == NULL) {
+                break;
+            }
+
+            if (span_size > (size_t) (dst_length - result[STEP_PRODUCED])) {
+                span_size = dst_length - result[STEP_PRODUCED];
+            }
+
+            (*env)->SetByteArrayRegion(env, dst,
+                dst_offset + result[STEP_PRODUCED], span_size,
+                (const jbyte *) span);
+            if ((*env)->ExceptionCheck(env)) {
+                goto done;
+            }
+
+            result[STEP_PRODUCED] += jb_consume(real_write_buf, span_size);
+        }
+    }
+
+done:
+    JSS_SSL_setStepStatus(env, status, result);
+}
+
 JNIEXPORT jint JNICALL
 Java_org_mozilla_jss_nss_SSL_getSSLRequestCertificate(JNIEnv *env, jclass clazz)
 {
@@ -1108,6 +1392,12 @@ Java_org_mozilla_jss_nss_SSL_getSSLEnableFallbackSCSV(JNIEnv *env, jclass clazz)
     return SSL_ENABLE_FALLBACK_SCSV;
 }
 
+JNIEXPORT jint JNICALL
+Java_org_mozilla_jss_nss_SSL_getSSLRecordSizeLimit(JNIEnv *env, jclass clazz)
+{
+    return SSL_RECORD_SIZE_LIMIT;
+}
+
 JNIEXPORT jint JNICALL
 Java_org_mozilla_jss_nss_SSL_getSSLRequireNever(JNIEnv *env, jclass clazz)
 {
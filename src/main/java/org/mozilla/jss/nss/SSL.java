@@ -5,7 +5,10 @@ package org.mozilla.jss.nss;
  * and handles the usage of NativeProxy objects.
  */
 
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
 import java.util.ArrayList;
+import java.util.Arrays;
 
 import org.mozilla.jss.pkcs11.PK11Cert;
 import org.mozilla.jss.pkcs11.PK11PrivKey;
@@ -120,6 +123,15 @@ public class SSL {
      */
     public static final int ENABLE_FALLBACK_SCSV = getSSLEnableFallbackSCSV();
 
+    /**
+     * Option for limiting the size of records the peer may send us, via the
+     * record_size_limit extension. Value for use with OptionGet and
+     * OptionSet.
+     *
+     * See also: SSL_RECORD_SIZE_LIMIT in /usr/include/nss3/ssl.h
+     */
+    public static final int RECORD_SIZE_LIMIT = getSSLRecordSizeLimit();
+
     /**
      * Value for never requiring a certificate. Value for use with
      * SSL_REQUIRE_CERTIFICATE with OptionGet and OptionSet.
@@ -519,6 +531,151 @@ public class SSL {
      */
     public static native int EnableHandshakeCallback(SSLFDProxy fd);
 
+    /**
+     * Perform one step of an SSLEngine unwrap with a single JNI call:
+     * write the remaining bytes of src (wire data from the peer) into
+     * read_buf, step the handshake with SSL_ForceHandshake when
+     * step_handshake is set, then PR_Read application data into the
+     * remaining space of dst until it is full or NSS would block.
+     *
+     * Either of src and dst may be null. The positions of src and dst are
+     * advanced past the bytes consumed and produced, even should the step
+     * throw part way; the outcome of the step is stored in result. Direct
+     * ByteBuffers are accessed in place; heap ByteBuffers are copied
+     * through their backing arrays. Meant for non-blocking fds, such as
+     * those backed by a BufferPRFD.
+     *
+     * See also: SSL_ForceHandshake in /usr/include/nss3/ssl.h and
+     *           PR_Read in /usr/include/nspr4/prio.h
+     */
+    public static void UnwrapStep(SSLFDProxy fd, BufferProxy read_buf,
+                                  BufferProxy write_buf, ByteBuffer src,
+                                  ByteBuffer dst, boolean step_handshake,
+                                  SSLStepResult result)
+    {
+        Object src_buffer = null;
+        int src_offset = 0;
+        int src_length = 0;
+
+        if (src != null && src.hasRemaining()) {
+            src_length = src.remaining();
+            if (src.isDirect()) {
+                src_buffer = src;
+                src_offset = src.position();
+            } else if (src.hasArray()) {
+                src_buffer = src.array();
+                src_offset = src.arrayOffset() + src.position();
+            } else {
+                // Read-only heap buffers don't expose their backing array;
+                // copy out the region without disturbing the position.
+                byte[] copy = new byte[src_length];
+                src.duplicate().get(copy);
+                src_buffer = copy;
+            }
+        }
+
+        Object dst_buffer = stepBuffer(dst);
+        int dst_offset = dst_buffer == null ? 0 : stepOffset(dst);
+        int dst_length = dst_buffer == null ? 0 : dst.remaining();
+
+        // As in WrapStep, the native step stores its status even when it
+        // throws, so that wire data already in read_buf isn't fed to NSS
+        // twice on retry.
+        Arrays.fill(result.status, 0);
+        try {
+            UnwrapStepNative(fd, read_buf, write_buf, src_buffer, src_offset,
+                             src_length, dst_buffer, dst_offset, dst_length,
+                             step_handshake, result.status);
+        } finally {
+            result.unpack();
+
+            if (result.consumed > 0) {
+                src.position(src.position() + result.consumed);
+            }
+
+            if (result.produced > 0) {
+                dst.position(dst.position() + result.produced);
+            }
+        }
+    }
+
+    /**
+     * Perform one step of an SSLEngine wrap with a single JNI call: step
+     * the handshake with SSL_ForceHandshake when step_handshake is set,
+     * gather up to max_amount bytes of application data from
+     * srcs[offset] through srcs[offset + length - 1] into a single
+     * PR_Writev call (or make an empty PR_Write to flush NSS when there
+     * is nothing to write), then move as much of write_buf (wire data for
+     * the peer) as fits into dst.
+     *
+     * Either of srcs and dst may be null. The positions of the source
+     * buffers and dst are advanced past the bytes consumed and produced;
+     * the outcome of the step is stored in result. Should the step throw
+     * part way, the source buffers and dst are still advanced past the
+     * bytes NSS accepted and the wire data already copied out.
+     *
+     * See also: SSL_ForceHandshake in /usr/include/nss3/ssl.h and
+     *           PR_Writev in /usr/include/nspr4/prio.h
+     */
+    public static void WrapStep(SSLFDProxy fd, BufferProxy read_buf,
+                                BufferProxy write_buf, ByteBuffer[] srcs,
+                                int offset, int length, int max_amount,
+                                ByteBuffer dst, boolean step_handshake,
+                                SSLStepResult result)
+    {
+        IOVector iov = result.iov;
+        int count = srcs == null ? 0 : iov.gather(srcs, offset, length, max_amount);
+
+        Object dst_buffer = stepBuffer(dst);
+        int dst_offset = dst_buffer == null ? 0 : stepOffset(dst);
+        int dst_length = dst_buffer == null ? 0 : dst.remaining();
+
+        // The native step stores its status even when it throws, so that
+        // plaintext NSS has already accepted is never handed to it again;
+        // clear out the last step's status in case it throws before that.
+        Arrays.fill(result.status, 0);
+        try {
+            WrapStepNative(fd, read_buf, write_buf, iov.buffers, iov.offsets,
+                           iov.lengths, count, dst_buffer, dst_offset,
+                           dst_length, step_handshake, result.status);
+        } finally {
+            result.unpack();
+            iov.advance(srcs, count, result.consumed);
+
+            if (result.produced > 0) {
+                dst.position(dst.position() + result.produced);
+            }
+        }
+    }
+
+    /* The direct ByteBuffer or backing array a step writes into; null when
+     * dst is null or full. */
+    private static Object stepBuffer(ByteBuffer dst) {
+        if (dst == null || !dst.hasRemaining()) {
+            return null;
+        }
+
+        if (dst.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+
+        return dst.isDirect() ? dst : dst.array();
+    }
+
+    private static int stepOffset(ByteBuffer dst) {
+        return dst.isDirect() ? dst.position() : dst.arrayOffset() + dst.position();
+    }
+
+    private static native void UnwrapStepNative(SSLFDProxy fd,
+        BufferProxy read_buf, BufferProxy write_buf, Object src,
+        int src_offset, int src_length, Object dst, int dst_offset,
+        int dst_length, boolean step_handshake, int[] status);
+
+    private static native void WrapStepNative(SSLFDProxy fd,
+        BufferProxy read_buf, BufferProxy write_buf, Object[] buffers,
+        int[] offsets, int[] lengths, int count, Object dst, int dst_offset,
+        int dst_length, boolean step_handshake, int[] status);
+
     /* Internal methods for querying constants. */
     private static native int getSSLRequestCertificate();
     private static native int getSSLRequireCertificate();
@@ -533,6 +690,7 @@ public class SSL {
     private static native int getSSLRenegotiateRequiresXtn();
     private static native int getSSLRenegotiateTransitional();
     private static native int getSSLEnableFallbackSCSV();
+    private static native int getSSLRecordSizeLimit();
     private static native int getSSLRequireNever();
     private static native int getSSLRequireAlways();
     private static native int getSSLRequireFirstHandshake();
@@ -108,28 +108,14 @@ PRStatus
 JSS_NSS_addSSLAlert(JNIEnv *env, jobject sslfd_proxy, jobject list,
     const SSLAlert *alert)
 {
-    jclass eventClass;
-    jmethodID eventConstructor;
     jobject event;
 
-    jclass eventListClass;
-    jmethodID arrayListAdd;
-
     PR_ASSERT(env != NULL && sslfd_proxy != NULL && list != NULL && alert != NULL);
+    PR_ASSERT(JSS_javaIDs.sslAlertEventConstructor != NULL);
 
     /* Build the new alert event object (org.mozilla.jss.ssl.SSLAlertEvent). */
-    eventClass = (*env)->FindClass(env, SSL_ALERT_EVENT_CLASS);
-    if (eventClass == NULL) {
-        return PR_FAILURE;
-    }
-
-    eventConstructor = (*env)->GetMethodID(env, eventClass, "<init>",
-                                           "(L" SSLFD_PROXY_CLASS_NAME ";II)V");
-    if (eventConstructor == NULL) {
-        return PR_FAILURE;
-    }
-
-    event = (*env)->NewObject(env, eventClass, eventConstructor,
+    event = (*env)->NewObject(env, JSS_javaIDs.sslAlertEventClass,
+                              JSS_javaIDs.sslAlertEventConstructor,
                               sslfd_proxy, (int)alert->level,
                               (int)alert->description);
     if (event == NULL) {
@@ -137,19 +123,16 @@ JSS_NSS_addSSLAlert(JNIEnv *env, jobject sslfd_proxy, jobject list,
     }
 
     /* Add it to the event list. */
-    eventListClass = (*env)->GetObjectClass(env, list);
-    if (eventListClass == NULL) {
-        return PR_FAILURE;
-    }
+    PR_ASSERT((*env)->IsInstanceOf(env, list, JSS_javaIDs.arrayListClass));
 
-    arrayListAdd = (*env)->GetMethodID(env, eventListClass, "add",
-                                       "(Ljava/lang/Object;)Z");
-    if (arrayListAdd == NULL) {
+    // We ignore the return code: ArrayList.add() always returns true.
+    (void)(*env)->CallBooleanMethod(env, list, JSS_javaIDs.arrayListAdd, event);
+    (*env)->DeleteLocalRef(env, event);
+
+    if ((*env)->ExceptionCheck(env)) {
         return PR_FAILURE;
     }
 
-    // We ignore the return code: ArrayList.add() always returns true.
-    (void)(*env)->CallBooleanMethod(env, list, arrayListAdd, event);
     return PR_SUCCESS;
 }
 
@@ -164,7 +147,7 @@ JSSL_SSLFDAlertReceivedCallback(const PRFileDesc *fd, void *arg, const SSLAlert
         return;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         return;
     }
 
@@ -188,7 +171,7 @@ JSSL_SSLFDAlertSentCallback(const PRFileDesc *fd, void *arg, const SSLAlert *ale
         return;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         return;
     }
 
@@ -254,7 +237,7 @@ JSSL_SSLFDHandshakeComplete(PRFileDesc *fd, void *client_data)
         return;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         return;
     }
 
@@ -293,7 +276,7 @@ JSSL_SSLFDAsyncCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig, PRBo
         return SECFailure;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         return SECFailure;
     }
 
@@ -336,7 +319,7 @@ JSSL_SSLFDSyncCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig, PRBoo
         return SECFailure;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         PR_SetError(PR_UNKNOWN_ERROR, 0);
         return SECFailure;
     }
@@ -389,7 +372,7 @@ JSSL_SSLFDAsyncBadCertCallback(void *arg, PRFileDesc *fd)
         return SECFailure;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         return SECFailure;
     }
 
@@ -438,7 +421,7 @@ JSSL_SSLFDSyncBadCertCallback(void *arg, PRFileDesc *fd)
         return SECFailure;
     }
 
-    if ((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != JNI_OK || env == NULL) {
+    if (JSS_attachCurrentThread(&env) != PR_SUCCESS) {
         PR_SetError(PR_UNKNOWN_ERROR, 0);
         return SECFailure;
     }
@@ -0,0 +1,82 @@
+package org.mozilla.jss.nss;
+
+/**
+ * The fields in an SSLStepResult describe the outcome of a single
+ * SSL.UnwrapStep or SSL.WrapStep call: how many bytes crossed in each
+ * direction, how stepping the handshake went, and how full the engine's
+ * buffers were afterwards.
+ *
+ * An SSLStepResult is meant to be allocated once per engine and passed to
+ * every step, so that stepping doesn't allocate; it must not be shared
+ * between threads.
+ */
+public class SSLStepResult {
+    /* Indices into status, as filled in by the native step. */
+    static final int CONSUMED = 0;
+    static final int PRODUCED = 1;
+    static final int HANDSHAKE_RESULT = 2;
+    static final int HANDSHAKE_ERROR = 3;
+    static final int ERROR = 4;
+    static final int READ_PENDING = 5;
+    static final int WRITE_PENDING = 6;
+    static final int STATUS_SIZE = 7;
+
+    /* For UnwrapStep, the number of bytes of wire data moved from src
+     * into the read buffer. For WrapStep, the result of PR_Writev: the
+     * number of bytes of application data accepted by NSS, or negative
+     * when the write failed. */
+    public int consumed;
+
+    /* For UnwrapStep, the number of bytes of application data read into
+     * dst; zero at end of stream, or negative when PR_Read failed without
+     * reading anything. For WrapStep, the number of bytes of wire data
+     * moved from the write buffer into dst. */
+    public int produced;
+
+    /* Result of SSL_ForceHandshake; SECSuccess when the handshake wasn't
+     * stepped. */
+    public int handshakeResult;
+
+    /* PR_GetError() after SSL_ForceHandshake failed; zero otherwise. */
+    public int handshakeError;
+
+    /* PR_GetError() after PR_Read or PR_Writev failed; zero otherwise. */
+    public int error;
+
+    /* Number of bytes left to read from the read buffer after the
+     * handshake step. */
+    public int readPending;
+
+    /* Number of bytes left to read from the write buffer after the
+     * handshake step. */
+    public int writePending;
+
+    /* Raw status, unpacked into the fields above after each step. */
+    int[] status = new int[STATUS_SIZE];
+
+    /* Scratch space for gathering WrapStep's sources. */
+    IOVector iov = new IOVector();
+
+    void unpack() {
+        consumed = status[CONSUMED];
+        produced = status[PRODUCED];
+        handshakeResult = status[HANDSHAKE_RESULT];
+        handshakeError = status[HANDSHAKE_ERROR];
+        error = status[ERROR];
+        readPending = status[READ_PENDING];
+        writePending = status[WRITE_PENDING];
+    }
+
+    @Override
+    public String toString() {
+        StringBuilder result = new StringBuilder("SSLStepResult:");
+        result.append("\n- consumed: " + consumed);
+        result.append("\n- produced: " + produced);
+        result.append("\n- handshakeResult: " + handshakeResult);
+        result.append("\n- handshakeError: " + handshakeError);
+        result.append("\n- error: " + error);
+        result.append("\n- readPending: " + readPending);
+        result.append("\n- writePending: " + writePending);
+        return result.toString();
+    }
+}
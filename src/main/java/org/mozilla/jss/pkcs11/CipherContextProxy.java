@@ -8,14 +8,15 @@ import org.mozilla.jss.util.NativeProxy;
 
 final class CipherContextProxy extends NativeProxy {
     public CipherContextProxy(byte[] pointer) {
-        super(pointer);
+        super(pointer, CipherContextProxy::releaseHandle);
+    }
+
+    public CipherContextProxy(long handle) {
+        super(handle, CipherContextProxy::releaseHandle);
     }
 
     @Override
     protected native void releaseNativeResources();
 
-    @Override
-    protected void finalize() throws Throwable {
-      super.finalize();
-    }
+    private static native void releaseHandle(long handle);
 }
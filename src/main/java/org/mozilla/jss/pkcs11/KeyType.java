@@ -217,11 +217,23 @@ public final class KeyType {
                             EncryptionAlgorithm.AES_128_CBC_PAD,
                             EncryptionAlgorithm.AES_192_CBC_PAD,
                             EncryptionAlgorithm.AES_256_CBC_PAD,
+                            EncryptionAlgorithm.AES_128_GCM,
+                            EncryptionAlgorithm.AES_192_GCM,
+                            EncryptionAlgorithm.AES_256_GCM,
                             CMACAlgorithm.AES
                             },
                             "AES"
                         );
 
+    //////////////////////////////////////////////////////////////
+    static public final KeyType
+    CHACHA20  = new KeyType(new Algorithm[]
+                            {
+                            EncryptionAlgorithm.CHACHA20_POLY1305
+                            },
+                            "ChaCha20"
+                        );
+
     //////////////////////////////////////////////////////////////
     static public final KeyType
     RC4     = new KeyType(new Algorithm[]
@@ -190,6 +190,23 @@ Java_org_mozilla_jss_pkcs11_CertProxy_releaseNativeResources
 finish:
 	PR_DetachThread();
 }
+
+/***********************************************************************
+ * CertProxy.releaseHandle
+ *
+ * Calls CERT_DestroyCertificate on the CERTCertificate of a CertProxy which
+ * was garbage collected without being closed.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_CertProxy_releaseHandle
+  (JNIEnv *env, jclass clazz, jlong handle)
+{
+	CERTCertificate *cert = JSS_handleToPtr(handle);
+
+	if (cert != NULL) {
+		CERT_DestroyCertificate(cert);
+	}
+}
 	
 
 /******************************************************************
@@ -562,11 +562,6 @@ public class PK11Cert
         }
     }
 
-    @Override
-    public void finalize() throws Throwable {
-        close();
-    }
-
     @Override
     public void close() throws Exception {
         if (certProxy != null) {
@@ -740,9 +735,11 @@ class CertProxy extends org.mozilla.jss.util.NativeProxy {
     public static Logger logger = LoggerFactory.getLogger(CertProxy.class);
 
     public CertProxy(byte[] pointer) {
-        super(pointer);
+        super(pointer, CertProxy::releaseHandle);
     }
 
     @Override
     protected native void releaseNativeResources();
+
+    private static native void releaseHandle(long handle);
 }
@@ -17,6 +17,25 @@
 #include <pk11util.h>
 #include <Algorithm.h>
 
+/* Longest authentication tag produced by any supported AEAD mechanism. */
+#define AEAD_MAX_TAG_LENGTH 16
+
+/* The unpadded form of a CBC mechanism; NSS only maps the other way. */
+static CK_MECHANISM_TYPE
+unpadMechanism(CK_MECHANISM_TYPE mech)
+{
+    switch (mech) {
+    case CKM_DES_CBC_PAD:
+        return CKM_DES_CBC;
+    case CKM_DES3_CBC_PAD:
+        return CKM_DES3_CBC;
+    case CKM_AES_CBC_PAD:
+        return CKM_AES_CBC;
+    default:
+        return mech;
+    }
+}
+
 /***********************************************************************
  *
  * PK11Cipher.initContext
@@ -53,8 +72,11 @@ Java_org_mozilla_jss_pkcs11_PK11Cipher_initContextWithKeyBits
         goto finish;
     }
 
-    if (padded)
+    if (padded) {
         mech = PK11_GetPadMechanism(mech);
+    } else {
+        mech = unpadMechanism(mech);
+    }
 
     /* get operation type */
     if( encrypt ) {
@@ -231,9 +253,899 @@ finish:
     PR_ASSERT( outBA || (*env)->ExceptionOccurred(env) );
     return outBA;
 }
+
+/***********************************************************************
+ *
+ * PK11Cipher.resetContext
+ *
+ * Restarts a finished cipher context with the key and parameters it was
+ * created with. PK11_DigestBegin does nothing to a context part way
+ * through an operation, so PK11Cipher replaces those instead.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_resetContext
+    (JNIEnv *env, jclass clazz, jobject contextObj)
+{
+    PK11Context *context=NULL;
+
+    PR_ASSERT(env!=NULL && contextObj!=NULL);
+
+    if( JSS_PK11_getCipherContext(env, contextObj, &context) != PR_SUCCESS) {
+        return;
+    }
+
+    if( PK11_DigestBegin(context) != SECSuccess ) {
+        JSS_throwMsgPrErrArg(
+            env, TOKEN_EXCEPTION, "Cipher context reset failed",
+            PR_GetError());
+    }
+}
     
 
 
+/***********************************************************************
+ *
+ * c i p h e r O p I n t o
+ *
+ * Runs PK11_CipherOp over input, writing straight into output, followed by
+ * PK11_DigestFinal into the rest of output when finish is set. Input which
+ * overlaps output is copied aside first. No JNI calls are made, so this may
+ * be used on pinned arrays.
+ *
+ * RETURNS
+ *      SECSuccess and the number of bytes written in *written, or
+ *      SECFailure with a description of the failed step in *message.
+ */
+static SECStatus
+cipherOpInto(PK11Context *context, unsigned char *input,
+    unsigned int inputLen, unsigned char *output, unsigned int outputLen,
+    PRBool finish, unsigned int *written, const char **message)
+{
+    unsigned char *copy = NULL;
+    int updateLen = 0;
+    unsigned int finalLen = 0;
+    SECStatus status = SECSuccess;
+
+    *written = 0;
+
+    if (inputLen > 0) {
+        if (input < output + outputLen && output < input + inputLen) {
+            copy = PR_Malloc(inputLen);
+            if (copy == NULL) {
+                *message = "Unable to allocate memory for cipher input";
+                return SECFailure;
+            }
+            PORT_Memcpy(copy, input, inputLen);
+            input = copy;
+        }
+
+        status = PK11_CipherOp(context, output, &updateLen, outputLen,
+                               input, inputLen);
+        if (status != SECSuccess) {
+            *message = "Cipher context update failed";
+            goto finish;
+        }
+    }
+
+    if (finish) {
+        status = PK11_DigestFinal(context, output + updateLen, &finalLen,
+                                  outputLen - updateLen);
+        if (status != SECSuccess) {
+            *message = "Cipher context finalization failed";
+            goto finish;
+        }
+    }
+
+    *written = updateLen + finalLen;
+
+finish:
+    if (copy != NULL) {
+        PORT_Memset(copy, 0, inputLen);
+        PR_Free(copy);
+    }
+    return status;
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.updateContextDirect
+ *
+ * Ciphers between two direct ByteBuffers without copying either. The
+ * offsets and lengths are checked by the caller.
+ */
+JNIEXPORT jint JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_updateContextDirect
+    (JNIEnv *env, jclass clazz, jobject contextObj, jobject inputBuf,
+    jint inputOffset, jint inputLen, jobject outputBuf, jint outputOffset,
+    jint outputLen, jboolean finish)
+{
+    PK11Context *context = NULL;
+    unsigned char *input = NULL;
+    unsigned char *output = NULL;
+    unsigned int written = 0;
+    const char *message = NULL;
+
+    PR_ASSERT(env != NULL && contextObj != NULL && outputBuf != NULL);
+    PR_ASSERT(inputOffset >= 0 && inputLen >= 0);
+    PR_ASSERT(outputOffset >= 0 && outputLen >= 0);
+
+    if (JSS_PK11_getCipherContext(env, contextObj, &context) != PR_SUCCESS) {
+        return -1;
+    }
+
+    if (inputLen > 0) {
+        input = (*env)->GetDirectBufferAddress(env, inputBuf);
+    }
+    output = (*env)->GetDirectBufferAddress(env, outputBuf);
+    if ((inputLen > 0 && input == NULL) || output == NULL) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Expected direct ByteBuffers");
+        return -1;
+    }
+
+    if (inputLen > 0) {
+        input += inputOffset;
+    }
+    output += outputOffset;
+
+    if (cipherOpInto(context, input, inputLen, output, outputLen, finish,
+                     &written, &message) != SECSuccess) {
+        JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION, message, PR_GetError());
+        return -1;
+    }
+
+    return written;
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.updateContextArray
+ *
+ * Ciphers from one byte array into another at the given offsets, without
+ * copying either. The offsets and lengths are checked by the caller.
+ */
+JNIEXPORT jint JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_updateContextArray
+    (JNIEnv *env, jclass clazz, jobject contextObj, jbyteArray inputBA,
+    jint inputOffset, jint inputLen, jbyteArray outputBA, jint outputOffset,
+    jint outputLen, jboolean finish)
+{
+    PK11Context *context = NULL;
+    jbyte *input = NULL;
+    jbyte *output = NULL;
+    unsigned int written = 0;
+    const char *message = NULL;
+    PRErrorCode error = 0;
+    SECStatus status;
+
+    PR_ASSERT(env != NULL && contextObj != NULL && outputBA != NULL);
+    PR_ASSERT(inputOffset >= 0 && inputLen >= 0);
+    PR_ASSERT(outputOffset >= 0 && outputLen >= 0);
+
+    if (JSS_PK11_getCipherContext(env, contextObj, &context) != PR_SUCCESS) {
+        return -1;
+    }
+
+    /* Pin both arrays rather than copying them in and out; nothing below
+     * calls back into the JVM until they're released. */
+    if (inputLen > 0) {
+        input = (*env)->GetPrimitiveArrayCritical(env, inputBA, NULL);
+        if (input == NULL) {
+            ASSERT_OUTOFMEM(env);
+            return -1;
+        }
+    }
+
+    output = (*env)->GetPrimitiveArrayCritical(env, outputBA, NULL);
+    if (output == NULL) {
+        if (input != NULL) {
+            (*env)->ReleasePrimitiveArrayCritical(env, inputBA, input,
+                                                  JNI_ABORT);
+        }
+        ASSERT_OUTOFMEM(env);
+        return -1;
+    }
+
+    status = cipherOpInto(context,
+                          input == NULL ? NULL : (unsigned char *)input + inputOffset,
+                          inputLen, (unsigned char *)output + outputOffset,
+                          outputLen, finish, &written, &message);
+    if (status != SECSuccess) {
+        error = PR_GetError();
+    }
+
+    (*env)->ReleasePrimitiveArrayCritical(env, outputBA, output, 0);
+    if (input != NULL) {
+        (*env)->ReleasePrimitiveArrayCritical(env, inputBA, input, JNI_ABORT);
+    }
+
+    if (status != SECSuccess) {
+        JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION, message, error);
+        return -1;
+    }
+
+    return written;
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.initAEADContext
+ *
+ * Creates a message-based context for an AEAD mechanism. Unlike the
+ * contexts created by initContext, it takes no IV: the nonce and any
+ * additional authenticated data are supplied with each message to aeadOp,
+ * so one context serves every message encrypted (or decrypted) under the
+ * key.
+ */
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_initAEADContext
+    (JNIEnv *env, jclass clazz, jboolean encrypt, jobject keyObj,
+        jobject algObj)
+{
+    CK_MECHANISM_TYPE mech;
+    PK11SymKey *key = NULL;
+    SECItem param = { siBuffer, NULL, 0 };
+    PK11Context *context = NULL;
+    CK_ATTRIBUTE_TYPE op;
+
+    PR_ASSERT(env != NULL && clazz != NULL && keyObj != NULL && algObj != NULL);
+
+    mech = JSS_getPK11MechFromAlg(env, algObj);
+    if (mech == CKM_INVALID_MECHANISM) {
+        JSS_throwMsg(env, TOKEN_EXCEPTION, "Unable to resolve algorithm to"
+            " PKCS #11 mechanism");
+        return NULL;
+    }
+
+    op = CKA_NSS_MESSAGE | (encrypt ? CKA_ENCRYPT : CKA_DECRYPT);
+
+    if (JSS_PK11_getSymKeyPtr(env, keyObj, &key) != PR_SUCCESS) {
+        return NULL;
+    }
+
+    context = PK11_CreateContextBySymKey(mech, op, key, &param);
+    if (context == NULL) {
+        JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION,
+            "Failed to generate AEAD crypto context", PR_GetError());
+        return NULL;
+    }
+
+    /* wrap crypto context. This sets context to NULL. */
+    return JSS_PK11_wrapCipherContextProxy(env, &context);
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.aeadOp
+ *
+ * Encrypts or decrypts a single message on a context from
+ * initAEADContext. When encrypting, the result is the ciphertext followed
+ * by a tag of tagLen bytes. When decrypting, the last tagLen bytes of the
+ * input are the tag, and an AEADBadTagException is thrown if it doesn't
+ * verify. The caller ensures inputLen is within the input array and, when
+ * decrypting, is at least tagLen.
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_aeadOp
+    (JNIEnv *env, jclass clazz, jobject contextObj, jboolean encrypt,
+        jbyteArray ivBA, jbyteArray aadBA, jbyteArray inputBA, jint inputLen,
+        jint tagLen)
+{
+    PK11Context *context = NULL;
+    jbyte *iv = NULL;
+    jbyte *aad = NULL;
+    jbyte *input = NULL;
+    unsigned char *output = NULL;
+    unsigned char *tag = NULL;
+    unsigned char tagBuf[AEAD_MAX_TAG_LENGTH];
+    int ivLen;
+    int aadLen = 0;
+    int dataLen = 0;
+    int outputLen = 0;
+    jbyteArray outArray = NULL;
+
+    PR_ASSERT(env != NULL && contextObj != NULL && ivBA != NULL);
+    PR_ASSERT(tagLen > 0 && tagLen <= (jint)sizeof(tagBuf));
+    PR_ASSERT(inputLen >= (encrypt ? 0 : tagLen));
+
+    if (JSS_PK11_getCipherContext(env, contextObj, &context) != PR_SUCCESS) {
+        goto finish;
+    }
+
+    ivLen = (*env)->GetArrayLength(env, ivBA);
+    iv = (*env)->GetByteArrayElements(env, ivBA, NULL);
+    if (iv == NULL) {
+        ASSERT_OUTOFMEM(env);
+        goto finish;
+    }
+
+    if (aadBA != NULL) {
+        aadLen = (*env)->GetArrayLength(env, aadBA);
+        aad = (*env)->GetByteArrayElements(env, aadBA, NULL);
+        if (aad == NULL) {
+            ASSERT_OUTOFMEM(env);
+            goto finish;
+        }
+    }
+
+    if (inputLen > 0) {
+        input = (*env)->GetByteArrayElements(env, inputBA, NULL);
+        if (input == NULL) {
+            ASSERT_OUTOFMEM(env);
+            goto finish;
+        }
+    }
+
+    /* Encryption appends the tag to the ciphertext; decryption takes it
+     * from the end of the input. Either way, the output fits in inputLen +
+     * tagLen bytes, and at least one byte is allocated. */
+    dataLen = encrypt ? inputLen : inputLen - tagLen;
+    output = PR_Malloc(dataLen + tagLen);
+    if (output == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    if (encrypt) {
+        tag = output + dataLen;
+    } else {
+        PORT_Memcpy(tagBuf, (unsigned char *)input + dataLen, tagLen);
+        tag = tagBuf;
+    }
+
+    if (PK11_AEADOp(context, CKG_NO_GENERATE, 0, (unsigned char *)iv, ivLen,
+            (unsigned char *)aad, aadLen, output, &outputLen, dataLen, tag,
+            tagLen, (unsigned char *)input, dataLen) != SECSuccess) {
+        if (encrypt) {
+            JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION,
+                "AEAD encryption failed", PR_GetError());
+        } else {
+            JSS_throwMsgPrErrArg(env, AEAD_BAD_TAG_EXCEPTION,
+                "AEAD decryption failed: tag mismatch", PR_GetError());
+        }
+        goto finish;
+    }
+    PR_ASSERT(outputLen == dataLen);
+
+    outArray = JSS_ToByteArray(env, output,
+                               encrypt ? outputLen + tagLen : outputLen);
+    if (outArray == NULL) {
+        ASSERT_OUTOFMEM(env);
+        goto finish;
+    }
+
+finish:
+    if (output != NULL) {
+        /* Plaintext of a message that failed to authenticate must not be
+         * left lying around. */
+        PORT_Memset(output, 0, dataLen + tagLen);
+        PR_Free(output);
+    }
+    if (input != NULL) {
+        (*env)->ReleaseByteArrayElements(env, inputBA, input, JNI_ABORT);
+    }
+    if (aad != NULL) {
+        (*env)->ReleaseByteArrayElements(env, aadBA, aad, JNI_ABORT);
+    }
+    if (iv != NULL) {
+        (*env)->ReleaseByteArrayElements(env, ivBA, iv, JNI_ABORT);
+    }
+    PR_ASSERT(outArray || (*env)->ExceptionOccurred(env));
+    return outArray;
+}
+
+/***********************************************************************
+ *
+ * Batched ciphering
+ *
+ * encryptBatch and decryptBatch cipher many messages under one key with a
+ * single PK11Context, which is re-initialized between messages with
+ * PK11_DigestBegin rather than created and destroyed each time. NSS can't
+ * change the IV of an existing context, so CBC contexts are created with
+ * an all-zero IV and each message's IV is applied by hand:
+ *
+ *  - Encryption pads the message itself and XORs the IV into the first
+ *    plaintext block, which is all CBC does with the IV.
+ *  - Decryption feeds the IV in as an extra first ciphertext block. Its
+ *    plaintext is discarded, and the real first block then chains off the
+ *    IV as usual. Padding is still checked by the token.
+ *
+ * AEAD algorithms use a message context instead, which takes the nonce
+ * with each message; batches carry no AAD and use full-length tags.
+ */
+typedef struct {
+    PK11Context *context;
+    PRBool encrypt;
+    PRBool aead;
+    /* whether to apply PKCS #5 padding by hand before encrypting */
+    PRBool pad;
+    unsigned int blockSize;
+    /* 0 for modes without an IV */
+    unsigned int ivLen;
+    /* each message is staged here before it is ciphered */
+    unsigned char *scratch;
+    unsigned int scratchLen;
+} BatchCipher;
+
+/* Longest IV or nonce accepted for a batch. */
+#define BATCH_MAX_IV_LENGTH 16
+
+static SECStatus
+batchInit(BatchCipher *bc, PRBool encrypt, PK11SymKey *key,
+    CK_MECHANISM_TYPE mech, PRBool padded, unsigned int maxInputLen,
+    const char **message)
+{
+    CK_MECHANISM_TYPE contextMech;
+    unsigned char zeroIV[BATCH_MAX_IV_LENGTH] = { 0 };
+    SECItem ivItem = { siBuffer, zeroIV, 0 };
+    SECItem *param = NULL;
+
+    PORT_Memset(bc, 0, sizeof(BatchCipher));
+    bc->encrypt = encrypt;
+    bc->aead = (mech == CKM_AES_GCM || mech == CKM_CHACHA20_POLY1305);
+
+    if (bc->aead) {
+        SECItem empty = { siBuffer, NULL, 0 };
+        bc->context = PK11_CreateContextBySymKey(mech,
+            CKA_NSS_MESSAGE | (encrypt ? CKA_ENCRYPT : CKA_DECRYPT), key,
+            &empty);
+    } else {
+        bc->ivLen = PK11_GetIVLength(mech);
+        bc->blockSize = PK11_GetBlockSize(mech, NULL);
+        if (bc->ivLen > BATCH_MAX_IV_LENGTH ||
+                (bc->ivLen > 0 && bc->ivLen != bc->blockSize)) {
+            *message = "Algorithm cannot be used in a batch";
+            return SECFailure;
+        }
+
+        /* Padding is checked by the token when decrypting, but applied by
+         * hand when encrypting, so that the IV can be applied to the whole
+         * first block. */
+        bc->pad = padded && encrypt;
+        contextMech = unpadMechanism(mech);
+        if (padded && !encrypt) {
+            contextMech = PK11_GetPadMechanism(contextMech);
+        }
+
+        ivItem.len = bc->ivLen;
+        param = PK11_ParamFromIV(contextMech, bc->ivLen > 0 ? &ivItem : NULL);
+        bc->context = PK11_CreateContextBySymKey(contextMech,
+            encrypt ? CKA_ENCRYPT : CKA_DECRYPT, key, param);
+        if (param != NULL) {
+            SECITEM_FreeItem(param, PR_TRUE /*freeit*/);
+        }
+    }
+
+    if (bc->context == NULL) {
+        *message = "Failed to generate crypto context";
+        return SECFailure;
+    }
+
+    bc->scratchLen = maxInputLen + 2 * bc->blockSize + 1;
+    bc->scratch = PR_Malloc(bc->scratchLen);
+    if (bc->scratch == NULL) {
+        *message = "Unable to allocate memory for batch";
+        return SECFailure;
+    }
+
+    return SECSuccess;
+}
+
+static void
+batchDestroy(BatchCipher *bc)
+{
+    if (bc->scratch != NULL) {
+        PORT_Memset(bc->scratch, 0, bc->scratchLen);
+        PR_Free(bc->scratch);
+    }
+    if (bc->context != NULL) {
+        PK11_DestroyContext(bc->context, PR_TRUE /*freeit*/);
+    }
+    PORT_Memset(bc, 0, sizeof(BatchCipher));
+}
+
+/* Where the next message's input must be copied before batchRun. */
+static unsigned char *
+batchStage(BatchCipher *bc)
+{
+    return bc->scratch + (bc->encrypt || bc->aead ? 0 : bc->ivLen);
+}
+
+/* Room batchRun needs in its output for a message of inputLen bytes; for
+ * CBC decryption, this includes the discarded IV block. */
+static PRUint64
+batchOutputBound(BatchCipher *bc, unsigned int inputLen)
+{
+    if (bc->aead) {
+        return (PRUint64)inputLen + (bc->encrypt ? AEAD_MAX_TAG_LENGTH : 0);
+    }
+    if (bc->encrypt) {
+        return (PRUint64)inputLen + (bc->pad ? bc->blockSize : 0);
+    }
+    return (PRUint64)inputLen + bc->ivLen;
+}
+
+/*
+ * Ciphers the inputLen bytes staged at batchStage into output. On failure,
+ * *badInput is set when the message itself was at fault: bad padding or a
+ * tag mismatch.
+ */
+static SECStatus
+batchRun(BatchCipher *bc, unsigned char *iv, unsigned int ivLen,
+    unsigned int inputLen, unsigned char *output, unsigned int maxOut,
+    unsigned int *written, const char **message, PRBool *badInput)
+{
+    unsigned char *input = bc->scratch;
+    unsigned int len = inputLen;
+    int updateLen = 0;
+    unsigned int finalLen = 0;
+    unsigned int i;
+
+    *written = 0;
+    *badInput = PR_FALSE;
+
+    if (bc->aead) {
+        unsigned int dataLen = inputLen;
+        int outLen = 0;
+
+        if (!bc->encrypt) {
+            if (inputLen < AEAD_MAX_TAG_LENGTH) {
+                *message = "Input too short to contain a tag";
+                *badInput = PR_TRUE;
+                return SECFailure;
+            }
+            dataLen -= AEAD_MAX_TAG_LENGTH;
+        }
+
+        if (PK11_AEADOp(bc->context, CKG_NO_GENERATE, 0, iv, ivLen, NULL, 0,
+                output, &outLen, dataLen,
+                bc->encrypt ? output + dataLen : input + dataLen,
+                AEAD_MAX_TAG_LENGTH, input, dataLen) != SECSuccess) {
+            *message = bc->encrypt ? "AEAD encryption failed"
+                                   : "AEAD decryption failed: tag mismatch";
+            *badInput = !bc->encrypt;
+            return SECFailure;
+        }
+
+        *written = outLen + (bc->encrypt ? AEAD_MAX_TAG_LENGTH : 0);
+        return SECSuccess;
+    }
+
+    if (bc->pad) {
+        unsigned int padLen = bc->blockSize - (inputLen % bc->blockSize);
+        PORT_Memset(input + len, padLen, padLen);
+        len += padLen;
+    }
+
+    if (bc->ivLen > 0) {
+        PR_ASSERT(ivLen == bc->ivLen);
+        if (bc->encrypt) {
+            for (i = 0; i < bc->ivLen && i < len; i++) {
+                input[i] ^= iv[i];
+            }
+        } else {
+            PORT_Memcpy(input, iv, bc->ivLen);
+            len += bc->ivLen;
+        }
+    }
+
+    /* A no-op for the first message, whose context is fresh. */
+    if (PK11_DigestBegin(bc->context) != SECSuccess) {
+        *message = "Cipher context initialization failed";
+        return SECFailure;
+    }
+
+    if (len > 0 && PK11_CipherOp(bc->context, output, &updateLen, maxOut,
+                                 input, len) != SECSuccess) {
+        *message = "Cipher context update failed";
+        return SECFailure;
+    }
+
+    if (PK11_DigestFinal(bc->context, output + updateLen, &finalLen,
+                         maxOut - updateLen) != SECSuccess) {
+        /* Don't leave the plaintext of the IV block behind. */
+        PORT_Memset(output, 0, updateLen);
+        *message = "Cipher context finalization failed";
+        *badInput = !bc->encrypt;
+        return SECFailure;
+    }
+
+    *written = updateLen + finalLen;
+
+    if (!bc->encrypt && bc->ivLen > 0) {
+        PR_ASSERT(*written >= bc->ivLen);
+        *written -= bc->ivLen;
+        PORT_Memmove(output, output + bc->ivLen, *written);
+        PORT_Memset(output + *written, 0, bc->ivLen);
+    }
+
+    return SECSuccess;
+}
+
+/* The messages of a batch: either the elements of a byte[][], or slices
+ * laid end to end in native memory. */
+typedef struct {
+    jobjectArray arrays;
+    const unsigned char *base;
+} BatchInput;
+
+static PRStatus
+batchLoad(JNIEnv *env, BatchInput *in, int index, PRUint64 offset,
+    unsigned char *dest, unsigned int len)
+{
+    if (in->arrays == NULL) {
+        PORT_Memcpy(dest, in->base + offset, len);
+        return PR_SUCCESS;
+    }
+
+    jbyteArray array = (*env)->GetObjectArrayElement(env, in->arrays, index);
+    if (array == NULL) {
+        return PR_FAILURE;
+    }
+    (*env)->GetByteArrayRegion(env, array, 0, len, (jbyte *)dest);
+    (*env)->DeleteLocalRef(env, array);
+    return (*env)->ExceptionCheck(env) ? PR_FAILURE : PR_SUCCESS;
+}
+
+/*
+ * Runs a whole batch through one BatchCipher. lengths holds the length of
+ * each of the count messages; offsets is filled with count + 1 offsets into
+ * output, where message i's result occupies offsets[i] up to offsets[i+1].
+ * When output is NULL, it is allocated to fit and returned in *allocated,
+ * which is left NULL on failure. Throws and returns PR_FAILURE on error.
+ */
+static PRStatus
+batchCipher(JNIEnv *env, jboolean encrypt, jobject keyObj, jobject algObj,
+    jboolean padded, jobjectArray ivs, BatchInput *input, const jint *lengths,
+    int count, unsigned char *output, PRUint64 outputLen,
+    unsigned char **allocated, jint *offsets)
+{
+    CK_MECHANISM_TYPE mech;
+    PK11SymKey *key = NULL;
+    BatchCipher bc;
+    unsigned char iv[BATCH_MAX_IV_LENGTH];
+    unsigned int ivLen = 0;
+    unsigned int maxInputLen = 0;
+    PRUint64 inputOffset = 0;
+    PRUint64 required = 0;
+    unsigned int written = 0;
+    const char *message = NULL;
+    PRBool badInput = PR_FALSE;
+    PRStatus status = PR_FAILURE;
+    char detail[128];
+    int i;
+
+    PORT_Memset(&bc, 0, sizeof(bc));
+
+    mech = JSS_getPK11MechFromAlg(env, algObj);
+    if (mech == CKM_INVALID_MECHANISM) {
+        JSS_throwMsg(env, TOKEN_EXCEPTION, "Unable to resolve algorithm to"
+            " PKCS #11 mechanism");
+        goto finish;
+    }
+
+    if (JSS_PK11_getSymKeyPtr(env, keyObj, &key) != PR_SUCCESS) {
+        goto finish;
+    }
+
+    for (i = 0; i < count; i++) {
+        PR_ASSERT(lengths[i] >= 0);
+        if ((unsigned int)lengths[i] > maxInputLen) {
+            maxInputLen = lengths[i];
+        }
+    }
+
+    if (batchInit(&bc, encrypt, key, mech, padded, maxInputLen,
+                  &message) != SECSuccess) {
+        JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION, message, PR_GetError());
+        goto finish;
+    }
+
+    for (i = 0; i < count; i++) {
+        required += batchOutputBound(&bc, lengths[i]);
+    }
+    if (required > PR_INT32_MAX) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Batch output would be too large");
+        goto finish;
+    }
+
+    if (output == NULL) {
+        /* At least one byte, so that an empty batch still succeeds. */
+        *allocated = output = PR_Malloc(required + 1);
+        outputLen = required;
+        if (output == NULL) {
+            JSS_throw(env, OUT_OF_MEMORY_ERROR);
+            goto finish;
+        }
+    } else if (outputLen < required) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Output buffer too small for batch");
+        goto finish;
+    }
+
+    offsets[0] = 0;
+    for (i = 0; i < count; i++) {
+        if (ivs != NULL) {
+            jbyteArray ivBA = (*env)->GetObjectArrayElement(env, ivs, i);
+            if (ivBA == NULL) {
+                JSS_throwMsg(env, NULL_POINTER_EXCEPTION, "Missing IV");
+                goto finish;
+            }
+            ivLen = (*env)->GetArrayLength(env, ivBA);
+            if (ivLen > sizeof(iv)) {
+                (*env)->DeleteLocalRef(env, ivBA);
+                JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION, "IV too long");
+                goto finish;
+            }
+            (*env)->GetByteArrayRegion(env, ivBA, 0, ivLen, (jbyte *)iv);
+            (*env)->DeleteLocalRef(env, ivBA);
+        }
+
+        if (batchLoad(env, input, i, inputOffset, batchStage(&bc),
+                      lengths[i]) != PR_SUCCESS) {
+            goto finish;
+        }
+        inputOffset += lengths[i];
+
+        if (batchRun(&bc, iv, ivLen, lengths[i], output + offsets[i],
+                     outputLen - offsets[i], &written, &message,
+                     &badInput) != SECSuccess) {
+            PR_snprintf(detail, sizeof(detail), "%s (message %d)", message, i);
+            if (!badInput) {
+                JSS_throwMsgPrErrArg(env, TOKEN_EXCEPTION, detail,
+                                     PR_GetError());
+            } else if (bc.aead) {
+                JSS_throwMsgPrErrArg(env, AEAD_BAD_TAG_EXCEPTION, detail,
+                                     PR_GetError());
+            } else {
+                JSS_throwMsgPrErrArg(env, BAD_PADDING_EXCEPTION, detail,
+                                     PR_GetError());
+            }
+            goto finish;
+        }
+
+        offsets[i + 1] = offsets[i] + written;
+    }
+
+    status = PR_SUCCESS;
+
+finish:
+    if (status != PR_SUCCESS && allocated != NULL && *allocated != NULL) {
+        PORT_Memset(*allocated, 0, required + 1);
+        PR_Free(*allocated);
+        *allocated = NULL;
+    }
+    PORT_Memset(iv, 0, sizeof(iv));
+    batchDestroy(&bc);
+    return status;
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.cipherBatchArray
+ *
+ * Ciphers each element of inputs, returning the results packed into one
+ * array; offsets (of length inputs.length + 1) is filled with where each
+ * result starts.
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_cipherBatchArray
+    (JNIEnv *env, jclass clazz, jboolean encrypt, jobject keyObj,
+        jobject algObj, jboolean padded, jobjectArray ivs,
+        jobjectArray inputs, jintArray offsetsArray)
+{
+    BatchInput input = { inputs, NULL };
+    jint *lengths = NULL;
+    jint *offsets = NULL;
+    unsigned char *output = NULL;
+    jbyteArray outArray = NULL;
+    int count;
+    int i;
+
+    PR_ASSERT(env != NULL && keyObj != NULL && algObj != NULL);
+    PR_ASSERT(inputs != NULL && offsetsArray != NULL);
+
+    count = (*env)->GetArrayLength(env, inputs);
+    PR_ASSERT((*env)->GetArrayLength(env, offsetsArray) == count + 1);
+
+    lengths = PR_Malloc(sizeof(jint) * (count + 1));
+    offsets = PR_Malloc(sizeof(jint) * (count + 1));
+    if (lengths == NULL || offsets == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    for (i = 0; i < count; i++) {
+        jobject element = (*env)->GetObjectArrayElement(env, inputs, i);
+        if (element == NULL) {
+            JSS_throwMsg(env, NULL_POINTER_EXCEPTION, "Missing input");
+            goto finish;
+        }
+        lengths[i] = (*env)->GetArrayLength(env, element);
+        (*env)->DeleteLocalRef(env, element);
+    }
+
+    if (batchCipher(env, encrypt, keyObj, algObj, padded, ivs, &input,
+                    lengths, count, NULL, 0, &output, offsets) != PR_SUCCESS) {
+        goto finish;
+    }
+
+    outArray = JSS_ToByteArray(env, output, offsets[count]);
+    if (outArray == NULL) {
+        ASSERT_OUTOFMEM(env);
+        goto finish;
+    }
+    (*env)->SetIntArrayRegion(env, offsetsArray, 0, count + 1, offsets);
+
+finish:
+    if (output != NULL) {
+        PORT_Memset(output, 0, offsets[count]);
+        PR_Free(output);
+    }
+    PR_Free(offsets);
+    PR_Free(lengths);
+    PR_ASSERT(outArray || (*env)->ExceptionOccurred(env));
+    return outArray;
+}
+
+/***********************************************************************
+ *
+ * PK11Cipher.cipherBatchDirect
+ *
+ * Ciphers messages laid end to end in a direct ByteBuffer, writing the
+ * results end to end into another. The buffers must not overlap, and the
+ * offsets and lengths are checked by the caller.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Cipher_cipherBatchDirect
+    (JNIEnv *env, jclass clazz, jboolean encrypt, jobject keyObj,
+        jobject algObj, jboolean padded, jobjectArray ivs, jobject inputBuf,
+        jint inputOffset, jintArray lengthsArray, jobject outputBuf,
+        jint outputOffset, jint outputLen, jintArray offsetsArray)
+{
+    BatchInput input = { NULL, NULL };
+    unsigned char *output = NULL;
+    jint *lengths = NULL;
+    jint *offsets = NULL;
+    int count;
+
+    PR_ASSERT(env != NULL && keyObj != NULL && algObj != NULL);
+    PR_ASSERT(lengthsArray != NULL && offsetsArray != NULL);
+
+    input.base = (*env)->GetDirectBufferAddress(env, inputBuf);
+    output = (*env)->GetDirectBufferAddress(env, outputBuf);
+    if (input.base == NULL || output == NULL) {
+        JSS_throwMsg(env, ILLEGAL_ARGUMENT_EXCEPTION,
+            "Expected direct ByteBuffers");
+        return;
+    }
+    input.base += inputOffset;
+    output += outputOffset;
+
+    count = (*env)->GetArrayLength(env, lengthsArray);
+    PR_ASSERT((*env)->GetArrayLength(env, offsetsArray) == count + 1);
+
+    lengths = (*env)->GetIntArrayElements(env, lengthsArray, NULL);
+    offsets = PR_Malloc(sizeof(jint) * (count + 1));
+    if (lengths == NULL || offsets == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    if (batchCipher(env, encrypt, keyObj, algObj, padded, ivs, &input,
+                    lengths, count, output, outputLen, NULL,
+                    offsets) == PR_SUCCESS) {
+        (*env)->SetIntArrayRegion(env, offsetsArray, 0, count + 1, offsets);
+    }
+
+finish:
+    PR_Free(offsets);
+    if (lengths != NULL) {
+        (*env)->ReleaseIntArrayElements(env, lengthsArray, lengths, JNI_ABORT);
+    }
+}
+
 /***********************************************************************
  *
  * J S S _ P K 1 1 _ g e t C i p h e r C o n t e x t
@@ -276,36 +1188,16 @@ JSS_PK11_getCipherContext(JNIEnv *env, jobject proxy, PK11Context **pContext)
 jobject
 JSS_PK11_wrapCipherContextProxy(JNIEnv *env, PK11Context **context) {
 
-    jbyteArray pointer=NULL;
-    jclass proxyClass;
-    jmethodID constructor;
     jobject contextObj=NULL;
 
     PR_ASSERT( env!=NULL && context!=NULL && *context!=NULL );
-
-    /* convert pointer to byte array */
-    pointer = JSS_ptrToByteArray(env, *context);
-
-    /*
-     * Lookup the class and constructor
-     */
-    proxyClass = (*env)->FindClass(env, CIPHER_CONTEXT_PROXY_CLASS_NAME);
-    if(proxyClass == NULL) {
-        ASSERT_OUTOFMEM(env);
-        goto finish;
-    }
-    constructor = (*env)->GetMethodID(env, proxyClass,
-                            PLAIN_CONSTRUCTOR,
-                            CIPHER_CONTEXT_PROXY_CONSTRUCTOR_SIG);
-    if(constructor == NULL) {
-        ASSERT_OUTOFMEM(env);
-        goto finish;
-    }
+    PR_ASSERT( JSS_javaIDs.cipherContextProxyConstructor != NULL );
 
     /* call the constructor */
-    contextObj = (*env)->NewObject(env, proxyClass, constructor, pointer);
+    contextObj = (*env)->NewObject(env, JSS_javaIDs.cipherContextProxyClass,
+                            JSS_javaIDs.cipherContextProxyConstructor,
+                            JSS_ptrToHandle(*context));
 
-finish:
     if(contextObj == NULL) {
         /* didn't work, so free resources */
         PK11_DestroyContext( (PK11Context*)*context, PR_TRUE /*freeit*/ );
@@ -330,3 +1222,21 @@ Java_org_mozilla_jss_pkcs11_CipherContextProxy_releaseNativeResources
         PK11_DestroyContext(context, PR_TRUE /*freeit*/);
     }
 }
+
+/***********************************************************************
+ *
+ * CipherContextProxy.releaseHandle
+ *
+ * Frees the PK11Context of a CipherContextProxy which was garbage
+ * collected without being closed.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_CipherContextProxy_releaseHandle
+    (JNIEnv *env, jclass clazz, jlong handle)
+{
+    PK11Context *context = JSS_handleToPtr(handle);
+
+    if (context != NULL) {
+        PK11_DestroyContext(context, PR_TRUE /*freeit*/);
+    }
+}
@@ -4,12 +4,18 @@
 
 package org.mozilla.jss.pkcs11;
 
+import java.io.ByteArrayOutputStream;
+import java.nio.ByteBuffer;
 import java.security.InvalidAlgorithmParameterException;
 import java.security.InvalidKeyException;
 import java.security.NoSuchAlgorithmException;
 import java.security.spec.AlgorithmParameterSpec;
+import java.util.Arrays;
 
+import javax.crypto.AEADBadTagException;
 import javax.crypto.BadPaddingException;
+import javax.crypto.ShortBufferException;
+import javax.crypto.spec.GCMParameterSpec;
 import javax.crypto.spec.IvParameterSpec;
 import javax.crypto.spec.RC2ParameterSpec;
 
@@ -45,6 +51,59 @@ public final class PK11Cipher
     // modified by various operations
     private int state=UNINITIALIZED;
 
+    // Bytes of the current message passed in but not yet returned, because
+    // the token holds back partial blocks or the last block for padding.
+    // Not used for AEAD algorithms, which buffer in aeadData instead.
+    private long buffered = 0;
+
+    // Whether input has gone into the current context since it was last
+    // started or finished. NSS restarts a context only between messages,
+    // so reinit() replaces one which is part way through a message.
+    private boolean inMessage = false;
+
+    // CBC algorithms only. NSS can't change the IV of an existing context,
+    // so reinit() switches to a context created with an all-zero IV and
+    // applies each new IV by hand; see chainProcess(). The context is kept
+    // for as long as the key and direction stay the same.
+    private CipherContextProxy chainContext = null;
+    private SymmetricKey chainKey = null;
+    private boolean chainEncrypt = false;
+
+    // CBC algorithms only: the IV applied by hand to the current message,
+    // or null when it uses contextProxy; how many bytes of the message have
+    // been passed to chainContext; and up to a block of input held back,
+    // until a whole block is available or, when decrypting with padding,
+    // until it is known whether it is the last.
+    private byte[] chainIV = null;
+    private long chainPos = 0;
+    private byte[] chainBlock = null;
+    private int chainHeld = 0;
+
+    // AEAD algorithms only. NSS message contexts take the nonce with each
+    // message rather than at creation, so one context per direction is
+    // kept across initXXX() calls for as long as the key stays the same.
+    private SymmetricKey aeadKey = null;
+    private CipherContextProxy aeadEncryptContext = null;
+    private CipherContextProxy aeadDecryptContext = null;
+
+    // AEAD algorithms only: tag length in bytes, set with initXXX()
+    private int tagLength = 0;
+
+    // AEAD algorithms only: the message is authenticated as a whole, so
+    // input and AAD are buffered until doFinal().
+    private MessageBuffer aeadData = new MessageBuffer();
+    private MessageBuffer aeadAAD = new MessageBuffer();
+
+    // AEAD algorithms only: the last nonce encrypted under aeadKey, and
+    // whether it has been used since initEncrypt(). This only guards
+    // against reusing the immediately preceding nonce; see initEncrypt().
+    private byte[] lastEncryptNonce = null;
+    private boolean nonceSpent = false;
+
+    // Default and allowed AEAD tag lengths, in bits.
+    private static final int DEFAULT_TAG_BITS = 128;
+    private static final int MIN_TAG_BITS = 96;
+
     // States
     private static final int UNINITIALIZED=0;
     private static final int ENCRYPT=1;
@@ -87,6 +146,13 @@ public final class PK11Cipher
 
 
     /**
+     * For AEAD algorithms, the caller is responsible for never encrypting
+     * twice under the same key and nonce. Only an immediate repeat is
+     * caught: initializing with the nonce of the last message encrypted
+     * under this key throws InvalidAlgorithmParameterException, but
+     * alternating between two nonces is not detected. Use a counter or a
+     * fresh random nonce for every message.
+     *
      * @deprecated isPadded() in EncryptionAlgorithm has been deprecated
      */
     @Override
@@ -100,6 +166,11 @@ public final class PK11Cipher
         checkKey(key);
         checkParams(parameters);
 
+        if( algorithm.isAEAD() ) {
+            initAEAD(true, key, parameters);
+            return;
+        }
+
         IV = getIVFromParams(parameters);
         this.key = key;
         this.parameters = parameters;
@@ -130,6 +201,11 @@ public final class PK11Cipher
         checkKey(key);
         checkParams(parameters);
 
+        if( algorithm.isAEAD() ) {
+            initAEAD(false, key, parameters);
+            return;
+        }
+
         IV = getIVFromParams(parameters);
         this.key = key;
         this.parameters = parameters;
@@ -146,6 +222,299 @@ public final class PK11Cipher
         }
     }
 
+    /**
+     * Starts a new message with the same key, direction, and parameters as
+     * the last initEncrypt() or initDecrypt(), but with a new IV. Rather
+     * than creating a new PKCS #11 context, as initializing again would,
+     * this restarts an existing one, which for short messages is much of
+     * the cost of ciphering them. Any message in progress is abandoned;
+     * as NSS can't restart a context part way through a message, a new
+     * context is created in that case.
+     *
+     * @param iv The IV (or AEAD nonce) for the next message, or null for
+     *        algorithms which take none.
+     * @throws IllegalStateException If the cipher has not been initialized.
+     */
+    public void reinit(byte[] iv)
+        throws IllegalStateException, InvalidKeyException,
+        InvalidAlgorithmParameterException, TokenException
+    {
+        if( state == UNINITIALIZED ) {
+            throw new IllegalStateException();
+        }
+
+        boolean encrypt = (state == ENCRYPT);
+        AlgorithmParameterSpec spec = null;
+        if( parameters instanceof GCMParameterSpec ) {
+            // AEAD contexts already take the nonce with each message.
+            spec = new GCMParameterSpec(tagLength * 8, iv);
+        } else if( algorithm.isAEAD() ) {
+            spec = new IvParameterSpec(iv);
+        } else if( parameters instanceof RC2ParameterSpec ) {
+            // NSS doesn't support the IV trick below for RC2.
+            spec = new RC2ParameterSpec(
+                ((RC2ParameterSpec) parameters).getEffectiveKeyBits(), iv);
+        }
+        if( spec != null ) {
+            if( encrypt ) {
+                initEncrypt(key, spec);
+            } else {
+                initDecrypt(key, spec);
+            }
+            return;
+        }
+
+        int ivLength = algorithm.getIVLength();
+        if( ivLength == 0 ) {
+            if( iv != null ) {
+                throw new InvalidAlgorithmParameterException(algorithm +
+                    " does not take an IV");
+            }
+            if( inMessage ) {
+                CipherContextProxy abandoned = contextProxy;
+                contextProxy = initContext(encrypt, key, algorithm, IV,
+                    algorithm.isPadded());
+                try {
+                    abandoned.close();
+                } catch( Exception e ) {
+                    throw new TokenException("Unable to release cipher " +
+                        "context: " + e.getMessage(), e);
+                }
+            } else {
+                resetContext(contextProxy);
+            }
+            buffered = 0;
+            inMessage = false;
+            return;
+        }
+
+        if( iv == null || iv.length != ivLength ) {
+            throw new InvalidAlgorithmParameterException(algorithm +
+                " requires a " + ivLength + "-byte IV");
+        }
+
+        if( inMessage && chainIV != null ) {
+            // Don't restart the chain context; see inMessage.
+            chainKey = null;
+        }
+        if( chainContext != null && chainKey == key &&
+                chainEncrypt == encrypt ) {
+            resetContext(chainContext);
+        } else {
+            closeChainContext();
+            // Padding is applied and checked by chainProcess(), so that the
+            // context only ever sees whole blocks.
+            chainContext = initContext(encrypt, key, algorithm,
+                new byte[ivLength], false);
+            chainKey = key;
+            chainEncrypt = encrypt;
+        }
+
+        IV = iv.clone();
+        parameters = new IvParameterSpec(IV);
+        chainIV = IV;
+        chainPos = 0;
+        if( chainBlock == null ) {
+            chainBlock = new byte[algorithm.getBlockSize()];
+        }
+        chainWipe();
+        buffered = 0;
+        inMessage = false;
+    }
+
+    /**
+     * Passes part of a message to chainContext, applying chainIV the way
+     * CBC would have, and writes the result into output. Only whole blocks
+     * go to the context. When encrypting, the IV is XORed into the first
+     * block, and the padding is added on the last call. When decrypting,
+     * the IV is passed in as an extra first block of ciphertext and its
+     * plaintext dropped, so that the real first block chains off it; the
+     * last block is held back and unpadded on the last call.
+     *
+     * Only the first block, when it is put together from held-back input
+     * or needs the IV, and the last are copied; whole blocks in between
+     * go straight from input to output as in process(). Neither buffer's
+     * position is changed.
+     *
+     * @return The number of bytes written to output.
+     */
+    private int chainProcess(ByteBuffer input, ByteBuffer output,
+        boolean finish)
+        throws IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        input = input.duplicate();
+        output = output.duplicate();
+        int blockSize = algorithm.getBlockSize();
+        boolean decrypt = (state == DECRYPT);
+        boolean padded =
+            algorithm.getPadding() != EncryptionAlgorithm.Padding.NONE;
+
+        long total = chainHeld + (long) input.remaining();
+        long feed = total - total % blockSize;
+        if( decrypt && padded && feed == total && feed > 0 ) {
+            feed -= blockSize;
+        }
+        long left = total - feed;
+        if( finish && (padded ? decrypt && left != blockSize : left != 0) ) {
+            throw new IllegalBlockSizeException(algorithm +
+                " input does not end on a block boundary");
+        }
+
+        // Read everything first, as output may overlap input.
+        boolean first = (chainPos == 0);
+        byte[] head = null;
+        if( feed > 0 && (chainHeld > 0 || (first && !decrypt)) ) {
+            head = Arrays.copyOf(chainBlock, blockSize);
+            input.get(head, chainHeld, blockSize - chainHeld);
+            if( first && !decrypt ) {
+                chainXorIV(head);
+            }
+            chainHeld = 0;
+        }
+        ByteBuffer middle = input.duplicate();
+        middle.limit(middle.position() +
+            (int) feed - (head == null ? 0 : blockSize));
+        input.position(middle.limit());
+        int rest = input.remaining();
+        input.get(chainBlock, chainHeld, rest);
+        chainHeld += rest;
+
+        if( decrypt && first && (feed > 0 || (finish && padded)) ) {
+            Arrays.fill(updateContext(chainContext, chainIV, blockSize),
+                (byte) 0);
+        }
+        chainPos += feed;
+
+        int start = output.position();
+        if( head != null ) {
+            // Cipher the first block before the rest, but write it after
+            // them, once the input it overlaps has been read.
+            byte[] headOut = updateContext(chainContext, head, blockSize);
+            Arrays.fill(head, (byte) 0);
+            output.position(start + headOut.length);
+            chainMiddle(middle, output);
+            int end = output.position();
+            output.position(start);
+            output.put(headOut);
+            output.position(end);
+        } else if( middle.hasRemaining() ) {
+            chainMiddle(middle, output);
+        }
+
+        if( finish && padded ) {
+            byte[] last = Arrays.copyOf(chainBlock, blockSize);
+            if( decrypt ) {
+                byte[] plain = updateContext(chainContext, last, blockSize);
+                int padLength = plain[blockSize - 1] & 0xff;
+                boolean valid = padLength > 0 && padLength <= blockSize;
+                for( int i = blockSize - padLength; valid && i < blockSize; i++ ) {
+                    valid = (plain[i] & 0xff) == padLength;
+                }
+                if( !valid ) {
+                    Arrays.fill(plain, (byte) 0);
+                    throw new BadPaddingException("Invalid " + algorithm +
+                        " padding");
+                }
+                output.put(plain, 0, blockSize - padLength);
+                Arrays.fill(plain, (byte) 0);
+            } else {
+                int padLength = blockSize - chainHeld;
+                Arrays.fill(last, chainHeld, blockSize, (byte) padLength);
+                if( first && feed == 0 ) {
+                    chainXorIV(last);
+                }
+                output.put(updateContext(chainContext, last, blockSize));
+            }
+            Arrays.fill(last, (byte) 0);
+        }
+
+        if( finish ) {
+            // The context holds no partial blocks, but must be finished
+            // before resetContext() can restart it.
+            finalizeContext(chainContext, blockSize, false);
+            chainWipe();
+        }
+        return output.position() - start;
+    }
+
+    /**
+     * Ciphers the whole blocks between input's position and limit into
+     * output, straight from one to the other when both are direct or both
+     * are backed by arrays, and advances output's position.
+     */
+    private void chainMiddle(ByteBuffer input, ByteBuffer output)
+        throws TokenException
+    {
+        int inputLen = input.remaining();
+        int written;
+        if( input.isDirect() && output.isDirect() ) {
+            written = updateContextDirect(chainContext,
+                input, input.position(), inputLen,
+                output, output.position(), output.remaining(), false);
+        } else if( input.hasArray() && output.hasArray() ) {
+            written = updateContextArray(chainContext,
+                input.array(), input.arrayOffset() + input.position(), inputLen,
+                output.array(), output.arrayOffset() + output.position(),
+                output.remaining(), false);
+        } else {
+            byte[] bytes = new byte[inputLen];
+            input.get(bytes);
+            byte[] result = updateContext(chainContext, bytes,
+                algorithm.getBlockSize());
+            output.put(result);
+            Arrays.fill(bytes, (byte) 0);
+            return;
+        }
+        output.position(output.position() + written);
+    }
+
+    /**
+     * chainProcess() for the byte array interface.
+     */
+    private byte[] chainUpdate(byte[] bytes, boolean finish)
+        throws IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        byte[] output = new byte[getRequiredOutputSize(bytes.length, finish)];
+        int written = chainProcess(ByteBuffer.wrap(bytes),
+            ByteBuffer.wrap(output), finish);
+        if( written == output.length ) {
+            return output;
+        }
+        byte[] result = Arrays.copyOf(output, written);
+        Arrays.fill(output, (byte) 0);
+        return result;
+    }
+
+    private void chainXorIV(byte[] block) {
+        for( int i = 0; i < block.length; i++ ) {
+            block[i] ^= chainIV[i];
+        }
+    }
+
+    private void chainWipe() {
+        if( chainBlock != null ) {
+            Arrays.fill(chainBlock, (byte) 0);
+        }
+        chainHeld = 0;
+    }
+
+    private void closeChainContext() throws TokenException {
+        CipherContextProxy context = chainContext;
+        chainContext = null;
+        chainKey = null;
+        chainIV = null;
+        chainWipe();
+
+        if( context != null ) {
+            try {
+                context.close();
+            } catch( Exception e ) {
+                throw new TokenException("Unable to release cipher context: " +
+                    e.getMessage(), e);
+            }
+        }
+    }
+
     @Override
     public byte[] update(byte[] bytes)
         throws IllegalStateException, TokenException
@@ -154,7 +523,27 @@ public final class PK11Cipher
             throw new IllegalStateException();
         }
 
-        return updateContext( contextProxy, bytes, algorithm.getBlockSize());
+        if( algorithm.isAEAD() ) {
+            checkNonce();
+            aeadData.write(bytes, 0, bytes.length);
+            return new byte[0];
+        }
+
+        inMessage = true;
+        byte[] result;
+        if( chainIV != null ) {
+            try {
+                result = chainUpdate(bytes, false);
+            } catch (IllegalBlockSizeException | BadPaddingException e) {
+                // Only finalization checks block sizes and padding.
+                throw new TokenException(e.getMessage(), e);
+            }
+        } else {
+            result = updateContext( contextProxy, bytes,
+                algorithm.getBlockSize());
+        }
+        buffered += bytes.length - result.length;
+        return result;
     }
 
     @Override
@@ -181,10 +570,25 @@ public final class PK11Cipher
             throw new IllegalStateException();
         }
 
-        byte[] first = update(bytes);
+        if( algorithm.isAEAD() ) {
+            checkNonce();
+            aeadData.write(bytes, 0, bytes.length);
+            return finishAEAD();
+        }
 
+        if( chainIV != null ) {
+            inMessage = true;
+            byte[] result = chainUpdate(bytes, true);
+            buffered = 0;
+            inMessage = false;
+            return result;
+        }
+
+        byte[] first = update(bytes);
         byte[] last = finalizeContext(contextProxy, algorithm.getBlockSize(),
-                    algorithm.isPadded() );
+                        algorithm.isPadded() );
+        buffered = 0;
+        inMessage = false;
 
         byte[] combined = new byte[ first.length+last.length ];
         System.arraycopy(first, 0, combined, 0, first.length);
@@ -216,8 +620,649 @@ public final class PK11Cipher
         if( state == UNINITIALIZED ) {
             throw new IllegalStateException();
         }
-        return finalizeContext(contextProxy, algorithm.getBlockSize(),
+
+        if( algorithm.isAEAD() ) {
+            checkNonce();
+            return finishAEAD();
+        }
+
+        if( chainIV != null ) {
+            return doFinal(new byte[0]);
+        }
+
+        byte[] last = finalizeContext(contextProxy, algorithm.getBlockSize(),
                     algorithm.isPadded() );
+        buffered = 0;
+        inMessage = false;
+        return last;
+    }
+
+    /**
+     * Supplies additional authenticated data (AAD) for the current message
+     * of an AEAD algorithm. The AAD is authenticated along with the message
+     * but not encrypted, and must be supplied before any of the message
+     * itself.
+     *
+     * @throws IllegalStateException If the cipher is not initialized, or
+     *         message data has already been supplied.
+     * @throws UnsupportedOperationException If this is not an AEAD
+     *         algorithm.
+     */
+    public void updateAAD(byte[] src, int offset, int length)
+        throws IllegalStateException
+    {
+        if( state == UNINITIALIZED ) {
+            throw new IllegalStateException();
+        }
+        if( !algorithm.isAEAD() ) {
+            throw new UnsupportedOperationException(algorithm +
+                " does not take additional authenticated data");
+        }
+        checkNonce();
+        if( aeadData.size() > 0 ) {
+            throw new IllegalStateException(
+                "AAD must be supplied before any message data");
+        }
+
+        aeadAAD.write(src, offset, length);
+    }
+
+    /**
+     * @return The length in bytes of the authentication tag produced or
+     *         expected by an AEAD algorithm, or 0 for other algorithms.
+     */
+    public int getTagLength() {
+        return tagLength;
+    }
+
+    private void initAEAD(boolean encrypt, SymmetricKey key,
+        AlgorithmParameterSpec parameters)
+        throws InvalidAlgorithmParameterException, TokenException
+    {
+        byte[] nonce;
+        int tagBits = DEFAULT_TAG_BITS;
+        if( parameters instanceof GCMParameterSpec ) {
+            nonce = ((GCMParameterSpec)parameters).getIV();
+            tagBits = ((GCMParameterSpec)parameters).getTLen();
+        } else {
+            nonce = getIVFromParams(parameters);
+        }
+
+        if( nonce == null || nonce.length == 0 ) {
+            throw new InvalidAlgorithmParameterException(algorithm +
+                " requires a nonce");
+        }
+        if( tagBits < MIN_TAG_BITS || tagBits > DEFAULT_TAG_BITS ||
+                tagBits % 8 != 0 ) {
+            throw new InvalidAlgorithmParameterException(
+                "Unsupported tag length: " + tagBits + " bits");
+        }
+
+        if( key != aeadKey ) {
+            closeAEADContexts();
+            aeadKey = key;
+        } else if( encrypt && Arrays.equals(nonce, lastEncryptNonce) ) {
+            throw new InvalidAlgorithmParameterException(
+                "Cannot reuse a nonce with the same key");
+        }
+
+        if( encrypt && aeadEncryptContext == null ) {
+            aeadEncryptContext = initAEADContext(true, key, algorithm);
+        } else if( !encrypt && aeadDecryptContext == null ) {
+            aeadDecryptContext = initAEADContext(false, key, algorithm);
+        }
+
+        IV = nonce;
+        this.key = key;
+        this.parameters = parameters;
+        tagLength = tagBits / 8;
+        nonceSpent = false;
+        aeadData.wipe();
+        aeadAAD.wipe();
+        state = encrypt ? ENCRYPT : DECRYPT;
+    }
+
+    /**
+     * Encryption under a nonce is one message; after that, the cipher
+     * must be reinitialized with a new nonce.
+     */
+    private void checkNonce() throws IllegalStateException {
+        if( nonceSpent ) {
+            throw new IllegalStateException("Cipher must be reinitialized " +
+                "with a new nonce after each encryption");
+        }
+    }
+
+    private byte[] finishAEAD()
+        throws BadPaddingException, TokenException
+    {
+        boolean encrypt = (state == ENCRYPT);
+        int length = aeadData.size();
+
+        try {
+            if( !encrypt && length < tagLength ) {
+                throw new AEADBadTagException("Input too short to contain a " +
+                    tagLength + "-byte tag");
+            }
+
+            return aeadOp(encrypt ? aeadEncryptContext : aeadDecryptContext,
+                encrypt, IV, aeadAAD.size() == 0 ? null : aeadAAD.toByteArray(),
+                aeadData.array(), length, tagLength);
+        } finally {
+            aeadData.wipe();
+            aeadAAD.wipe();
+            if( encrypt ) {
+                lastEncryptNonce = IV;
+                nonceSpent = true;
+            }
+        }
+    }
+
+    private void closeAEADContexts() throws TokenException {
+        CipherContextProxy[] contexts = { aeadEncryptContext, aeadDecryptContext };
+        aeadEncryptContext = null;
+        aeadDecryptContext = null;
+        aeadKey = null;
+        lastEncryptNonce = null;
+
+        for( CipherContextProxy context : contexts ) {
+            if( context == null ) {
+                continue;
+            }
+            try {
+                context.close();
+            } catch( Exception e ) {
+                throw new TokenException("Unable to release AEAD context: " +
+                    e.getMessage(), e);
+            }
+        }
+    }
+
+    /**
+     * A ByteArrayOutputStream whose contents can be passed to native code
+     * without copying, and which zeroes them when reset.
+     */
+    private static final class MessageBuffer extends ByteArrayOutputStream {
+        byte[] array() {
+            return buf;
+        }
+
+        void wipe() {
+            Arrays.fill(buf, 0, count, (byte) 0);
+            reset();
+        }
+    }
+
+    /**
+     * Size of the output buffer required by the ByteBuffer and array-offset
+     * variants of update() and doFinal(), which write straight into the
+     * caller's buffer. This counts the input held back by earlier calls, as
+     * well as the padding added by finalization, and is what the JCA
+     * provider reports from Cipher.getOutputSize().
+     *
+     * @param inputLen Number of bytes to be passed in.
+     * @param finish Whether the call is to doFinal() rather than update().
+     */
+    public int getRequiredOutputSize(int inputLen, boolean finish) {
+        if( algorithm.isAEAD() ) {
+            // Everything is held back until doFinal(), which adds (or
+            // removes) the tag.
+            if( !finish ) {
+                return 0;
+            }
+            long required = (long) aeadData.size() + inputLen +
+                (state == DECRYPT ? -tagLength : tagLength);
+            return (int) Math.max(0, Math.min(required, Integer.MAX_VALUE));
+        }
+
+        // Encryption returns whole blocks, and finalization pads out the
+        // last one. Decryption can return everything, less any padding.
+        long pending = buffered + inputLen;
+        long required = pending;
+        if( state == ENCRYPT &&
+                algorithm.getPadding() != EncryptionAlgorithm.Padding.NONE ) {
+            int blockSize = algorithm.getBlockSize();
+            required = pending - pending % blockSize;
+            if( finish ) {
+                required += blockSize;
+            }
+        }
+        return (int) Math.min(required, Integer.MAX_VALUE);
+    }
+
+    /**
+     * Cipher input from its position up to its limit, writing the result
+     * into output at its position. When both buffers are direct, or both
+     * are backed by arrays, no intermediate copies are made. On return,
+     * input's position is at its limit and output's position is past the
+     * bytes written.
+     *
+     * @return The number of bytes written to output.
+     * @throws ShortBufferException If output has less room remaining than
+     *         getRequiredOutputSize(input.remaining(), false).
+     */
+    public int update(ByteBuffer input, ByteBuffer output)
+        throws IllegalStateException, ShortBufferException, TokenException
+    {
+        try {
+            return process(input, output, false);
+        } catch (IllegalBlockSizeException | BadPaddingException e) {
+            // Only finalization checks block sizes and padding.
+            throw new TokenException(e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Cipher input from its position up to its limit and finish the
+     * operation, writing the result into output at its position; see
+     * update(ByteBuffer, ByteBuffer).
+     *
+     * @return The number of bytes written to output.
+     * @throws ShortBufferException If output has less room remaining than
+     *         getRequiredOutputSize(input.remaining(), true).
+     */
+    public int doFinal(ByteBuffer input, ByteBuffer output)
+        throws IllegalStateException, ShortBufferException,
+        IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        return process(input, output, true);
+    }
+
+    /**
+     * Cipher inputLen bytes of input, starting at inputOffset, writing the
+     * result straight into output at outputOffset.
+     *
+     * @return The number of bytes written to output.
+     * @throws ShortBufferException If output has less room after
+     *         outputOffset than getRequiredOutputSize(inputLen, false).
+     */
+    public int update(byte[] input, int inputOffset, int inputLen,
+        byte[] output, int outputOffset)
+        throws IllegalStateException, ShortBufferException, TokenException
+    {
+        try {
+            return process(input, inputOffset, inputLen, output, outputOffset,
+                           false);
+        } catch (IllegalBlockSizeException | BadPaddingException e) {
+            throw new TokenException(e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Cipher inputLen bytes of input, starting at inputOffset, and finish
+     * the operation, writing the result straight into output at
+     * outputOffset.
+     *
+     * @return The number of bytes written to output.
+     * @throws ShortBufferException If output has less room after
+     *         outputOffset than getRequiredOutputSize(inputLen, true).
+     */
+    public int doFinal(byte[] input, int inputOffset, int inputLen,
+        byte[] output, int outputOffset)
+        throws IllegalStateException, ShortBufferException,
+        IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        return process(input, inputOffset, inputLen, output, outputOffset,
+                       true);
+    }
+
+    /**
+     * The outputs of encryptBatch() or decryptBatch(), packed end to end
+     * into one array. The output for message <i>i</i> runs from
+     * <code>getOffsets()[i]</code> up to <code>getOffsets()[i+1]</code>.
+     */
+    public static final class BatchResult {
+        private final byte[] output;
+        private final int[] offsets;
+
+        BatchResult(byte[] output, int[] offsets) {
+            this.output = output;
+            this.offsets = offsets;
+        }
+
+        /** @return The packed outputs of all messages. */
+        public byte[] getOutput() {
+            return output;
+        }
+
+        /** @return Where each output starts, plus one final entry for the
+         *          end of the last. */
+        public int[] getOffsets() {
+            return offsets;
+        }
+
+        /** @return The number of messages in the batch. */
+        public int size() {
+            return offsets.length - 1;
+        }
+
+        /** @return A copy of the output for message <code>index</code>. */
+        public byte[] get(int index) {
+            return Arrays.copyOfRange(output, offsets[index],
+                offsets[index + 1]);
+        }
+    }
+
+    /**
+     * Encrypts a batch of messages under one key, with one native call and
+     * one PKCS #11 context for the whole batch rather than one per message.
+     * This suits many short messages, where setting up each operation costs
+     * more than the encryption itself.
+     *
+     * <p>CBC and ECB modes (of any algorithm but RC2), RC4, and the AEAD
+     * algorithms are supported. For AEAD algorithms, each message is given
+     * a full 16-byte tag and no additional authenticated data.
+     *
+     * @param ivs The IV (or, for AEAD algorithms, the 12-byte nonce) for
+     *        each message. May be null for algorithms which take no IV.
+     *        Never reuse an AEAD nonce under the same key.
+     * @param inputs The messages to encrypt.
+     */
+    public static BatchResult encryptBatch(SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, byte[][] inputs)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        TokenException
+    {
+        try {
+            return cipherBatch(true, key, algorithm, ivs, inputs);
+        } catch (BadPaddingException e) {
+            // Only decryption checks padding and tags.
+            throw new TokenException(e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Decrypts a batch of messages encrypted by encryptBatch(), or by any
+     * other means with the same algorithm.
+     *
+     * @throws BadPaddingException If any message is incorrectly padded, or
+     *         an AEAD message fails authentication (an AEADBadTagException).
+     *         The message names the offending index, and no output is
+     *         returned for any message.
+     * @see #encryptBatch(SymmetricKey, EncryptionAlgorithm, byte[][], byte[][])
+     */
+    public static BatchResult decryptBatch(SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, byte[][] inputs)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        BadPaddingException, TokenException
+    {
+        return cipherBatch(false, key, algorithm, ivs, inputs);
+    }
+
+    /**
+     * Encrypts a batch of messages laid end to end in input, from its
+     * position on, writing the results end to end into output at its
+     * position. The buffers must not overlap. When both are direct, no
+     * intermediate copies are made. On return, both positions are advanced
+     * past the bytes consumed and written.
+     *
+     * @param lengths The length of each message in input.
+     * @return The offset of each result in output, relative to its
+     *         position on entry, plus one final entry for the end of the
+     *         last.
+     * @throws ShortBufferException If output has less room remaining than
+     *         getBatchOutputSize(algorithm, lengths).
+     * @see #encryptBatch(SymmetricKey, EncryptionAlgorithm, byte[][], byte[][])
+     */
+    public static int[] encryptBatch(SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, ByteBuffer input,
+        int[] lengths, ByteBuffer output)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        ShortBufferException, TokenException
+    {
+        try {
+            return cipherBatch(true, key, algorithm, ivs, input, lengths,
+                               output);
+        } catch (BadPaddingException e) {
+            throw new TokenException(e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Decrypts a batch of messages laid end to end in input; see
+     * encryptBatch(SymmetricKey, EncryptionAlgorithm, byte[][], ByteBuffer,
+     * int[], ByteBuffer) and decryptBatch(SymmetricKey,
+     * EncryptionAlgorithm, byte[][], byte[][]).
+     */
+    public static int[] decryptBatch(SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, ByteBuffer input,
+        int[] lengths, ByteBuffer output)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        ShortBufferException, BadPaddingException, TokenException
+    {
+        return cipherBatch(false, key, algorithm, ivs, input, lengths, output);
+    }
+
+    /**
+     * @return An upper bound on the room needed in the output buffer to
+     *         encrypt or decrypt a batch of messages of the given lengths.
+     */
+    public static int getBatchOutputSize(EncryptionAlgorithm algorithm,
+        int[] lengths)
+    {
+        int overhead = algorithm.isAEAD() ? BATCH_TAG_LENGTH
+                                          : algorithm.getBlockSize();
+        long required = 0;
+        for (int length : lengths) {
+            required += length + overhead;
+        }
+        return (int) Math.min(required, Integer.MAX_VALUE);
+    }
+
+    // Tag length used for AEAD batches, in bytes.
+    private static final int BATCH_TAG_LENGTH = DEFAULT_TAG_BITS / 8;
+
+    // Nonce length required for AEAD batches, in bytes.
+    private static final int BATCH_NONCE_LENGTH = 12;
+
+    private static BatchResult cipherBatch(boolean encrypt, SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, byte[][] inputs)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        BadPaddingException, TokenException
+    {
+        checkBatch(key, algorithm, ivs, inputs.length);
+
+        int[] offsets = new int[inputs.length + 1];
+        byte[] output = cipherBatchArray(encrypt, key, algorithm,
+            algorithm.isPadded(), ivs, inputs, offsets);
+        return new BatchResult(output, offsets);
+    }
+
+    private static int[] cipherBatch(boolean encrypt, SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, ByteBuffer input,
+        int[] lengths, ByteBuffer output)
+        throws InvalidKeyException, InvalidAlgorithmParameterException,
+        ShortBufferException, BadPaddingException, TokenException
+    {
+        checkBatch(key, algorithm, ivs, lengths.length);
+
+        long total = 0;
+        for (int length : lengths) {
+            if( length < 0 ) {
+                throw new IllegalArgumentException("Negative message length");
+            }
+            total += length;
+        }
+        if( total > input.remaining() ) {
+            throw new IllegalArgumentException("Message lengths add up to " +
+                total + ", but only " + input.remaining() + " remaining");
+        }
+
+        int required = getBatchOutputSize(algorithm, lengths);
+        if( output.remaining() < required ) {
+            throw new ShortBufferException(required + " needed, " +
+                output.remaining() + " supplied");
+        }
+
+        int[] offsets = new int[lengths.length + 1];
+        if( !input.isDirect() || !output.isDirect() ) {
+            // Copy the messages out into arrays rather than pinning one side
+            // and not the other.
+            byte[][] inputs = new byte[lengths.length][];
+            for (int i = 0; i < lengths.length; i++) {
+                inputs[i] = new byte[lengths[i]];
+                input.get(inputs[i]);
+            }
+
+            byte[] result = cipherBatchArray(encrypt, key, algorithm,
+                algorithm.isPadded(), ivs, inputs, offsets);
+            output.put(result);
+            return offsets;
+        }
+
+        cipherBatchDirect(encrypt, key, algorithm, algorithm.isPadded(), ivs,
+            input, input.position(), lengths, output, output.position(),
+            output.remaining(), offsets);
+
+        input.position(input.position() + (int) total);
+        output.position(output.position() + offsets[lengths.length]);
+        return offsets;
+    }
+
+    /**
+     * Checks the key, that the algorithm can be used in a batch, and that
+     * there is a correctly sized IV for each of count messages.
+     */
+    private static void checkBatch(SymmetricKey key,
+        EncryptionAlgorithm algorithm, byte[][] ivs, int count)
+        throws InvalidKeyException, InvalidAlgorithmParameterException
+    {
+        checkKey(key, algorithm);
+
+        EncryptionAlgorithm.Mode mode = algorithm.getMode();
+        EncryptionAlgorithm.Alg alg = algorithm.getAlg();
+        boolean batchable = algorithm.isAEAD() ||
+            alg == EncryptionAlgorithm.Alg.RC4 ||
+            (alg != EncryptionAlgorithm.Alg.RC2 &&
+             (mode == EncryptionAlgorithm.Mode.CBC ||
+              mode == EncryptionAlgorithm.Mode.ECB));
+        if( !batchable ) {
+            throw new InvalidAlgorithmParameterException(algorithm +
+                " cannot be used in a batch");
+        }
+
+        int ivLength = algorithm.isAEAD() ? BATCH_NONCE_LENGTH
+                                          : algorithm.getIVLength();
+        if( ivLength == 0 ) {
+            if( ivs != null ) {
+                throw new InvalidAlgorithmParameterException(algorithm +
+                    " does not take an IV");
+            }
+            return;
+        }
+
+        if( ivs == null || ivs.length != count ) {
+            throw new InvalidAlgorithmParameterException(algorithm +
+                " needs an IV for each message");
+        }
+        for (int i = 0; i < count; i++) {
+            if( ivs[i] == null || ivs[i].length != ivLength ) {
+                throw new InvalidAlgorithmParameterException("IV for message " +
+                    i + " must be " + ivLength + " bytes");
+            }
+        }
+    }
+
+    private int process(ByteBuffer input, ByteBuffer output, boolean finish)
+        throws IllegalStateException, ShortBufferException,
+        IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        if( state == UNINITIALIZED ) {
+            throw new IllegalStateException();
+        }
+
+        int inputLen = input.remaining();
+        int required = getRequiredOutputSize(inputLen, finish);
+        if( output.remaining() < required ) {
+            throw new ShortBufferException(required + " needed, " +
+                output.remaining() + " supplied");
+        }
+
+        boolean direct = input.isDirect() && output.isDirect();
+        boolean arrays = input.hasArray() && output.hasArray();
+        if( algorithm.isAEAD() || !(direct || arrays) ) {
+            // AEAD algorithms buffer the message until doFinal() anyway.
+            // For mixed buffers, copy the input out rather than pinning one
+            // side and not the other.
+            byte[] bytes = new byte[inputLen];
+            input.duplicate().get(bytes);
+            byte[] result = finish ? doFinal(bytes) : update(bytes);
+            output.put(result);
+            input.position(input.limit());
+            return result.length;
+        }
+
+        int written;
+        inMessage = true;
+        if( chainIV != null ) {
+            written = chainProcess(input, output, finish);
+        } else if( direct ) {
+            written = updateContextDirect(contextProxy,
+                input, input.position(), inputLen,
+                output, output.position(), output.remaining(), finish);
+        } else {
+            written = updateContextArray(contextProxy,
+                input.array(), input.arrayOffset() + input.position(), inputLen,
+                output.array(), output.arrayOffset() + output.position(),
+                output.remaining(), finish);
+        }
+
+        buffered = finish ? 0 : buffered + inputLen - written;
+        inMessage = !finish;
+        input.position(input.limit());
+        output.position(output.position() + written);
+        return written;
+    }
+
+    private int process(byte[] input, int inputOffset, int inputLen,
+        byte[] output, int outputOffset, boolean finish)
+        throws IllegalStateException, ShortBufferException,
+        IllegalBlockSizeException, BadPaddingException, TokenException
+    {
+        if( state == UNINITIALIZED ) {
+            throw new IllegalStateException();
+        }
+
+        if( inputLen < 0 || (inputLen > 0 && (input == null ||
+                inputOffset < 0 || inputOffset > input.length - inputLen)) ) {
+            throw new IndexOutOfBoundsException("Invalid input offset " +
+                inputOffset + " or length " + inputLen);
+        }
+        if( outputOffset < 0 || outputOffset > output.length ) {
+            throw new IndexOutOfBoundsException("Invalid output offset " +
+                outputOffset);
+        }
+
+        int available = output.length - outputOffset;
+        int required = getRequiredOutputSize(inputLen, finish);
+        if( available < required ) {
+            throw new ShortBufferException(required + " needed, " +
+                available + " supplied");
+        }
+
+        if( algorithm.isAEAD() ) {
+            byte[] bytes = new byte[inputLen];
+            if( inputLen > 0 ) {
+                System.arraycopy(input, inputOffset, bytes, 0, inputLen);
+            }
+            byte[] result = finish ? doFinal(bytes) : update(bytes);
+            System.arraycopy(result, 0, output, outputOffset, result.length);
+            return result.length;
+        }
+
+        int written;
+        inMessage = true;
+        if( chainIV != null ) {
+            written = chainProcess(inputLen == 0 ? ByteBuffer.allocate(0) :
+                    ByteBuffer.wrap(input, inputOffset, inputLen),
+                ByteBuffer.wrap(output, outputOffset, available), finish);
+        } else {
+            written = updateContextArray(contextProxy, input, inputOffset,
+                inputLen, output, outputOffset, available, finish);
+        }
+        buffered = finish ? 0 : buffered + inputLen - written;
+        inMessage = !finish;
+        return written;
     }
 
     private static native CipherContextProxy
@@ -235,16 +1280,62 @@ public final class PK11Cipher
     updateContext( CipherContextProxy context, byte[] input, int blocksize )
         throws TokenException;
 
+    private static native int
+    updateContextDirect(CipherContextProxy context, ByteBuffer input,
+        int inputOffset, int inputLen, ByteBuffer output, int outputOffset,
+        int outputLen, boolean finish)
+        throws TokenException;
+
+    private static native int
+    updateContextArray(CipherContextProxy context, byte[] input,
+        int inputOffset, int inputLen, byte[] output, int outputOffset,
+        int outputLen, boolean finish)
+        throws TokenException;
+
+    private static native CipherContextProxy
+    initAEADContext(boolean encrypt, SymmetricKey key, EncryptionAlgorithm alg)
+        throws TokenException;
+
+    private static native byte[]
+    aeadOp(CipherContextProxy context, boolean encrypt, byte[] nonce,
+        byte[] aad, byte[] input, int inputLen, int tagLen)
+        throws TokenException, AEADBadTagException;
+
+    private static native byte[]
+    cipherBatchArray(boolean encrypt, SymmetricKey key,
+        EncryptionAlgorithm alg, boolean padded, byte[][] ivs,
+        byte[][] inputs, int[] offsets)
+        throws TokenException, BadPaddingException;
+
+    private static native void
+    cipherBatchDirect(boolean encrypt, SymmetricKey key,
+        EncryptionAlgorithm alg, boolean padded, byte[][] ivs,
+        ByteBuffer input, int inputOffset, int[] lengths, ByteBuffer output,
+        int outputOffset, int outputLen, int[] offsets)
+        throws TokenException, BadPaddingException;
+
     private static native byte[]
     finalizeContext( CipherContextProxy context, int blocksize, boolean padded)
         throws TokenException, IllegalBlockSizeException, BadPaddingException;
 
+    private static native void
+    resetContext(CipherContextProxy context)
+        throws TokenException;
+
     private void reset() {
+        if( inMessage && chainIV != null ) {
+            // Don't let reinit() restart the chain context; see inMessage.
+            chainKey = null;
+        }
         parameters = null;
         key = null;
         IV = null;
         state = UNINITIALIZED;
         contextProxy = null;
+        chainIV = null;
+        chainWipe();
+        buffered = 0;
+        inMessage = false;
     }
 
     /**
@@ -271,6 +1362,12 @@ public final class PK11Cipher
      * for this algorithm.
      */
     private void checkKey(SymmetricKey key) throws InvalidKeyException {
+        checkKey(key, algorithm);
+    }
+
+    private static void checkKey(SymmetricKey key,
+        EncryptionAlgorithm algorithm) throws InvalidKeyException
+    {
         if( key==null ) {
             throw new InvalidKeyException("Key is null");
         }
@@ -292,18 +1389,20 @@ public final class PK11Cipher
         }
     }
 
-    @Override
-    public void finalize() throws Throwable {
-        close();
-    }
-
     @Override
     public void close() throws Exception {
-        if (contextProxy != null) {
-            try {
-                contextProxy.close();
-            } finally {
-                contextProxy = null;
+        aeadData.wipe();
+        aeadAAD.wipe();
+        try {
+            closeAEADContexts();
+            closeChainContext();
+        } finally {
+            if (contextProxy != null) {
+                try {
+                    contextProxy.close();
+                } finally {
+                    contextProxy = null;
+                }
             }
         }
     }
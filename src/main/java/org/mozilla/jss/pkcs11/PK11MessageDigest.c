@@ -9,6 +9,7 @@
 #include <seccomon.h>
 #include <pk11func.h>
 #include <secitem.h>
+#include <secerr.h>
 
 /* JSS includes */
 #include <java_ids.h>
@@ -52,36 +53,27 @@ Java_org_mozilla_jss_pkcs11_PK11MessageDigest_initHMAC
     (JNIEnv *env, jclass clazz, jobject tokenObj, jobject algObj,
      jobject keyObj)
 {
-    PK11SymKey *origKey = NULL, *newKey=NULL;
+    PK11SymKey *key = NULL;
     PK11Context *context = NULL;
     CK_MECHANISM_TYPE mech;
     SECItem param;
     jobject contextObj=NULL;
-    bool freeNewKey = true;
 
     mech = JSS_getPK11MechFromAlg(env, algObj);
     PR_ASSERT( mech != CKM_INVALID_MECHANISM ); /* we checked already in Java */
 
-    if( JSS_PK11_getSymKeyPtr(env, keyObj, &origKey) != PR_SUCCESS ) {
+    /* The key was already copied with CKA_SIGN set, where the token
+     * allows it; see PK11SymKey.getSigningCopy. */
+    if( JSS_PK11_getSymKeyPtr(env, keyObj, &key) != PR_SUCCESS ) {
         /* exception was thrown */
         goto finish;
     }
 
-    /* copy the key, setting the CKA_SIGN attribute */
-    
-    newKey = PK11_CopySymKeyForSigning(origKey, mech);
-
-    /* For some key on the hsm, this call could fail, but the key may work anyway */
-
-    if( newKey == NULL ) {
-        newKey = origKey;
-        freeNewKey = false;
-    }
-
     param.data = NULL;
     param.len = 0;
 
-    context = PK11_CreateContextBySymKey(mech, CKA_SIGN, newKey, &param);
+    /* The context holds its own reference to the key. */
+    context = PK11_CreateContextBySymKey(mech, CKA_SIGN, key, &param);
     if( context == NULL ) {
         JSS_throwMsg(env, DIGEST_EXCEPTION,
             "Unable to initialize digest context");
@@ -90,13 +82,60 @@ Java_org_mozilla_jss_pkcs11_PK11MessageDigest_initHMAC
 
     contextObj = JSS_PK11_wrapCipherContextProxy(env, &context);
 finish:
-    if(freeNewKey) {
-        /* SymKeys are ref counted, and the context will free it's ref
-         * when it is destroyed */
-        PK11_FreeSymKey(newKey);
+    return contextObj;
+}
+
+/***********************************************************************
+ *
+ * PK11MessageDigest.resetContext
+ *
+ * Restarts a digest or MAC context, abandoning any operation in progress.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_PK11MessageDigest_resetContext
+    (JNIEnv *env, jclass clazz, jobject proxyObj)
+{
+    PK11Context *context = NULL;
+
+    if( JSS_PK11_getCipherContext(env, proxyObj, &context) != PR_SUCCESS ) {
+        /* exception was thrown */
+        return;
     }
 
-    return contextObj;
+    if( PK11_DigestBegin(context) != SECSuccess ) {
+        JSS_throwMsg(env, DIGEST_EXCEPTION, "Unable to reset digest context");
+    }
+}
+
+
+/***********************************************************************
+ *
+ * PK11MessageDigest.cloneContext
+ *
+ * Copies a digest or MAC context along with the state of the operation in
+ * progress. PK11_CloneContext saves and restores the state through the
+ * token, which not every token (or mechanism) supports.
+ */
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_pkcs11_PK11MessageDigest_cloneContext
+    (JNIEnv *env, jclass clazz, jobject proxyObj)
+{
+    PK11Context *context = NULL;
+    PK11Context *copy = NULL;
+
+    if( JSS_PK11_getCipherContext(env, proxyObj, &context) != PR_SUCCESS ) {
+        /* exception was thrown */
+        return NULL;
+    }
+
+    copy = PK11_CloneContext(context);
+    if( copy == NULL ) {
+        JSS_throwMsgPrErr(env, DIGEST_EXCEPTION,
+            "Unable to copy the state of the digest context");
+        return NULL;
+    }
+
+    return JSS_PK11_wrapCipherContextProxy(env, &copy);
 }
 
 
@@ -176,3 +215,205 @@ finish:
     JSS_DerefByteArray(env, outbuf, bytes, 0);
     return outLen;
 }
+
+
+/***********************************************************************
+ *
+ * PK11MessageDigest.digestAll
+ *
+ * Digests many inputs with one context, restarted by PK11_DigestBegin
+ * between them, writing the digests end to end into one byte array.
+ */
+static SECStatus
+digestOne(PK11Context *context, const unsigned char *data, unsigned int len,
+    unsigned char *out, unsigned int outLen)
+{
+    unsigned int written = 0;
+
+    if( PK11_DigestBegin(context) != SECSuccess ) {
+        return SECFailure;
+    }
+    if( len > 0 && PK11_DigestOp(context, data, len) != SECSuccess ) {
+        return SECFailure;
+    }
+    if( PK11_DigestFinal(context, out, &written, outLen) != SECSuccess ) {
+        return SECFailure;
+    }
+    if( written != outLen ) {
+        PORT_SetError(SEC_ERROR_OUTPUT_LEN);
+        return SECFailure;
+    }
+    return SECSuccess;
+}
+
+/*
+ * Creates the digest context and the array for count digests of outLen
+ * bytes each. On success the array's contents are referenced in *output,
+ * which is NULL when the array is empty.
+ */
+static PK11Context *
+digestAllInit(JNIEnv *env, jobject algObj, jint count, jint outLen,
+    jbyteArray *resultBA, jbyte **output)
+{
+    SECOidTag alg;
+    PK11Context *context = NULL;
+
+    *output = NULL;
+
+    alg = JSS_getOidTagFromAlg(env, algObj);
+    if( alg == SEC_OID_UNKNOWN ) {
+        JSS_throwMsg(env, DIGEST_EXCEPTION, "Unrecognized digest algorithm");
+        return NULL;
+    }
+
+    context = PK11_CreateDigestContext(alg);
+    if( context == NULL ) {
+        JSS_throwMsgPrErr(env, DIGEST_EXCEPTION,
+            "Unable to create digest context");
+        return NULL;
+    }
+
+    *resultBA = (*env)->NewByteArray(env, count * outLen);
+    if( *resultBA == NULL ) {
+        ASSERT_OUTOFMEM(env);
+        goto loser;
+    }
+
+    if( count > 0 && outLen > 0 &&
+            !JSS_RefByteArray(env, *resultBA, output, NULL) ) {
+        ASSERT_OUTOFMEM(env);
+        goto loser;
+    }
+
+    return context;
+
+loser:
+    PK11_DestroyContext(context, PR_TRUE /*freeit*/);
+    return NULL;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_org_mozilla_jss_pkcs11_PK11MessageDigest_digestArrays
+    (JNIEnv *env, jclass clazz, jobject algObj, jobjectArray inputs,
+        jint outLen)
+{
+    PK11Context *context = NULL;
+    jbyteArray resultBA = NULL;
+    jbyte *output = NULL;
+    jint count;
+    jint i;
+    SECStatus status = SECFailure;
+
+    PR_ASSERT(env!=NULL && algObj!=NULL && inputs!=NULL);
+
+    count = (*env)->GetArrayLength(env, inputs);
+    context = digestAllInit(env, algObj, count, outLen, &resultBA, &output);
+    if( context == NULL ) {
+        /* exception was thrown */
+        return NULL;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        jbyteArray inputBA;
+        jbyte *data = NULL;
+        jsize length = 0;
+        SECStatus digested;
+
+        inputBA = (*env)->GetObjectArrayElement(env, inputs, i);
+        if( inputBA == NULL ) {
+            JSS_throwMsg(env, NULL_POINTER_EXCEPTION, "Null input to digest");
+            goto finish;
+        }
+
+        /* An empty input references nothing, but still has a digest. */
+        if( !JSS_RefByteArray(env, inputBA, &data, &length) && length > 0 ) {
+            (*env)->DeleteLocalRef(env, inputBA);
+            goto finish;
+        }
+
+        /* Keep status at SECFailure until every input is digested, so
+         * that leaving the loop early never returns a partial result. */
+        digested = digestOne(context, (unsigned char *)data, length,
+            (unsigned char *)output + (size_t) i * outLen, outLen);
+
+        JSS_DerefByteArray(env, inputBA, data, JNI_ABORT);
+        (*env)->DeleteLocalRef(env, inputBA);
+
+        if( digested != SECSuccess ) {
+            JSS_throwMsgPrErr(env, DIGEST_EXCEPTION,
+                "Error occurred while performing digest operation");
+            goto finish;
+        }
+    }
+    status = SECSuccess;
+
+finish:
+    JSS_DerefByteArray(env, resultBA, output,
+        status == SECSuccess ? 0 : JNI_ABORT);
+    PK11_DestroyContext(context, PR_TRUE /*freeit*/);
+    return status == SECSuccess ? resultBA : NULL;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_org_mozilla_jss_pkcs11_PK11MessageDigest_digestPacked
+    (JNIEnv *env, jclass clazz, jobject algObj, jbyteArray dataBA,
+        jintArray offsetsIA, jintArray lengthsIA, jint outLen)
+{
+    PK11Context *context = NULL;
+    jbyteArray resultBA = NULL;
+    jbyte *output = NULL;
+    jbyte *data = NULL;
+    jint *offsets = NULL;
+    jint *lengths = NULL;
+    jint count;
+    jint i;
+    SECStatus status = SECFailure;
+
+    PR_ASSERT(env!=NULL && algObj!=NULL && dataBA!=NULL &&
+        offsetsIA!=NULL && lengthsIA!=NULL);
+
+    /* The offsets and lengths were checked against the data in Java. */
+    count = (*env)->GetArrayLength(env, offsetsIA);
+    context = digestAllInit(env, algObj, count, outLen, &resultBA, &output);
+    if( context == NULL ) {
+        /* exception was thrown */
+        return NULL;
+    }
+
+    offsets = (*env)->GetIntArrayElements(env, offsetsIA, NULL);
+    lengths = (*env)->GetIntArrayElements(env, lengthsIA, NULL);
+    if( offsets == NULL || lengths == NULL ) {
+        ASSERT_OUTOFMEM(env);
+        goto finish;
+    }
+
+    /* Empty data is fine as long as every input is empty. */
+    JSS_RefByteArray(env, dataBA, &data, NULL);
+    if( (*env)->ExceptionCheck(env) ) {
+        goto finish;
+    }
+
+    for( i = 0; i < count; i++ ) {
+        if( digestOne(context, (unsigned char *)data + offsets[i],
+                lengths[i], (unsigned char *)output + (size_t) i * outLen,
+                outLen) != SECSuccess ) {
+            JSS_throwMsgPrErr(env, DIGEST_EXCEPTION,
+                "Error occurred while performing digest operation");
+            goto finish;
+        }
+    }
+    status = SECSuccess;
+
+finish:
+    JSS_DerefByteArray(env, dataBA, data, JNI_ABORT);
+    if( offsets != NULL ) {
+        (*env)->ReleaseIntArrayElements(env, offsetsIA, offsets, JNI_ABORT);
+    }
+    if( lengths != NULL ) {
+        (*env)->ReleaseIntArrayElements(env, lengthsIA, lengths, JNI_ABORT);
+    }
+    JSS_DerefByteArray(env, resultBA, output,
+        status == SECSuccess ? 0 : JNI_ABORT);
+    PK11_DestroyContext(context, PR_TRUE /*freeit*/);
+    return status == SECSuccess ? resultBA : NULL;
+}
@@ -14,7 +14,7 @@ import java.security.InvalidKeyException;
  */
 public final class PK11MessageDigest
     extends JSSMessageDigest
-    implements java.lang.AutoCloseable
+    implements java.lang.AutoCloseable, Cloneable
 {
 
     private PK11Token token;
@@ -22,6 +22,9 @@ public final class PK11MessageDigest
     private PK11SymKey hmacKey;
     private DigestAlgorithm alg;
 
+    // Whether any input has gone into digestProxy since it was started.
+    private boolean updated;
+
     PK11MessageDigest(PK11Token token, DigestAlgorithm alg)
         throws NoSuchAlgorithmException, DigestException
     {
@@ -48,8 +51,17 @@ public final class PK11MessageDigest
             throw new InvalidKeyException("HMAC key is not a PKCS #11 key");
         }
 
-        hmacKey = (PK11SymKey) key;
+        PK11SymKey signingKey = ((PK11SymKey) key).getSigningCopy(alg);
+        if( digestProxy != null && signingKey == hmacKey ) {
+            // Same key as before, so the context can be reused.
+            resetContext(digestProxy);
+            updated = false;
+            return;
+        }
+
+        hmacKey = signingKey;
         this.digestProxy = initHMAC(token, alg, hmacKey);
+        updated = false;
     }
 
     @Override
@@ -65,6 +77,7 @@ public final class PK11MessageDigest
         }
 
         update(digestProxy, input, offset, len);
+        updated = true;
     }
 
     @Override
@@ -88,7 +101,12 @@ public final class PK11MessageDigest
 
     @Override
     public void reset() throws DigestException {
-        if( ! (alg instanceof HMACAlgorithm || alg instanceof CMACAlgorithm) ) {
+        updated = false;
+        if( digestProxy != null ) {
+            // Restart the existing context rather than creating a new one,
+            // which for HMAC would mean setting up the key again.
+            resetContext(digestProxy);
+        } else if( ! (alg instanceof HMACAlgorithm || alg instanceof CMACAlgorithm) ) {
             // This is a regular digest, so we have enough information
             // to initialize the context
             this.digestProxy = initDigest(alg);
@@ -102,6 +120,96 @@ public final class PK11MessageDigest
         }
     }
 
+    /**
+     * Returns a copy of this digest, including any input digested so far.
+     * Copying an operation in progress relies on the token being able to
+     * save its state, which the NSS internal token can do for digests but
+     * not for HMAC.
+     *
+     * @throws CloneNotSupportedException If the token cannot copy the
+     *         operation in progress.
+     */
+    @Override
+    public PK11MessageDigest clone() throws CloneNotSupportedException {
+        PK11MessageDigest copy = (PK11MessageDigest) super.clone();
+        // Never share the context, even if copying it fails, since each
+        // digest closes its own.
+        copy.digestProxy = null;
+        if( digestProxy == null ) {
+            return copy;
+        }
+
+        try {
+            if( updated ) {
+                copy.digestProxy = cloneContext(digestProxy);
+            } else if( hmacKey != null ) {
+                // Nothing to copy yet; starting afresh works everywhere.
+                copy.digestProxy = initHMAC(token, alg, hmacKey);
+            } else {
+                copy.digestProxy = initDigest(alg);
+            }
+        } catch( DigestException e ) {
+            CloneNotSupportedException cnse =
+                new CloneNotSupportedException(e.getMessage());
+            cnse.initCause(e);
+            throw cnse;
+        }
+        return copy;
+    }
+
+    /**
+     * Digests each of inputs, using one context for the whole batch
+     * rather than one per input. This suits many small inputs, such as
+     * certificates to fingerprint, where setting up each digest costs
+     * more than the digest itself.
+     *
+     * @param alg A plain digest algorithm; not HMAC or CMAC.
+     * @return The digests end to end: the digest of input <i>i</i> starts
+     *         at <code>i * alg.getOutputSize()</code>.
+     */
+    public static byte[] digestAll(DigestAlgorithm alg, byte[][] inputs)
+        throws DigestException
+    {
+        checkDigestAll(alg, inputs.length);
+        return digestArrays(alg, inputs, alg.getOutputSize());
+    }
+
+    /**
+     * Digests each of several inputs packed into data; input <i>i</i> is
+     * the <code>lengths[i]</code> bytes at <code>offsets[i]</code>. See
+     * digestAll(DigestAlgorithm, byte[][]).
+     */
+    public static byte[] digestAll(DigestAlgorithm alg, byte[] data,
+        int[] offsets, int[] lengths)
+        throws DigestException
+    {
+        if( offsets.length != lengths.length ) {
+            throw new IllegalArgumentException(
+                "Must have one offset for each length");
+        }
+        for( int i = 0; i < offsets.length; i++ ) {
+            if( offsets[i] < 0 || lengths[i] < 0 ||
+                    offsets[i] > data.length - lengths[i] ) {
+                throw new IndexOutOfBoundsException("Input " + i +
+                    " is outside the data");
+            }
+        }
+
+        checkDigestAll(alg, offsets.length);
+        return digestPacked(alg, data, offsets, lengths, alg.getOutputSize());
+    }
+
+    private static void checkDigestAll(DigestAlgorithm alg, int count)
+        throws DigestException
+    {
+        if( alg instanceof HMACAlgorithm || alg instanceof CMACAlgorithm ) {
+            throw new DigestException("Digest is an HMAC or CMAC digest");
+        }
+        if( (long) count * alg.getOutputSize() > Integer.MAX_VALUE ) {
+            throw new IllegalArgumentException("Too many inputs: " + count);
+        }
+    }
+
     @Override
     public DigestAlgorithm getAlgorithm() {
         return alg;
@@ -115,6 +223,23 @@ public final class PK11MessageDigest
     initHMAC(PK11Token token, DigestAlgorithm alg, PK11SymKey key)
         throws DigestException;
 
+    private static native void
+    resetContext(CipherContextProxy proxy)
+        throws DigestException;
+
+    private static native CipherContextProxy
+    cloneContext(CipherContextProxy proxy)
+        throws DigestException;
+
+    private static native byte[]
+    digestArrays(DigestAlgorithm alg, byte[][] inputs, int outLen)
+        throws DigestException;
+
+    private static native byte[]
+    digestPacked(DigestAlgorithm alg, byte[] data, int[] offsets,
+        int[] lengths, int outLen)
+        throws DigestException;
+
     private static native void
     update(CipherContextProxy proxy, byte[] inbuf, int offset, int len);
 
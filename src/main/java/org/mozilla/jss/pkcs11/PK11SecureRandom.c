@@ -21,6 +21,12 @@
 
 #include <jssutil.h>
 
+/*
+ * Number of bytes nextBytes generates at a time, on the stack
+ */
+
+#define NEXT_BYTES_CHUNK 256
+
 /*
  * JNI FUNCTION:  PK11SecureRandom.setSeed
  *
@@ -211,16 +217,16 @@ Java_org_mozilla_jss_pkcs11_PK11SecureRandom_nextBytes
      * "JNI" data members
      */
 
-    jbyte*    jdata   = NULL;
     jsize     jlen    = 0;
+    jsize     offset  = 0;
 
 
     /*
      * "C" data members
      */
 
-    PRThread*     VARIABLE_MAY_NOT_BE_USED pThread = NULL;
-    SECStatus     status  = PR_FALSE;
+    unsigned char buffer[NEXT_BYTES_CHUNK];
+    SECStatus     status  = SECSuccess;
 
 
     /*
@@ -229,50 +235,43 @@ Java_org_mozilla_jss_pkcs11_PK11SecureRandom_nextBytes
 
     PR_ASSERT( env != NULL && this != NULL );
 
-
-    /*
-     * Attach to the external java thread
-     */
-
-    pThread = PR_AttachThread( PR_SYSTEM_THREAD, 0, NULL );
-    PR_ASSERT( pThread != NULL );
-
-
-    /*
-     * Convert "JNI jbyteArray" into "JNI jbyte*" so
-     * that it can be cast into a "C unsigned char*";
-     * also get its length.
-     */
-    JSS_RefByteArray(env, jbytes, &jdata, &jlen);
+    if( jbytes == NULL ) {
+        return;
+    }
 
 
     /*
-     * Generate a pseudo-random number; currently,
-     * failures from this routine are ignored
+     * Generate the pseudo-random sequence on the stack and copy it
+     * into the "JNI jbyteArray" one chunk at a time; unlike pinning the
+     * array, this needs no allocation nor a copy back when done. This is
+     * called from the calling Java thread, so no NSPR attach is needed.
+     * Currently, failures from PK11_GenerateRandom are ignored.
      */
 
-    status = PK11_GenerateRandom( ( unsigned char* ) jdata, ( int ) jlen );
-    if( status != SECSuccess ) {
-        goto finish;
-    }
+    jlen = (*env)->GetArrayLength( env, jbytes );
 
+    while( offset < jlen ) {
+        jsize amount = jlen - offset;
+        if( amount > NEXT_BYTES_CHUNK ) {
+            amount = NEXT_BYTES_CHUNK;
+        }
 
-finish:
+        status = PK11_GenerateRandom( buffer, ( int ) amount );
+        if( status != SECSuccess ) {
+            break;
+        }
 
-    /*
-     * Copy back the contents of the "JNI jbyte*" and
-     * free any resources associated with it
-     */
-
-    JSS_DerefByteArray(env, jbytes, jdata, 0);
+        (*env)->SetByteArrayRegion( env, jbytes, offset, amount,
+                                    ( jbyte* ) buffer );
+        offset += amount;
+    }
 
 
     /*
-     * Detach from the external java thread and return
+     * Don't leave random material lying around on the stack
      */
 
-    PR_DetachThread();
+    PORT_Memset( buffer, 0, sizeof( buffer ) );
 
     return;
 }
-
@@ -14,6 +14,7 @@
 #include <cryptoht.h>
 #include <cryptohi.h>
 #include <keyhi.h>
+#include <secoid.h>
 
 #include <jssutil.h>
 #include <java_ids.h>
@@ -374,6 +375,343 @@ finish:
 	return verified;
 }
 
+/***********************************************************************
+ *
+ * Batch operations
+ *
+ * verifyBatch and rawSignBatch copy every item out of the JVM on the
+ * calling thread, then spread the NSS calls over a shared NSPR thread pool.
+ * The workers never touch JNI; they pull items off a shared index until
+ * the batch is exhausted, and the calling thread does the same rather than
+ * sit idle.
+ */
+typedef struct {
+    const SECKEYPublicKey *key;
+    SECAlgorithmID algid;
+    SECItem data;
+    SECItem sig;
+    PRErrorCode error;
+} VerifyItem;
+
+typedef struct {
+    VerifyItem *items;
+    PRInt32 count;
+    /* index of the next unclaimed item */
+    PRInt32 next;
+} VerifyBatch;
+
+static PRCallOnceType batchPoolOnce;
+
+/* Protects the fields below. */
+static PRLock *batchPoolLock = NULL;
+
+/* Signalled when the last batch using batchPool finishes. */
+static PRCondVar *batchPoolIdle = NULL;
+
+/* Created on first use; replaced when the thread count changes. */
+static PRThreadPool *batchPool = NULL;
+
+/* Number of batches currently running on batchPool. */
+static PRInt32 batchPoolUsers = 0;
+
+/* Threads per batch, counting the calling thread; zero means one per
+ * processor. */
+static PRInt32 batchPoolThreads = 0;
+
+static PRStatus
+batchPoolInit(void)
+{
+    batchPoolLock = PR_NewLock();
+    if (batchPoolLock == NULL) {
+        return PR_FAILURE;
+    }
+
+    batchPoolIdle = PR_NewCondVar(batchPoolLock);
+    return batchPoolIdle == NULL ? PR_FAILURE : PR_SUCCESS;
+}
+
+static PRInt32
+batchPoolThreadCount(void)
+{
+    PRInt32 threads = batchPoolThreads;
+    if (threads <= 0) {
+        threads = PR_GetNumberOfProcessors();
+    }
+    return threads < 1 ? 1 : threads;
+}
+
+/*
+ * Takes a reference to the pool, creating it if need be, and sets *workers
+ * to the number of pool threads a batch may use. Returns NULL when batches
+ * should run on the calling thread alone.
+ */
+static PRThreadPool *
+batchPoolAcquire(PRInt32 *workers)
+{
+    PRThreadPool *pool = NULL;
+
+    *workers = 0;
+    if (PR_CallOnce(&batchPoolOnce, batchPoolInit) != PR_SUCCESS) {
+        return NULL;
+    }
+
+    PR_Lock(batchPoolLock);
+    *workers = batchPoolThreadCount() - 1;
+    if (*workers > 0 && batchPool == NULL) {
+        batchPool = PR_CreateThreadPool(*workers, *workers, 0);
+    }
+    pool = *workers > 0 ? batchPool : NULL;
+    if (pool != NULL) {
+        batchPoolUsers++;
+    }
+    PR_Unlock(batchPoolLock);
+
+    return pool;
+}
+
+static void
+batchPoolRelease(PRThreadPool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    PR_Lock(batchPoolLock);
+    if (--batchPoolUsers == 0) {
+        PR_NotifyAllCondVar(batchPoolIdle);
+    }
+    PR_Unlock(batchPoolLock);
+}
+
+/*
+ * Runs worker on the calling thread and on up to count - 1 pool threads,
+ * returning once all of them have finished. Each worker must claim items
+ * from a shared index until none are left, so that it doesn't matter how
+ * many actually run.
+ */
+static void
+batchPoolRun(PRJobFn worker, void *arg, PRInt32 count)
+{
+    PRThreadPool *pool = NULL;
+    PRJob **jobs = NULL;
+    PRInt32 workers = 0;
+    PRInt32 queued = 0;
+    PRInt32 i;
+
+    pool = batchPoolAcquire(&workers);
+    if (workers > count - 1) {
+        workers = count - 1;
+    }
+    if (pool != NULL && workers > 0) {
+        jobs = PR_Calloc(workers, sizeof(PRJob *));
+        for (queued = 0; jobs != NULL && queued < workers; queued++) {
+            jobs[queued] = PR_QueueJob(pool, worker, arg,
+                                       PR_TRUE /*joinable*/);
+        }
+    }
+
+    /* Whatever the pool doesn't pick up, we do ourselves. */
+    worker(arg);
+
+    for (i = 0; i < queued; i++) {
+        if (jobs[i] != NULL) {
+            PR_JoinJob(jobs[i]);
+        }
+    }
+    PR_Free(jobs);
+    batchPoolRelease(pool);
+}
+
+static void PR_CALLBACK
+verifyWorker(void *arg)
+{
+    VerifyBatch *batch = arg;
+    PRInt32 index;
+
+    while ((index = PR_ATOMIC_INCREMENT(&batch->next) - 1) < batch->count) {
+        VerifyItem *item = &batch->items[index];
+
+        if (VFY_VerifyDataWithAlgorithmID(item->data.data, item->data.len,
+                item->key, &item->sig, &item->algid, NULL /*hash*/,
+                NULL /*wincx*/) == SECSuccess) {
+            item->error = 0;
+        } else {
+            item->error = PR_GetError();
+            if (item->error == 0) {
+                item->error = SEC_ERROR_BAD_SIGNATURE;
+            }
+        }
+    }
+}
+
+/*
+ * Copies a byte[] into arena. Returns PR_FAILURE with an exception pending
+ * on error.
+ */
+static PRStatus
+copyToArena(JNIEnv *env, PLArenaPool *arena, jbyteArray array, SECItem *item)
+{
+    item->type = siBuffer;
+    item->len = (*env)->GetArrayLength(env, array);
+    item->data = PORT_ArenaAlloc(arena, item->len > 0 ? item->len : 1);
+    if (item->data == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        return PR_FAILURE;
+    }
+
+    (*env)->GetByteArrayRegion(env, array, 0, item->len, (jbyte *)item->data);
+    return (*env)->ExceptionCheck(env) ? PR_FAILURE : PR_SUCCESS;
+}
+
+/***********************************************************************
+ *
+ * PK11Signature.verifyBatchNative
+ *
+ * Verifies signatures[i] over data[i] with keys[i] and algs[i] for every i,
+ * storing 0 in errors[i] for a good signature, SEC_ERROR_BAD_SIGNATURE for
+ * a bad one, or whatever other error NSS reported. Only failures to read
+ * the arguments are thrown.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Signature_verifyBatchNative
+    (JNIEnv *env, jclass clazz, jobjectArray keys, jobjectArray algs,
+        jobjectArray data, jobjectArray signatures, jintArray errorsArray)
+{
+    PLArenaPool *arena = NULL;
+    VerifyBatch batch = { NULL, 0, 0 };
+    jint *errors = NULL;
+    PRInt32 i;
+
+    PR_ASSERT(env != NULL && keys != NULL && algs != NULL);
+    PR_ASSERT(data != NULL && signatures != NULL && errorsArray != NULL);
+
+    batch.count = (*env)->GetArrayLength(env, keys);
+    if (batch.count == 0) {
+        return;
+    }
+
+    arena = PORT_NewArena(DER_DEFAULT_CHUNKSIZE);
+    if (arena == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    batch.items = PORT_ArenaZNewArray(arena, VerifyItem, batch.count);
+    errors = PR_Calloc(batch.count, sizeof(jint));
+    if (batch.items == NULL || errors == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    for (i = 0; i < batch.count; i++) {
+        VerifyItem *item = &batch.items[i];
+        jobject keyObj = (*env)->GetObjectArrayElement(env, keys, i);
+        jobject algObj = (*env)->GetObjectArrayElement(env, algs, i);
+        jobject dataBA = (*env)->GetObjectArrayElement(env, data, i);
+        jobject sigBA = (*env)->GetObjectArrayElement(env, signatures, i);
+        SECOidTag tag = SEC_OID_UNKNOWN;
+        PRStatus status = PR_FAILURE;
+        SECKEYPublicKey *pubk = NULL;
+
+        if (keyObj == NULL || algObj == NULL || dataBA == NULL ||
+                sigBA == NULL) {
+            JSS_throwMsg(env, NULL_POINTER_EXCEPTION, "Incomplete batch item");
+        } else if (JSS_PK11_getPubKeyPtr(env, keyObj, &pubk) == PR_SUCCESS &&
+                (tag = JSS_getOidTagFromAlg(env, algObj)) != SEC_OID_UNKNOWN &&
+                copyToArena(env, arena, dataBA, &item->data) == PR_SUCCESS &&
+                copyToArena(env, arena, sigBA, &item->sig) == PR_SUCCESS) {
+            item->key = pubk;
+            if (SECOID_SetAlgorithmID(arena, &item->algid, tag,
+                                      NULL) == SECSuccess) {
+                status = PR_SUCCESS;
+            } else {
+                JSS_throwMsgPrErr(env, SIGNATURE_EXCEPTION,
+                                  "Unable to set signature algorithm ID");
+            }
+        }
+
+        (*env)->DeleteLocalRef(env, keyObj);
+        (*env)->DeleteLocalRef(env, algObj);
+        (*env)->DeleteLocalRef(env, dataBA);
+        (*env)->DeleteLocalRef(env, sigBA);
+
+        if (status != PR_SUCCESS) {
+            if (!(*env)->ExceptionCheck(env)) {
+                JSS_throwMsg(env, SIGNATURE_EXCEPTION,
+                             "Unable to resolve signature algorithm");
+            }
+            goto finish;
+        }
+    }
+
+    batchPoolRun(verifyWorker, &batch, batch.count);
+
+    for (i = 0; i < batch.count; i++) {
+        errors[i] = batch.items[i].error;
+    }
+    (*env)->SetIntArrayRegion(env, errorsArray, 0, batch.count, errors);
+
+finish:
+    PR_Free(errors);
+    if (arena != NULL) {
+        PORT_FreeArena(arena, PR_TRUE /* zero */);
+    }
+}
+
+/***********************************************************************
+ *
+ * PK11Signature.setBatchThreadsNative
+ *
+ * Resizes the pool used by batch operations. The old pool is torn down once the
+ * batches running on it finish; later batches use the new size.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Signature_setBatchThreadsNative
+    (JNIEnv *env, jclass clazz, jint threads)
+{
+    PRThreadPool *old = NULL;
+
+    if (PR_CallOnce(&batchPoolOnce, batchPoolInit) != PR_SUCCESS) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        return;
+    }
+
+    PR_Lock(batchPoolLock);
+    batchPoolThreads = threads;
+    while (batchPoolUsers > 0) {
+        PR_WaitCondVar(batchPoolIdle, PR_INTERVAL_NO_TIMEOUT);
+    }
+    old = batchPool;
+    batchPool = NULL;
+    PR_Unlock(batchPoolLock);
+
+    if (old != NULL) {
+        PR_ShutdownThreadPool(old);
+        PR_JoinThreadPool(old);
+    }
+}
+
+/***********************************************************************
+ *
+ * PK11Signature.getBatchThreadsNative
+ */
+JNIEXPORT jint JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Signature_getBatchThreadsNative
+    (JNIEnv *env, jclass clazz)
+{
+    jint threads;
+
+    if (PR_CallOnce(&batchPoolOnce, batchPoolInit) != PR_SUCCESS) {
+        return 1;
+    }
+
+    PR_Lock(batchPoolLock);
+    threads = batchPoolThreadCount();
+    PR_Unlock(batchPoolLock);
+
+    return threads;
+}
+
 /*
  * Extract the algorithm from a PK11Signature.
  *
@@ -768,21 +1106,13 @@ finish:
 
 /***********************************************************************
  *
- * SigContextProxy.releaseNativeResources
+ * d e s t r o y S i g C o n t e x t P r o x y
  *
- * Deletes the SGNContext wrapped by this SigContextProxy object.
+ * Frees a SigContextProxy along with the context it holds.
  */
-JNIEXPORT void JNICALL
-Java_org_mozilla_jss_pkcs11_SigContextProxy_releaseNativeResources
-  (JNIEnv *env, jobject this)
+static void
+destroySigContextProxy(SigContextProxy *proxy)
 {
-    SigContextProxy *proxy = NULL;
-
-    /* Retrieve the proxy pointer */
-    if (JSS_getPtrFromProxy(env, this, (void**)&proxy) != PR_SUCCESS) {
-        return;
-    }
-
     if (proxy == NULL) {
         return;
     }
@@ -800,6 +1130,40 @@ Java_org_mozilla_jss_pkcs11_SigContextProxy_releaseNativeResources
     PR_Free(proxy);
 }
 
+/***********************************************************************
+ *
+ * SigContextProxy.releaseNativeResources
+ *
+ * Deletes the SGNContext wrapped by this SigContextProxy object.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_SigContextProxy_releaseNativeResources
+  (JNIEnv *env, jobject this)
+{
+    SigContextProxy *proxy = NULL;
+
+    /* Retrieve the proxy pointer */
+    if (JSS_getPtrFromProxy(env, this, (void**)&proxy) != PR_SUCCESS) {
+        return;
+    }
+
+    destroySigContextProxy(proxy);
+}
+
+/***********************************************************************
+ *
+ * SigContextProxy.releaseHandle
+ *
+ * Deletes the context of a SigContextProxy which was garbage collected
+ * without being closed.
+ */
+JNIEXPORT void JNICALL
+Java_org_mozilla_jss_pkcs11_SigContextProxy_releaseHandle
+  (JNIEnv *env, jclass clazz, jlong handle)
+{
+    destroySigContextProxy(JSS_handleToPtr(handle));
+}
+
 /***********************************************************************
  * PK11Signature.engineRawSignNative
  */
@@ -849,6 +1213,183 @@ finish:
     return sigBA;
 }
 
+/*
+ * A batch of digests to sign with one key. Each signature gets a sigLen
+ * slot in output.
+ */
+typedef struct {
+    SECKEYPrivateKey *key;
+    SECItem *digests;
+    unsigned char *output;
+    unsigned int sigLen;
+    unsigned int *lengths;
+    PRErrorCode *errors;
+    PRInt32 count;
+    /* index of the next unclaimed digest */
+    PRInt32 next;
+} SignBatch;
+
+static void PR_CALLBACK
+signWorker(void *arg)
+{
+    SignBatch *batch = arg;
+    PRInt32 index;
+
+    while ((index = PR_ATOMIC_INCREMENT(&batch->next) - 1) < batch->count) {
+        SECItem sig = { siBuffer, batch->output + index * batch->sigLen,
+                        batch->sigLen };
+
+        if (PK11_Sign(batch->key, &sig, &batch->digests[index]) == SECSuccess) {
+            batch->lengths[index] = sig.len;
+            batch->errors[index] = 0;
+        } else {
+            batch->errors[index] = PR_GetError();
+            if (batch->errors[index] == 0) {
+                batch->errors[index] = SEC_ERROR_LIBRARY_FAILURE;
+            }
+        }
+    }
+}
+
+/*
+ * Whether the token holding key can run more than one operation at once.
+ */
+static PRBool
+allowsConcurrentSessions(SECKEYPrivateKey *key)
+{
+    CK_TOKEN_INFO info;
+
+    if (PK11_GetTokenInfo(key->pkcs11Slot, &info) != SECSuccess) {
+        return PR_FALSE;
+    }
+
+    /* CK_EFFECTIVELY_INFINITE (0) and CK_UNAVAILABLE_INFORMATION don't
+     * limit us either. */
+    return info.ulMaxSessionCount != 1;
+}
+
+/***********************************************************************
+ * PK11Signature.rawSignBatchNative
+ *
+ * Signs each digest with key, as engineRawSignNative does for one. The
+ * first digest is signed on the calling thread, so that any login the
+ * token needs happens here rather than on a pool thread; the rest are
+ * spread over the batch pool when the token allows concurrent sessions.
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_org_mozilla_jss_pkcs11_PK11Signature_rawSignBatchNative
+    (JNIEnv *env, jclass clazz, jobject keyObj, jobjectArray digestArrays)
+{
+    PLArenaPool *arena = NULL;
+    SignBatch batch;
+    jclass byteArrayClass = NULL;
+    jobjectArray sigArrays = NULL;
+    jobjectArray result = NULL;
+    int sigLen;
+    PRInt32 count;
+    PRInt32 i;
+
+    PR_ASSERT(env != NULL && keyObj != NULL && digestArrays != NULL);
+
+    PORT_Memset(&batch, 0, sizeof(batch));
+
+    if (JSS_PK11_getPrivKeyPtr(env, keyObj, &batch.key) != PR_SUCCESS) {
+        /* exception was thrown */
+        goto finish;
+    }
+
+    byteArrayClass = (*env)->FindClass(env, "[B");
+    if (byteArrayClass == NULL) {
+        ASSERT_OUTOFMEM(env);
+        goto finish;
+    }
+
+    count = (*env)->GetArrayLength(env, digestArrays);
+    sigArrays = (*env)->NewObjectArray(env, count, byteArrayClass, NULL);
+    if (sigArrays == NULL || count == 0) {
+        result = sigArrays;
+        goto finish;
+    }
+
+    sigLen = PK11_SignatureLen(batch.key);
+    if (sigLen <= 0) {
+        JSS_throwMsgPrErr(env, SIGNATURE_EXCEPTION,
+                          "Unable to determine signature length");
+        goto finish;
+    }
+    batch.sigLen = sigLen;
+
+    arena = PORT_NewArena(DER_DEFAULT_CHUNKSIZE);
+    if (arena == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    batch.digests = PORT_ArenaZNewArray(arena, SECItem, count);
+    batch.lengths = PORT_ArenaZNewArray(arena, unsigned int, count);
+    batch.errors = PORT_ArenaZNewArray(arena, PRErrorCode, count);
+    batch.output = PORT_ArenaAlloc(arena, (size_t)count * batch.sigLen);
+    if (batch.digests == NULL || batch.lengths == NULL ||
+            batch.errors == NULL || batch.output == NULL) {
+        JSS_throw(env, OUT_OF_MEMORY_ERROR);
+        goto finish;
+    }
+
+    for (i = 0; i < count; i++) {
+        jobject digestBA = (*env)->GetObjectArrayElement(env, digestArrays, i);
+        PRStatus status;
+
+        if (digestBA == NULL) {
+            JSS_throwMsg(env, NULL_POINTER_EXCEPTION, "Missing digest");
+            goto finish;
+        }
+        status = copyToArena(env, arena, digestBA, &batch.digests[i]);
+        (*env)->DeleteLocalRef(env, digestBA);
+        if (status != PR_SUCCESS) {
+            goto finish;
+        }
+    }
+
+    batch.count = 1;
+    signWorker(&batch);
+
+    /* The worker overshoots next on its way out. */
+    batch.next = 1;
+    batch.count = count;
+    if (batch.errors[0] == 0 && allowsConcurrentSessions(batch.key)) {
+        batchPoolRun(signWorker, &batch, count - 1);
+    } else {
+        signWorker(&batch);
+    }
+
+    for (i = 0; i < count; i++) {
+        jbyteArray sigBA;
+
+        if (batch.errors[i] != 0) {
+            JSS_throwMsgPrErrArg(env, SIGNATURE_EXCEPTION,
+                "Signature operation failed on token", batch.errors[i]);
+            goto finish;
+        }
+
+        sigBA = JSS_ToByteArray(env, batch.output + i * batch.sigLen,
+                                batch.lengths[i]);
+        if (sigBA == NULL) {
+            ASSERT_OUTOFMEM(env);
+            goto finish;
+        }
+        (*env)->SetObjectArrayElement(env, sigArrays, i, sigBA);
+        (*env)->DeleteLocalRef(env, sigBA);
+    }
+
+    result = sigArrays;
+
+finish:
+    if (arena != NULL) {
+        PORT_FreeArena(arena, PR_TRUE /* zero */);
+    }
+    return result;
+}
+
 /***********************************************************************
  * PK11Signature.engineRawVerifyNative
  */
@@ -13,7 +13,11 @@ import java.security.SecureRandom;
 import java.security.SignatureException;
 import java.security.spec.AlgorithmParameterSpec;
 import java.security.spec.PSSParameterSpec;
+import org.mozilla.jss.CryptoManager;
+import org.mozilla.jss.NotInitializedException;
 import org.mozilla.jss.crypto.*;
+import org.mozilla.jss.nss.PR;
+import org.mozilla.jss.nss.SECErrors;
 import org.mozilla.jss.util.*;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
@@ -281,6 +285,39 @@ public final class PK11Signature
 		return sig.length;
     }
 
+    /**
+     * Signs a batch of digests with one private key, as a raw signature
+     * does for a single digest, in one call. The key and its signature
+     * length are resolved once for the whole batch, and when its token
+     * allows concurrent sessions, the digests are signed in parallel on the
+     * batch thread pool; see setBatchThreads().
+     *
+     * @param digests The digests to sign. For RSA keys, these must already
+     *        be DER encoded DigestInfo structures.
+     * @return The signature of each digest.
+     * @throws SignatureException If any digest fails to sign; no
+     *         signatures are returned.
+     */
+    public static byte[][] rawSignBatch(PrivateKey key, byte[][] digests)
+        throws InvalidKeyException, SignatureException, TokenException
+    {
+        if( ! (key instanceof PK11PrivKey) ) {
+            throw new InvalidKeyException("privateKey is not a PKCS #11 "+
+                "private key");
+        }
+        for (byte[] digest : digests) {
+            if( digest == null ) {
+                throw new NullPointerException("Missing digest");
+            }
+        }
+
+        return rawSignBatchNative(key, digests);
+    }
+
+    private static native byte[][] rawSignBatchNative(PrivateKey key,
+        byte[][] digests)
+        throws SignatureException, TokenException;
+
     /**
      * Performs raw signing of the given hash with the given private key.
      */
@@ -340,6 +377,171 @@ public final class PK11Signature
 	native protected boolean engineVerifyNative(byte[] sigBytes)
 		throws SignatureException, TokenException;
 
+    /**
+     * Verifies a batch of signatures in one call: signatures[i] over
+     * data[i] with keys[i] and algorithms[i], for every i. The signatures
+     * are checked in parallel on a shared native thread pool; see
+     * setBatchThreads().
+     *
+     * <p>RSA-PSS and raw (pre-hashed) algorithms need per-signature
+     * parameters, so those items are verified one at a time on the calling
+     * thread instead.
+     *
+     * @param errors If not null, receives 0 for each signature which
+     *        verified, SECErrors.BAD_SIGNATURE for each which didn't, and
+     *        the NSS error code for any which couldn't be checked at all.
+     * @return Whether each signature verified.
+     * @throws InvalidKeyException If a key is not a PKCS #11 key, or does
+     *         not suit its algorithm.
+     */
+    public static boolean[] verifyBatch(PublicKey[] keys,
+        SignatureAlgorithm[] algorithms, byte[][] data, byte[][] signatures,
+        int[] errors)
+        throws InvalidKeyException, SignatureException, TokenException
+    {
+        int count = keys.length;
+        if( algorithms.length != count || data.length != count ||
+                signatures.length != count ||
+                (errors != null && errors.length != count) ) {
+            throw new IllegalArgumentException("Batch arrays differ in length");
+        }
+
+        // Split the batch into what NSS can verify from an algorithm tag
+        // alone, and the rest.
+        int[] nativeIndexes = new int[count];
+        int nativeCount = 0;
+        for (int i = 0; i < count; i++) {
+            checkVerifyKey(keys[i], algorithms[i]);
+            if( algorithms[i].getRawAlg() != algorithms[i] &&
+                    !isRSAPSSAlgorithm(algorithms[i]) ) {
+                nativeIndexes[nativeCount++] = i;
+            }
+        }
+
+        int[] results = errors != null ? errors : new int[count];
+        int[] nativeErrors = new int[nativeCount];
+        if( nativeCount > 0 ) {
+            PublicKey[] nativeKeys = new PublicKey[nativeCount];
+            SignatureAlgorithm[] nativeAlgs =
+                new SignatureAlgorithm[nativeCount];
+            byte[][] nativeData = new byte[nativeCount][];
+            byte[][] nativeSigs = new byte[nativeCount][];
+            for (int j = 0; j < nativeCount; j++) {
+                int i = nativeIndexes[j];
+                nativeKeys[j] = keys[i];
+                nativeAlgs[j] = algorithms[i];
+                nativeData[j] = data[i];
+                nativeSigs[j] = signatures[i];
+            }
+            verifyBatchNative(nativeKeys, nativeAlgs, nativeData, nativeSigs,
+                nativeErrors);
+        }
+
+        boolean[] verified = new boolean[count];
+        for (int i = 0, j = 0; i < count; i++) {
+            if( j < nativeCount && nativeIndexes[j] == i ) {
+                results[i] = nativeErrors[j++];
+            } else {
+                results[i] = verifyOne(keys[i], algorithms[i], data[i],
+                                       signatures[i]);
+            }
+            verified[i] = results[i] == 0;
+        }
+        return verified;
+    }
+
+    /**
+     * Verifies a batch of signatures; see
+     * verifyBatch(PublicKey[], SignatureAlgorithm[], byte[][], byte[][], int[]).
+     */
+    public static boolean[] verifyBatch(PublicKey[] keys,
+        SignatureAlgorithm[] algorithms, byte[][] data, byte[][] signatures)
+        throws InvalidKeyException, SignatureException, TokenException
+    {
+        return verifyBatch(keys, algorithms, data, signatures, null);
+    }
+
+    /**
+     * Sets the number of threads, counting the caller's, over which each
+     * verifyBatch() or rawSignBatch() call is spread. Zero (the default)
+     * means one per processor; one keeps batches on the calling thread.
+     */
+    public static void setBatchThreads(int threads) {
+        if( threads < 0 ) {
+            throw new IllegalArgumentException("Negative thread count: " +
+                threads);
+        }
+        setBatchThreadsNative(threads);
+    }
+
+    /**
+     * @return The number of threads each batch call is spread over,
+     *         counting the caller's.
+     */
+    public static int getBatchThreads() {
+        return getBatchThreadsNative();
+    }
+
+    private static void checkVerifyKey(PublicKey key,
+        SignatureAlgorithm algorithm) throws InvalidKeyException
+    {
+        if( !(key instanceof PK11PubKey) ) {
+            throw new InvalidKeyException("publicKey is not a PKCS #11 "+
+                "public key");
+        }
+
+        try {
+            if( KeyType.getKeyTypeFromAlgorithm(algorithm)
+                             != ((PK11PubKey) key).getKeyType() )
+            {
+                throw new InvalidKeyException(
+                    "Key type is inconsistent with algorithm");
+            }
+        } catch( NoSuchAlgorithmException e ) {
+            throw new InvalidKeyException("Unknown algorithm: " + algorithm, e);
+        }
+    }
+
+    /**
+     * Verifies a single item of a batch through a signature context.
+     *
+     * @return The error code for the item, as for verifyBatch().
+     */
+    private static int verifyOne(PublicKey key, SignatureAlgorithm algorithm,
+        byte[] data, byte[] signature)
+        throws InvalidKeyException, TokenException
+    {
+        PK11Token token;
+        try {
+            token = (PK11Token) CryptoManager.getInstance()
+                .getInternalCryptoToken();
+        } catch( NotInitializedException e ) {
+            throw new TokenException("CryptoManager is not initialized", e);
+        }
+
+        try (PK11Signature sig = new PK11Signature(token, algorithm)) {
+            sig.engineInitVerify(key);
+            sig.engineUpdate(data, 0, data.length);
+            return sig.engineVerify(signature) ? 0 : SECErrors.BAD_SIGNATURE;
+        } catch( SignatureException e ) {
+            int error = PR.GetError();
+            return error != 0 ? error : SECErrors.BAD_SIGNATURE;
+        } catch( InvalidKeyException | TokenException e ) {
+            throw e;
+        } catch( Exception e ) {
+            throw new TokenException(e.getMessage(), e);
+        }
+    }
+
+    private static native void verifyBatchNative(PublicKey[] keys,
+        SignatureAlgorithm[] algorithms, byte[][] data, byte[][] signatures,
+        int[] errors)
+        throws SignatureException;
+
+    private static native void setBatchThreadsNative(int threads);
+
+    private static native int getBatchThreadsNative();
+
     @Override
     public void engineSetParameter(AlgorithmParameterSpec params)
         throws InvalidAlgorithmParameterException, TokenException
@@ -388,7 +590,7 @@ public final class PK11Signature
         return hashAlg;
     }
 
-    private boolean isRSAPSSAlgorithm(SignatureAlgorithm algorithm) {
+    private static boolean isRSAPSSAlgorithm(SignatureAlgorithm algorithm) {
         if (algorithm == null) {
             return false;
         }
@@ -404,11 +606,6 @@ public final class PK11Signature
         return false;
     }
 
-    @Override
-    public void finalize() throws Throwable {
-        close();
-    }
-
     @Override
     public void close() throws Exception {
         if (sigContext != null) {
@@ -441,8 +638,10 @@ class SigContextProxy extends NativeProxy {
     public static Logger logger = LoggerFactory.getLogger(SigContextProxy.class);
 
     public SigContextProxy(byte[] pointer) {
-        super(pointer);
+        super(pointer, SigContextProxy::releaseHandle);
     }
     @Override
     protected native void releaseNativeResources();
+
+    private static native void releaseHandle(long handle);
 }
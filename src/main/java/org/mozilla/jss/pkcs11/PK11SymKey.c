@@ -13,6 +13,7 @@
 #include <java_ids.h>
 #include <jssutil.h>
 #include "pk11util.h"
+#include <Algorithm.h>
 
 /* For PKCS#11 v3.0 compatibility */
 #ifndef CKM_NSS_PBE_SHA1_DES_CBC
@@ -241,6 +242,41 @@ finish:
     return dataArray;
 }
 
+/***********************************************************************
+ *
+ * PK11SymKey.copyForSigning
+ *
+ * Returns a copy of this key with CKA_SIGN set, for the mechanism of the
+ * given HMAC or CMAC algorithm, or NULL if the token won't copy it.
+ */
+JNIEXPORT jobject JNICALL
+Java_org_mozilla_jss_pkcs11_PK11SymKey_copyForSigning
+    (JNIEnv *env, jobject this, jobject algObj)
+{
+    PK11SymKey *key = NULL;
+    PK11SymKey *copy = NULL;
+    CK_MECHANISM_TYPE mech;
+
+    PR_ASSERT(env!=NULL && this!=NULL && algObj!=NULL);
+
+    mech = JSS_getPK11MechFromAlg(env, algObj);
+    PR_ASSERT( mech != CKM_INVALID_MECHANISM ); /* we checked already in Java */
+
+    if( JSS_PK11_getSymKeyPtr(env, this, &key) != PR_SUCCESS ) {
+        /* exception was thrown */
+        return NULL;
+    }
+
+    /* For some keys on an HSM this fails, but the key may work anyway */
+    copy = PK11_CopySymKeyForSigning(key, mech);
+    if( copy == NULL ) {
+        return NULL;
+    }
+
+    /* This sets copy to NULL. */
+    return JSS_PK11_wrapSymKey(env, &copy);
+}
+
 /***********************************************************************
  *
  * PK11SymKey.getKeyType
@@ -302,6 +338,10 @@ Java_org_mozilla_jss_pkcs11_PK11SymKey_getKeyType
           case CKK_AES:
             typeFieldName = AES_KEYTYPE_FIELD;
             break;
+          case CKK_CHACHA20:
+          case CKK_NSS_CHACHA20:
+            typeFieldName = CHACHA20_KEYTYPE_FIELD;
+            break;
           case CKK_DES2:
              typeFieldName = DES3_KEYTYPE_FIELD;
              break;
@@ -4,7 +4,11 @@
 
 package org.mozilla.jss.pkcs11;
 
+import java.util.HashMap;
+import java.util.Map;
+
 import org.mozilla.jss.crypto.CryptoToken;
+import org.mozilla.jss.crypto.DigestAlgorithm;
 import org.mozilla.jss.crypto.SymmetricKey;
 
 // We've updated jss.crypto.SymmetricKey to extend javax.crypto.SecretKey, so
@@ -26,6 +30,11 @@ public final class PK11SymKey implements SymmetricKey {
     private SymKeyProxy keyProxy;
     private String nickName;
 
+    // Copies of this key with CKA_SIGN set, made for HMAC and CMAC, one per
+    // algorithm. Copying is a token operation, so each copy is made once
+    // and then released along with this key.
+    private Map<DigestAlgorithm, PK11SymKey> signingCopies = null;
+
     @Override
     public SymmetricKey.Type getType() {
         KeyType kt = getKeyType();
@@ -101,6 +110,29 @@ public final class PK11SymKey implements SymmetricKey {
     }
 
     public native void setNickNameNative(String nickName);
+
+    /**
+     * Returns a copy of this key which can sign with the given HMAC or CMAC
+     * algorithm, making it the first time it is asked for. When the token
+     * won't copy this key, returns the key itself, which may work anyway.
+     */
+    synchronized PK11SymKey getSigningCopy(DigestAlgorithm alg) {
+        if( signingCopies == null ) {
+            signingCopies = new HashMap<>();
+        }
+
+        PK11SymKey copy = signingCopies.get(alg);
+        if( copy == null ) {
+            copy = copyForSigning(alg);
+            if( copy == null ) {
+                copy = this;
+            }
+            signingCopies.put(alg, copy);
+        }
+        return copy;
+    }
+
+    private native PK11SymKey copyForSigning(DigestAlgorithm alg);
 }
 
 class SymKeyProxy extends KeyProxy {
@@ -16,7 +16,9 @@ import org.mozilla.jss.crypto.TokenException;
 import org.mozilla.jss.crypto.TokenRuntimeException;
 import org.mozilla.jss.crypto.TokenSupplierManager;
 
-public abstract class JSSMessageDigestSpi extends MessageDigestSpi {
+public abstract class JSSMessageDigestSpi extends MessageDigestSpi
+    implements Cloneable
+{
 
     private JSSMessageDigest digest;
 
@@ -47,9 +49,15 @@ public abstract class JSSMessageDigestSpi extends MessageDigestSpi {
         }
     }
 
+    /**
+     * Copies the digest along with any input digested so far, so that
+     * inputs sharing a prefix need only digest it once.
+     */
     @Override
     public Object clone() throws CloneNotSupportedException {
-        throw new CloneNotSupportedException();
+        JSSMessageDigestSpi copy = (JSSMessageDigestSpi) super.clone();
+        copy.digest = (JSSMessageDigest) digest.clone();
+        return copy;
     }
 
     @Override
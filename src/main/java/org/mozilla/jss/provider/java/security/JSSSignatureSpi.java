@@ -20,6 +20,8 @@ import org.mozilla.jss.crypto.PrivateKey;
 import org.mozilla.jss.crypto.SignatureAlgorithm;
 import org.mozilla.jss.crypto.TokenException;
 import org.mozilla.jss.crypto.TokenSupplierManager;
+import org.mozilla.jss.pkcs11.PK11PubKey;
+import org.mozilla.jss.pkcs11.PK11Signature;
 
 public class JSSSignatureSpi extends java.security.SignatureSpi {
 
@@ -89,21 +91,62 @@ public class JSSSignatureSpi extends java.security.SignatureSpi {
               TokenSupplierManager.getTokenSupplier().getThreadToken();
             sig = token.getSignatureContext(alg);
 
-            // convert the public key into a JSS public key if necessary
-            if( ! (publicKey instanceof org.mozilla.jss.pkcs11.PK11PubKey) ) {
-                if( ! publicKey.getFormat().equalsIgnoreCase("X.509") ) {
-                    throw new InvalidKeyException(
-                        "Unsupported public key format: " +
-                        publicKey.getFormat());
-                }
-                X509EncodedKeySpec encodedKey =
-                    new X509EncodedKeySpec(publicKey.getEncoded());
-                KeyFactory fact = KeyFactory.getInstance(
-                    publicKey.getAlgorithm(), "Mozilla-JSS");
-                publicKey = fact.generatePublic(encodedKey);
-            }
+            sig.initVerify(toJSSPublicKey(publicKey));
+        } catch(java.security.NoSuchAlgorithmException e) {
+            throw new InvalidKeyException("Algorithm not supported");
+        } catch(TokenException e) {
+            throw new InvalidKeyException("Token exception occurred");
+        }
+    }
+
+    /**
+     * Verifies a batch of signatures in one call, accepting any X.509
+     * encodable public keys; see PK11Signature.verifyBatch().
+     *
+     * @param errors If not null, receives the NSS error code for each
+     *        signature, or 0 where it verified.
+     * @return Whether each signature verified.
+     */
+    public static boolean[] verifyBatch(PublicKey[] keys,
+        SignatureAlgorithm[] algorithms, byte[][] data, byte[][] signatures,
+        int[] errors)
+        throws InvalidKeyException, SignatureException
+    {
+        PublicKey[] jssKeys = new PublicKey[keys.length];
+        for (int i = 0; i < keys.length; i++) {
+            jssKeys[i] = toJSSPublicKey(keys[i]);
+        }
+
+        try {
+            return PK11Signature.verifyBatch(jssKeys, algorithms, data,
+                signatures, errors);
+        } catch(TokenException e) {
+            throw new SignatureException("Token exception occurred", e);
+        }
+    }
+
+    /**
+     * Converts the public key into a JSS public key if necessary.
+     */
+    static PublicKey toJSSPublicKey(PublicKey publicKey)
+        throws InvalidKeyException
+    {
+        if( publicKey instanceof PK11PubKey ) {
+            return publicKey;
+        }
+
+        if( ! publicKey.getFormat().equalsIgnoreCase("X.509") ) {
+            throw new InvalidKeyException(
+                "Unsupported public key format: " +
+                publicKey.getFormat());
+        }
 
-            sig.initVerify(publicKey);
+        try {
+            X509EncodedKeySpec encodedKey =
+                new X509EncodedKeySpec(publicKey.getEncoded());
+            KeyFactory fact = KeyFactory.getInstance(
+                publicKey.getAlgorithm(), "Mozilla-JSS");
+            return fact.generatePublic(encodedKey);
         } catch(NoSuchProviderException e) {
             throw new InvalidKeyException("Unable to convert non-JSS key " +
                 "to JSS key");
@@ -112,8 +155,6 @@ public class JSSSignatureSpi extends java.security.SignatureSpi {
                 "to JSS key");
         } catch(java.security.NoSuchAlgorithmException e) {
             throw new InvalidKeyException("Algorithm not supported");
-        } catch(TokenException e) {
-            throw new InvalidKeyException("Token exception occurred");
         }
     }
 
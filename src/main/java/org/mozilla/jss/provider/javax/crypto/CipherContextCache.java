@@ -0,0 +1,122 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+package org.mozilla.jss.provider.javax.crypto;
+
+import java.util.Iterator;
+import java.util.LinkedHashMap;
+import java.util.Map;
+
+import org.mozilla.jss.crypto.EncryptionAlgorithm;
+import org.mozilla.jss.crypto.SymmetricKey;
+import org.mozilla.jss.pkcs11.PK11Cipher;
+
+/**
+ * A small cache of initialized ciphers, keyed by key, algorithm, and
+ * direction, so that JSSCipherSpi can start a new message with
+ * PK11Cipher.reinit() rather than creating a new PKCS #11 context.
+ *
+ * Each JSSCipherSpi has its own, so that neither ciphers nor keys outlive
+ * the javax.crypto.Cipher using them. Only callers who initialize the same
+ * Cipher again for each message gain from it; one created per message
+ * never makes one. Ciphers are checked out with take() and handed back
+ * with put(); a cipher in use is never in the cache. The least recently
+ * used cipher is closed when the cache overflows, and clear() closes them
+ * all.
+ */
+final class CipherContextCache {
+
+    // Ciphers cached per JSSCipherSpi.
+    static final int CAPACITY = 4;
+
+    private final LinkedHashMap<Entry, PK11Cipher> ciphers =
+        new LinkedHashMap<>(8, 0.75f, true);
+
+    /**
+     * Whether ciphers for alg can be cached. AEAD ciphers already keep
+     * their contexts across initialization, and RC2 ciphers can't be
+     * reinitialized without a new context.
+     */
+    static boolean isCacheable(EncryptionAlgorithm alg) {
+        return !alg.isAEAD() && alg.getAlg() != EncryptionAlgorithm.Alg.RC2;
+    }
+
+    /**
+     * Removes and returns the cached cipher last initialized with key for
+     * the given algorithm and direction, or returns null.
+     */
+    PK11Cipher take(SymmetricKey key, EncryptionAlgorithm alg,
+        boolean encrypt)
+    {
+        return ciphers.remove(new Entry(key, alg, encrypt));
+    }
+
+    /**
+     * Caches cipher, last initialized with key for the given algorithm
+     * and direction.
+     */
+    void put(SymmetricKey key, EncryptionAlgorithm alg, boolean encrypt,
+        PK11Cipher cipher)
+    {
+        PK11Cipher previous = ciphers.put(new Entry(key, alg, encrypt),
+            cipher);
+        if( previous != null && previous != cipher ) {
+            close(previous);
+        }
+
+        Iterator<Map.Entry<Entry, PK11Cipher>> it =
+            ciphers.entrySet().iterator();
+        while( ciphers.size() > CAPACITY && it.hasNext() ) {
+            PK11Cipher eldest = it.next().getValue();
+            it.remove();
+            close(eldest);
+        }
+    }
+
+    /**
+     * Closes and removes every cached cipher.
+     */
+    void clear() {
+        for( PK11Cipher cipher : ciphers.values() ) {
+            close(cipher);
+        }
+        ciphers.clear();
+    }
+
+    private static void close(PK11Cipher cipher) {
+        try {
+            cipher.close();
+        } catch( Exception e ) {
+            // Its contexts are released when it is collected instead.
+        }
+    }
+
+    private static final class Entry {
+        private final SymmetricKey key;
+        private final EncryptionAlgorithm alg;
+        private final boolean encrypt;
+
+        Entry(SymmetricKey key, EncryptionAlgorithm alg, boolean encrypt) {
+            this.key = key;
+            this.alg = alg;
+            this.encrypt = encrypt;
+        }
+
+        @Override
+        public boolean equals(Object o) {
+            if( !(o instanceof Entry) ) {
+                return false;
+            }
+            Entry other = (Entry) o;
+            return key == other.key && alg == other.alg &&
+                encrypt == other.encrypt;
+        }
+
+        @Override
+        public int hashCode() {
+            return System.identityHashCode(key) * 31 +
+                System.identityHashCode(alg) * 2 + (encrypt ? 1 : 0);
+        }
+    }
+}
@@ -4,6 +4,7 @@
 
 package org.mozilla.jss.provider.javax.crypto;
 
+import java.nio.ByteBuffer;
 import java.security.AlgorithmParameters;
 import java.security.InvalidAlgorithmParameterException;
 import java.security.InvalidKeyException;
@@ -21,6 +22,7 @@ import javax.crypto.IllegalBlockSizeException;
 import javax.crypto.SecretKey;
 import javax.crypto.SecretKeyFactory;
 import javax.crypto.ShortBufferException;
+import javax.crypto.spec.GCMParameterSpec;
 import javax.crypto.spec.IvParameterSpec;
 import javax.crypto.spec.RC2ParameterSpec;
 
@@ -36,6 +38,7 @@ import org.mozilla.jss.crypto.SymmetricKey;
 import org.mozilla.jss.crypto.TokenException;
 import org.mozilla.jss.crypto.TokenRuntimeException;
 import org.mozilla.jss.crypto.TokenSupplierManager;
+import org.mozilla.jss.pkcs11.PK11Cipher;
 import org.mozilla.jss.pkcs11.PK11PrivKey;
 import org.mozilla.jss.pkcs11.PK11PubKey;
 import org.mozilla.jss.pkix.primitive.SubjectPublicKeyInfo;
@@ -52,9 +55,19 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
     private KeyWrapAlgorithm wrapAlg = null;
     private AlgorithmParameterSpec params = null;
     private int blockSize;
+    // The key and direction cipher was initialized with, when it can be
+    // handed back to cipherCache for reuse.
+    private SymmetricKey cipherKey = null;
+    private boolean cipherEncrypt;
+    // Ciphers from earlier initializations, created when first needed.
+    private CipherContextCache cipherCache = null;
     //keyStrength  is used for RC2ParameterSpec and EncryptionAlgorithm.lookup
     private int keyStrength;
 
+    // Length of the nonces generated for AEAD algorithms, and of their tags.
+    private static final int AEAD_NONCE_LENGTH = 12;
+    private static final int AEAD_TAG_BITS = 128;
+
     protected JSSCipherSpi(String algFamily) {
         this.algFamily = algFamily;
         token = TokenSupplierManager.getTokenSupplier().getThreadToken();
@@ -101,8 +114,22 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
         throws InvalidKeyException, InvalidAlgorithmParameterException
     {
       try {
-        // throw away any previous state
+        // throw away any previous state, except that an AEAD cipher is
+        // kept for reuse with the same algorithm: it holds on to its
+        // message contexts for as long as the key stays the same. Other
+        // ciphers go back to cipherCache.
+        org.mozilla.jss.crypto.Cipher previousCipher = cipher;
+        EncryptionAlgorithm previousAlg = encAlg;
+        if( cipherKey != null ) {
+            if( cipherCache == null ) {
+                cipherCache = new CipherContextCache();
+            }
+            cipherCache.put(cipherKey, encAlg, cipherEncrypt,
+                (PK11Cipher) cipher);
+            previousCipher = null;
+        }
         cipher = null;
+        cipherKey = null;
         wrapper = null;
 
         params = givenParams;
@@ -145,23 +172,45 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
                     token.getName());
             }
 
-            cipher = token.getCipherContext(encAlg);
+            boolean encrypt = (opmode == Cipher.ENCRYPT_MODE);
+            boolean cacheable = CipherContextCache.isCacheable(encAlg);
+            PK11Cipher cached = null;
+            if( encAlg.isAEAD() && encAlg == previousAlg &&
+                    previousCipher != null ) {
+                cipher = previousCipher;
+            } else if( cacheable && cipherCache != null && (cached =
+                    cipherCache.take(symkey, encAlg, encrypt)) != null ) {
+                cipher = cached;
+            } else {
+                cipher = token.getCipherContext(encAlg);
+            }
 
-            if( opmode == Cipher.ENCRYPT_MODE ) {
-                if( params == noAlgParams ) {
-                    // we're supposed to generate some params
-                    params = generateAlgParams(encAlg, blockSize);
-                }
+            if( params == noAlgParams ) {
+                // we're supposed to generate some params when encrypting
+                params = encrypt ? generateAlgParams(encAlg, blockSize) : null;
+            }
+
+            if( cached != null && (params == null ||
+                    params instanceof IvParameterSpec) ) {
+                // Same key and direction as before; only the IV changes.
+                cached.reinit(engineGetIV());
+            } else if( encrypt ) {
                 cipher.initEncrypt(symkey, params);
-            } else if( opmode == Cipher.DECRYPT_MODE ) {
-                if( params == noAlgParams) {
-                    params = null;
-                }
+            } else {
                 cipher.initDecrypt(symkey, params);
             }
+
+            if( cacheable && cipher instanceof PK11Cipher ) {
+                cipherKey = symkey;
+                cipherEncrypt = encrypt;
+            }
         } else {
             assert(
                 opmode==Cipher.WRAP_MODE || opmode==Cipher.UNWRAP_MODE);
+            if( cipherCache != null ) {
+                // Release them rather than hold them while wrapping.
+                cipherCache.clear();
+            }
             wrapAlg = KeyWrapAlgorithm.fromString(buf.toString());
             blockSize = wrapAlg.getBlockSize();
             wrapper = token.getKeyWrapper(wrapAlg);
@@ -220,6 +269,8 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
             if (algFamily.compareToIgnoreCase("RC2") == 0) {
                 gp = givenParams.getParameterSpec(
                     javax.crypto.spec.RC2ParameterSpec.class );
+            } else if ("GCM".equalsIgnoreCase(algMode)) {
+                gp = givenParams.getParameterSpec(GCMParameterSpec.class);
             } else if (algMode.compareToIgnoreCase("CBC") == 0) {
                  gp = givenParams.getParameterSpec(
                              javax.crypto.spec.IvParameterSpec.class );
@@ -254,8 +305,11 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
             // no parameters are needed
             return null;
         }
-        // generate an IV
-        byte[] iv = new byte[blockSize];
+        // generate an IV; AEAD algorithms take a nonce instead, whose
+        // length doesn't depend on the block size
+        boolean aead = (alg instanceof EncryptionAlgorithm) &&
+            ((EncryptionAlgorithm) alg).isAEAD();
+        byte[] iv = new byte[aead ? AEAD_NONCE_LENGTH : blockSize];
         try {
             SecureRandom random = SecureRandom.getInstance("pkcs11prng",
                                                        "Mozilla-JSS");
@@ -265,7 +319,10 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
         }
 
         for (int i = 0; i < paramClasses.length; i ++) {
-            if( paramClasses[i].equals( javax.crypto.spec.IvParameterSpec.class ) ) {
+            if( paramClasses[i].equals( GCMParameterSpec.class ) ) {
+                algParSpec = new GCMParameterSpec(AEAD_TAG_BITS, iv);
+                break;
+            } else if( paramClasses[i].equals( javax.crypto.spec.IvParameterSpec.class ) ) {
                 algParSpec = new javax.crypto.spec.IvParameterSpec(iv);
                 break;
             } else if ( paramClasses[i].equals( RC2ParameterSpec.class ) ) {
@@ -292,6 +349,8 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
         }
         if( params instanceof IvParameterSpec) {
             return ((IvParameterSpec)params).getIV();
+        } else if( params instanceof GCMParameterSpec ) {
+            return ((GCMParameterSpec)params).getIV();
         } else if( params instanceof RC2ParameterSpec ) {
             return ((RC2ParameterSpec)params).getIV();
         } else {
@@ -307,6 +366,9 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
                || ( params instanceof RC2ParameterSpec )) {
                 algParams = AlgorithmParameters.getInstance(algFamily);
                 algParams.init(params);
+            } else if( params instanceof GCMParameterSpec ) {
+                algParams = AlgorithmParameters.getInstance("GCM");
+                algParams.init(params);
             }
           } catch(NoSuchAlgorithmException e) {
               throw new RuntimeException("Unable to get parameters: " + e.getMessage(), e);
@@ -318,10 +380,31 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
 
     @Override
     public int engineGetOutputSize(int inputLen) {
+        // Report what the direct path needs, so that outputs sized from
+        // this are written into without an intermediate copy.
+        if( cipher instanceof PK11Cipher ) {
+            return ((PK11Cipher) cipher).getRequiredOutputSize(inputLen, true);
+        }
         int total = (blockSize-1) + inputLen;
         return ((total / blockSize) + 1) * blockSize;
     }
 
+    @Override
+    protected void engineUpdateAAD(byte[] src, int offset, int len) {
+        if( !(cipher instanceof PK11Cipher) ) {
+            throw new UnsupportedOperationException(
+                "Additional authenticated data requires an AEAD cipher");
+        }
+        ((PK11Cipher) cipher).updateAAD(src, offset, len);
+    }
+
+    @Override
+    protected void engineUpdateAAD(ByteBuffer src) {
+        byte[] aad = new byte[src.remaining()];
+        src.get(aad);
+        engineUpdateAAD(aad, 0, aad.length);
+    }
+
     @Override
     public byte[] engineUpdate(byte[] input, int inputOffset, int inputLen) {
         if(cipher == null) {
@@ -340,6 +423,17 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
     public int engineUpdate(byte[] input, int inputOffset, int inputLen,
         byte[] output, int outputOffset) throws ShortBufferException
     {
+        PK11Cipher direct = directCipher(output.length - outputOffset,
+                                         inputLen, false);
+        if( direct != null ) {
+            try {
+                return direct.update(input, inputOffset, inputLen, output,
+                                     outputOffset);
+            } catch(TokenException te) {
+                throw new TokenRuntimeException(te.getMessage());
+            }
+        }
+
         byte[] bytes = engineUpdate(input, inputOffset, inputLen);
         if( bytes.length > output.length-outputOffset ) {
             throw new ShortBufferException(bytes.length +  " needed, " +
@@ -379,6 +473,19 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
             throws ShortBufferException, IllegalBlockSizeException,
             BadPaddingException
     {
+        PK11Cipher direct = directCipher(output.length - outputOffset,
+                                         inputLen, true);
+        if( direct != null ) {
+            try {
+                return direct.doFinal(input, inputOffset, inputLen, output,
+                                      outputOffset);
+            } catch(org.mozilla.jss.crypto.IllegalBlockSizeException ibse) {
+                throw new IllegalBlockSizeException(ibse.getMessage());
+            } catch(TokenException te) {
+                throw new TokenRuntimeException(te.getMessage());
+            }
+        }
+
         byte[] bytes = engineDoFinal(input, inputOffset, inputLen);
         if( bytes.length > output.length-outputOffset ) {
             throw new ShortBufferException(bytes.length +  " needed, " +
@@ -388,6 +495,72 @@ public class JSSCipherSpi extends javax.crypto.CipherSpi {
         return bytes.length;
     }
 
+    @Override
+    protected int engineUpdate(ByteBuffer input, ByteBuffer output)
+        throws ShortBufferException
+    {
+        PK11Cipher direct = directCipher(output.remaining(),
+                                         input.remaining(), false);
+        if( direct == null || !sameKind(input, output) ) {
+            return super.engineUpdate(input, output);
+        }
+
+        try {
+            return direct.update(input, output);
+        } catch(TokenException te) {
+            throw new TokenRuntimeException(te.getMessage());
+        }
+    }
+
+    @Override
+    protected int engineDoFinal(ByteBuffer input, ByteBuffer output)
+        throws ShortBufferException, IllegalBlockSizeException,
+        BadPaddingException
+    {
+        PK11Cipher direct = directCipher(output.remaining(),
+                                         input.remaining(), true);
+        if( direct == null || !sameKind(input, output) ) {
+            return super.engineDoFinal(input, output);
+        }
+
+        try {
+            return direct.doFinal(input, output);
+        } catch(org.mozilla.jss.crypto.IllegalBlockSizeException ibse) {
+            throw new IllegalBlockSizeException(ibse.getMessage());
+        } catch(TokenException te) {
+            throw new TokenRuntimeException(te.getMessage());
+        }
+    }
+
+    /**
+     * Get the underlying PK11Cipher when it can write straight into an
+     * output buffer with the given room; otherwise, return null and let
+     * the caller copy through an intermediate array, which also reports
+     * short buffers exactly.
+     */
+    private PK11Cipher directCipher(int available, int inputLen,
+        boolean finish)
+    {
+        if( !(cipher instanceof PK11Cipher) ) {
+            return null;
+        }
+
+        PK11Cipher pk11Cipher = (PK11Cipher) cipher;
+        if( available < pk11Cipher.getRequiredOutputSize(inputLen, finish) ) {
+            return null;
+        }
+        return pk11Cipher;
+    }
+
+    /**
+     * Whether both buffers are direct, or both are backed by arrays, so
+     * that PK11Cipher can cipher between them without copying.
+     */
+    private static boolean sameKind(ByteBuffer input, ByteBuffer output) {
+        return (input.isDirect() && output.isDirect()) ||
+            (input.hasArray() && output.hasArray());
+    }
+
     @Override
     public byte[] engineWrap(Key key)
         throws IllegalBlockSizeException, InvalidKeyException
@@ -26,7 +26,7 @@ import org.mozilla.jss.crypto.SymmetricKey;
 import org.mozilla.jss.crypto.TokenRuntimeException;
 import org.mozilla.jss.crypto.TokenSupplierManager;
 
-public class JSSMacSpi extends javax.crypto.MacSpi {
+public class JSSMacSpi extends javax.crypto.MacSpi implements Cloneable {
 
     private JSSMessageDigest digest=null;
     private DigestAlgorithm alg;
@@ -134,9 +134,19 @@ public class JSSMacSpi extends javax.crypto.MacSpi {
       }
     }
 
+    /**
+     * Copies the MAC along with any input processed so far. This fails
+     * with CloneNotSupportedException once input has been processed, if
+     * the token cannot save the state of the MAC; the NSS internal token
+     * can only copy an HMAC before any input.
+     */
     @Override
     public Object clone() throws CloneNotSupportedException {
-        throw new CloneNotSupportedException();
+        JSSMacSpi copy = (JSSMacSpi) super.clone();
+        if (digest != null) {
+            copy.digest = (JSSMessageDigest) digest.clone();
+        }
+        return copy;
     }
 
     public static class HmacSHA1 extends JSSMacSpi {
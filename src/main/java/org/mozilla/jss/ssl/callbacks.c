@@ -29,7 +29,7 @@ JSSL_getOCSPPolicy() {
     jclass cryptoManagerClass;
 
     /* get the JNI environment */
-    if((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != 0){
+    if(JSS_attachCurrentThread(&env) != PR_SUCCESS){
         PR_ASSERT(PR_FALSE);
         goto finish;
     }
@@ -155,7 +155,7 @@ JSSL_CallCertSelectionCallback(    void * arg,
     JNIEnv *env;
     int debug_cc=0;
 
-    if((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != 0){
+    if(JSS_attachCurrentThread(&env) != PR_SUCCESS){
         PR_ASSERT(PR_FALSE);
         return SECFailure;
     }
@@ -298,7 +298,7 @@ JSSL_AlertReceivedCallback(const PRFileDesc *fd, void *arg, const SSLAlert *aler
 {
     JSSL_SocketData *socket = (JSSL_SocketData*) arg;
 
-    jint rc;
+    PRStatus rc;
     JNIEnv *env;
     jclass socketClass, eventClass;
     jmethodID eventConstructor;
@@ -308,13 +308,13 @@ JSSL_AlertReceivedCallback(const PRFileDesc *fd, void *arg, const SSLAlert *aler
     PR_ASSERT(socket != NULL);
     PR_ASSERT(socket->socketObject != NULL);
 
-    rc = (*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL);
-    PR_ASSERT(rc == JNI_OK);
+    rc = JSS_attachCurrentThread(&env);
+    PR_ASSERT(rc == PR_SUCCESS);
     PR_ASSERT(env != NULL);
 
     /* Fast return when assumptions are incorrect. */
     if (socket == NULL || socket->socketObject == NULL ||
-            rc != JNI_OK || env == NULL) {
+            rc != PR_SUCCESS || env == NULL) {
         return;
     }
 
@@ -341,8 +341,6 @@ JSSL_AlertReceivedCallback(const PRFileDesc *fd, void *arg, const SSLAlert *aler
     PR_ASSERT(fireEvent != NULL);
 
     (*env)->CallVoidMethod(env, socket->socketObject, fireEvent, event);
-
-    (*JSS_javaVM)->DetachCurrentThread(JSS_javaVM);
 }
 
 void
@@ -350,7 +348,7 @@ JSSL_AlertSentCallback(const PRFileDesc *fd, void *arg, const SSLAlert *alert)
 {
     JSSL_SocketData *socket = (JSSL_SocketData*) arg;
 
-    jint rc;
+    PRStatus rc;
     JNIEnv *env;
     jclass socketClass, eventClass;
     jmethodID eventConstructor, eventSetLevel, eventSetDescription;
@@ -360,13 +358,13 @@ JSSL_AlertSentCallback(const PRFileDesc *fd, void *arg, const SSLAlert *alert)
     PR_ASSERT(socket != NULL);
     PR_ASSERT(socket->socketObject != NULL);
 
-    rc = (*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL);
-    PR_ASSERT(rc == JNI_OK);
+    rc = JSS_attachCurrentThread(&env);
+    PR_ASSERT(rc == PR_SUCCESS);
     PR_ASSERT(env != NULL);
 
     /* Fast return when assumptions are incorrect. */
     if (socket == NULL || socket->socketObject == NULL ||
-            rc != JNI_OK || env == NULL) {
+            rc != PR_SUCCESS || env == NULL) {
         return;
     }
 
@@ -407,8 +405,6 @@ JSSL_AlertSentCallback(const PRFileDesc *fd, void *arg, const SSLAlert *alert)
     PR_ASSERT(fireEvent != NULL);
 
     (*env)->CallVoidMethod(env, socket->socketObject, fireEvent, event);
-
-    (*JSS_javaVM)->DetachCurrentThread(JSS_javaVM);
 }
 
 void
@@ -422,7 +418,7 @@ JSSL_HandshakeCallback(PRFileDesc *fd, void *arg)
     PR_ASSERT(sock!=NULL);
 
     /* get the JNI environment */
-    if((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != 0){
+    if(JSS_attachCurrentThread(&env) != PR_SUCCESS){
         PR_ASSERT(PR_FALSE);
         goto finish;
     }
@@ -578,7 +574,6 @@ JSSL_JavaCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig,
     CERTVerifyLog log;
     JNIEnv *env;
     jobject validityStatus;
-    jmethodID addReasonMethod;
     int certUsage;
     int checkcn_rv;
     jmethodID approveMethod;
@@ -600,7 +595,7 @@ JSSL_JavaCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig,
     int ocspPolicy = JSSL_getOCSPPolicy();
 
     /* get the JNI environment */
-    if((*JSS_javaVM)->AttachCurrentThread(JSS_javaVM, (void**)&env, NULL) != 0){
+    if(JSS_attachCurrentThread(&env) != PR_SUCCESS){
         PR_ASSERT(PR_FALSE);
         goto finish;
     }
@@ -658,31 +653,13 @@ JSSL_JavaCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig,
     /*
      * create a new ValidityStatus object
      */
-    {
-        jclass clazz;
-        jmethodID cons;
-
-        clazz = (*env)->FindClass(env, SSLCERT_APP_CB_VALIDITY_STATUS_CLASS);
-        if( clazz == NULL ) goto finish;
-
-        cons = (*env)->GetMethodID(env, clazz,
-                        PLAIN_CONSTRUCTOR, PLAIN_CONSTRUCTOR_SIG);
-        if( cons == NULL ) goto finish;
-
-        validityStatus = (*env)->NewObject(env, clazz, cons);
-        if( validityStatus == NULL ) {
-            goto finish;
-        }
-
-        /* get the addReason methodID while we're at it */
-        addReasonMethod = (*env)->GetMethodID(env, clazz,
-            SSLCERT_APP_CB_VALIDITY_STATUS_ADD_REASON_NAME,
-            SSLCERT_APP_CB_VALIDITY_STATUS_ADD_REASON_SIG);
-        if( addReasonMethod == NULL ) {
-            goto finish;
-        }
+    PR_ASSERT( JSS_javaIDs.validityStatusConstructor != NULL );
+    validityStatus = (*env)->NewObject(env, JSS_javaIDs.validityStatusClass,
+                        JSS_javaIDs.validityStatusConstructor);
+    if( validityStatus == NULL ) {
+        goto finish;
     }
-    
+
     /*
      * Load up the ValidityStatus object with all the reasons for failure
      */
@@ -701,7 +678,8 @@ JSSL_JavaCertAuthCallback(void *arg, PRFileDesc *fd, PRBool checkSig,
             depth = node->depth;
 
             ninjacert = JSS_PK11_wrapCert(env,&errorcert);
-            (*env)->CallVoidMethod(env, validityStatus, addReasonMethod,
+            (*env)->CallVoidMethod(env, validityStatus,
+                JSS_javaIDs.validityStatusAddReason,
                 error,
                 ninjacert,
                 depth
@@ -52,8 +52,10 @@ JSS_SSL_getException(PRFilePrivate *priv)
 }
 
 
+/* fd->secret->javaVM is always JSS_javaVM; there's only one JVM per
+ * process. */
 #define GET_ENV(vm, env) \
-    ( ((*(vm))->AttachCurrentThread((vm), (void**)&(env), NULL) == 0) ? 0 : 1 )
+    ( (JSS_attachCurrentThread(&(env)) == PR_SUCCESS) ? 0 : 1 )
 
 static PRInt32 
 writebuf(JNIEnv *env, PRFileDesc *fd, jobject sockObj, jbyteArray byteArray)
@@ -182,6 +182,37 @@ static PRInt32 PRBufferWrite(PRFileDesc *fd, const void *buf, PRInt32 amount)
     return PRBufferSend(fd, buf, amount, 0, -1);
 }
 
+static PRInt32 PRBufferWritev(PRFileDesc *fd, const PRIOVec *iov,
+        PRInt32 iov_size, PRIntervalTime timeout)
+{
+    /* Writev gathers several discontiguous arrays into a single write. As
+     * with Send, copy as much as fits into the buffer, else return
+     * EWOULDBLOCK when there's no free space at all. */
+
+    PRFilePrivate *internal = fd->secret;
+    struct iovec vectors[PR_MAX_IOVECTOR_SIZE];
+
+    if (iov_size < 0 || iov_size > PR_MAX_IOVECTOR_SIZE) {
+        PR_SetError(PR_BUFFER_OVERFLOW_ERROR, 0);
+        return -1;
+    }
+
+    if (!jb_can_write(internal->write_buffer)) {
+        /* See comment in PRBufferSend about EWOULDBLOCK. */
+        PR_SetError(PR_WOULD_BLOCK_ERROR, EWOULDBLOCK);
+        return -1;
+    }
+
+    /* PRIOVec stores its length as an int; translate into the native
+     * iovec which j_buffer understands. */
+    for (PRInt32 i = 0; i < iov_size; i++) {
+        vectors[i].iov_base = iov[i].iov_base;
+        vectors[i].iov_len = iov[i].iov_len < 0 ? 0 : iov[i].iov_len;
+    }
+
+    return jb_writev(internal->write_buffer, vectors, iov_size);
+}
+
 
 // Respond to recv requests
 static PRInt32 PRBufferRecv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout)
@@ -290,7 +321,7 @@ static const PRIOMethods PRIOBufferMethods = {
     (PRSeek64FN)invalidInternalCall,
     (PRFileInfoFN)invalidInternalCall,
     (PRFileInfo64FN)invalidInternalCall,
-    (PRWritevFN)invalidInternalCall,
+    PRBufferWritev,
     (PRConnectFN)invalidInternalCall,
     (PRAcceptFN)invalidInternalCall,
     (PRBindFN)invalidInternalCall,
@@ -1,8 +1,24 @@
 package org.mozilla.jss.ssl.javax;
 
+import java.lang.ref.Reference;
+import java.lang.ref.ReferenceQueue;
+import java.lang.ref.WeakReference;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.security.cert.CertificateEncodingException;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.HashMap;
+import java.util.Map;
+import java.util.TreeMap;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.Executor;
 import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.LongAccumulator;
+import java.util.concurrent.atomic.LongAdder;
+import java.util.concurrent.locks.ReadWriteLock;
+import java.util.concurrent.locks.ReentrantReadWriteLock;
 
 import javax.net.ssl.SSLEngineResult;
 import javax.net.ssl.SSLException;
@@ -52,6 +68,41 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
      */
     protected static int BUFFER_SIZE = 1 << 12;
 
+    /**
+     * Maximum length of the plaintext of a single TLS record (2^14 bytes),
+     * absent a smaller record_size_limit.
+     */
+    protected static final int MAX_RECORD_PLAINTEXT = 1 << 14;
+
+    /**
+     * Maximum length a TLS record may grow by when protected: the five byte
+     * record header plus up to 2048 bytes of expansion under TLS 1.2 and
+     * earlier (TLS 1.3 permits only 256).
+     */
+    protected static final int MAX_RECORD_OVERHEAD = 5 + 2048;
+
+    /**
+     * Most application data written per record right after the handshake
+     * or an idle period, when dynamic record sizing is enabled. A protected
+     * record this size fits in a single TCP segment, so the peer can
+     * decrypt and act on the first bytes without waiting for the rest of a
+     * full record to arrive.
+     */
+    protected static final int SMALL_RECORD_SIZE = 1 << 10;
+
+    /**
+     * Amount of application data sent in small records before switching to
+     * full records; about one initial TCP congestion window.
+     */
+    protected static final int SMALL_RECORD_WINDOW = 1 << 14;
+
+    /**
+     * Time without sending application data, in nanoseconds, after which
+     * we go back to small records; by then TCP has likely reset its
+     * congestion window.
+     */
+    protected static final long RECORD_IDLE_TIMEOUT = 1000000000L;
+
     /**
      * Whether or not this SSLEngine is acting as the client end of the
      * handshake.
@@ -185,10 +236,75 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
     protected HashMap<Integer, Integer> config;
 
     /**
-     * Set of cached server sockets based on the PK11Cert they were
-     * initialized with.
+     * Whether or not to send small records after the handshake and idle
+     * periods; see getRecordSize(...).
      */
-    protected static HashMap<PK11Cert, SSLFDProxy> serverTemplates = new HashMap<PK11Cert, SSLFDProxy>();
+    protected boolean dynamic_record_sizing = true;
+
+    /**
+     * Amount of application data sent in small records since the
+     * handshake or the last idle period, up to SMALL_RECORD_WINDOW.
+     */
+    protected int small_record_data;
+
+    /**
+     * System.nanoTime() when application data was last sent.
+     */
+    protected long last_record_time;
+
+    /**
+     * Executor to run peer certificate validation on, instead of handing
+     * it out via getDelegatedTask(); see setValidationExecutor(...).
+     */
+    protected Executor validation_executor;
+
+    /**
+     * Cached model sockets, compiled from the parameters of the engines
+     * which use them; see ModelParameters and importFromModel.
+     */
+    protected static ConcurrentHashMap<ModelParameters, SSLFDProxy> modelTemplates = new ConcurrentHashMap<ModelParameters, SSLFDProxy>();
+
+    /**
+     * Keys of modelTemplates in the order they were added, oldest first;
+     * evicted in that order once the cache holds more than
+     * maxModelTemplates models.
+     */
+    private static ConcurrentLinkedQueue<ModelParameters> modelTemplateOrder = new ConcurrentLinkedQueue<ModelParameters>();
+
+    /**
+     * Upper bound on the number of cached model sockets.
+     */
+    private static volatile int maxModelTemplates = 64;
+
+    /**
+     * Held for reading while a model socket is copied and for writing
+     * while an evicted one is closed, so that no model is closed out
+     * from under an engine copying it.
+     */
+    private static ReadWriteLock modelTemplateLock = new ReentrantReadWriteLock();
+
+    private static LongAdder modelTemplateHits = new LongAdder();
+    private static LongAdder modelTemplateMisses = new LongAdder();
+
+    /**
+     * SHA-256 fingerprints of server certificates, keyed by the identity of
+     * the PK11Cert they were computed from, so that engines sharing a
+     * certificate object only encode and hash it once. Entries are dropped
+     * once their certificate is garbage collected; see certFingerprint(...).
+     */
+    private static ConcurrentHashMap<CertKey, byte[]> certFingerprints = new ConcurrentHashMap<CertKey, byte[]>();
+    private static ReferenceQueue<PK11Cert> staleCertKeys = new ReferenceQueue<PK11Cert>();
+    private static LongAdder certFingerprintCount = new LongAdder();
+
+    /**
+     * Timing of peer certificate validation across all engines, in
+     * nanoseconds; see recordValidation(...).
+     */
+    private static LongAdder validationCount = new LongAdder();
+    private static LongAdder validationQueueTime = new LongAdder();
+    private static LongAdder validationRunTime = new LongAdder();
+    private static LongAccumulator validationMaxQueueTime = new LongAccumulator(Math::max, 0);
+    private static LongAccumulator validationMaxRunTime = new LongAccumulator(Math::max, 0);
 
     /**
      * Whether or not the session cache has been initialized already.
@@ -209,7 +325,7 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
     public JSSEngine() {
         super();
 
-        session = new JSSSession(this, BUFFER_SIZE);
+        session = new JSSSession(this);
         config = getDefaultConfiguration();
     }
 
@@ -223,7 +339,7 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
     public JSSEngine(String peerHost, int peerPort) {
         super(peerHost, peerPort);
 
-        session = new JSSSession(this, BUFFER_SIZE);
+        session = new JSSSession(this);
         session.setPeerHost(peerHost);
         session.setPeerPort(peerPort);
         config = getDefaultConfiguration();
@@ -245,7 +361,7 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
         cert = (PK11Cert) localCert;
         key = (PK11PrivKey) localKey;
 
-        session = new JSSSession(this, BUFFER_SIZE);
+        session = new JSSSession(this);
         session.setPeerHost(peerHost);
         session.setPeerPort(peerPort);
         config = getDefaultConfiguration();
@@ -962,6 +1078,136 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
      */
     public abstract SecurityStatusResult getStatus();
 
+    /**
+     * Gets the largest plaintext record the peer may send us: the
+     * record_size_limit we advertise if one is configured, else the
+     * protocol maximum.
+     */
+    protected int getInboundRecordLimit() {
+        Integer limit = null;
+        if (config != null) {
+            limit = config.get(SSL.RECORD_SIZE_LIMIT);
+        }
+
+        if (limit == null || limit <= 0 || limit > MAX_RECORD_PLAINTEXT) {
+            return MAX_RECORD_PLAINTEXT;
+        }
+
+        return limit;
+    }
+
+    /**
+     * Sets whether or not to use dynamic record sizing: when enabled (the
+     * default), application data sent right after the handshake, or after
+     * the connection has been idle, goes out in small records so that the
+     * peer sees the first bytes sooner; bulk transfers then switch to full
+     * records, which have less framing overhead. NSS further splits records
+     * to honor the peer's record_size_limit.
+     */
+    public void setDynamicRecordSizing(boolean enabled) {
+        dynamic_record_sizing = enabled;
+    }
+
+    /**
+     * Gets whether or not dynamic record sizing is enabled.
+     */
+    public boolean getDynamicRecordSizing() {
+        return dynamic_record_sizing;
+    }
+
+    /**
+     * Starts sending in small records again when no application data has
+     * been sent for RECORD_IDLE_TIMEOUT. Call once per wrap(...), before
+     * getRecordSize(...).
+     */
+    protected void checkRecordIdle() {
+        if (small_record_data > 0 && System.nanoTime() - last_record_time > RECORD_IDLE_TIMEOUT) {
+            small_record_data = 0;
+        }
+    }
+
+    /**
+     * Gets the most application data to hand NSS in a single write: a
+     * small record while dynamic record sizing calls for one, else
+     * full_size.
+     */
+    protected int getRecordSize(int full_size) {
+        if (dynamic_record_sizing && small_record_data < SMALL_RECORD_WINDOW) {
+            return Math.min(SMALL_RECORD_SIZE, full_size);
+        }
+
+        return full_size;
+    }
+
+    /**
+     * Accounts for application data handed to NSS by wrap(...).
+     */
+    protected void recordSent(int amount) {
+        if (amount <= 0) {
+            return;
+        }
+
+        small_record_data = Math.min(SMALL_RECORD_WINDOW, small_record_data + amount);
+        last_record_time = System.nanoTime();
+    }
+
+    /**
+     * Sets the Executor to validate the peer's certificate chain on.
+     *
+     * By default, TrustManager validation is handed out as a delegated task
+     * which the caller has to run before the handshake can continue. When
+     * an Executor is set, the engine submits validation to it instead: while
+     * it runs, getHandshakeStatus() reports NEED_TASK and wrap(...) and
+     * unwrap(...) return immediately with NEED_TASK, consuming and
+     * producing nothing. Once validation finishes, its result is passed to
+     * NSS, getHandshakeStatus() changes to NEED_WRAP and the handshake
+     * resumes on the next call to wrap(...). Should the Executor reject the
+     * task, it is handed out via getDelegatedTask() as usual.
+     *
+     * Meanwhile, getDelegatedTask() returns a task which blocks until
+     * validation finishes, so the usual loop of running delegated tasks
+     * until there are none left doesn't spin on NEED_TASK. Callers which
+     * must not block should poll getHandshakeStatus() instead.
+     *
+     * Only applies to validation which NSS lets complete asynchronously,
+     * which currently is the server's certificate chain validated by a
+     * client. Set to null to go back to delegated tasks.
+     */
+    public void setValidationExecutor(Executor executor) {
+        validation_executor = executor;
+    }
+
+    /**
+     * Gets the Executor peer certificate validation is submitted to, if
+     * any.
+     */
+    public Executor getValidationExecutor() {
+        return validation_executor;
+    }
+
+    /**
+     * Accounts for a single peer certificate validation: queue_time is the
+     * time from NSS requesting validation until it started, and run_time
+     * the time it took to run the TrustManagers.
+     */
+    protected static void recordValidation(long queue_time, long run_time) {
+        validationCount.increment();
+        validationQueueTime.add(queue_time);
+        validationRunTime.add(run_time);
+        validationMaxQueueTime.accumulate(queue_time);
+        validationMaxRunTime.accumulate(run_time);
+    }
+
+    /**
+     * Gets the ceiling for an elastic buffer carrying records of at most
+     * record_limit bytes of plaintext. This fits two full protected records,
+     * so a single wrap or unwrap call can move an entire record even while
+     * part of the next one is already buffered.
+     */
+    protected static int getMaxBufferSize(int record_limit) {
+        return 2 * (record_limit + MAX_RECORD_OVERHEAD);
+    }
+
     /**
      * Gets the default configuration.
      */
@@ -1008,28 +1254,390 @@ public abstract class JSSEngine extends javax.net.ssl.SSLEngine {
     }
 
     /**
-     * Returns the templated server certificate, if one exists.
-     */
-    protected static SSLFDProxy getServerTemplate(PK11Cert cert, PK11PrivKey key) {
-        if (cert == null || key == null) {
-            return null;
+     * An immutable snapshot of the configuration an engine applies to its
+     * SSL PRFileDesc which can instead live on a model PRFileDesc: enabled
+     * cipher suites, protocol version range, SSL_OptionSet options, client
+     * authentication mode, and the server certificate and key. All of
+     * these are copied by SSL_ImportFD, so engines with equal parameters
+     * share one model, compiled once, and a new engine needs a single
+     * SSL_ImportFD call instead of hundreds of SSL_CipherPrefSet and
+     * SSL_OptionSet calls.
+     */
+    protected static final class ModelParameters {
+        private final boolean asServer;
+        private final PK11Cert cert;
+        private final PK11PrivKey key;
+        // SHA-256 of the certificate's DER encoding, so that lookups don't
+        // have to call down into NSS for it; null without a certificate.
+        private final byte[] certFingerprint;
+        private final SSLVersion minProtocol;
+        private final SSLVersion maxProtocol;
+        // Null to keep the default cipher suites.
+        private final SSLCipher[] ciphers;
+        private final TreeMap<Integer, Integer> options;
+        private final boolean wantClientAuth;
+        private final boolean needClientAuth;
+        private final int hash;
+
+        ModelParameters(JSSEngine engine) throws SSLException {
+            asServer = engine.as_server;
+            // Client certificates are selected per connection instead.
+            cert = asServer ? engine.cert : null;
+            key = asServer ? engine.key : null;
+            certFingerprint = cert == null ? null : fingerprint(cert);
+
+            // The range only applies when both ends are given.
+            boolean range = engine.min_protocol != null &&
+                engine.max_protocol != null;
+            minProtocol = range ? engine.min_protocol : null;
+            maxProtocol = range ? engine.max_protocol : null;
+
+            if (engine.enabled_ciphers == null) {
+                ciphers = null;
+            } else {
+                ciphers = Arrays.stream(engine.enabled_ciphers)
+                    .filter(suite -> suite != null)
+                    .toArray(SSLCipher[]::new);
+            }
+
+            options = new TreeMap<>();
+            if (engine.config != null) {
+                options.putAll(engine.config);
+            }
+
+            wantClientAuth = asServer && engine.want_client_auth;
+            needClientAuth = asServer && engine.need_client_auth;
+
+            int h = Boolean.hashCode(asServer);
+            h = 31 * h + Arrays.hashCode(certFingerprint);
+            h = 31 * h + (minProtocol == null ? 0 : minProtocol.hashCode());
+            h = 31 * h + (maxProtocol == null ? 0 : maxProtocol.hashCode());
+            h = 31 * h + Arrays.hashCode(ciphers);
+            h = 31 * h + options.hashCode();
+            h = 31 * h + Boolean.hashCode(wantClientAuth);
+            h = 31 * h + Boolean.hashCode(needClientAuth);
+            hash = h;
+        }
+
+        @Override
+        public int hashCode() {
+            return hash;
+        }
+
+        @Override
+        public boolean equals(Object o) {
+            if (!(o instanceof ModelParameters)) {
+                return false;
+            }
+
+            ModelParameters other = (ModelParameters) o;
+            return hash == other.hash &&
+                asServer == other.asServer &&
+                Arrays.equals(certFingerprint, other.certFingerprint) &&
+                minProtocol == other.minProtocol &&
+                maxProtocol == other.maxProtocol &&
+                Arrays.equals(ciphers, other.ciphers) &&
+                options.equals(other.options) &&
+                wantClientAuth == other.wantClientAuth &&
+                needClientAuth == other.needClientAuth;
+        }
+
+        private static byte[] fingerprint(PK11Cert cert) throws SSLException {
+            CertKey lookup = new CertKey(cert, null);
+            byte[] result = certFingerprints.get(lookup);
+            if (result != null) {
+                return result;
+            }
+
+            try {
+                MessageDigest digest = MessageDigest.getInstance("SHA-256");
+                result = digest.digest(cert.getEncoded());
+            } catch (CertificateEncodingException | NoSuchAlgorithmException e) {
+                throw new SSLException("Unable to fingerprint server certificate: " + e.getMessage(), e);
+            }
+
+            certFingerprintCount.increment();
+
+            // Drop fingerprints of collected certificates before adding one.
+            Reference<? extends PK11Cert> stale;
+            while ((stale = staleCertKeys.poll()) != null) {
+                certFingerprints.remove(stale);
+            }
+
+            byte[] existing = certFingerprints.putIfAbsent(new CertKey(cert, staleCertKeys), result);
+            return existing != null ? existing : result;
         }
 
-        SSLFDProxy fd = serverTemplates.get(cert);
-        if (fd == null) {
+        /**
+         * Creates a model SSL PRFileDesc with these parameters applied.
+         */
+        private SSLFDProxy compile() throws SSLException {
             PRFDProxy base = PR.NewTCPSocket();
-            fd = SSL.ImportFD(null, base);
-            if (SSL.ConfigServerCert(fd, cert, key) != SSL.SECSuccess) {
-                String msg = "Unable to configure certificate and key on ";
-                msg += "model SSL PRFileDesc proxy: ";
-                msg += errorText(PR.GetError());
-                throw new RuntimeException(msg);
+            SSLFDProxy model = SSL.ImportFD(null, base);
+            if (model == null) {
+                PR.Close(base);
+                throw new SSLException("Unable to create model SSL PRFileDesc: " + errorText(PR.GetError()));
+            }
+
+            try {
+                apply(model);
+            } catch (SSLException e) {
+                PR.Close(model);
+                throw e;
+            }
+
+            return model;
+        }
+
+        private void apply(SSLFDProxy model) throws SSLException {
+            // Applied in the order engines used to apply them to their own
+            // sockets, so that explicit options win.
+            if (asServer) {
+                if (cert != null && key != null &&
+                        SSL.ConfigServerCert(model, cert, key) != SSL.SECSuccess) {
+                    throw new SSLException("Unable to configure certificate and key on model SSL PRFileDesc proxy: " + errorText(PR.GetError()));
+                }
+
+                if (SSL.OptionSet(model, SSL.REQUEST_CERTIFICATE, wantClientAuth || needClientAuth ? 1 : 0) == SSL.SECFailure) {
+                    throw new SSLException("Unable to configure SSL_REQUEST_CERTIFICATE option: " + errorText(PR.GetError()));
+                }
+
+                if (SSL.OptionSet(model, SSL.REQUIRE_CERTIFICATE, needClientAuth ? SSL.REQUIRE_ALWAYS : 0) == SSL.SECFailure) {
+                    throw new SSLException("Unable to configure SSL_REQUIRE_CERTIFICATE option: " + errorText(PR.GetError()));
+                }
+            }
+
+            if (minProtocol != null) {
+                SSLVersionRange vrange = new SSLVersionRange(minProtocol, maxProtocol);
+                if (SSL.VersionRangeSet(model, vrange) == SSL.SECFailure) {
+                    throw new SSLException("Unable to set version range: " + errorText(PR.GetError()));
+                }
+            }
+
+            if (ciphers != null) {
+                // Disable every suite, then enable only those requested.
+                // Suites which can't be enabled are most likely disallowed
+                // by local policy; log them.
+                for (SSLCipher suite : SSLCipher.values()) {
+                    SSL.CipherPrefSet(model, suite.getID(), false);
+                }
+                for (SSLCipher suite : ciphers) {
+                    if (SSL.CipherPrefSet(model, suite.getID(), true) == SSL.SECFailure) {
+                        logger.warn("Unable to enable cipher suite " + suite + ": " + errorText(PR.GetError()));
+                    }
+                }
+            }
+
+            for (Map.Entry<Integer, Integer> option : options.entrySet()) {
+                if (SSL.OptionSet(model, option.getKey(), option.getValue()) != SSL.SECSuccess) {
+                    throw new SSLException("Unable to set configuration value: " + option.getKey() + "=" + option.getValue());
+                }
+            }
+        }
+    }
+
+    /**
+     * Weak, identity-based key for certFingerprints. PK11Cert.equals(...)
+     * and hashCode() re-encode the certificate, which is exactly the work
+     * the fingerprint cache avoids.
+     */
+    private static final class CertKey extends WeakReference<PK11Cert> {
+        private final int hash;
+
+        CertKey(PK11Cert cert, ReferenceQueue<PK11Cert> queue) {
+            super(cert, queue);
+            hash = System.identityHashCode(cert);
+        }
+
+        @Override
+        public int hashCode() {
+            return hash;
+        }
+
+        @Override
+        public boolean equals(Object o) {
+            if (this == o) {
+                return true;
+            }
+
+            if (!(o instanceof CertKey)) {
+                return false;
+            }
+
+            PK11Cert cert = get();
+            return cert != null && cert == ((CertKey) o).get();
+        }
+    }
+
+    /**
+     * Takes a snapshot of the parts of this engine's configuration that
+     * belong on its model SSL PRFileDesc; see importFromModel.
+     */
+    protected ModelParameters getModelParameters() throws SSLException {
+        return new ModelParameters(this);
+    }
+
+    /**
+     * Creates an SSL PRFileDesc on top of fd, copying its configuration
+     * from the model SSL PRFileDesc for the given parameters. The model is
+     * compiled the first time the parameters are seen and cached after
+     * that. Returns null when SSL_ImportFD fails, like SSL.ImportFD.
+     */
+    protected static SSLFDProxy importFromModel(ModelParameters params, PRFDProxy fd) throws SSLException {
+        while (true) {
+            SSLFDProxy model = getModelTemplate(params);
+
+            modelTemplateLock.readLock().lock();
+            try {
+                // Only a model still in the cache is known not to be closed.
+                if (modelTemplates.get(params) == model) {
+                    return SSL.ImportFD(model, fd);
+                }
+            } finally {
+                modelTemplateLock.readLock().unlock();
+            }
+
+            // Evicted before we got to copy it; look it up again.
+        }
+    }
+
+    private static SSLFDProxy getModelTemplate(ModelParameters params) throws SSLException {
+        SSLFDProxy model = modelTemplates.get(params);
+        if (model != null) {
+            modelTemplateHits.increment();
+            return model;
+        }
+
+        modelTemplateMisses.increment();
+
+        // Compiled outside of any lock; when two engines race on the same
+        // parameters, the loser closes its copy and uses the winner's.
+        SSLFDProxy compiled = params.compile();
+        model = modelTemplates.putIfAbsent(params, compiled);
+        if (model != null) {
+            closeModelTemplate(compiled);
+            return model;
+        }
+
+        modelTemplateOrder.add(params);
+        evictModelTemplates();
+        return compiled;
+    }
+
+    private static void evictModelTemplates() {
+        while (modelTemplates.size() > maxModelTemplates) {
+            ModelParameters eldest = modelTemplateOrder.poll();
+            if (eldest == null) {
+                return;
             }
 
-            serverTemplates.put(cert, fd);
+            modelTemplateLock.writeLock().lock();
+            try {
+                SSLFDProxy model = modelTemplates.remove(eldest);
+                if (model != null) {
+                    closeModelTemplate(model);
+                }
+            } finally {
+                modelTemplateLock.writeLock().unlock();
+            }
         }
+    }
 
-        return fd;
+    private static void closeModelTemplate(SSLFDProxy model) {
+        try {
+            PR.Close(model);
+            model.close();
+        } catch (Exception e) {
+            logger.warn("Unable to close model SSL PRFileDesc: " + e.getMessage(), e);
+        }
+    }
+
+    /**
+     * Returns the upper bound on the number of cached model SSL
+     * PRFileDescs.
+     */
+    public static int getMaxModelTemplates() {
+        return maxModelTemplates;
+    }
+
+    /**
+     * Sets the upper bound on the number of cached model SSL PRFileDescs,
+     * evicting the oldest models until the cache fits. Must be at least
+     * one.
+     */
+    public static void setMaxModelTemplates(int max) {
+        if (max < 1) {
+            throw new IllegalArgumentException("Expected at least one model template; got " + max);
+        }
+
+        maxModelTemplates = max;
+        evictModelTemplates();
+    }
+
+    /**
+     * Returns the number of times a server certificate had to be encoded
+     * and hashed to look up its model SSL PRFileDesc; engines reusing a
+     * certificate object reuse its fingerprint instead.
+     */
+    public static long getCertFingerprintCount() {
+        return certFingerprintCount.sum();
+    }
+
+    /**
+     * Returns the number of engines which found their model SSL
+     * PRFileDesc in the cache.
+     */
+    public static long getModelTemplateHits() {
+        return modelTemplateHits.sum();
+    }
+
+    /**
+     * Returns the number of engines which had to compile their model SSL
+     * PRFileDesc.
+     */
+    public static long getModelTemplateMisses() {
+        return modelTemplateMisses.sum();
+    }
+
+    /**
+     * Returns the number of peer certificate validations run by all
+     * engines.
+     */
+    public static long getValidationCount() {
+        return validationCount.sum();
+    }
+
+    /**
+     * Returns the total time, in nanoseconds, peer certificate validations
+     * spent waiting to run, either in the validation Executor's queue or
+     * for the caller to run the delegated task.
+     */
+    public static long getValidationQueueTime() {
+        return validationQueueTime.sum();
+    }
+
+    /**
+     * Returns the longest time, in nanoseconds, a single peer certificate
+     * validation spent waiting to run.
+     */
+    public static long getValidationMaxQueueTime() {
+        return validationMaxQueueTime.get();
+    }
+
+    /**
+     * Returns the total time, in nanoseconds, spent running TrustManagers
+     * to validate peer certificates.
+     */
+    public static long getValidationRunTime() {
+        return validationRunTime.sum();
+    }
+
+    /**
+     * Returns the longest time, in nanoseconds, a single peer certificate
+     * validation spent running TrustManagers.
+     */
+    public static long getValidationMaxRunTime() {
+        return validationMaxRunTime.get();
     }
 
     /**
@@ -8,6 +8,9 @@ import java.nio.channels.WritableByteChannel;
 import java.nio.channels.Channels;
 import java.security.PublicKey;
 import java.nio.ByteBuffer;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.Executor;
+import java.util.concurrent.RejectedExecutionException;
 
 import javax.net.ssl.*;
 
@@ -60,6 +63,17 @@ public class JSSEngineReferenceImpl extends JSSEngine {
      */
     private BufferProxy write_buf;
 
+    /**
+     * Maximum capacity of write_buf, fixed when it is created.
+     */
+    private int write_buf_capacity;
+
+    /**
+     * Outcome of the last SSL.WrapStep or SSL.UnwrapStep call; reused
+     * across steps.
+     */
+    private SSLStepResult step_result = new SSLStepResult();
+
     /**
      * Number of times heuristic has not matched the current state.
      *
@@ -132,6 +146,12 @@ public class JSSEngineReferenceImpl extends JSSEngine {
      */
     private CertValidationTask task;
 
+    /**
+     * Whether cleanup() found task still running on the validation
+     * executor, leaving it to close ssl_fd once the task finishes.
+     */
+    private boolean close_after_validation;
+
     public JSSEngineReferenceImpl() {
         super();
 
@@ -239,18 +259,14 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         createBuffers();
         createBufferFD();
 
-        // Initialize the appropriate end of this connection.
+        // Initialize the appropriate end of this connection. The requested
+        // cipher suites, protocols, and options came with the model.
         if (as_server) {
             initServer();
         } else {
             initClient();
         }
 
-        // Apply the requested cipher suites and protocols.
-        applyProtocols();
-        applyCiphers();
-        applyConfig();
-
         // Apply hostname information (via setURL). Note that this is an
         // extension to SSLEngine for use with NSS; we don't always get this
         // information and so need to work around it sometimes. See
@@ -269,21 +285,37 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         debug("JSSEngine: createBuffers()");
 
         // If the buffers exist, destroy them and then recreate them.
+        //
+        // Both are elastic: they start out as a single BUFFER_SIZE chunk
+        // and grow as needed, so that a whole TLS record can cross in one
+        // wrap or unwrap call. The read side only needs to hold records up
+        // to the record_size_limit we advertise to the peer. We don't learn
+        // the peer's limit until the handshake completes, so the write side
+        // is sized for the largest record TLS allows.
 
         if (read_buf != null) {
             Buffer.Free(read_buf);
         }
-        read_buf = Buffer.Create(BUFFER_SIZE);
+        read_buf = Buffer.CreateElastic(BUFFER_SIZE, getMaxBufferSize(getInboundRecordLimit()));
 
         if (write_buf != null) {
             Buffer.Free(write_buf);
         }
-        write_buf = Buffer.Create(BUFFER_SIZE);
+        write_buf = Buffer.CreateElastic(BUFFER_SIZE, getMaxBufferSize(MAX_RECORD_PLAINTEXT));
+        write_buf_capacity = (int) Buffer.Capacity(write_buf);
     }
 
     private void createBufferFD() throws SSLException {
         debug("JSSEngine: createBufferFD()");
 
+        // As a performance improvement, we copy a model socket with our
+        // cipher suites, protocols, options, and (as a server) key and
+        // certificate already applied, rather than applying them from
+        // scratch. This saves a significant amount of time during
+        // construction. The implementation lives in JSSEngine, to be shared
+        // by all other JSSEngine implementations.
+        ModelParameters params = getModelParameters();
+
         // Create the basis for the ssl_fd from the pair of buffers we created
         // above.
 
@@ -300,18 +332,14 @@ public class JSSEngineReferenceImpl extends JSSEngine {
             throw new SSLException("Error creating buffer-backed PRFileDesc.");
         }
 
-        SSLFDProxy model = null;
-        if (as_server) {
-            // As a performance improvement, we can copy the server template
-            // (containing the desired key and certificate) rather than
-            // re-creating it from scratch. This saves a significant amount of
-            // time during construction. The implementation lives in JSSEngine,
-            // to be shared by all other JSSEngine implementations.
-            model = getServerTemplate(cert, key);
+        // Initialize ssl_fd from the model Buffer-backed PRFileDesc.
+        try {
+            ssl_fd = importFromModel(params, fd);
+        } catch (SSLException e) {
+            PR.Close(fd);
+            throw e;
         }
 
-        // Initialize ssl_fd from the model Buffer-backed PRFileDesc.
-        ssl_fd = SSL.ImportFD(model, fd);
         if (ssl_fd == null) {
             PR.Close(fd);
             throw new SSLException("Error creating SSL socket on top of buffer-backed PRFileDesc.");
@@ -389,8 +417,6 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         //
         // TODO: Make this configurable.
         initializeSessionCache(1, 100, null);
-
-        configureClientAuth();
     }
 
     private void configureClientAuth() throws SSLException {
@@ -431,73 +457,6 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         }
     }
 
-    private void applyCiphers() throws SSLException {
-        debug("JSSEngine: applyCiphers()");
-        // Enabled the ciphersuites specified by setEnabledCipherSuites(...).
-        // When this isn't called, enabled_ciphers will be null, so we'll just
-        // use whatever is enabled by default.
-        if (enabled_ciphers == null) {
-            return;
-        }
-
-        // We need to disable the suite if it isn't present in the list of
-        // suites above. Be lazy about it for the time being and disable all
-        // cipher suites first.
-        for (SSLCipher suite : SSLCipher.values()) {
-            if (SSL.CipherPrefSet(ssl_fd, suite.getID(), false) == SSL.SECFailure) {
-                // warn("Unable to set cipher suite preference for " + suite.name() + ": " + errorText(PR.GetError()));
-            }
-        }
-
-        // Only enable these particular suites. When a cipher suite can't be
-        // enabled it is most likely due to local policy. Log it. Also log
-        // which ciphers were successfully enabled for debugging purposes.
-        for (SSLCipher suite : enabled_ciphers) {
-            if (suite == null) {
-                continue;
-            }
-
-            if (SSL.CipherPrefSet(ssl_fd, suite.getID(), true) == SSL.SECFailure) {
-                warn("Unable to enable cipher suite " + suite + ": " + errorText(PR.GetError()));
-            } else {
-                debug("Enabled cipher suite " + suite + ": " + errorText(PR.GetError()));
-            }
-        }
-    }
-
-    private void applyProtocols() throws SSLException {
-        debug("JSSEngine: applyProtocols() min_protocol=" + min_protocol + " max_protocol=" + max_protocol);
-        // Enable the protocols only when both a maximum and minimum protocol
-        // version are specified.
-        if (min_protocol == null || max_protocol == null) {
-            debug("JSSEngine: applyProtocols() - missing min_protocol or max_protocol; using defaults");
-            return;
-        }
-
-        // We should bound this range by crypto-policies in the future to
-        // match the current behavior. However, Tomcat already bounds
-        // what we set in the server.xml config by what the JSSEngine
-        // indicates it supports. Because we only indicate we support
-        // what is allowed under crypto-policies, it effective does
-        // this bounding for us.
-        SSLVersionRange vrange = new SSLVersionRange(min_protocol, max_protocol);
-        if (SSL.VersionRangeSet(ssl_fd, vrange) == SSL.SECFailure) {
-            throw new SSLException("Unable to set version range: " + errorText(PR.GetError()));
-        }
-    }
-
-    private void applyConfig() throws SSLException {
-        debug("JSSEngine: applyConfig()");
-        for (Integer key : config.keySet()) {
-            Integer value = config.get(key);
-
-            debug("Setting configuration option: " + key + "=" + value);
-            if (SSL.OptionSet(ssl_fd, key, value) != SSL.SECSuccess) {
-                throw new SSLException("Unable to set configuration value: " + key + "=" + value);
-            }
-        }
-    }
-
     private void applyHosts() throws SSLException {
         debug("JSSEngine: applyHosts()");
 
@@ -603,7 +562,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public void beginHandshake() throws SSLException {
+    public synchronized void beginHandshake() throws SSLException {
         debug("JSSEngine: beginHandshake()");
 
         // We assume beginHandshake(...) is the entry point for initializing
@@ -693,7 +652,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public void closeInbound() {
+    public synchronized void closeInbound() {
         debug("JSSEngine: closeInbound()");
 
         if (!is_inbound_closed && ssl_fd != null && !closed_fd) {
@@ -707,7 +666,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public void closeOutbound() {
+    public synchronized void closeOutbound() {
         debug("JSSEngine: closeOutbound()");
 
         if (!is_outbound_closed && ssl_fd != null && !closed_fd) {
@@ -725,7 +684,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public Runnable getDelegatedTask() {
+    public synchronized Runnable getDelegatedTask() {
         debug("JSSEngine: getDelegatedTask()");
 
         // task can either contain a task instance or null; task gets
@@ -741,6 +700,15 @@ public class JSSEngineReferenceImpl extends JSSEngine {
             checkNeedCertValidation();
         }
 
+        // A task submitted to the validation executor is already running
+        // elsewhere. Returning null would tell the caller there's nothing
+        // left to do while we still report NEED_TASK; hand out a task which
+        // waits for validation to finish instead.
+        if (task != null && task.submitted) {
+            CertValidationTask pending = task;
+            return pending::awaitCompletion;
+        }
+
         return task;
     }
 
@@ -754,29 +722,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
                 return true;
             }
 
-            debug("JSSEngine: checkNeedCertValidation() - task done with code " + task.result);
-
-            // Since the task has finished, we now need to inform NSS about
-            // the results of our certificate validation step.
-            if (SSL.AuthCertificateComplete(ssl_fd, task.result) != SSL.SECSuccess) {
-                String msg = "Got unexpected failure finishing cert ";
-                msg += "authentication in NSS. Returned code ";
-                msg += task.result;
-                throw new RuntimeException(msg);
-            }
-
-            // After checking certificates, our best guess will be that we
-            // need to run wrap again. This is because we either need to
-            // inform the caller of an error that occurred, or continue the
-            // handshake. Worst case, we'll call updateHandshakeState() and
-            // it'll correct our mistake eventually.
-
-            debug("JSSEngine: checkNeedCertValidation() - task done, removing");
-
-            task = null;
-            handshake_state = SSLEngineResult.HandshakeStatus.NEED_WRAP;
-            ssl_fd.needCertValidation = false;
-
+            completeCertValidation();
             return false;
         }
 
@@ -799,15 +745,105 @@ public class JSSEngineReferenceImpl extends JSSEngine {
 
         // OK, time to create our runnable task.
         task = new CertValidationTask(ssl_fd);
+        task.requested = System.nanoTime();
 
         // Update our handshake state so we know what to do next.
         handshake_state = SSLEngineResult.HandshakeStatus.NEED_TASK;
 
-        return true;
+        submitCertValidation();
+
+        // A direct Executor could have already run the task to completion,
+        // in which case the handshake can continue right away.
+        return task != null;
+    }
+
+    private void completeCertValidation() {
+        debug("JSSEngine: completeCertValidation() - task done with code " + task.result);
+
+        // Since the task has finished, we now need to inform NSS about
+        // the results of our certificate validation step.
+        if (SSL.AuthCertificateComplete(ssl_fd, task.result) != SSL.SECSuccess) {
+            String msg = "Got unexpected failure finishing cert ";
+            msg += "authentication in NSS. Returned code ";
+            msg += task.result;
+            throw new RuntimeException(msg);
+        }
+
+        // After checking certificates, our best guess will be that we
+        // need to run wrap again. This is because we either need to
+        // inform the caller of an error that occurred, or continue the
+        // handshake. Worst case, we'll call updateHandshakeState() and
+        // it'll correct our mistake eventually.
+
+        debug("JSSEngine: completeCertValidation() - task done, removing");
+
+        task = null;
+        handshake_state = SSLEngineResult.HandshakeStatus.NEED_WRAP;
+        ssl_fd.needCertValidation = false;
+    }
+
+    private void submitCertValidation() {
+        Executor executor = validation_executor;
+        if (executor == null) {
+            return;
+        }
+
+        // Only the TrustManagers run on the executor; the result is passed
+        // back to NSS under this engine's lock, so that it doesn't race
+        // with wrap() or unwrap() driving ssl_fd.
+        CertValidationTask validation = task;
+        validation.submitted = true;
+
+        try {
+            executor.execute(() -> {
+                try {
+                    validation.run();
+                    finishSubmittedValidation(validation);
+                } finally {
+                    validation.completed.countDown();
+                }
+            });
+        } catch (RejectedExecutionException ree) {
+            debug("JSSEngine: submitCertValidation() - rejected by executor, delegating instead: " + ree.getMessage());
+            validation.submitted = false;
+        }
+    }
+
+    private synchronized void finishSubmittedValidation(CertValidationTask validation) {
+        if (close_after_validation) {
+            // We were closed while the TrustManagers ran; there's no
+            // handshake left to continue.
+            debug("JSSEngine: finishSubmittedValidation() - engine closed, cleaning up");
+            close_after_validation = false;
+            task = null;
+            cleanupSSLFD();
+            return;
+        }
+
+        if (task != validation || ssl_fd == null || closed_fd) {
+            // wrap(), unwrap(), or another caller already noticed the task
+            // finishing and passed the result to NSS.
+            return;
+        }
+
+        try {
+            completeCertValidation();
+        } catch (RuntimeException re) {
+            // There's no caller to throw to from the executor; clear the
+            // task so the next wrap() or unwrap() reports the failure.
+            task = null;
+            handshake_state = SSLEngineResult.HandshakeStatus.NEED_WRAP;
+            ssl_fd.needCertValidation = false;
+
+            if (!seen_exception) {
+                seen_exception = true;
+                ssl_exception = new SSLHandshakeException(re.getMessage());
+            }
+        }
     }
 
     @Override
-    public SSLEngineResult.HandshakeStatus getHandshakeStatus() {
+    public synchronized SSLEngineResult.HandshakeStatus getHandshakeStatus() {
         debug("JSSEngine: getHandshakeStatus()");
 
         // If task is NULL, we need to update the state to check if the
@@ -888,48 +924,26 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         return result;
     }
 
-    private int putData(byte[] data, ByteBuffer[] buffers, int offset, int length) {
-        debug("JSSEngine: putData()");
-        // Handle the rather unreasonable task of moving data into the buffers.
-        // We assume the buffer parameters have already been checked by
-        // computeSize(...); that is, offset/length contracts hold and that
-        // each buffer in the range is non-null.
-        //
-        // We also assume that data.length does not exceed the total number
-        // of bytes the buffers can hold; this is what computeSize(...)'s
-        // return value should ensure. This directly means that the inner
-        // while loop won't exceed the bounds of offset+length.
-
-        int buffer_index = offset;
-        int data_index = 0;
-
-        if (data == null || buffers == null) {
-            return data_index;
+    private ByteBuffer nextBuffer(ByteBuffer[] buffers, int offset, int length) {
+        // Find the first buffer with space remaining, if any. We assume the
+        // buffer parameters have already been checked by computeSize(...);
+        // that is, offset/length contracts hold and that each buffer in the
+        // range is non-null, unless the first one is.
+        if (buffers == null) {
+            return null;
         }
 
-        for (data_index = 0; data_index < data.length;) {
-            // Ensure we have have a buffer with capacity.
-            while ((buffers[buffer_index] == null || buffers[buffer_index].remaining() <= 0) &&
-                    (buffer_index < offset + length)) {
-                buffer_index += 1;
-            }
-            if (buffer_index >= offset + length) {
-                break;
+        for (int index = offset; index < offset + length; index++) {
+            if (buffers[index] == null) {
+                return null;
             }
 
-            // Compute the size of the put: it is the minimum of the space
-            // remaining in this buffer and the bytes remaining in the data
-            // array.
-            int put_size = buffers[buffer_index].remaining();
-            if (put_size > (data.length - data_index)) {
-                put_size = data.length - data_index;
+            if (buffers[index].hasRemaining()) {
+                return buffers[index];
             }
-
-            buffers[buffer_index].put(data, data_index, put_size);
-            data_index += put_size;
         }
 
-        return data_index;
+        return null;
     }
 
     private SSLException checkSSLAlerts() {
@@ -979,12 +993,36 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     private void updateHandshakeState() {
         debug("JSSEngine: updateHandshakeState()");
 
+        if (!needHandshakeStep()) {
+            return;
+        }
+
+        step_result.handshakeResult = SSL.ForceHandshake(ssl_fd);
+        step_result.handshakeError = 0;
+        if (step_result.handshakeResult == SSL.SECFailure) {
+            step_result.handshakeError = PR.GetError();
+        }
+
+        step_result.readPending = (int) Buffer.ReadCapacity(read_buf);
+        step_result.writePending = (int) Buffer.ReadCapacity(write_buf);
+
+        finishHandshakeStep(step_result);
+    }
+
+    /**
+     * First half of updateHandshakeState(): updates our handshake state
+     * for as long as the handshake doesn't need to be stepped, returning
+     * whether or not it does. The wrap and unwrap loops step the handshake
+     * as part of SSL.WrapStep and SSL.UnwrapStep, and then call
+     * finishHandshakeStep(...) with the result.
+     */
+    private boolean needHandshakeStep() {
         // If we've previously seen an exception, we should just return
         // here; there's already an alert on the wire, so there's no point
         // in checking for new ones and/or stepping the handshake: it has
         // already failed.
         if (seen_exception) {
-            return;
+            return false;
         }
 
         // If we're already done, we should check for SSL ALerts.
@@ -994,7 +1032,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
 
             ssl_exception = checkSSLAlerts();
             seen_exception = (ssl_exception != null);
-            return;
+            return false;
         }
 
         // If we've previously finished handshaking, then move to
@@ -1017,14 +1055,22 @@ public class JSSEngineReferenceImpl extends JSSEngine {
 
             ssl_exception = checkSSLAlerts();
             seen_exception = (ssl_exception != null);
-            return;
+            return false;
         }
 
         // Since we're not obviously done handshaking, and the last time we
         // were called, we were still handshaking, step the handshake.
         debug("JSSEngine.updateHandshakeState() - forcing handshake");
-        if (SSL.ForceHandshake(ssl_fd) == SSL.SECFailure) {
-            int error_value = PR.GetError();
+        return true;
+    }
+
+    /**
+     * Second half of updateHandshakeState(): updates our handshake state
+     * from the result of stepping the handshake.
+     */
+    private void finishHandshakeStep(SSLStepResult step) {
+        if (step.handshakeResult == SSL.SECFailure) {
+            int error_value = step.handshakeError;
 
             if (error_value != PRErrors.WOULD_BLOCK_ERROR) {
                 debug("JSSEngine.updateHandshakeState() - FATAL " + getStatus());
@@ -1038,13 +1084,13 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         }
 
         // Check if we've just finished handshaking.
-        debug("JSSEngine.updateHandshakeState() - read_buf.read=" + Buffer.ReadCapacity(read_buf) + " read_buf.write=" + Buffer.WriteCapacity(read_buf) + " write_buf.read=" + Buffer.ReadCapacity(write_buf) + " write_buf.write=" + Buffer.WriteCapacity(write_buf));
+        debug("JSSEngine.updateHandshakeState() - read_buf.read=" + step.readPending + " write_buf.read=" + step.writePending);
 
         // Set NEED_WRAP when we have data to send to the client.
-        if (Buffer.ReadCapacity(write_buf) > 0 && handshake_state != SSLEngineResult.HandshakeStatus.NEED_WRAP) {
+        if (step.writePending > 0 && handshake_state != SSLEngineResult.HandshakeStatus.NEED_WRAP) {
             // Can't write; to read, we need to call wrap to provide more
             // data to write.
-            debug("JSSEngine.updateHandshakeState() - can write " + Buffer.ReadCapacity(write_buf) + " bytes, NEED_WRAP to process");
+            debug("JSSEngine.updateHandshakeState() - can write " + step.writePending + " bytes, NEED_WRAP to process");
             handshake_state = SSLEngineResult.HandshakeStatus.NEED_WRAP;
             unknown_state_count = 0;
             return;
@@ -1057,7 +1103,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         // (according to SecurityStatusResult since it has sent the massage)
         // but we haven't yet gotten around to doing so if we're in a WRAP()
         // call.
-        if (ssl_fd.handshakeComplete && Buffer.ReadCapacity(write_buf) == 0) {
+        if (ssl_fd.handshakeComplete && step.writePending == 0) {
             debug("JSSEngine.updateHandshakeState() - handshakeComplete is " + ssl_fd.handshakeComplete + ", so we've just finished handshaking");
             step_handshake = false;
             handshake_state = SSLEngineResult.HandshakeStatus.FINISHED;
@@ -1082,9 +1128,9 @@ public class JSSEngineReferenceImpl extends JSSEngine {
             return;
         }
 
-        if (Buffer.ReadCapacity(read_buf) == 0 && handshake_state != SSLEngineResult.HandshakeStatus.NEED_UNWRAP) {
+        if (step.readPending == 0 && handshake_state != SSLEngineResult.HandshakeStatus.NEED_UNWRAP) {
             // Set NEED_UNWRAP when we have no data to read from the client.
-            debug("JSSEngine.updateHandshakeState() - can read " + Buffer.ReadCapacity(read_buf) + " bytes, NEED_UNWRAP to give us more");
+            debug("JSSEngine.updateHandshakeState() - can read " + step.readPending + " bytes, NEED_UNWRAP to give us more");
             handshake_state = SSLEngineResult.HandshakeStatus.NEED_UNWRAP;
             unknown_state_count = 0;
             return;
@@ -1131,7 +1177,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public SSLEngineResult unwrap(ByteBuffer src, ByteBuffer[] dsts, int offset, int length) throws IllegalArgumentException, SSLException {
+    public synchronized SSLEngineResult unwrap(ByteBuffer src, ByteBuffer[] dsts, int offset, int length) throws IllegalArgumentException, SSLException {
         debug("JSSEngine: unwrap(ssl_fd=" + ssl_fd + ")");
 
         // In this method, we're taking the network wire contents of src and
@@ -1184,37 +1230,35 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         int this_src_write;
         int this_dst_write;
 
-        do {
-            this_src_write = 0;
-            this_dst_write = 0;
+        // Validate dsts once up front; each step fills the first of them
+        // with space remaining.
+        computeSize(dsts, offset, length);
 
-            if (src != null) {
-                this_src_write = Math.min((int) Buffer.WriteCapacity(read_buf), src.remaining());
+        do {
+            // Each step crosses into native code once: it copies wire data
+            // from src into read_buf, steps the handshake if we still need
+            // to (see updateHandshakeState()), and reads application data
+            // out of ssl_fd into dst.
+            ByteBuffer dst = nextBuffer(dsts, offset, length);
+            boolean step_handshake = needHandshakeStep();
 
-                // When we have data from src, write it to read_buf.
-                if (this_src_write > 0) {
-                    byte[] wire_buffer = new byte[this_src_write];
-                    src.get(wire_buffer);
+            SSL.UnwrapStep(ssl_fd, read_buf, write_buf, src, dst, step_handshake, step_result);
 
-                    this_src_write = (int) Buffer.Write(read_buf, wire_buffer);
+            this_src_write = step_result.consumed;
+            if (this_src_write > 0) {
+                wire_data += this_src_write;
+                debug("JSSEngine.unwrap(): Wrote " + this_src_write + " bytes to read_buf.");
+            }
 
-                    wire_data += this_src_write;
-                    debug("JSSEngine.unwrap(): Wrote " + this_src_write + " bytes to read_buf.");
-                }
+            if (step_handshake) {
+                finishHandshakeStep(step_result);
             }
 
-            // In the above, we should always try to read and write data. Check to
-            // see if we need to step our handshake process or not.
-            updateHandshakeState();
-
-            int max_dst_size = computeSize(dsts, offset, length);
-            byte[] app_buffer = PR.Read(ssl_fd, max_dst_size);
-            int error = PR.GetError();
-            debug("JSSEngine.unwrap() - " + app_buffer + " error=" + errorText(error));
-            if (app_buffer != null) {
-                this_dst_write = putData(app_buffer, dsts, offset, length);
-                app_data += this_dst_write;
-            } else if (max_dst_size > 0) {
+            this_dst_write = Math.max(step_result.produced, 0);
+            app_data += this_dst_write;
+
+            int error = step_result.error;
+            if (this_dst_write == 0 && dst != null) {
                 // There are two scenarios we need to ignore here:
                 //  1. WOULD_BLOCK_ERRORs are safe, because we're expecting
                 //     not to block. Usually this means we don't have space
@@ -1273,104 +1317,29 @@ public class JSSEngineReferenceImpl extends JSSEngine {
         return new SSLEngineResult(handshake_status, handshake_state, wire_data, app_data);
     }
 
-    public int writeData(ByteBuffer[] srcs, int offset, int length) {
-        debug("JSSEngine: writeData()");
-        // This is the tough end of reading/writing. There's two potential
-        // places buffering could occur:
-        //
-        //  - Inside the NSS library (unclear if this happens).
-        //  - write_buf
-        //
-        // So when we call PR.Write(ssl_fd, data), it isn't guaranteed that
-        // we can write all of data to ssl_fd (unlike with all our other read
-        // or write operations where we have a clear bound). In the event that
-        // our Write call is truncated, we have to put data back into the
-        // buffer from whence it was read.
-        //
-        // However, we do use Buffer.WriteCapacity(write_buf) as a proxy
-        // metric for how much we can write without having to place data back
-        // in a src buffer.
-        //
-        // When we don't perform an actual NSPR write call, make a dummy
-        // invocation to ensure we always attempt to flush these buffers.
-        int data_length = 0;
-
-        int index = offset;
-        int max_index = offset + length;
-
-        boolean attempted_write = false;
-
-        while (index < max_index) {
-            // If we don't have any remaining bytes in this buffer, skip it.
-            if (srcs[index] == null || srcs[index].remaining() <= 0) {
-                index += 1;
-                continue;
-            }
-            debug("JSSEngine.writeData(): index=" + index + " max_index=" + max_index);
-
-            // We expect (i.e., need to construct a buffer) to write up to
-            // this much. Note that this is non-zero since we're taking the
-            // max here and we guarantee with the previous statement that
-            // srcs[index].remaining() > 0. There's no point in getting more
-            // than BUFFER_SIZE bytes either; so cap at the minimum of the
-            // two sizes.
-            int expected_write = Math.min(srcs[index].remaining(), BUFFER_SIZE);
-            debug("JSSEngine.writeData(): expected_write=" + expected_write + " write_cap=" + Buffer.WriteCapacity(write_buf) + " read_cap=" + Buffer.ReadCapacity(read_buf));
-
-            // Get data from our current srcs[index] buffer.
-            byte[] app_data = new byte[expected_write];
-            srcs[index].get(app_data);
-
-            // Actual amount written. Since this is a PR.Write call, mark
-            // attempted_write.
-            int this_write = PR.Write(ssl_fd, app_data);
-            attempted_write = true;
-
-            // Reset our buffer's position in event of sub-optimal write.
-            if (this_write < expected_write) {
-                int pos = srcs[index].position();
-
-                // When this_write < 0, we want to reset to the beginning
-                // because we assume we haven't written any data due to an
-                // error before writing.
-                int delta = expected_write - Math.max(0, this_write);
-
-                srcs[index].position(pos - delta);
-            }
-
-            debug("JSSEngine.writeData(): this_write=" + this_write);
-            if (this_write < 0) {
-                int error = PR.GetError();
-                if (error == PRErrors.SOCKET_SHUTDOWN_ERROR) {
-                    debug("NSPR reports outbound socket is shutdown.");
-                    is_outbound_closed = true;
-                } else if (error != PRErrors.WOULD_BLOCK_ERROR) {
-                    throw new RuntimeException("Unable to write to internal ssl_fd: " + errorText(PR.GetError()));
-                }
-
-                break;
+    private int checkWriteResult(SSLStepResult step) {
+        // SSL.WrapStep hands all of srcs to NSS in a single PR_Writev
+        // call, but NSS isn't guaranteed to accept all of it (unlike with
+        // all our other read or write operations where we have a clear
+        // bound): write_buf might fill up first. The positions of the
+        // source buffers only advance by the amount NSS actually accepted,
+        // so a truncated write leaves the rest of the data in place for the
+        // next step.
+        int data_length = step.consumed;
+
+        debug("JSSEngine.checkWriteResult(): this_write=" + data_length);
+        if (data_length < 0) {
+            int error = step.error;
+            if (error == PRErrors.SOCKET_SHUTDOWN_ERROR) {
+                debug("NSPR reports outbound socket is shutdown.");
+                is_outbound_closed = true;
+            } else if (error != PRErrors.WOULD_BLOCK_ERROR) {
+                throw new RuntimeException("Unable to write to internal ssl_fd: " + errorText(error));
             }
 
-            data_length += this_write;
-
-            if (this_write < expected_write) {
-                // If we didn't get an error but we got less than our expected
-                // write, it is best to exit to give us time to drain the
-                // buffers before attempting another write. We're guaranteed
-                // to be called again because we wrote a non-zero amount here.
-                break;
-            }
+            data_length = 0;
         }
 
-        // When we didn't call PR.Write, invoke a dummy call to PR.Write to
-        // ensure we always attempt to write to push data from NSS's internal
-        // buffers into our network buffers.
-        if (!attempted_write) {
-            PR.Write(ssl_fd, null);
-        }
-
-        debug("JSSEngine.writeData(): data_length=" + data_length);
-
         return data_length;
     }
 
@@ -1406,7 +1375,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     @Override
-    public SSLEngineResult wrap(ByteBuffer[] srcs, int offset, int length, ByteBuffer dst) throws IllegalArgumentException, SSLException {
+    public synchronized SSLEngineResult wrap(ByteBuffer[] srcs, int offset, int length, ByteBuffer dst) throws IllegalArgumentException, SSLException {
         debug("JSSEngine: wrap(ssl_fd=" + ssl_fd + ")");
         // In this method, we're taking the application data from the various
         // srcs and writing it to the remote peer (via ssl_fd). If there's any
@@ -1460,14 +1429,33 @@ public class JSSEngineReferenceImpl extends JSSEngine {
             closeOutbound();
         }
 
+        checkRecordIdle();
+
         int this_src_write;
         int this_dst_write;
         do {
             this_src_write = 0;
             this_dst_write = 0;
 
-            // First we try updating the handshake state.
-            updateHandshakeState();
+            // Each step crosses into native code once: it steps the
+            // handshake if we still need to (see updateHandshakeState()),
+            // writes data from srcs to ssl_fd, and copies whatever NSS
+            // wrote to write_buf into dst. There's no point in gathering
+            // more than write_buf can hold; with dynamic record sizing, we
+            // gather only a small record's worth at a time, and NSS writes
+            // each step's data as a single record.
+            //
+            // Note that we always attempt the write, even if the handshake
+            // isn't yet marked as finished. This is because we need the
+            // call to PR.Write(...) to tell if an alert is getting sent.
+            boolean step_handshake = needHandshakeStep();
+            int record_size = getRecordSize(write_buf_capacity);
+            SSL.WrapStep(ssl_fd, read_buf, write_buf, srcs, offset, length, record_size, dst, step_handshake, step_result);
+
+            if (step_handshake) {
+                finishHandshakeStep(step_result);
+            }
+
             if (ssl_exception == null && seen_exception) {
                 if (handshake_state != SSLEngineResult.HandshakeStatus.NOT_HANDSHAKING) {
                     // In the event that:
@@ -1489,36 +1477,25 @@ public class JSSEngineReferenceImpl extends JSSEngine {
                 }
             }
 
-            // Try writing data from srcs to the other end of the connection. Note
-            // that we always attempt this, even if the handshake isn't yet marked
-            // as finished. This is because we need the call to PR.Write(...) to
-            // tell if an alert is getting sent.
-            this_src_write = writeData(srcs, offset, length);
+            this_src_write = checkWriteResult(step_result);
             if (this_src_write > 0) {
                 app_data += this_src_write;
+                recordSent(this_src_write);
                 debug("JSSEngine.wrap(): wrote " + this_src_write + " from srcs to buffer.");
             } else {
                 debug("JSSEngine.wrap(): not writing from srcs to buffer: this_src_write=" + this_src_write);
             }
 
-            if (dst != null) {
-                // Get an estimate for the expected write to dst; this is
-                // the minimum of write_buf read capacity and dst.remaining
-                // capacity.
-                this_dst_write = Math.min((int) Buffer.ReadCapacity(write_buf), dst.remaining());
-
-                // Try reading data from write_buf to dst; always do this, even
-                // if we didn't write.
-                if (this_dst_write > 0) {
-                    byte[] wire_buffer = Buffer.Read(write_buf, this_dst_write);
-                    dst.put(wire_buffer);
-                    this_dst_write = wire_buffer.length;
-                    wire_data += this_dst_write;
-
-                    debug("JSSEngine.wrap() - Wrote " + wire_buffer.length + " bytes to dst.");
-                } else {
-                    debug("JSSEngine.wrap(): not writing from write_buf into dst: this_dst_write=0 write_buf.read_capacity=" + Buffer.ReadCapacity(write_buf) + " dst.remaining=" + dst.remaining());
-                }
+            // The step always reads data from write_buf to dst, even if we
+            // didn't write. The amount read is the minimum of write_buf's
+            // read capacity and dst.remaining().
+            this_dst_write = step_result.produced;
+            if (this_dst_write > 0) {
+                wire_data += this_dst_write;
+
+                debug("JSSEngine.wrap() - Wrote " + this_dst_write + " bytes to dst.");
+            } else if (dst != null) {
+                debug("JSSEngine.wrap(): not writing from write_buf into dst: this_dst_write=0 dst.remaining=" + dst.remaining());
             } else {
                 debug("JSSEngine.wrap(): not writing from write_buf into NULL dst");
             }
@@ -1592,7 +1569,7 @@ public class JSSEngineReferenceImpl extends JSSEngine {
      * data streams if still open.
      */
     @Override
-    public void cleanup() {
+    public synchronized void cleanup() {
         debug("JSSEngine: cleanup()");
 
         if (!is_inbound_closed) {
@@ -1635,6 +1612,14 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     private void cleanupSSLFD() {
+        if (task != null && task.submitted && !task.finished) {
+            // The validation executor is still reading the peer's
+            // certificates from ssl_fd; it'll call back here when done.
+            debug("JSSEngine: cleanupSSLFD() - deferring until validation finishes");
+            close_after_validation = true;
+            return;
+        }
+
         if (!closed_fd && ssl_fd != null) {
             try {
                 SSL.RemoveCallbacks(ssl_fd);
@@ -1659,10 +1644,43 @@ public class JSSEngineReferenceImpl extends JSSEngine {
     }
 
     private class CertValidationTask extends CertAuthHandler {
+        /**
+         * System.nanoTime() when NSS asked for validation, or zero when
+         * NSS runs it synchronously.
+         */
+        public long requested;
+
+        /**
+         * Whether this task was submitted to the validation executor,
+         * rather than handed out via getDelegatedTask().
+         */
+        public boolean submitted;
+
+        /**
+         * Counted down once a submitted task has run and its result has
+         * been passed to NSS.
+         */
+        public final CountDownLatch completed = new CountDownLatch(1);
+
         public CertValidationTask(SSLFDProxy fd) {
             super(fd);
         }
 
+        /**
+         * Blocks until this submitted task has completed; this is the
+         * task getDelegatedTask() hands out while it runs on the
+         * validation executor.
+         */
+        public void awaitCompletion() {
+            try {
+                completed.await();
+            } catch (InterruptedException ie) {
+                // Let the caller notice the interruption; the handshake
+                // status still reports NEED_TASK until validation ends.
+                Thread.currentThread().interrupt();
+            }
+        }
+
         public String findAuthType(SSLFDProxy ssl_fd, PK11Cert[] chain) throws Exception {
             // Java's CryptoManager is supposed to validate that the auth type
             // chosen by the underlying protocol is compatible with the
@@ -1736,6 +1754,16 @@ public class JSSEngineReferenceImpl extends JSSEngine {
 
         @Override
         public int check(SSLFDProxy fd) {
+            long started = System.nanoTime();
+            try {
+                return validate(fd);
+            } finally {
+                long queued = requested == 0 ? 0 : started - requested;
+                recordValidation(queued, System.nanoTime() - started);
+            }
+        }
+
+        private int validate(SSLFDProxy fd) {
             // Needs to be available for assignException() below.
             PK11Cert[] chain = null;
 
@@ -15,9 +15,6 @@ import org.mozilla.jss.ssl.*;
 public class JSSSession implements SSLSession, AutoCloseable {
     private JSSEngine parent;
 
-    private int applicationBufferSize;
-    private int packetBufferSize;
-
     private SSLCipher cipherSuite;
     private SSLVersion protocolVersion;
 
@@ -40,12 +37,9 @@ public class JSSSession implements SSLSession, AutoCloseable {
 
     private boolean closed;
 
-    protected JSSSession(JSSEngine engine, int buffer_size) {
+    protected JSSSession(JSSEngine engine) {
         this.parent = engine;
 
-        applicationBufferSize = buffer_size;
-        packetBufferSize = buffer_size;
-
         this.appDataMap = new HashMap<String, Object>();
     }
 
@@ -72,12 +66,14 @@ public class JSSSession implements SSLSession, AutoCloseable {
 
     @Override
     public int getApplicationBufferSize() {
-        return applicationBufferSize;
+        // The most plaintext a single record from our peer can carry.
+        return parent.getInboundRecordLimit();
     }
 
     @Override
     public int getPacketBufferSize() {
-        return packetBufferSize;
+        // The largest protected record sent in either direction.
+        return JSSEngine.MAX_RECORD_PLAINTEXT + JSSEngine.MAX_RECORD_OVERHEAD;
     }
 
     @Override
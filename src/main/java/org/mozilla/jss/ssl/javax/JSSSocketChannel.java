@@ -49,8 +49,9 @@ public class JSSSocketChannel extends SocketChannel {
         this.writeChannel = writeChannel;
         this.engine = engine;
 
-        this.readBuffer = ByteBuffer.allocate(engine.getSession().getApplicationBufferSize());
-        this.writeBuffer = ByteBuffer.allocate(engine.getSession().getApplicationBufferSize());
+        // Both buffers hold wire data, so they need to fit a whole record.
+        this.readBuffer = ByteBuffer.allocate(engine.getSession().getPacketBufferSize());
+        this.writeBuffer = ByteBuffer.allocate(engine.getSession().getPacketBufferSize());
     }
 
     public JSSSocketChannel(JSSSocket sslSocket, SocketChannel parent, JSSEngine engine) throws IOException {
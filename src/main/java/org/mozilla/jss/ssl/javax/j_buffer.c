@@ -18,6 +18,67 @@ j_buffer *jb_alloc(size_t length) {
     return buf;
 }
 
+static j_chunk *jb_chunk_alloc(size_t chunk_size) {
+    return calloc(1, sizeof(j_chunk) + chunk_size);
+}
+
+static void jb_chunk_free(j_chunk *chunk, size_t chunk_size) {
+    // As with jb_free, clear the chunk in case any sensitive information
+    // was stored in it.
+    memset(chunk->data, 0, chunk_size);
+    free(chunk);
+}
+
+j_buffer *jb_alloc_elastic(size_t chunk_size, size_t max_capacity) {
+    if (chunk_size == 0) {
+        return NULL;
+    }
+
+    j_buffer *buf = calloc(1, sizeof(j_buffer));
+    size_t max_chunks = (max_capacity + chunk_size - 1) / chunk_size;
+    if (max_chunks == 0) {
+        max_chunks = 1;
+    }
+
+    buf->chunk_size = chunk_size;
+    buf->capacity = max_chunks * chunk_size;
+
+    // Always keep a single chunk around, so that an idle buffer can accept
+    // writes without allocating.
+    buf->head = jb_chunk_alloc(chunk_size);
+    buf->tail = buf->head;
+    buf->chunk_count = 1;
+
+    return buf;
+}
+
+bool jb_is_elastic(j_buffer *buf) {
+    return buf != NULL && buf->chunk_size != 0;
+}
+
+j_buffer *jb_alloc_spsc(size_t length) {
+    // Positions are taken modulo the capacity; an empty ring has none.
+    if (length == 0) {
+        return NULL;
+    }
+
+    j_buffer *buf = calloc(1, sizeof(j_buffer));
+    buf->contents = calloc(length, sizeof(uint8_t));
+
+    buf->capacity = length;
+    buf->spsc = true;
+
+    // Nothing has been written or read yet.
+    atomic_init(&buf->spsc_written, 0);
+    atomic_init(&buf->spsc_read, 0);
+
+    return buf;
+}
+
+bool jb_is_spsc(j_buffer *buf) {
+    return buf != NULL && buf->spsc;
+}
+
 size_t jb_capacity(j_buffer *buf) {
     if (buf == NULL) {
         return 0;
@@ -27,6 +88,14 @@ size_t jb_capacity(j_buffer *buf) {
 }
 
 bool jb_can_read(j_buffer *buf) {
+    if (jb_is_elastic(buf)) {
+        return buf->length != 0;
+    }
+
+    if (jb_is_spsc(buf)) {
+        return jb_read_capacity(buf) != 0;
+    }
+
     /* buf->read_pos == buf->capacity <=> can't read from the buffer */
     return buf != NULL && buf->read_pos != buf->capacity;
 }
@@ -36,6 +105,20 @@ size_t jb_read_capacity(j_buffer *buf) {
         return 0;
     }
 
+    if (jb_is_elastic(buf)) {
+        return buf->length;
+    }
+
+    if (jb_is_spsc(buf)) {
+        /* Load spsc_read first: it only ever grows towards spsc_written, so
+         * the difference can't underflow. */
+        size_t read = atomic_load_explicit(&buf->spsc_read,
+                                           memory_order_acquire);
+        size_t written = atomic_load_explicit(&buf->spsc_written,
+                                              memory_order_acquire);
+        return written - read;
+    }
+
     /* Semantics: buf->read_pos == buf->capacity <=> can't read */
     if (buf->read_pos == buf->capacity) {
         return 0;
@@ -58,6 +141,10 @@ size_t jb_read_capacity(j_buffer *buf) {
 }
 
 bool jb_can_write(j_buffer *buf) {
+    if (jb_is_elastic(buf) || jb_is_spsc(buf)) {
+        return jb_write_capacity(buf) != 0;
+    }
+
     /* buf->write_pos == buf->capacity <=> can't write to the buffer */
     return buf != NULL && buf->write_pos != buf->capacity;
 }
@@ -67,6 +154,18 @@ size_t jb_write_capacity(j_buffer *buf) {
         return 0;
     }
 
+    if (jb_is_elastic(buf)) {
+        /* We can fill the rest of the tail chunk, plus any chunks we've yet
+         * to allocate. */
+        size_t max_chunks = buf->capacity / buf->chunk_size;
+        return (buf->chunk_size - buf->tail->end) +
+               (max_chunks - buf->chunk_count) * buf->chunk_size;
+    }
+
+    if (jb_is_spsc(buf)) {
+        return buf->capacity - jb_read_capacity(buf);
+    }
+
     /* Semantics: buf->write_pos == buf->capacity <=> can't write */
     if (buf->write_pos == buf->capacity) {
         return 0;
@@ -94,6 +193,11 @@ int jb_put(j_buffer *buf, uint8_t byte) {
         return EOF;
     }
 
+    if (jb_is_elastic(buf) || jb_is_spsc(buf)) {
+        jb_write(buf, &byte, 1);
+        return byte;
+    }
+
     buf->contents[buf->write_pos] = byte;
 
     if (buf->read_pos == buf->capacity) {
@@ -125,76 +229,43 @@ int jb_put(j_buffer *buf, uint8_t byte) {
 size_t jb_write(j_buffer *buf, const uint8_t *input, size_t input_size) {
     /* ret == 0 <=> can't write to the buffer or input_size == 0 */
     /* ret == amount written <=> can write to the buffer */
-    if (!jb_can_write(buf) || input_size == 0) {
-        return 0;
+    size_t written = 0;
+
+    // The writable region is at most two contiguous spans: from write_pos
+    // up to either read_pos or the end of the buffer, and then from the
+    // head of the buffer up to read_pos. Hence this loop executes at most
+    // twice.
+    while (written < input_size) {
+        size_t span_size = 0;
+        uint8_t *span = jb_peek_write(buf, &span_size);
+        if (span == NULL) {
+            break;
+        }
+
+        if (span_size > input_size - written) {
+            span_size = input_size - written;
+        }
+
+        memcpy(span, input + written, span_size);
+        written += jb_commit(buf, span_size);
     }
 
-    // Quantity we should write in our first batch.
-    size_t write_size = buf->capacity - buf->write_pos;
-
-    // Location (offset from buf->contents) we should write to.
-    uint8_t *write_ptr = buf->contents + buf->write_pos;
-
-    if (buf->read_pos > buf->write_pos) {
-        // When buf->read_pos > buf->write_pos, we know that we are limited
-        // in the quantity we can write by buf->read_pos. (If buf->read_pos <
-        // buf->write_pos, we are not limited and can read up to capacity).
-        // Since we guarantee buf->read_pos <= buf->capacity, this subtraction
-        // will not grow the size written and only shrink it.
-        write_size = buf->read_pos - buf->write_pos;
-    }
-    if (write_size > input_size) {
-        // Since we're limited by the amount we can ultimately write by the
-        // quantity of bytes of input we have, shrink write_size since it was
-        // previously greater than input_size.
-        write_size = input_size;
-    }
+    return written;
+}
 
-    // Note that, sometimes write_size is computed as being smaller than
-    // input_size. This happens when write_pos is towards the end of the
-    // buffer, but read_pos is not at the start. Thus we can write more
-    // bytes than we computed above. To handle this, we call jb_write
-    // again after this pass. In the above we ensure that we always write
-    // at least one byte, so input_size shrinks and buf->write_pos moves.
-    // This ensures we make at most two calls to jb_write and have a recursion
-    // depth of at most two.
+size_t jb_writev(j_buffer *buf, const struct iovec *iov, size_t iov_count) {
+    size_t written = 0;
 
-    // This copies the current byte window from the input to the buffer.
-    memcpy(write_ptr, input, write_size);
+    for (size_t i = 0; i < iov_count; i++) {
+        size_t amount = jb_write(buf, iov[i].iov_base, iov[i].iov_len);
+        written += amount;
 
-    if (buf->read_pos == buf->capacity) {
-        // Since we just wrote bytes, we can now read bytes again.
-        buf->read_pos = buf->write_pos;
+        if (amount < iov[i].iov_len) {
+            break;
+        }
     }
 
-    // Since write_size is bounded above by the difference between
-    // buf->capacity and buf->write_pos, we guarantee that
-    // buf->write_pos <= buf->capacity after adding write_size.
-    buf->write_pos += write_size;
-
-    if (buf->write_pos == buf->capacity && buf->read_pos != 0) {
-        // If we're at capacity but buf->read_pos isn't the start of the
-        // buffer, we can update write_pos to be the head. In this case,
-        // when write_size < input_size, we can write again, hence why we
-        // call jb_write at the end.
-        buf->write_pos = 0;
-    }
-    if (buf->write_pos == buf->read_pos) {
-        // In this case, we've written the most we can until we ran into
-        // read_pos, so we lack space to write again, so update write_pos
-        // to be the capacity of the buffer.
-        buf->write_pos = buf->capacity;
-    }
-
-    // Since we can recurse, update input (the pointer to where we're
-    // writing), by the write_size so that the next byte is placed correctly.
-    // Also, update input_size by write_size such that the remaining capacity
-    // of the input buffer (or, the offset input buffer) is reflected.
-    input += write_size;
-    input_size -= write_size;
-
-    // Recurse, updating the return value by this write size.
-    return write_size + jb_write(buf, input, input_size);
+    return written;
 }
 
 int jb_get(j_buffer *buf) {
@@ -203,6 +274,12 @@ int jb_get(j_buffer *buf) {
         return EOF;
     }
 
+    if (jb_is_elastic(buf) || jb_is_spsc(buf)) {
+        uint8_t byte = 0;
+        jb_read(buf, &byte, 1);
+        return byte;
+    }
+
     uint8_t result = buf->contents[buf->read_pos];
 
     if (buf->write_pos == buf->capacity) {
@@ -231,33 +308,135 @@ int jb_get(j_buffer *buf) {
 size_t jb_read(j_buffer *buf, uint8_t *output, size_t output_size) {
     /* ret == 0 <=> can't read from the buffer or output_size == 0 */
     /* ret == amount written <=> can read from the buffer */
-    if (!jb_can_read(buf) || output_size == 0) {
-        return 0;
+    size_t read = 0;
+
+    // As with jb_write, the readable region is at most two contiguous spans,
+    // so this loop executes at most twice.
+    while (read < output_size) {
+        size_t span_size = 0;
+        const uint8_t *span = jb_peek_read(buf, &span_size);
+        if (span == NULL) {
+            break;
+        }
+
+        if (span_size > output_size - read) {
+            span_size = output_size - read;
+        }
+
+        memcpy(output + read, span, span_size);
+        read += jb_consume(buf, span_size);
+    }
+
+    return read;
+}
+
+size_t jb_readv(j_buffer *buf, const struct iovec *iov, size_t iov_count) {
+    size_t read = 0;
+
+    for (size_t i = 0; i < iov_count; i++) {
+        size_t amount = jb_read(buf, iov[i].iov_base, iov[i].iov_len);
+        read += amount;
+
+        if (amount < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return read;
+}
+
+const uint8_t *jb_peek_read(j_buffer *buf, size_t *span_size) {
+    *span_size = 0;
+
+    if (jb_is_spsc(buf)) {
+        // Only the consumer stores spsc_read, so our own load can be
+        // relaxed; acquiring spsc_written makes the producer's bytes up to
+        // that point visible to us.
+        size_t read = atomic_load_explicit(&buf->spsc_read,
+                                           memory_order_relaxed);
+        size_t written = atomic_load_explicit(&buf->spsc_written,
+                                              memory_order_acquire);
+        if (written == read) {
+            return NULL;
+        }
+
+        size_t offset = read % buf->capacity;
+
+        // The span ends at the last written byte or the end of storage.
+        *span_size = written - read;
+        if (*span_size > buf->capacity - offset) {
+            *span_size = buf->capacity - offset;
+        }
+
+        return buf->contents + offset;
+    }
+
+    if (!jb_can_read(buf)) {
+        return NULL;
     }
 
-    // Location we should read from: buf->contents + the offset given by
-    // buf->read_pos.
-    uint8_t *read_ptr = buf->contents + buf->read_pos;
+    if (jb_is_elastic(buf)) {
+        // Only the head chunk holds the next bytes to be read.
+        *span_size = buf->head->end - buf->head->start;
+        return buf->head->data + buf->head->start;
+    }
 
-    // Size of the read we should perform. We're always bounded above by the
-    // difference between buf->capacity and buf->read_pos.
-    size_t read_size = buf->capacity - buf->read_pos;
+    // Size of the span is always bounded above by the difference between
+    // buf->capacity and buf->read_pos.
+    *span_size = buf->capacity - buf->read_pos;
 
     if (buf->write_pos > buf->read_pos) {
         // When the condition holds and since buf->write_pos <= buf->capacity,
-        // update read_size to be the difference between buf->write_pos and
-        // buf->read_pos. This will thus never grow read_size.
-        read_size = buf->write_pos - buf->read_pos;
+        // the span ends at buf->write_pos instead. This will thus never grow
+        // the span.
+        *span_size = buf->write_pos - buf->read_pos;
     }
-    if (read_size > output_size) {
-        // Bound read_size by output_size when read_size exceeds output_size.
-        read_size = output_size;
+
+    return buf->contents + buf->read_pos;
+}
+
+size_t jb_consume(j_buffer *buf, size_t amount) {
+    size_t span_size = 0;
+    if (jb_peek_read(buf, &span_size) == NULL || amount == 0) {
+        return 0;
     }
 
-    // We perform the initial copy of bytes from buf->contents to the output
-    // buffer. However, we might need another pass, hence the recursion at the
-    // end of jb_read. For more discussion, see the documentation in
-    memcpy(output, read_ptr, read_size);
+    if (amount > span_size) {
+        amount = span_size;
+    }
+
+    if (jb_is_spsc(buf)) {
+        // Release our reads of the span, handing the space back to the
+        // producer.
+        size_t read = atomic_load_explicit(&buf->spsc_read,
+                                           memory_order_relaxed);
+        atomic_store_explicit(&buf->spsc_read, read + amount,
+                              memory_order_release);
+        return amount;
+    }
+
+    if (jb_is_elastic(buf)) {
+        buf->head->start += amount;
+        buf->length -= amount;
+
+        if (buf->head->start == buf->head->end) {
+            if (buf->head->next != NULL) {
+                // The head chunk is fully drained and more data follows it;
+                // release the chunk so that the buffer shrinks back down.
+                j_chunk *drained = buf->head;
+                buf->head = drained->next;
+                buf->chunk_count -= 1;
+                jb_chunk_free(drained, buf->chunk_size);
+            } else {
+                // This is the last chunk, so the buffer is empty. Keep the
+                // chunk but rewind it, so the next write can use all of it.
+                buf->head->start = 0;
+                buf->head->end = 0;
+            }
+        }
+
+        return amount;
+    }
 
     if (buf->write_pos == buf->capacity) {
         // Since we just read from the buffer, we can now write to the buffer
@@ -265,7 +444,7 @@ size_t jb_read(j_buffer *buf, uint8_t *output, size_t output_size) {
         buf->write_pos = buf->read_pos;
     }
 
-    buf->read_pos += read_size;
+    buf->read_pos += amount;
 
     if (buf->read_pos == buf->capacity && buf->write_pos != 0) {
         // When we've reached buf->capacity and buf->write_pos isn't at the
@@ -276,15 +455,169 @@ size_t jb_read(j_buffer *buf, uint8_t *output, size_t output_size) {
     if (buf->read_pos == buf->write_pos) {
         // When buf->read_pos is buf->write_pos, we can no longer read any
         // more bytes from the buffer, so set buf->read_pos to our sentinel,
-        // buf->capacity.
+        // buf->capacity. Because the buffer is now empty, also move
+        // buf->write_pos back to the head so that the next writable span
+        // covers the entire buffer rather than stopping at the end.
         buf->read_pos = buf->capacity;
+        buf->write_pos = 0;
+    }
+
+    return amount;
+}
+
+uint8_t *jb_peek_write(j_buffer *buf, size_t *span_size) {
+    *span_size = 0;
+
+    if (jb_is_spsc(buf)) {
+        // Only the producer stores spsc_written; acquiring spsc_read ensures
+        // the consumer is done with the space we're about to reuse.
+        size_t written = atomic_load_explicit(&buf->spsc_written,
+                                              memory_order_relaxed);
+        size_t read = atomic_load_explicit(&buf->spsc_read,
+                                           memory_order_acquire);
+        if (written - read == buf->capacity) {
+            return NULL;
+        }
+
+        size_t offset = written % buf->capacity;
+
+        // The span ends at the first unread byte or the end of storage.
+        *span_size = buf->capacity - (written - read);
+        if (*span_size > buf->capacity - offset) {
+            *span_size = buf->capacity - offset;
+        }
+
+        return buf->contents + offset;
     }
 
-    // Move our output array by read_size and decrease its given size to
-    // handle the recursion into jb_read.
-    output += read_size;
-    output_size -= read_size;
-    return read_size + jb_read(buf, output, output_size);
+    if (!jb_can_write(buf)) {
+        return NULL;
+    }
+
+    if (jb_is_elastic(buf)) {
+        if (buf->tail->end == buf->chunk_size) {
+            // The tail is full but we're below our ceiling; grow the chain
+            // by a chunk.
+            j_chunk *chunk = jb_chunk_alloc(buf->chunk_size);
+            if (chunk == NULL) {
+                return NULL;
+            }
+
+            buf->tail->next = chunk;
+            buf->tail = chunk;
+            buf->chunk_count += 1;
+        }
+
+        *span_size = buf->chunk_size - buf->tail->end;
+        return buf->tail->data + buf->tail->end;
+    }
+
+    // The span is bounded above by the end of the buffer.
+    *span_size = buf->capacity - buf->write_pos;
+
+    if (buf->read_pos > buf->write_pos) {
+        // When buf->read_pos > buf->write_pos, we know that we are limited
+        // in the quantity we can write by buf->read_pos. (If buf->read_pos <
+        // buf->write_pos, we are not limited and can write up to capacity).
+        // Since we guarantee buf->read_pos <= buf->capacity, this subtraction
+        // will not grow the span and only shrink it.
+        *span_size = buf->read_pos - buf->write_pos;
+    }
+
+    return buf->contents + buf->write_pos;
+}
+
+size_t jb_commit(j_buffer *buf, size_t amount) {
+    size_t span_size = 0;
+    if (jb_peek_write(buf, &span_size) == NULL || amount == 0) {
+        return 0;
+    }
+
+    if (amount > span_size) {
+        amount = span_size;
+    }
+
+    if (jb_is_spsc(buf)) {
+        // Publish the bytes placed in the span to the consumer.
+        size_t written = atomic_load_explicit(&buf->spsc_written,
+                                              memory_order_relaxed);
+        atomic_store_explicit(&buf->spsc_written, written + amount,
+                              memory_order_release);
+        return amount;
+    }
+
+    if (jb_is_elastic(buf)) {
+        buf->tail->end += amount;
+        buf->length += amount;
+        return amount;
+    }
+
+    if (buf->read_pos == buf->capacity) {
+        // Since we just wrote bytes, we can now read bytes again.
+        buf->read_pos = buf->write_pos;
+    }
+
+    // Since amount is bounded above by the difference between
+    // buf->capacity and buf->write_pos, we guarantee that
+    // buf->write_pos <= buf->capacity after adding it.
+    buf->write_pos += amount;
+
+    if (buf->write_pos == buf->capacity && buf->read_pos != 0) {
+        // If we're at capacity but buf->read_pos isn't the start of the
+        // buffer, we can update write_pos to be the head; the next span
+        // starts there.
+        buf->write_pos = 0;
+    }
+    if (buf->write_pos == buf->read_pos) {
+        // In this case, we've written the most we can until we ran into
+        // read_pos, so we lack space to write again, so update write_pos
+        // to be the capacity of the buffer.
+        buf->write_pos = buf->capacity;
+    }
+
+    return amount;
+}
+
+void jb_clear(j_buffer *buf) {
+    if (buf == NULL) {
+        return;
+    }
+
+    if (jb_is_elastic(buf)) {
+        // Release everything past the first chunk, then wipe and rewind the
+        // one we keep.
+        j_chunk *chunk = buf->head->next;
+        while (chunk != NULL) {
+            j_chunk *next = chunk->next;
+            jb_chunk_free(chunk, buf->chunk_size);
+            chunk = next;
+        }
+
+        memset(buf->head->data, 0, buf->chunk_size);
+        buf->head->next = NULL;
+        buf->head->start = 0;
+        buf->head->end = 0;
+        buf->tail = buf->head;
+        buf->chunk_count = 1;
+        buf->length = 0;
+        return;
+    }
+
+    if (buf->contents == NULL || buf->capacity == 0) {
+        return;
+    }
+
+    memset(buf->contents, 0, buf->capacity);
+
+    if (jb_is_spsc(buf)) {
+        atomic_store(&buf->spsc_written, 0);
+        atomic_store(&buf->spsc_read, 0);
+        return;
+    }
+
+    // As in jb_alloc, an empty buffer can only be written to.
+    buf->write_pos = 0;
+    buf->read_pos = buf->capacity;
 }
 
 void jb_free(j_buffer *buf) {
@@ -292,6 +625,22 @@ void jb_free(j_buffer *buf) {
     if (buf == NULL) {
         return;
     }
+    if (jb_is_elastic(buf)) {
+        j_chunk *chunk = buf->head;
+        while (chunk != NULL) {
+            j_chunk *next = chunk->next;
+            jb_chunk_free(chunk, buf->chunk_size);
+            chunk = next;
+        }
+
+        buf->head = NULL;
+        buf->tail = NULL;
+        buf->chunk_size = 0;
+        buf->capacity = 0;
+
+        free(buf);
+        return;
+    }
     if (buf->contents == NULL || buf->capacity == 0) {
         return;
     }
@@ -1,20 +1,47 @@
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 #pragma once
 
+/*
+ * A single fixed-size chunk in the chain backing an elastic j_buffer. Bytes
+ * in data[start, end) are readable; data[end, chunk_size) is writable.
+ */
+typedef struct j_chunk {
+    struct j_chunk *next;
+
+    /* Offset of the next byte to read from this chunk. */
+    size_t start;
+
+    /* Offset of the next byte to write into this chunk. */
+    size_t end;
+
+    uint8_t data[];
+} j_chunk;
+
 /*
  * Opaque structure for buffers. Subject to change at any time.
  *
  * A j_buffer is a circular ring buffer creating a FIFO queue of bytes.
+ *
+ * Alternatively, an elastic j_buffer (created with jb_alloc_elastic) is a
+ * chain of fixed-size chunks. It starts out as a single chunk, grows a chunk
+ * at a time up to its capacity as data is written, and drops chunks again
+ * as they're drained.
+ *
+ * Neither kind is thread-safe. A single-producer/single-consumer j_buffer
+ * (created with jb_alloc_spsc) is a ring which one thread may write to while
+ * another concurrently reads from it, without locking.
  */
-typedef struct {
-    /* Contents of the buffer. */
+typedef struct j_buffer {
+    /* Contents of the buffer; NULL for elastic buffers. */
     uint8_t *contents;
 
     /* Capacity is used as a sentinel value; when write_pos == capacity, can't
-     * write. */
+     * write. For elastic buffers, this is the ceiling the chain may grow to. */
     size_t capacity;
 
     /* Next position to write to, else capacity if unable to write. */
@@ -22,6 +49,34 @@ typedef struct {
 
     /* Next position to read from, else capacity if unable to read. */
     size_t read_pos;
+
+    /* Size of each chunk in an elastic buffer; zero for a ring buffer. */
+    size_t chunk_size;
+
+    /* Number of chunks currently allocated in an elastic buffer. */
+    size_t chunk_count;
+
+    /* Number of readable bytes stored in an elastic buffer. */
+    size_t length;
+
+    /* Chunks are read from head and written to tail. */
+    j_chunk *head;
+    j_chunk *tail;
+
+    /* Whether this is a single-producer/single-consumer ring. */
+    bool spsc;
+
+    /* Single-producer/single-consumer rings only: running totals of bytes
+     * written and read. The producer alone stores spsc_written and the
+     * consumer alone stores spsc_read, each with release semantics; the
+     * other side loads it with acquire semantics. Their difference is the
+     * number of readable bytes, and each modulo capacity is the position of
+     * the next write or read. */
+    atomic_size_t spsc_written;
+    atomic_size_t spsc_read;
+
+    /* Next buffer in a free list while idle in a j_buffer_pool. */
+    struct j_buffer *pool_next;
 } j_buffer;
 
 /*
@@ -30,7 +85,38 @@ typedef struct {
  */
 j_buffer *jb_alloc(size_t length);
 
-/* Get the original capacity (i.e., when empty) of the specified buffer. */
+/*
+ * Create a new elastic buffer; must be freed with jb_free. The buffer
+ * allocates storage in chunks of chunk_size bytes as it fills, up to
+ * max_capacity (rounded up to a whole number of chunks), and releases
+ * drained chunks back down to a single chunk when idle. Space consumed
+ * from the front of the oldest chunk is reclaimed once that chunk is fully
+ * drained.
+ */
+j_buffer *jb_alloc_elastic(size_t chunk_size, size_t max_capacity);
+
+/* Whether or not the buffer was created with jb_alloc_elastic. */
+bool jb_is_elastic(j_buffer *buf);
+
+/*
+ * Create a new single-producer/single-consumer ring buffer of the given
+ * length; must be freed with jb_free. One thread may call the writing
+ * functions (jb_put, jb_write, jb_writev, jb_peek_write and jb_commit) while
+ * another concurrently calls the reading functions (jb_get, jb_read,
+ * jb_readv, jb_peek_read and jb_consume); either may query capacities.
+ * Bytes committed by the producer are visible to the consumer once it
+ * observes them as readable. jb_clear and jb_free require that neither side
+ * is in use. Returns NULL when length is zero.
+ */
+j_buffer *jb_alloc_spsc(size_t length);
+
+/* Whether or not the buffer was created with jb_alloc_spsc. */
+bool jb_is_spsc(j_buffer *buf);
+
+/*
+ * Get the original capacity (i.e., when empty) of the specified buffer. For
+ * elastic buffers, this is the maximum capacity.
+ */
 size_t jb_capacity(j_buffer *buf);
 
 /* Whether or not the buffer can be read from. */
@@ -59,6 +145,14 @@ int jb_put(j_buffer *buf, uint8_t byte);
  */
 size_t jb_write(j_buffer *buf, const uint8_t *input, size_t input_size);
 
+/*
+ * Store the contents of several arrays into the buffer, in order, as if by
+ * successive calls to jb_write. Stops at the first array which doesn't fit
+ * entirely. Returns the total number of characters written; zero when the
+ * buffer is already full or iov_count is zero.
+ */
+size_t jb_writev(j_buffer *buf, const struct iovec *iov, size_t iov_count);
+
 /*
  * Get the next character from the buffer or EOF if the buffer is empty. If
  * not EOF, can safely be casted to uint8_t.
@@ -73,7 +167,60 @@ int jb_get(j_buffer *buf);
 size_t jb_read(j_buffer *buf, uint8_t *output, size_t output_size);
 
 /*
- * Free a buffer allocated with jb_alloc. This includes zeroing the contents
- * of the buffer in case any sensitive material was stored.
+ * Scatter the contents of the buffer across several arrays, in order, as if
+ * by successive calls to jb_read. Stops once the buffer is empty. Returns the
+ * total number of characters read; zero if the buffer was empty.
+ */
+size_t jb_readv(j_buffer *buf, const struct iovec *iov, size_t iov_count);
+
+/*
+ * Get the largest contiguous span of readable bytes, starting at the next
+ * byte jb_get would return. The span ends either at the last written byte
+ * or at the end of the underlying storage, whichever comes first; when the
+ * readable region wraps around, a second peek after jb_consume returns the
+ * remainder. The size of the span is stored in span_size. Returns NULL (and
+ * a span_size of zero) when the buffer is empty.
+ *
+ * The returned pointer remains valid until the next call which modifies
+ * the buffer.
+ */
+const uint8_t *jb_peek_read(j_buffer *buf, size_t *span_size);
+
+/*
+ * Mark up to amount bytes of the span returned by jb_peek_read as read,
+ * without copying them. Returns the number of bytes consumed; this is
+ * bounded above by the size of the current readable span.
+ */
+size_t jb_consume(j_buffer *buf, size_t amount);
+
+/*
+ * Get the largest contiguous span of writable space, starting at the
+ * location jb_put would store the next byte. The size of the span is stored
+ * in span_size. Returns NULL (and a span_size of zero) when the buffer is
+ * full.
+ *
+ * Bytes placed in the span are not visible to readers until they are
+ * committed with jb_commit.
+ */
+uint8_t *jb_peek_write(j_buffer *buf, size_t *span_size);
+
+/*
+ * Mark up to amount bytes at the start of the span returned by jb_peek_write
+ * as written. Returns the number of bytes committed; this is bounded above
+ * by the size of the current writable span.
+ */
+size_t jb_commit(j_buffer *buf, size_t amount);
+
+/*
+ * Empty the buffer, zeroing its contents in case any sensitive material was
+ * stored. Afterwards the buffer is indistinguishable from a freshly
+ * allocated one; an elastic buffer is shrunk back down to a single chunk.
+ */
+void jb_clear(j_buffer *buf);
+
+/*
+ * Free a buffer allocated with jb_alloc or jb_alloc_elastic. This includes
+ * zeroing the contents of the buffer in case any sensitive material was
+ * stored.
  */
 void jb_free(j_buffer *buf);
@@ -0,0 +1,287 @@
+#include <nspr.h>
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "j_buffer.h"
+#include "j_buffer_pool.h"
+
+/* A singly linked list of idle buffers, threaded through pool_next. */
+typedef struct {
+    j_buffer *head;
+    size_t count;
+} j_buffer_list;
+
+static PRCallOnceType pool_once;
+
+/* Index of each thread's j_buffer_list in NSPR's thread-private data. */
+static PRUintn pool_thread_index;
+
+/* Protects pool_global. */
+static PRLock *pool_lock = NULL;
+
+/* Overflow list shared by all threads. */
+static j_buffer_list pool_global;
+
+/* The counters are only informational (or, for pool_idle, a bound), so
+ * relaxed ordering suffices; the lists themselves are either thread-local
+ * or protected by pool_lock. */
+static atomic_size_t pool_limit = JB_POOL_DEFAULT_LIMIT;
+static atomic_size_t pool_leased;
+static atomic_size_t pool_leased_high_water;
+static atomic_size_t pool_idle;
+static atomic_size_t pool_idle_high_water;
+static _Atomic uint64_t pool_hits;
+static _Atomic uint64_t pool_misses;
+
+static void jb_pool_push(j_buffer_list *list, j_buffer *buf) {
+    buf->pool_next = list->head;
+    list->head = buf;
+    list->count += 1;
+}
+
+static j_buffer *jb_pool_take(j_buffer_list *list, bool spsc,
+                              size_t chunk_size, size_t capacity) {
+    // Buffers of different shapes share a list, but in practice there are
+    // only a couple of shapes in use at once, so the match is found early.
+    j_buffer **link = &list->head;
+    while (*link != NULL) {
+        j_buffer *buf = *link;
+        if (buf->spsc == spsc && buf->chunk_size == chunk_size &&
+                buf->capacity == capacity) {
+            *link = buf->pool_next;
+            buf->pool_next = NULL;
+            list->count -= 1;
+            return buf;
+        }
+
+        link = &buf->pool_next;
+    }
+
+    return NULL;
+}
+
+static void jb_pool_raise(atomic_size_t *high_water, size_t value) {
+    size_t current = atomic_load_explicit(high_water, memory_order_relaxed);
+    while (value > current &&
+           !atomic_compare_exchange_weak_explicit(high_water, &current, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+        // current was reloaded by the failed exchange; try again.
+    }
+}
+
+/* Free idle buffers from the global list until we're within our limit.
+ * Must be called with pool_lock held. */
+static void jb_pool_trim_locked(void) {
+    size_t limit = atomic_load_explicit(&pool_limit, memory_order_relaxed);
+
+    while (pool_global.head != NULL &&
+           atomic_load_explicit(&pool_idle, memory_order_relaxed) > limit) {
+        j_buffer *buf = pool_global.head;
+        pool_global.head = buf->pool_next;
+        pool_global.count -= 1;
+
+        atomic_fetch_sub_explicit(&pool_idle, 1, memory_order_relaxed);
+        jb_free(buf);
+    }
+}
+
+static void PR_CALLBACK jb_pool_thread_exit(void *priv) {
+    j_buffer_list *list = priv;
+    if (list == NULL) {
+        return;
+    }
+
+    // Hand the exiting thread's idle buffers over to the global list so
+    // other threads can still make use of them.
+    PR_Lock(pool_lock);
+    while (list->head != NULL) {
+        j_buffer *buf = list->head;
+        list->head = buf->pool_next;
+        jb_pool_push(&pool_global, buf);
+    }
+    jb_pool_trim_locked();
+    PR_Unlock(pool_lock);
+
+    free(list);
+}
+
+static PRStatus jb_pool_init(void) {
+    pool_lock = PR_NewLock();
+    if (pool_lock == NULL) {
+        return PR_FAILURE;
+    }
+
+    return PR_NewThreadPrivateIndex(&pool_thread_index, jb_pool_thread_exit);
+}
+
+static bool jb_pool_ready(void) {
+    return PR_CallOnce(&pool_once, jb_pool_init) == PR_SUCCESS;
+}
+
+static j_buffer_list *jb_pool_thread_list(bool create) {
+    j_buffer_list *list = PR_GetThreadPrivate(pool_thread_index);
+
+    if (list == NULL && create) {
+        list = calloc(1, sizeof(j_buffer_list));
+        if (list != NULL &&
+                PR_SetThreadPrivate(pool_thread_index, list) != PR_SUCCESS) {
+            free(list);
+            list = NULL;
+        }
+    }
+
+    return list;
+}
+
+/* Lease a buffer of the given shape: a chunk_size of zero means a ring
+ * buffer of the given capacity, single-producer/single-consumer when spsc
+ * is set. */
+static j_buffer *jb_pool_lease_shape(bool spsc, size_t chunk_size,
+                                     size_t capacity) {
+    j_buffer *buf = NULL;
+
+    if (jb_pool_ready()) {
+        j_buffer_list *list = jb_pool_thread_list(false);
+        if (list != NULL) {
+            buf = jb_pool_take(list, spsc, chunk_size, capacity);
+        }
+
+        if (buf == NULL) {
+            PR_Lock(pool_lock);
+            buf = jb_pool_take(&pool_global, spsc, chunk_size, capacity);
+            PR_Unlock(pool_lock);
+        }
+    }
+
+    if (buf != NULL) {
+        atomic_fetch_sub_explicit(&pool_idle, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&pool_hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&pool_misses, 1, memory_order_relaxed);
+
+        if (chunk_size != 0) {
+            buf = jb_alloc_elastic(chunk_size, capacity);
+        } else if (spsc) {
+            buf = jb_alloc_spsc(capacity);
+        } else {
+            buf = jb_alloc(capacity);
+        }
+
+        if (buf == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t leased = atomic_fetch_add_explicit(&pool_leased, 1,
+                                              memory_order_relaxed) + 1;
+    jb_pool_raise(&pool_leased_high_water, leased);
+
+    return buf;
+}
+
+j_buffer *jb_pool_lease(size_t length) {
+    return jb_pool_lease_shape(false, 0, length);
+}
+
+j_buffer *jb_pool_lease_spsc(size_t length) {
+    return jb_pool_lease_shape(true, 0, length);
+}
+
+j_buffer *jb_pool_lease_elastic(size_t chunk_size, size_t max_capacity) {
+    if (chunk_size == 0) {
+        return NULL;
+    }
+
+    // Round the same way jb_alloc_elastic does, so that buffers leased with
+    // the same arguments match those already in the pool.
+    size_t max_chunks = (max_capacity + chunk_size - 1) / chunk_size;
+    if (max_chunks == 0) {
+        max_chunks = 1;
+    }
+
+    return jb_pool_lease_shape(false, chunk_size, max_chunks * chunk_size);
+}
+
+void jb_pool_return(j_buffer *buf) {
+    if (buf == NULL) {
+        return;
+    }
+
+    atomic_fetch_sub_explicit(&pool_leased, 1, memory_order_relaxed);
+
+    if (!jb_pool_ready()) {
+        jb_free(buf);
+        return;
+    }
+
+    // Reserve our place in the pool before touching any lists, so that
+    // concurrent returns can't push us over the limit.
+    size_t idle = atomic_fetch_add_explicit(&pool_idle, 1,
+                                            memory_order_relaxed) + 1;
+    if (idle > atomic_load_explicit(&pool_limit, memory_order_relaxed)) {
+        atomic_fetch_sub_explicit(&pool_idle, 1, memory_order_relaxed);
+        jb_free(buf);
+        return;
+    }
+
+    jb_pool_raise(&pool_idle_high_water, idle);
+
+    // Wipe the buffer now, rather than when it is next leased, so that
+    // sensitive material doesn't linger in idle buffers.
+    jb_clear(buf);
+
+    j_buffer_list *list = jb_pool_thread_list(true);
+    if (list != NULL && list->count < JB_POOL_THREAD_CACHE) {
+        jb_pool_push(list, buf);
+        return;
+    }
+
+    PR_Lock(pool_lock);
+    jb_pool_push(&pool_global, buf);
+    PR_Unlock(pool_lock);
+}
+
+size_t jb_pool_get_limit(void) {
+    return atomic_load_explicit(&pool_limit, memory_order_relaxed);
+}
+
+void jb_pool_set_limit(size_t limit) {
+    atomic_store_explicit(&pool_limit, limit, memory_order_relaxed);
+
+    if (!jb_pool_ready()) {
+        return;
+    }
+
+    // We can't reach into other threads' caches, but we can trim our own.
+    j_buffer_list *list = jb_pool_thread_list(false);
+    while (list != NULL && list->head != NULL &&
+           atomic_load_explicit(&pool_idle, memory_order_relaxed) > limit) {
+        j_buffer *buf = list->head;
+        list->head = buf->pool_next;
+        list->count -= 1;
+
+        atomic_fetch_sub_explicit(&pool_idle, 1, memory_order_relaxed);
+        jb_free(buf);
+    }
+
+    PR_Lock(pool_lock);
+    jb_pool_trim_locked();
+    PR_Unlock(pool_lock);
+}
+
+void jb_pool_get_stats(j_buffer_pool_stats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    stats->leased = atomic_load_explicit(&pool_leased, memory_order_relaxed);
+    stats->leased_high_water = atomic_load_explicit(&pool_leased_high_water,
+                                                    memory_order_relaxed);
+    stats->idle = atomic_load_explicit(&pool_idle, memory_order_relaxed);
+    stats->idle_high_water = atomic_load_explicit(&pool_idle_high_water,
+                                                  memory_order_relaxed);
+    stats->hits = atomic_load_explicit(&pool_hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&pool_misses, memory_order_relaxed);
+}
@@ -0,0 +1,88 @@
+#include <nspr.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Buffers handed out by the pool. */
+#include "j_buffer.h"
+
+#pragma once
+
+/*
+ * A process-wide pool of idle j_buffers, so that short-lived connections
+ * don't pay for allocating and freeing their buffers every time.
+ *
+ * Each thread keeps a small cache of idle buffers which it can lease from
+ * and return to without locking; when that cache is full, buffers spill
+ * over into a global list shared by all threads. Buffers are wiped (as if
+ * by jb_clear) when returned, so no data crosses between leases. The total
+ * number of idle buffers held by the pool never exceeds its limit; buffers
+ * returned beyond that are freed outright.
+ */
+
+/* Default limit on the number of idle buffers held by the pool. */
+#define JB_POOL_DEFAULT_LIMIT 256
+
+/* Number of idle buffers each thread may hold before spilling over into the
+ * global list. */
+#define JB_POOL_THREAD_CACHE 4
+
+/* Snapshot of the pool's counters; see jb_pool_get_stats. */
+typedef struct {
+    /* Number of buffers currently leased out. */
+    size_t leased;
+
+    /* Largest number of buffers ever leased out at once. */
+    size_t leased_high_water;
+
+    /* Number of idle buffers currently held by the pool. */
+    size_t idle;
+
+    /* Largest number of idle buffers ever held by the pool. */
+    size_t idle_high_water;
+
+    /* Number of leases satisfied by an idle buffer. */
+    uint64_t hits;
+
+    /* Number of leases which required allocating a new buffer. */
+    uint64_t misses;
+} j_buffer_pool_stats;
+
+/*
+ * Lease an empty ring buffer of the given length, as if by jb_alloc. Must be
+ * returned with jb_pool_return rather than jb_free.
+ */
+j_buffer *jb_pool_lease(size_t length);
+
+/*
+ * Lease an empty single-producer/single-consumer ring buffer, as if by
+ * jb_alloc_spsc. Must be returned with jb_pool_return rather than jb_free.
+ */
+j_buffer *jb_pool_lease_spsc(size_t length);
+
+/*
+ * Lease an empty elastic buffer, as if by jb_alloc_elastic. Must be
+ * returned with jb_pool_return rather than jb_free.
+ */
+j_buffer *jb_pool_lease_elastic(size_t chunk_size, size_t max_capacity);
+
+/*
+ * Return a leased buffer to the pool. The buffer is wiped, and is freed
+ * instead when the pool is already at its limit.
+ */
+void jb_pool_return(j_buffer *buf);
+
+/* Get the limit on the number of idle buffers held by the pool. */
+size_t jb_pool_get_limit(void);
+
+/*
+ * Set the limit on the number of idle buffers held by the pool. Lowering
+ * the limit frees idle buffers cached by the calling thread and on the
+ * global list to make room; those cached by other threads are released
+ * when the owning thread exits. A limit of zero disables pooling.
+ */
+void jb_pool_set_limit(size_t limit);
+
+/* Fill stats with a snapshot of the pool's counters. */
+void jb_pool_get_stats(j_buffer_pool_stats *stats);
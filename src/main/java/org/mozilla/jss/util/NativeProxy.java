@@ -4,15 +4,22 @@
 
 package org.mozilla.jss.util;
 
+import java.lang.ref.PhantomReference;
+import java.lang.ref.ReferenceQueue;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collections;
 import java.util.HashSet;
+import java.util.List;
 import java.util.Set;
 import java.util.WeakHashMap;
+import java.util.concurrent.ConcurrentHashMap;
 import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicLong;
 
 import org.mozilla.jss.CryptoManager;
-import org.mozilla.jss.netscape.security.util.Utils;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
 
@@ -22,17 +29,105 @@ import org.slf4j.LoggerFactory;
  * It contains some code to help make sure that native memory is getting
  * freed properly.
  *
+ * Proxies which are never closed are reclaimed once they become
+ * unreachable. Subclasses which pass a Releaser to their constructor are
+ * tracked with a phantom reference and released in batches by a daemon
+ * thread, without waiting on the JVM's finalizer; see getReclaimStats().
+ * Other subclasses fall back to calling close() from a finalizer.
+ *
  * @author nicolson
  * @version $Revision$ $Date$
  */
 public abstract class NativeProxy implements AutoCloseable {
     public static Logger logger = LoggerFactory.getLogger(NativeProxy.class);
-    private static final boolean saveStacktraces = assertsEnabled() && CryptoManager.JSS_DEBUG;
+
+    /**
+     * Whether or not to record where each NativeProxy was created.
+     *
+     * This lives in a holder class rather than directly on NativeProxy:
+     * libjss resolves NativeProxy's field and method IDs when it is loaded,
+     * which initializes this class from within CryptoManager's static
+     * initializer. Reading CryptoManager.JSS_DEBUG at that point would see
+     * its default value.
+     */
+    private static class Debug {
+        static final boolean saveStacktraces = assertsEnabled() && CryptoManager.JSS_DEBUG;
+    }
+
+    /**
+     * Frees the native data structure behind a proxy which was garbage
+     * collected without being closed.
+     *
+     * This is called on the reclaimer thread after the proxy itself is
+     * gone, so it is given only the C pointer. It must not capture the
+     * proxy; a static native method is the usual implementation.
+     */
+    @FunctionalInterface
+    public interface Releaser {
+        void release(long handle) throws Exception;
+    }
+
+    /**
+     * Create a NativeProxy from a C pointer. This is the primary way of
+     * creating a NativeProxy; it should be called from the constructor of
+     * your subclass.
+     *
+     * @param handle A C pointer, cast to a jlong, pointing to a native data
+     *            structure. The NativeProxy instance acts as a proxy for
+     *            that native data structure. Zero is the null pointer.
+     */
+    public NativeProxy(long handle) {
+        this(handle, true);
+    }
+
+    /**
+     * Create a NativeProxy from a C pointer. This allows for creating an
+     * untracked NativeProxy instance (when track=false), which allows for
+     * creating NativeProxy instances out of stack-allocated variables
+     * and/or creating NativeProxies which aren't freed.
+     */
+    protected NativeProxy(long handle, boolean track) {
+        this(handle, track, null);
+    }
+
+    /**
+     * Create a NativeProxy from a C pointer, which is freed by releaser if
+     * this proxy is garbage collected before being closed.
+     *
+     * releaseNativeResources() is still used by close(); both must free
+     * the same native data structure.
+     */
+    protected NativeProxy(long handle, Releaser releaser) {
+        this(handle, true, releaser);
+    }
+
+    private NativeProxy(long handle, boolean track, Releaser releaser) {
+        mPointer = handle;
+        mHashCode = registryIndex.getAndIncrement();
+        if (mPointer != 0) {
+            mHashCode += Long.hashCode(mPointer);
+        }
+
+        if (track && Debug.saveStacktraces) {
+            registry.add(this);
+
+            mTrace = Arrays.toString(Thread.currentThread().getStackTrace());
+        }
+
+        if (mPointer != 0) {
+            if (releaser != null) {
+                mReclaimable = new Reclaimable(this, releaser);
+            } else {
+                mGuardian = new Guardian();
+            }
+        }
+    }
 
     /**
      * Create a NativeProxy from a byte array representing a C pointer.
-     * This is the primary way of creating a NativeProxy; it should be called
-     * from the constructor of your subclass.
+     *
+     * Kept for compatibility with code which still creates its proxies
+     * with JSS_ptrToByteArray; prefer NativeProxy(long) instead.
      *
      * @param pointer A byte array, created with JSS_ptrToByteArray, that
      *            contains a pointer pointing to a native data structure. The
@@ -43,24 +138,38 @@ public abstract class NativeProxy implements AutoCloseable {
     }
 
     /**
-     * Create a NativeProxy from a byte array representing a C pointer.
-     * This allows for creating an untracked NativeProxy instance (when
-     * track=false), which allows for creating NativeProxy instances out
-     * of stack-allocated variables and/or creating NativeProxies which
-     * aren't freed.
+     * Create a NativeProxy from a byte array representing a C pointer,
+     * optionally untracked; see NativeProxy(long, boolean).
      */
     protected NativeProxy(byte[] pointer, boolean track) {
-        mPointer = pointer;
-        mHashCode = registryIndex.getAndIncrement();
-        if (mPointer != null) {
-            mHashCode += Arrays.hashCode(mPointer);
-        }
+        this(toHandle(pointer), track);
+    }
 
-        if (track && saveStacktraces) {
-            assert (pointer != null);
-            registry.add(this);
+    /**
+     * Create a NativeProxy from a byte array representing a C pointer,
+     * reclaimed by releaser; see NativeProxy(long, Releaser).
+     */
+    protected NativeProxy(byte[] pointer, Releaser releaser) {
+        this(toHandle(pointer), releaser);
+    }
 
-            mTrace = Arrays.toString(Thread.currentThread().getStackTrace());
+    /**
+     * Convert a byte array created by JSS_ptrToByteArray back into the C
+     * pointer it holds, in native byte order.
+     */
+    private static long toHandle(byte[] pointer) {
+        if (pointer == null) {
+            return 0;
+        }
+
+        ByteBuffer buffer = ByteBuffer.wrap(pointer).order(ByteOrder.nativeOrder());
+        switch (pointer.length) {
+            case Long.BYTES:
+                return buffer.getLong();
+            case Integer.BYTES:
+                return Integer.toUnsignedLong(buffer.getInt());
+            default:
+                throw new IllegalArgumentException("Invalid native pointer length: " + pointer.length);
         }
     }
 
@@ -80,11 +189,11 @@ public abstract class NativeProxy implements AutoCloseable {
             return false;
         }
         NativeProxy nObj = (NativeProxy) obj;
-        if (this.mPointer == null || nObj.mPointer == null) {
+        if (this.mPointer == 0 || nObj.mPointer == 0) {
             return false;
         }
 
-        return Arrays.equals(this.mPointer, nObj.mPointer);
+        return this.mPointer == nObj.mPointer;
     }
 
     /**
@@ -107,48 +216,21 @@ public abstract class NativeProxy implements AutoCloseable {
      * data structures in C code that are referenced by this proxy.
      * releaseNativeResources() will usually be implemented as a native method.
      * <p>
-     * You don't call this method; NativeProxy.finalize() or close() calls
-     * it for you.
+     * You don't call this method; close() calls it for you.
      * </p>
      *
      * If you free these resources explicitly, call clear(); instead.
      */
     protected abstract void releaseNativeResources() throws Exception;
 
-    /**
-     * Finalize this NativeProxy by releasing its native resources.
-     * The finalizer calls releaseNativeResources() so you don't have to.
-     * This finalizer should be called from the finalize() method of all
-     * subclasses:
-     * class MyProxy extends NativeProxy {
-     * [...]
-     * protected void finalize() throws Throwable {
-     * // do any object-specific finalization other than
-     * // releasing native resources
-     * [...]
-     * super.finalize();
-     * }
-     * }
-     *
-     * @deprecated finalize() in Object has been deprecated. Use close(...)
-     *             from the AutoCloseable interface instead.
-     */
-    @Override
-    @Deprecated
-    protected void finalize() throws Throwable {
-        close();
-    }
-
     /**
      * Close this NativeProxy by releasing its native resources if they
      * haven't otherwise been freed.
-     *
-     * See comment in finalize.
      */
     @Override
     public final void close() throws Exception {
         try {
-            if (mPointer != null) {
+            if (mPointer != 0) {
                 releaseNativeResources();
             }
         } finally {
@@ -160,29 +242,49 @@ public abstract class NativeProxy implements AutoCloseable {
      * Call clear(...) to clear the value of the pointer, setting it to null.
      *
      * This should be used when the pointer has been freed by another means.
-     * Similar to finalize(...) or close(...), except that it doesn't call
+     * Similar to close(...), except that it doesn't call
      * releaseNativeResources(...).
      *
      * See also: JSS_clearPtrFromProxy(...) in jssutil.h
      */
     public final void clear() {
-        this.mPointer = null;
+        this.mPointer = 0;
         // registry.remove(this);
+
+        // Nothing is left to reclaim once the pointer is gone.
+        if (mReclaimable != null) {
+            mReclaimable.disarm();
+            mReclaimable = null;
+        }
+        mGuardian = null;
     }
 
     /**
      * Whether or not this is a null pointer.
      */
     public boolean isNull() {
-        return this.mPointer == null;
+        return this.mPointer == 0;
     }
 
     /**
-     * Byte array containing native pointer bytes.
+     * Native pointer, or zero when null. Read directly by native code; see
+     * JSS_getPtrFromProxy in jssutil.c.
      */
-    private byte mPointer[];
+    private long mPointer;
     private int mHashCode;
 
+    /**
+     * Phantom reference which frees mPointer should this proxy be collected
+     * while still open; null when constructed without a Releaser.
+     */
+    private Reclaimable mReclaimable;
+
+    /**
+     * Finalizable companion which closes this proxy when it is collected;
+     * used in place of mReclaimable when there is no Releaser.
+     */
+    private Object mGuardian;
+
     /**
      * String containing backtrace of pointer generation.
      */
@@ -199,20 +301,19 @@ public abstract class NativeProxy implements AutoCloseable {
      * the registry is empty. This could be done, for example, in the
      * jssjava JVM after main() completes.
      *
-     * This registration process verifies that people are calling
-     * NativeProxy.finalize() from their subclasses of NativeProxy, so that
-     * releaseNativeResources() gets called.
+     * This registration process verifies that NativeProxy instances are
+     * being closed, so that releaseNativeResources() gets called.
      */
     static Set<NativeProxy> registry = Collections.newSetFromMap(new WeakHashMap<NativeProxy, Boolean>());
     static AtomicInteger registryIndex = new AtomicInteger();
 
     @Override
     public String toString() {
-        if (mPointer == null) {
+        if (mPointer == 0) {
             return this.getClass().getName() + "[" + mHashCode + "@null]";
         }
 
-        return this.getClass().getName() + "[" + mHashCode + "@" + Utils.HexEncode(mPointer) + "]";
+        return this.getClass().getName() + "[" + mHashCode + "@" + Long.toHexString(mPointer) + "]";
     }
 
     /**
@@ -237,9 +338,9 @@ public abstract class NativeProxy implements AutoCloseable {
         if (!registry.isEmpty()) {
             logger.warn(registry.size() + " NativeProxys are still registered.");
 
-            if (saveStacktraces) {
+            if (Debug.saveStacktraces) {
                 for (NativeProxy proxy : registry) {
-                    logger.warn("\t" + Arrays.toString(proxy.mPointer) + " ::: " + proxy.mTrace);
+                    logger.warn("\t" + Long.toHexString(proxy.mPointer) + " ::: " + proxy.mTrace);
                 }
             }
         } else {
@@ -274,4 +375,149 @@ public abstract class NativeProxy implements AutoCloseable {
             throw first;
         }
     }
+
+    /**
+     * Get a snapshot of the counters for proxies reclaimed after being
+     * garbage collected without being closed.
+     */
+    public static NativeProxyStats getReclaimStats() {
+        return new NativeProxyStats(armed.size(), inFlight.get(),
+                                    reclaimed.get(), failed.get(),
+                                    batches.get());
+    }
+
+    /**
+     * Largest number of collected proxies released by the reclaimer thread
+     * in one go.
+     */
+    static final int RECLAIM_BATCH_SIZE = 64;
+
+    /**
+     * Phantom references to collected proxies, drained by the reclaimer
+     * thread.
+     */
+    private static final ReferenceQueue<NativeProxy> reclaimQueue = new ReferenceQueue<>();
+
+    /**
+     * Phantom references which still own their native pointer. This keeps
+     * them reachable until they are either disarmed by clear() or dequeued;
+     * whichever removes a reference from this set frees its pointer.
+     */
+    private static final Set<Reclaimable> armed = ConcurrentHashMap.newKeySet();
+
+    /**
+     * Proxies in the batch currently being released by the reclaimer
+     * thread; see NativeProxyStats.getInFlight().
+     */
+    private static final AtomicLong inFlight = new AtomicLong();
+
+    private static final AtomicLong reclaimed = new AtomicLong();
+    private static final AtomicLong failed = new AtomicLong();
+    private static final AtomicLong batches = new AtomicLong();
+
+    private static Thread reclaimer;
+
+    /**
+     * Start the reclaimer thread the first time a proxy is registered with
+     * it.
+     */
+    private static synchronized void startReclaimer() {
+        if (reclaimer != null) {
+            return;
+        }
+
+        reclaimer = new Thread(NativeProxy::reclaimLoop, "JSS NativeProxy Reclaimer");
+        reclaimer.setDaemon(true);
+        reclaimer.start();
+    }
+
+    private static void reclaimLoop() {
+        List<Reclaimable> batch = new ArrayList<>(RECLAIM_BATCH_SIZE);
+
+        while (true) {
+            try {
+                // Block for the first reference, then take whatever else
+                // has queued up behind it without waiting.
+                batch.add((Reclaimable) reclaimQueue.remove());
+
+                Reclaimable next;
+                while (batch.size() < RECLAIM_BATCH_SIZE &&
+                        (next = (Reclaimable) reclaimQueue.poll()) != null) {
+                    batch.add(next);
+                }
+            } catch (InterruptedException e) {
+                // We're a daemon; keep going until the JVM exits.
+            }
+
+            if (batch.isEmpty()) {
+                continue;
+            }
+
+            inFlight.addAndGet(batch.size());
+            for (Reclaimable reference : batch) {
+                reference.reclaim();
+                inFlight.decrementAndGet();
+            }
+
+            batches.incrementAndGet();
+            batch.clear();
+        }
+    }
+
+    /**
+     * Phantom reference which remembers how to free a proxy's pointer once
+     * the proxy itself has been collected.
+     */
+    private static final class Reclaimable extends PhantomReference<NativeProxy> {
+        private final long handle;
+        private final Releaser releaser;
+
+        Reclaimable(NativeProxy proxy, Releaser releaser) {
+            super(proxy, reclaimQueue);
+            this.handle = proxy.mPointer;
+            this.releaser = releaser;
+
+            armed.add(this);
+            startReclaimer();
+        }
+
+        /**
+         * Give up ownership of the pointer, because the proxy has been
+         * closed or cleared.
+         */
+        void disarm() {
+            armed.remove(this);
+            clear();
+        }
+
+        /**
+         * Free the pointer of a collected proxy, unless it was disarmed
+         * first.
+         */
+        void reclaim() {
+            if (!armed.remove(this)) {
+                return;
+            }
+
+            try {
+                releaser.release(handle);
+                reclaimed.incrementAndGet();
+            } catch (Throwable t) {
+                failed.incrementAndGet();
+                logger.warn("Unable to reclaim native pointer " + Long.toHexString(handle) + ": " + t.getMessage(), t);
+            }
+        }
+    }
+
+    /**
+     * Finalizable companion of a proxy without a Releaser; when both become
+     * unreachable, it closes the proxy as NativeProxy.finalize() once did.
+     */
+    private final class Guardian {
+        @Override
+        @SuppressWarnings("deprecation")
+        protected void finalize() throws Throwable {
+            close();
+        }
+    }
 }
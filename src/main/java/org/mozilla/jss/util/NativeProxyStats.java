@@ -0,0 +1,82 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+package org.mozilla.jss.util;
+
+/**
+ * Counters for NativeProxy instances reclaimed after being garbage
+ * collected without being closed.
+ *
+ * This class is a data class; it contains public getters and no setters.
+ * It usually should be constructed via a call to
+ * NativeProxy.getReclaimStats() rather than directly constructing an
+ * instance. The values are a snapshot and are not updated afterwards.
+ */
+public class NativeProxyStats {
+    private long tracked;
+    private long inFlight;
+    private long reclaimed;
+    private long failed;
+    private long batches;
+
+    public NativeProxyStats(long tracked, long inFlight, long reclaimed,
+                            long failed, long batches)
+    {
+        this.tracked = tracked;
+        this.inFlight = inFlight;
+        this.reclaimed = reclaimed;
+        this.failed = failed;
+        this.batches = batches;
+    }
+
+    /**
+     * Number of open proxies which will be reclaimed if they are collected
+     * before being closed.
+     */
+    public long getTracked() {
+        return tracked;
+    }
+
+    /**
+     * Number of collected proxies in the batch the reclaimer thread is
+     * currently releasing: taken off the reference queue but not yet
+     * released. This is at most one batch; references the garbage
+     * collector has queued but the reclaimer hasn't dequeued yet aren't
+     * counted, as ReferenceQueue doesn't expose its length.
+     */
+    public long getInFlight() {
+        return inFlight;
+    }
+
+    /**
+     * Number of collected proxies whose native resources were released.
+     */
+    public long getReclaimed() {
+        return reclaimed;
+    }
+
+    /**
+     * Number of collected proxies whose native resources couldn't be
+     * released.
+     */
+    public long getFailed() {
+        return failed;
+    }
+
+    /**
+     * Number of batches processed by the reclaimer thread.
+     */
+    public long getBatches() {
+        return batches;
+    }
+
+    @Override
+    public String toString() {
+        return "NativeProxyStats [tracked=" + tracked +
+               ", inFlight=" + inFlight +
+               ", reclaimed=" + reclaimed +
+               ", failed=" + failed +
+               ", batches=" + batches + "]";
+    }
+}
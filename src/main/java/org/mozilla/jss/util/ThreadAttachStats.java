@@ -0,0 +1,55 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+package org.mozilla.jss.util;
+
+/**
+ * Counters for native threads attached to the JVM by JSS so that NSS
+ * callbacks can call back into Java.
+ *
+ * This class is a data class; it contains public getters and no setters.
+ * It usually should be constructed via a call to
+ * CryptoManager.getThreadAttachStats() rather than directly constructing
+ * an instance. The values are a snapshot and are not updated afterwards.
+ */
+public class ThreadAttachStats {
+    private long attaches;
+    private long detaches;
+    private long hits;
+
+    public ThreadAttachStats(long attaches, long detaches, long hits) {
+        this.attaches = attaches;
+        this.detaches = detaches;
+        this.hits = hits;
+    }
+
+    /**
+     * Number of threads JSS attached to the JVM.
+     */
+    public long getAttaches() {
+        return attaches;
+    }
+
+    /**
+     * Number of threads attached by JSS which were detached again when
+     * they exited.
+     */
+    public long getDetaches() {
+        return detaches;
+    }
+
+    /**
+     * Number of callbacks made on a thread which was already attached.
+     */
+    public long getHits() {
+        return hits;
+    }
+
+    @Override
+    public String toString() {
+        return "ThreadAttachStats [attaches=" + attaches +
+               ", detaches=" + detaches +
+               ", hits=" + hits + "]";
+    }
+}
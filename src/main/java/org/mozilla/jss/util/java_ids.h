@@ -4,6 +4,8 @@
 #ifndef JAVA_IDS_H
 #define JAVA_IDS_H
 
+#include <jni.h>
+
 PR_BEGIN_EXTERN_C
 
 /*
@@ -35,7 +37,7 @@ PR_BEGIN_EXTERN_C
  * CipherContextProxy
  */
 #define CIPHER_CONTEXT_PROXY_CLASS_NAME "org/mozilla/jss/pkcs11/CipherContextProxy"
-#define CIPHER_CONTEXT_PROXY_CONSTRUCTOR_SIG "([B)V"
+#define CIPHER_CONTEXT_PROXY_CONSTRUCTOR_SIG "(J)V"
 
 /*
  * Collection
@@ -87,6 +89,7 @@ PR_BEGIN_EXTERN_C
 #define RC2_KEYTYPE_FIELD "RC2"
 #define SHA1_HMAC_KEYTYPE_FIELD "SHA1_HMAC"
 #define AES_KEYTYPE_FIELD "AES"
+#define CHACHA20_KEYTYPE_FIELD "CHACHA20"
 #define GENERIC_SECRET_KEYTYPE_FIELD "GENERIC_SECRET"
 
 /*
@@ -94,7 +97,9 @@ PR_BEGIN_EXTERN_C
  */
 #define NATIVE_PROXY_CLASS_NAME  "org/mozilla/jss/util/NativeProxy"
 #define NATIVE_PROXY_POINTER_FIELD "mPointer"
-#define NATIVE_PROXY_POINTER_SIG "[B"
+#define NATIVE_PROXY_POINTER_SIG "J"
+#define NATIVE_PROXY_CLEAR_NAME "clear"
+#define NATIVE_PROXY_CLEAR_SIG "()V"
 
 /*
  * NSSInit
@@ -294,6 +299,8 @@ PR_BEGIN_EXTERN_C
  * SSLAlertEvent
  */
 #define SSL_ALERT_EVENT_CLASS "org/mozilla/jss/ssl/SSLAlertEvent"
+#define SSL_ALERT_EVENT_SSLFD_CONSTRUCTOR_SIG \
+    "(L" SSLFD_PROXY_CLASS_NAME ";II)V"
 
 /*
  * SSLCertificateApprovalCallback
@@ -401,7 +408,7 @@ PR_BEGIN_EXTERN_C
  * BufferProxy
  */
 #define BUFFER_PROXY_CLASS_NAME "org/mozilla/jss/nss/BufferProxy"
-#define BUFFER_PROXY_CONSTRUCTOR_SIG "([B)V"
+#define BUFFER_PROXY_CONSTRUCTOR_SIG "(J)V"
 
 /*
  * GlobalRefProxy
@@ -439,6 +446,48 @@ PR_BEGIN_EXTERN_C
 #define SSL_PRELIMINARY_CHANNEL_INFO_CLASS_NAME "org/mozilla/jss/nss/SSLPreliminaryChannelInfo"
 #define SSL_PRELIMINARY_CHANNEL_INFO_CONSTRUCTOR_SIG "(JIIZJZIZZII)V"
 
+/*
+ * ArrayList
+ */
+#define ARRAY_LIST_CLASS_NAME "java/util/ArrayList"
+#define ARRAY_LIST_ADD_NAME "add"
+#define ARRAY_LIST_ADD_SIG "(Ljava/lang/Object;)Z"
+
+/*
+** Looking identifiers up by name is expensive relative to the small amount
+** of work done by many of our native methods, so the ones used on hot paths
+** are resolved once, when libjss is loaded (see JNI_OnLoad in jssutil.c),
+** and cached here. Classes are held as global references for the lifetime
+** of the library; all of these are valid from any thread.
+*/
+typedef struct {
+    jclass algorithmClass;
+    jfieldID algorithmOidIndex;
+
+    jclass arrayListClass;
+    jmethodID arrayListAdd;
+
+    jclass bufferProxyClass;
+    jmethodID bufferProxyConstructor;
+
+    jclass cipherContextProxyClass;
+    jmethodID cipherContextProxyConstructor;
+
+    jclass nativeProxyClass;
+    jfieldID nativeProxyPointer;
+    jmethodID nativeProxyClear;
+
+    jclass sslAlertEventClass;
+    jmethodID sslAlertEventConstructor;
+
+    jclass validityStatusClass;
+    jmethodID validityStatusConstructor;
+    jmethodID validityStatusAddReason;
+} JSS_JavaIDs;
+
+/* defined in jssutil.c */
+extern JSS_JavaIDs JSS_javaIDs;
+
 PR_END_EXTERN_C
 
 #endif
@@ -14,6 +14,8 @@ PR_BEGIN_EXTERN_C
 
 #define JAVA_LANG_EXCEPTION "java/lang/Exception"
 
+#define AEAD_BAD_TAG_EXCEPTION "javax/crypto/AEADBadTagException"
+
 #define ALREADY_INITIALIZED_EXCEPTION "org/mozilla/jss/crypto/AlreadyInitializedException"
 
 #define ARRAY_INDEX_OUT_OF_BOUNDS_EXCEPTION "java/lang/ArrayIndexOutOfBoundsException"
@@ -5,6 +5,7 @@
 #include <jni.h>
 #include <nspr.h>
 #include <plstr.h>
+#include <stdatomic.h>
 #include <seccomon.h>
 #include <secitem.h>
 #include "jssutil.h"
@@ -19,6 +20,260 @@
 #include "secerr.h"
 #include "keyhi.h"
 
+/***********************************************************************
+**
+** Cached JNI identifiers; see java_ids.h.
+*/
+JSS_JavaIDs JSS_javaIDs;
+
+static PRStatus
+JSS_cacheClass(JNIEnv *env, const char *className, jclass *clazz)
+{
+    jclass localClass = (*env)->FindClass(env, className);
+    if (localClass == NULL) {
+        return PR_FAILURE;
+    }
+
+    *clazz = (jclass) (*env)->NewGlobalRef(env, localClass);
+    (*env)->DeleteLocalRef(env, localClass);
+    if (*clazz == NULL) {
+        ASSERT_OUTOFMEM(env);
+        return PR_FAILURE;
+    }
+
+    return PR_SUCCESS;
+}
+
+static PRStatus
+JSS_cacheMethod(JNIEnv *env, jclass clazz, const char *name, const char *sig,
+    jmethodID *method)
+{
+    *method = (*env)->GetMethodID(env, clazz, name, sig);
+    return *method == NULL ? PR_FAILURE : PR_SUCCESS;
+}
+
+static PRStatus
+JSS_cacheField(JNIEnv *env, jclass clazz, const char *name, const char *sig,
+    jfieldID *field)
+{
+    *field = (*env)->GetFieldID(env, clazz, name, sig);
+    return *field == NULL ? PR_FAILURE : PR_SUCCESS;
+}
+
+static void
+JSS_releaseJavaIDs(JNIEnv *env)
+{
+    jclass *classes[] = {
+        &JSS_javaIDs.algorithmClass,
+        &JSS_javaIDs.arrayListClass,
+        &JSS_javaIDs.bufferProxyClass,
+        &JSS_javaIDs.cipherContextProxyClass,
+        &JSS_javaIDs.nativeProxyClass,
+        &JSS_javaIDs.sslAlertEventClass,
+        &JSS_javaIDs.validityStatusClass,
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (*classes[i] != NULL) {
+            (*env)->DeleteGlobalRef(env, *classes[i]);
+        }
+    }
+
+    memset(&JSS_javaIDs, 0, sizeof(JSS_javaIDs));
+}
+
+static PRStatus
+JSS_initJavaIDs(JNIEnv *env)
+{
+    JSS_JavaIDs *ids = &JSS_javaIDs;
+
+    if (JSS_cacheClass(env, ALGORITHM_CLASS_NAME, &ids->algorithmClass) != PR_SUCCESS ||
+        JSS_cacheField(env, ids->algorithmClass, OID_INDEX_FIELD_NAME,
+                       OID_INDEX_FIELD_SIG, &ids->algorithmOidIndex) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, ARRAY_LIST_CLASS_NAME, &ids->arrayListClass) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->arrayListClass, ARRAY_LIST_ADD_NAME,
+                        ARRAY_LIST_ADD_SIG, &ids->arrayListAdd) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, BUFFER_PROXY_CLASS_NAME, &ids->bufferProxyClass) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->bufferProxyClass, PLAIN_CONSTRUCTOR,
+                        BUFFER_PROXY_CONSTRUCTOR_SIG,
+                        &ids->bufferProxyConstructor) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, CIPHER_CONTEXT_PROXY_CLASS_NAME,
+                       &ids->cipherContextProxyClass) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->cipherContextProxyClass, PLAIN_CONSTRUCTOR,
+                        CIPHER_CONTEXT_PROXY_CONSTRUCTOR_SIG,
+                        &ids->cipherContextProxyConstructor) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, NATIVE_PROXY_CLASS_NAME, &ids->nativeProxyClass) != PR_SUCCESS ||
+        JSS_cacheField(env, ids->nativeProxyClass, NATIVE_PROXY_POINTER_FIELD,
+                       NATIVE_PROXY_POINTER_SIG, &ids->nativeProxyPointer) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->nativeProxyClass, NATIVE_PROXY_CLEAR_NAME,
+                        NATIVE_PROXY_CLEAR_SIG, &ids->nativeProxyClear) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, SSL_ALERT_EVENT_CLASS, &ids->sslAlertEventClass) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->sslAlertEventClass, PLAIN_CONSTRUCTOR,
+                        SSL_ALERT_EVENT_SSLFD_CONSTRUCTOR_SIG,
+                        &ids->sslAlertEventConstructor) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    if (JSS_cacheClass(env, SSLCERT_APP_CB_VALIDITY_STATUS_CLASS,
+                       &ids->validityStatusClass) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->validityStatusClass, PLAIN_CONSTRUCTOR,
+                        PLAIN_CONSTRUCTOR_SIG,
+                        &ids->validityStatusConstructor) != PR_SUCCESS ||
+        JSS_cacheMethod(env, ids->validityStatusClass,
+                        SSLCERT_APP_CB_VALIDITY_STATUS_ADD_REASON_NAME,
+                        SSLCERT_APP_CB_VALIDITY_STATUS_ADD_REASON_SIG,
+                        &ids->validityStatusAddReason) != PR_SUCCESS)
+    {
+        return PR_FAILURE;
+    }
+
+    return PR_SUCCESS;
+}
+
+/***********************************************************************
+**
+** J N I _ O n L o a d
+**
+** Called by the JVM when libjss is loaded. Resolves the identifiers in
+** JSS_javaIDs; if any can't be found, the library fails to load rather
+** than failing later on first use.
+*/
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved)
+{
+    JNIEnv *env = NULL;
+
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK ||
+        env == NULL)
+    {
+        return JNI_ERR;
+    }
+
+    if (JSS_initJavaIDs(env) != PR_SUCCESS) {
+        JSS_releaseJavaIDs(env);
+        return JNI_ERR;
+    }
+
+    JSS_javaVM = vm;
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT void JNICALL
+JNI_OnUnload(JavaVM *vm, void *reserved)
+{
+    JNIEnv *env = NULL;
+
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) == JNI_OK &&
+        env != NULL)
+    {
+        JSS_releaseJavaIDs(env);
+    }
+}
+
+/***********************************************************************
+**
+** Threads attached by JSS_attachCurrentThread.
+**
+** The JVM already remembers each thread's JNIEnv, so an attached thread
+** only costs a GetEnv lookup on later calls. NSPR thread-private data marks
+** the threads we attached ourselves, so that its destructor can detach
+** them again when they exit rather than leaking their java.lang.Thread.
+*/
+static PRCallOnceType attachOnce;
+static PRUintn attachThreadIndex;
+
+static _Atomic uint64_t attachCount;
+static _Atomic uint64_t detachCount;
+static _Atomic uint64_t attachHits;
+
+static void PR_CALLBACK
+JSS_detachThreadOnExit(void *priv)
+{
+    JavaVM *vm = priv;
+
+    if (vm != NULL && (*vm)->DetachCurrentThread(vm) == JNI_OK) {
+        atomic_fetch_add_explicit(&detachCount, 1, memory_order_relaxed);
+    }
+}
+
+static PRStatus
+JSS_initAttachIndex(void)
+{
+    return PR_NewThreadPrivateIndex(&attachThreadIndex, JSS_detachThreadOnExit);
+}
+
+PRStatus
+JSS_attachCurrentThread(JNIEnv **env)
+{
+    JavaVM *vm = JSS_javaVM;
+
+    PR_ASSERT(env != NULL);
+    *env = NULL;
+
+    if (vm == NULL) {
+        return PR_FAILURE;
+    }
+
+    if ((*vm)->GetEnv(vm, (void **)env, JNI_VERSION_1_6) == JNI_OK &&
+        *env != NULL)
+    {
+        atomic_fetch_add_explicit(&attachHits, 1, memory_order_relaxed);
+        return PR_SUCCESS;
+    }
+
+    if (PR_CallOnce(&attachOnce, JSS_initAttachIndex) != PR_SUCCESS) {
+        return PR_FAILURE;
+    }
+
+    if ((*vm)->AttachCurrentThread(vm, (void **)env, NULL) != JNI_OK ||
+        *env == NULL)
+    {
+        *env = NULL;
+        return PR_FAILURE;
+    }
+
+    atomic_fetch_add_explicit(&attachCount, 1, memory_order_relaxed);
+
+    /* Should we fail to record the thread, it merely stays attached until
+     * the JVM exits, as it always used to. */
+    PR_SetThreadPrivate(attachThreadIndex, vm);
+    return PR_SUCCESS;
+}
+
+void
+JSS_getAttachStats(JSS_AttachStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    stats->attaches = atomic_load_explicit(&attachCount, memory_order_relaxed);
+    stats->detaches = atomic_load_explicit(&detachCount, memory_order_relaxed);
+    stats->hits = atomic_load_explicit(&attachHits, memory_order_relaxed);
+}
+
 /***********************************************************************
 **
 ** J S S _ t h r o w M s g P r E r r A r g
@@ -197,13 +452,7 @@ JSS_throw(JNIEnv *env, char *throwableClassName)
 PRStatus
 JSS_getPtrFromProxy(JNIEnv *env, jobject nativeProxy, void **ptr)
 {
-#ifdef DEBUG
-    jclass nativeProxyClass;
-#endif
-	jclass proxyClass;
-    jfieldID byteArrayField;
-    jbyteArray byteArray;
-    int size;
+    jlong handle;
 
     PR_ASSERT(env!=NULL && nativeProxy != NULL && ptr != NULL);
     if( nativeProxy == NULL ) {
@@ -211,48 +460,16 @@ JSS_getPtrFromProxy(JNIEnv *env, jobject nativeProxy, void **ptr)
         return PR_FAILURE;
     }
 
-	proxyClass = (*env)->GetObjectClass(env, nativeProxy);
-	PR_ASSERT(proxyClass != NULL);
-
-#ifdef DEBUG
-    nativeProxyClass = (*env)->FindClass(
-								env,
-								NATIVE_PROXY_CLASS_NAME);
-    if(nativeProxyClass == NULL) {
-        ASSERT_OUTOFMEM(env);
-        return PR_FAILURE;
-    }
-
     /* make sure what we got was really a NativeProxy object */
-    PR_ASSERT( (*env)->IsInstanceOf(env, nativeProxy, nativeProxyClass) );
-#endif
-
-    byteArrayField = (*env)->GetFieldID(
-								env,
-								proxyClass,
-								NATIVE_PROXY_POINTER_FIELD,
-						        NATIVE_PROXY_POINTER_SIG);
-    if(byteArrayField==NULL) {
-        ASSERT_OUTOFMEM(env);
-        return PR_FAILURE;
-    }
+    PR_ASSERT(JSS_javaIDs.nativeProxyPointer != NULL);
+    PR_ASSERT( (*env)->IsInstanceOf(env, nativeProxy,
+                                    JSS_javaIDs.nativeProxyClass) );
 
-    byteArray = (jbyteArray) (*env)->GetObjectField(env, nativeProxy,
-                        byteArrayField);
-    if (byteArray == NULL) {
-        *ptr = NULL;
-    } else {
-        size = sizeof(*ptr);
-        PR_ASSERT((*env)->GetArrayLength(env, byteArray) == size);
-        (*env)->GetByteArrayRegion(env, byteArray, 0, size, (void*)ptr);
-    }
+    handle = (*env)->GetLongField(env, nativeProxy,
+                                  JSS_javaIDs.nativeProxyPointer);
+    *ptr = JSS_handleToPtr(handle);
 
-    if( (*env)->ExceptionOccurred(env) ) {
-        PR_ASSERT(PR_FALSE);
-        return PR_FAILURE;
-    } else {
-        return PR_SUCCESS;
-    }
+    return PR_SUCCESS;
 }
 
 /***********************************************************************
@@ -896,28 +1113,14 @@ void JSS_SECStatusToExceptionMessage(JNIEnv *env, SECStatus result, PRErrorCode
 PRStatus
 JSS_clearPtrFromProxy(JNIEnv *env, jobject nativeProxy)
 {
-    jclass proxyClass;
-    jmethodID nativeProxyClear;
-
     PR_ASSERT(env!=NULL && nativeProxy != NULL);
     if( nativeProxy == NULL ) {
         JSS_throw(env, NULL_POINTER_EXCEPTION);
         return PR_FAILURE;
     }
 
-    proxyClass = (*env)->GetObjectClass(env, nativeProxy);
-    PR_ASSERT(proxyClass != NULL);
-
-    nativeProxyClear = (*env)->GetMethodID(env,
-                                           proxyClass,
-                                           "clear",
-                                           "()V");
-    if (nativeProxyClear == NULL) {
-        ASSERT_OUTOFMEM(env);
-        return PR_FAILURE;
-    }
-
-    (*env)->CallVoidMethod(env, nativeProxy, nativeProxyClear);
+    PR_ASSERT(JSS_javaIDs.nativeProxyClear != NULL);
+    (*env)->CallVoidMethod(env, nativeProxy, JSS_javaIDs.nativeProxyClear);
     if ((*env)->ExceptionOccurred(env)) {
         PR_ASSERT(PR_FALSE);
         return PR_FAILURE;
@@ -2,6 +2,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <certt.h>
 #include <nspr.h>
@@ -41,6 +42,39 @@ void PR_DetachThread(void);
 /* defined in CryptoManager.c */
 extern JavaVM *JSS_javaVM;
 
+/***********************************************************************
+** J S S _ a t t a c h C u r r e n t T h r e a d
+**
+** Get the JNIEnv of the calling thread, attaching it to JSS_javaVM first
+** if it isn't already attached. Use this from callbacks which NSS may
+** invoke on threads not started by Java.
+**
+** A thread attached here stays attached until it exits, at which point it
+** is detached again; callers must not call DetachCurrentThread themselves.
+** Threads which were already attached are left to their owner.
+**
+** Returns: PR_SUCCESS on success, PR_FAILURE if the thread couldn't be
+** attached. No exception is thrown.
+*/
+PRStatus
+JSS_attachCurrentThread(JNIEnv **env);
+
+/* Snapshot of the counters kept by JSS_attachCurrentThread. */
+typedef struct {
+    /* Number of threads attached to the JVM. */
+    uint64_t attaches;
+
+    /* Number of attached threads detached again on exit. */
+    uint64_t detaches;
+
+    /* Number of calls satisfied by an already attached thread. */
+    uint64_t hits;
+} JSS_AttachStats;
+
+/* Fill stats with a snapshot of JSS_attachCurrentThread's counters. */
+void
+JSS_getAttachStats(JSS_AttachStats *stats);
+
 /***********************************************************************
  * J S S _ t h r o w M s g
  *
@@ -180,6 +214,14 @@ JSS_getPtrFromProxyOwner(JNIEnv *env, jobject proxyOwner, char* proxyFieldName,
 jbyteArray
 JSS_ptrToByteArray(JNIEnv *env, void *ptr);
 
+/*
+ * Convert between a C pointer and the handle held by a NativeProxy. The
+ * handle can be passed into a NativeProxy(long) constructor, which avoids
+ * the allocation made by JSS_ptrToByteArray.
+ */
+#define JSS_ptrToHandle(ptr) ((jlong) (intptr_t) (ptr))
+#define JSS_handleToPtr(handle) ((void *) (intptr_t) (handle))
+
 /************************************************************************
  *
  * J S S _ w i p e C h a r A r r a y
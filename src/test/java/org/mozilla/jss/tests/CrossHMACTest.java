@@ -115,6 +115,47 @@ public class CrossHMACTest {
         }
     }
 
+    /**
+     * Checks that an HMAC reused with the same key, by initializing it
+     * again, resetting it part way through, or cloning it, matches a fresh
+     * one.
+     */
+    public void reuseHMAC(String alg, SecretKeyFacade sk, String clearText)
+            throws Exception {
+        Mac mozillaHmac = Mac.getInstance(alg, MOZ_PROVIDER_NAME);
+        mozillaHmac.init(sk);
+        byte[] expected = mozillaHmac.doFinal(clearText.getBytes());
+
+        for (int i = 0; i < 3; i++) {
+            mozillaHmac.init(sk);
+            mozillaHmac.update(clearText.getBytes());
+            mozillaHmac.reset();
+            if (!MessageDigest.isEqual(expected,
+                    mozillaHmac.doFinal(clearText.getBytes()))) {
+                throw new Exception("ERROR: reused " + alg +
+                        " gives a different result");
+            }
+        }
+
+        // A keyed HMAC can always be copied before any input.
+        mozillaHmac.init(sk);
+        Mac copy = (Mac) mozillaHmac.clone();
+        if (!MessageDigest.isEqual(expected,
+                copy.doFinal(clearText.getBytes()))) {
+            throw new Exception("ERROR: cloned " + alg +
+                    " gives a different result");
+        }
+
+        // So can one which hasn't been initialized yet.
+        Mac fresh = (Mac) Mac.getInstance(alg, MOZ_PROVIDER_NAME).clone();
+        fresh.init(sk);
+        if (!MessageDigest.isEqual(expected,
+                fresh.doFinal(clearText.getBytes()))) {
+            throw new Exception("ERROR: " + alg + " cloned before init" +
+                    " gives a different result");
+        }
+    }
+
     public boolean fipsMode() {
         return cm.FIPSEnabled();
     }
@@ -173,6 +214,7 @@ public class CrossHMACTest {
                         hmacTest.doHMAC(JSS_HMAC_Algs[i], sk, clearText);
                     }
                 }
+                hmacTest.reuseHMAC(JSS_HMAC_Algs[i], sk, clearText);
             }
 
         } catch (Exception e) {
@@ -7,6 +7,10 @@ import java.io.FileInputStream;
 import java.security.MessageDigest;
 import java.security.Provider;
 import java.security.Security;
+import java.util.Arrays;
+
+import org.mozilla.jss.crypto.DigestAlgorithm;
+import org.mozilla.jss.pkcs11.PK11MessageDigest;
 
 public class DigestTest {
 
@@ -20,6 +24,9 @@ public class DigestTest {
      * List all the Digest Algorithms that JSS implements.
      */
     static final String JSS_Digest_Algs[] = { "SHA-256", "SHA-384","SHA-512" };
+    static final DigestAlgorithm JSS_Digest_Alg_Objects[] = {
+        DigestAlgorithm.SHA256, DigestAlgorithm.SHA384, DigestAlgorithm.SHA512
+    };
 
     public static boolean messageDigestCompare(String alg, byte[] toBeDigested)
     throws Exception {
@@ -86,6 +93,76 @@ public class DigestTest {
         return true;
     }
 
+    /**
+     * Checks that a digest cloned part way through gives the same results
+     * as digesting each whole input from scratch.
+     */
+    public static void testClone(String alg, byte[] toBeDigested)
+    throws Exception {
+        int prefix = toBeDigested.length / 2;
+
+        MessageDigest mozillaDigest =
+                MessageDigest.getInstance(alg, MOZ_PROVIDER_NAME);
+        byte[] expected = mozillaDigest.digest(toBeDigested);
+
+        mozillaDigest.update(toBeDigested, 0, prefix);
+        MessageDigest copy = (MessageDigest) mozillaDigest.clone();
+        MessageDigest other = (MessageDigest) mozillaDigest.clone();
+
+        // Finishing one copy must not disturb the others.
+        copy.update(toBeDigested, prefix, toBeDigested.length - prefix);
+        other.update(new byte[] { 0x42 });
+        mozillaDigest.update(toBeDigested, prefix,
+                toBeDigested.length - prefix);
+
+        if (!MessageDigest.isEqual(expected, copy.digest()) ||
+                !MessageDigest.isEqual(expected, mozillaDigest.digest()) ||
+                MessageDigest.isEqual(expected, other.digest())) {
+            throw new Exception("ERROR: cloned " + alg +
+                                " gives a different message digest");
+        }
+        System.out.println("Cloned " + alg + " digest is correct");
+    }
+
+    /**
+     * Checks PK11MessageDigest.digestAll against digesting each input on
+     * its own.
+     */
+    public static void testDigestAll(String alg, DigestAlgorithm jssAlg,
+            byte[] toBeDigested) throws Exception {
+        int count = 16;
+        int outLen = jssAlg.getOutputSize();
+        byte[][] inputs = new byte[count][];
+        int[] offsets = new int[count];
+        int[] lengths = new int[count];
+        for (int i = 0; i < count; i++) {
+            offsets[i] = (toBeDigested.length * i) / (2 * count);
+            lengths[i] = Math.min(i * 11, toBeDigested.length - offsets[i]);
+            inputs[i] = Arrays.copyOfRange(toBeDigested, offsets[i],
+                    offsets[i] + lengths[i]);
+        }
+
+        byte[] packed = PK11MessageDigest.digestAll(jssAlg, inputs);
+        byte[] fromData = PK11MessageDigest.digestAll(jssAlg, toBeDigested,
+                offsets, lengths);
+
+        MessageDigest mozillaDigest =
+                MessageDigest.getInstance(alg, MOZ_PROVIDER_NAME);
+        for (int i = 0; i < count; i++) {
+            byte[] expected = mozillaDigest.digest(inputs[i]);
+            byte[] actual = Arrays.copyOfRange(packed, i * outLen,
+                    (i + 1) * outLen);
+            byte[] actualFromData = Arrays.copyOfRange(fromData, i * outLen,
+                    (i + 1) * outLen);
+            if (!MessageDigest.isEqual(expected, actual) ||
+                    !MessageDigest.isEqual(expected, actualFromData)) {
+                throw new Exception("ERROR: digestAll gives a different " +
+                                    alg + " digest for input " + i);
+            }
+        }
+        System.out.println("Batched " + alg + " digests are correct");
+    }
+
 
     public static void main(String []argv) {
 
@@ -121,6 +198,9 @@ public class DigestTest {
                     // no provider to compare results with
                     testJSSDigest(JSS_Digest_Algs[i], toBeDigested);
                 }
+                testClone(JSS_Digest_Algs[i], toBeDigested);
+                testDigestAll(JSS_Digest_Algs[i], JSS_Digest_Alg_Objects[i],
+                        toBeDigested);
             }
 
             //HMAC examples in org.mozilla.jss.tests.HMACTest
@@ -5,6 +5,7 @@
 package org.mozilla.jss.tests;
 
 import java.io.IOException;
+import java.nio.ByteBuffer;
 import java.security.AlgorithmParameters;
 import java.security.InvalidKeyException;
 import java.security.NoSuchAlgorithmException;
@@ -13,11 +14,15 @@ import java.security.Provider;
 import java.security.SecureRandom;
 import java.security.Security;
 import java.security.spec.AlgorithmParameterSpec;
+import java.util.Arrays;
 
+import javax.crypto.AEADBadTagException;
 import javax.crypto.Cipher;
 import javax.crypto.KeyGenerator;
 import javax.crypto.SecretKey;
 import javax.crypto.SecretKeyFactory;
+import javax.crypto.spec.GCMParameterSpec;
+import javax.crypto.spec.IvParameterSpec;
 import javax.crypto.spec.PBEKeySpec;
 import javax.crypto.spec.RC2ParameterSpec;
 
@@ -375,6 +380,206 @@ public class JCASymKeyGen {
         }
     }
 
+    /**
+     * Encrypt between direct ByteBuffers and decrypt between heap
+     * ByteBuffers, both of which the provider ciphers without copying.
+     *
+     * @param sKey
+     * @param algFamily
+     * @param algType
+     * @param provider
+     */
+    public void testByteBufferCipher(javax.crypto.SecretKey sKey,
+            String algFamily, String algType, String provider)
+            throws Exception {
+        byte[] plaintext = plainText;
+        if (algType.endsWith("PKCS5Padding")) {
+            plaintext = plainTextPad;
+        }
+
+        Cipher cipher = Cipher.getInstance(algType, provider);
+        AlgorithmParameterSpec RC2ParSpec = null;
+        AlgorithmParameters ap = null;
+
+        if (algFamily.compareToIgnoreCase("RC2")==0) {
+            byte[] iv = new byte[8];
+            SecureRandom random = SecureRandom.getInstance("pkcs11prng",
+                    MOZ_PROVIDER_NAME);
+            random.nextBytes(iv);
+            RC2ParSpec = new RC2ParameterSpec(128, iv);
+            cipher.init(Cipher.ENCRYPT_MODE, sKey, RC2ParSpec);
+        } else {
+            cipher.init(Cipher.ENCRYPT_MODE, sKey);
+            ap = cipher.getParameters();
+        }
+
+        // Size the output from getOutputSize(), which is all the provider
+        // needs to write straight into it.
+        int size = cipher.getOutputSize(plaintext.length);
+        ByteBuffer input = ByteBuffer.allocateDirect(plaintext.length);
+        ByteBuffer ciphertext = ByteBuffer.allocateDirect(size);
+        input.put(plaintext);
+        input.flip();
+
+        cipher.update(input, ciphertext);
+        cipher.doFinal(input, ciphertext);
+        if (input.hasRemaining()) {
+            throw new Exception("ERROR: " + algType +
+                    " didn't consume its direct input");
+        }
+        ciphertext.flip();
+
+        cipher = Cipher.getInstance(algType, provider);
+        if (RC2ParSpec != null) {
+            cipher.init(Cipher.DECRYPT_MODE, sKey, RC2ParSpec);
+        } else if (ap != null) {
+            cipher.init(Cipher.DECRYPT_MODE, sKey, ap);
+        } else {
+            cipher.init(Cipher.DECRYPT_MODE, sKey);
+        }
+
+        byte[] encrypted = new byte[ciphertext.remaining()];
+        ciphertext.get(encrypted);
+        ByteBuffer recovered = ByteBuffer.allocate(
+                cipher.getOutputSize(encrypted.length));
+        cipher.doFinal(ByteBuffer.wrap(encrypted), recovered);
+        recovered.flip();
+
+        if (!ByteBuffer.wrap(plaintext).equals(recovered)) {
+            throw new Exception("ERROR: ByteBuffer round trip failed for " +
+                    algType);
+        }
+    }
+
+    /**
+     * Initialize one Cipher again for each message with a new IV, in both
+     * directions, and check it against a new Cipher each time. This is the
+     * case in which the provider reuses its PKCS #11 contexts. One message
+     * is abandoned part way through, and the rest go through direct
+     * buffers sized from getOutputSize().
+     *
+     * @param sKey
+     * @param algType
+     * @param provider
+     */
+    public void testCipherReuse(javax.crypto.SecretKey sKey, String algType,
+            String provider) throws Exception {
+        Cipher reused = Cipher.getInstance(algType, provider);
+        SecureRandom random = SecureRandom.getInstance("pkcs11prng",
+                MOZ_PROVIDER_NAME);
+        int blockSize = reused.getBlockSize();
+        boolean padded = algType.endsWith("PKCS5Padding");
+
+        for (int i = 0; i < 6; i++) {
+            byte[] iv = new byte[blockSize];
+            random.nextBytes(iv);
+            IvParameterSpec spec = new IvParameterSpec(iv);
+            byte[] plaintext = new byte[padded ? 7 * i + 3 :
+                    (2 * i + 1) * blockSize];
+            random.nextBytes(plaintext);
+
+            Cipher fresh = Cipher.getInstance(algType, provider);
+            fresh.init(Cipher.ENCRYPT_MODE, sKey, spec);
+            byte[] expected = fresh.doFinal(plaintext);
+
+            if (i == 3) {
+                reused.init(Cipher.ENCRYPT_MODE, sKey, spec);
+                reused.update(plaintext, 0, blockSize + 1);
+            }
+            reused.init(Cipher.ENCRYPT_MODE, sKey, spec);
+            ByteBuffer input = ByteBuffer.allocateDirect(plaintext.length);
+            input.put(plaintext);
+            input.flip();
+            ByteBuffer output = ByteBuffer.allocateDirect(
+                    reused.getOutputSize(plaintext.length));
+            reused.doFinal(input, output);
+            output.flip();
+            if (!output.equals(ByteBuffer.wrap(expected))) {
+                throw new Exception("ERROR: " + algType + " ciphertext " + i +
+                        " differs from a new Cipher's");
+            }
+
+            reused.init(Cipher.DECRYPT_MODE, sKey, spec);
+            if (!Arrays.equals(plaintext, reused.doFinal(expected))) {
+                throw new Exception("ERROR: " + algType + " plaintext " + i +
+                        " differs from the original");
+            }
+        }
+    }
+
+    /**
+     * Encrypt several messages under one AES key with AES/GCM/NoPadding,
+     * each with its own nonce and AAD, and check that they decrypt, that
+     * tampering is detected, and that otherProvider (when given) agrees.
+     *
+     * @param sKey
+     * @param provider
+     * @param otherProvider
+     */
+    public void testAEADCipher(javax.crypto.SecretKey sKey, String provider,
+            String otherProvider) throws Exception {
+        String algType = "AES/GCM/NoPadding";
+        byte[] aad = "JSS AEAD test".getBytes();
+        Cipher encryptor = Cipher.getInstance(algType, provider);
+        Cipher decryptor = Cipher.getInstance(algType, provider);
+
+        for (int i = 0; i < 3; i++) {
+            byte[] plaintext = (i % 2 == 0) ? plainText : plainTextPadB;
+
+            // The provider generates a fresh nonce on every init.
+            encryptor.init(Cipher.ENCRYPT_MODE, sKey);
+            GCMParameterSpec spec = encryptor.getParameters()
+                    .getParameterSpec(GCMParameterSpec.class);
+            encryptor.updateAAD(aad);
+            byte[] ciphertext = encryptor.doFinal(plaintext);
+            if (ciphertext.length != plaintext.length + 16) {
+                throw new Exception("ERROR: " + algType + " produced " +
+                        ciphertext.length + " bytes for " +
+                        plaintext.length + " bytes of input");
+            }
+
+            decryptor.init(Cipher.DECRYPT_MODE, sKey, spec);
+            decryptor.updateAAD(aad);
+            byte[] recovered = decryptor.doFinal(ciphertext);
+            if (!Arrays.equals(plaintext, recovered)) {
+                throw new Exception("ERROR: " + algType +
+                        " round trip failed");
+            }
+
+            ciphertext[0] ^= 1;
+            decryptor.init(Cipher.DECRYPT_MODE, sKey, spec);
+            decryptor.updateAAD(aad);
+            try {
+                decryptor.doFinal(ciphertext);
+                throw new Exception("ERROR: " + algType +
+                        " accepted a tampered message");
+            } catch (AEADBadTagException expected) {
+                // Expected.
+            }
+            ciphertext[0] ^= 1;
+
+            if (otherProvider != null) {
+                Cipher other = Cipher.getInstance(algType, otherProvider);
+                other.init(Cipher.DECRYPT_MODE, sKey, spec);
+                other.updateAAD(aad);
+                if (!Arrays.equals(plaintext,
+                        other.doFinal(ciphertext))) {
+                    throw new Exception("ERROR: " + otherProvider +
+                            " disagrees with " + provider + " on " + algType);
+                }
+            }
+        }
+
+        // Encrypting twice under the same nonce must be refused.
+        try {
+            encryptor.doFinal(plainText);
+            throw new Exception("ERROR: " + algType +
+                    " allowed a second message under one nonce");
+        } catch (IllegalStateException expected) {
+            // Expected.
+        }
+    }
+
     public static void main(String args[]) {
 
         String certDbLoc             = ".";
@@ -462,6 +667,13 @@ public class JCASymKeyGen {
                     skg.testMultiPartCipher(mozKey, symKeyTable[i][0],
                         symKeyTable[i][a],
                         MOZ_PROVIDER_NAME, MOZ_PROVIDER_NAME);
+                    skg.testByteBufferCipher(mozKey, symKeyTable[i][0],
+                        symKeyTable[i][a], MOZ_PROVIDER_NAME);
+                    if (symKeyTable[i][a].contains("/CBC/") &&
+                            !symKeyTable[i][0].equals("RC2")) {
+                        skg.testCipherReuse(mozKey, symKeyTable[i][a],
+                            MOZ_PROVIDER_NAME);
+                    }
 
                     try {
                         //check to see if the otherProvider we are testing
@@ -498,6 +710,11 @@ public class JCASymKeyGen {
                     }
                 }
             }
+
+            mozKey = skg.genSecretKey("AES", MOZ_PROVIDER_NAME);
+            skg.testAEADCipher(mozKey, MOZ_PROVIDER_NAME,
+                    bFipsMode ? null : otherProvider);
+            System.out.println(MOZ_PROVIDER_NAME + " tested AES/GCM/NoPadding");
         } catch(Exception e) {
             e.printStackTrace();
             System.exit(1);
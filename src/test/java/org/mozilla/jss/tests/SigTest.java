@@ -22,6 +22,8 @@ import org.mozilla.jss.crypto.KeyPairGeneratorSpi;
 import org.mozilla.jss.crypto.Policy;
 import org.mozilla.jss.crypto.Signature;
 import org.mozilla.jss.crypto.SignatureAlgorithm;
+import org.mozilla.jss.nss.SECErrors;
+import org.mozilla.jss.pkcs11.PK11Signature;
 import org.mozilla.jss.pkcs11.PK11Token;
 
 public class SigTest {
@@ -121,6 +123,75 @@ public class SigTest {
             throw new Exception("ERROR: PSS Signature failed to verify.");
         }
 
+        // Batch verification, mixing natively batched and PSS items, with
+        // every third signature corrupted.
+        int count = 12;
+        PublicKey[] keys = new PublicKey[count];
+        SignatureAlgorithm[] algs = new SignatureAlgorithm[count];
+        byte[][] batchData = new byte[count][];
+        byte[][] signatures = new byte[count][];
+        for (int i = 0; i < count; i++) {
+            Signature batchSigner = i % 4 == 3 ? signerPSS : signer;
+            keys[i] = keyPair.getPublic();
+            algs[i] = i % 4 == 3 ?
+                SignatureAlgorithm.RSAPSSSignatureWithSHA256Digest :
+                SignatureAlgorithm.RSASignatureWithSHA256Digest;
+            batchData[i] = new byte[i + 1];
+            java.util.Arrays.fill(batchData[i], (byte) i);
+
+            batchSigner.initSign(
+                    (org.mozilla.jss.crypto.PrivateKey) keyPair.getPrivate());
+            batchSigner.update(batchData[i]);
+            signatures[i] = batchSigner.sign();
+            if (i % 3 == 0) {
+                signatures[i][signatures[i].length / 2] ^= 0x01;
+            }
+        }
+
+        int[] errors = new int[count];
+        for (int threads : new int[] {1, 4}) {
+            PK11Signature.setBatchThreads(threads);
+            boolean[] verified = PK11Signature.verifyBatch(keys, algs,
+                    batchData, signatures, errors);
+            for (int i = 0; i < count; i++) {
+                boolean expected = i % 3 != 0;
+                if (verified[i] != expected) {
+                    throw new Exception("ERROR: Batch item " + i +
+                            " verified: " + verified[i]);
+                }
+                if (!expected && errors[i] != SECErrors.BAD_SIGNATURE) {
+                    throw new Exception("ERROR: Batch item " + i +
+                            " failed with " + errors[i]);
+                }
+            }
+        }
+        PK11Signature.setBatchThreads(0);
+        System.out.println("Batch Signatures Verified Successfully!");
+
+        // Raw batch signing must match raw signing one digest at a time.
+        Signature rawSigner = token.getSignatureContext(
+                SignatureAlgorithm.RSASignature);
+        byte[][] digests = new byte[count][];
+        for (int i = 0; i < count; i++) {
+            digests[i] = java.security.MessageDigest.getInstance("SHA-256")
+                    .digest(batchData[i]);
+        }
+        PK11Signature.setBatchThreads(4);
+        byte[][] rawSignatures = PK11Signature.rawSignBatch(
+                (org.mozilla.jss.crypto.PrivateKey) keyPair.getPrivate(),
+                digests);
+        PK11Signature.setBatchThreads(0);
+        for (int i = 0; i < count; i++) {
+            rawSigner.initSign(
+                    (org.mozilla.jss.crypto.PrivateKey) keyPair.getPrivate());
+            rawSigner.update(digests[i]);
+            if (!java.util.Arrays.equals(rawSigner.sign(), rawSignatures[i])) {
+                throw new Exception("ERROR: Raw batch signature " + i +
+                        " differs");
+            }
+        }
+        System.out.println("Batch Raw Signatures Created Successfully!");
+
         System.out.println("SigTest passed.");
     }
 }
@@ -4,11 +4,15 @@
 
 package org.mozilla.jss.tests;
 
+import java.io.ByteArrayOutputStream;
+import java.nio.ByteBuffer;
 import java.security.InvalidAlgorithmParameterException;
 import java.security.spec.AlgorithmParameterSpec;
 import java.util.LinkedList;
 import java.util.List;
 
+import javax.crypto.BadPaddingException;
+import javax.crypto.spec.GCMParameterSpec;
 import javax.crypto.spec.RC2ParameterSpec;
 
 import org.mozilla.jss.CryptoManager;
@@ -22,6 +26,7 @@ import org.mozilla.jss.crypto.KeyGenerator;
 import org.mozilla.jss.crypto.PBEAlgorithm;
 import org.mozilla.jss.crypto.PBEKeyGenParams;
 import org.mozilla.jss.crypto.SymmetricKey;
+import org.mozilla.jss.pkcs11.PK11Cipher;
 import org.mozilla.jss.pkcs11.PK11SecureRandom;
 import org.mozilla.jss.util.Password;
 
@@ -201,6 +206,326 @@ public class SymKeyGen {
         return bStatus; // no exception was thrown.
     }
 
+    /**
+     * Checks PK11Cipher.encryptBatch and decryptBatch against encrypting
+     * and decrypting each message on its own.
+     */
+    public void batchTest(SymmetricKey key, EncryptionAlgorithm eAlg)
+        throws Exception {
+
+        boolean padded = eAlg.getPadding() != EncryptionAlgorithm.Padding.NONE;
+        boolean blocks = !padded && !eAlg.isAEAD() &&
+            (eAlg.getMode() == EncryptionAlgorithm.Mode.CBC ||
+             eAlg.getMode() == EncryptionAlgorithm.Mode.ECB);
+        int ivLength = eAlg.isAEAD() ? 12 : eAlg.getIVLength();
+        int count = 20;
+
+        PK11SecureRandom rng = new PK11SecureRandom();
+        byte[][] ivs = ivLength == 0 ? null : new byte[count][];
+        byte[][] inputs = new byte[count][];
+        int[] lengths = new int[count];
+        for (int i = 0; i < count; i++) {
+            // Unpadded block modes need whole blocks.
+            lengths[i] = blocks ? (i % 4) * eAlg.getBlockSize() : i * 3;
+            inputs[i] = new byte[lengths[i]];
+            rng.nextBytes(inputs[i]);
+            if (ivs != null) {
+                ivs[i] = new byte[ivLength];
+                rng.nextBytes(ivs[i]);
+            }
+        }
+
+        PK11Cipher.BatchResult encrypted =
+            PK11Cipher.encryptBatch(key, eAlg, ivs, inputs);
+        if (encrypted.size() != count) {
+            throw new Exception("Wrong batch size: " + encrypted.size());
+        }
+
+        Cipher cipher = token.getCipherContext(eAlg);
+        byte[][] ciphertexts = new byte[count][];
+        for (int i = 0; i < count; i++) {
+            AlgorithmParameterSpec spec = null;
+            if (eAlg.isAEAD()) {
+                spec = new GCMParameterSpec(128, ivs[i]);
+            } else if (ivs != null) {
+                spec = new IVParameterSpec(ivs[i]);
+            }
+
+            if (spec == null) {
+                cipher.initEncrypt(key);
+            } else {
+                cipher.initEncrypt(key, spec);
+            }
+            byte[] expected = cipher.doFinal(inputs[i]);
+            ciphertexts[i] = encrypted.get(i);
+            if (!java.util.Arrays.equals(expected, ciphertexts[i])) {
+                throw new Exception("Batch ciphertext " + i + " differs for " +
+                    eAlg);
+            }
+        }
+
+        PK11Cipher.BatchResult decrypted =
+            PK11Cipher.decryptBatch(key, eAlg, ivs, ciphertexts);
+        for (int i = 0; i < count; i++) {
+            if (!java.util.Arrays.equals(inputs[i], decrypted.get(i))) {
+                throw new Exception("Batch plaintext " + i + " differs for " +
+                    eAlg);
+            }
+        }
+
+        // The same through direct buffers.
+        ByteBuffer input = ByteBuffer.allocateDirect(
+            encrypted.getOutput().length);
+        input.put(encrypted.getOutput()).flip();
+        int[] ctLengths = new int[count];
+        for (int i = 0; i < count; i++) {
+            ctLengths[i] = ciphertexts[i].length;
+        }
+        ByteBuffer output = ByteBuffer.allocateDirect(
+            PK11Cipher.getBatchOutputSize(eAlg, ctLengths));
+        int[] offsets = PK11Cipher.decryptBatch(key, eAlg, ivs, input,
+            ctLengths, output);
+        if (input.hasRemaining() ||
+                output.position() != offsets[count]) {
+            throw new Exception("Batch buffers not advanced for " + eAlg);
+        }
+        for (int i = 0; i < count; i++) {
+            byte[] plaintext = new byte[offsets[i + 1] - offsets[i]];
+            output.position(offsets[i]);
+            output.get(plaintext);
+            if (!java.util.Arrays.equals(inputs[i], plaintext)) {
+                throw new Exception("Direct batch plaintext " + i +
+                    " differs for " + eAlg);
+            }
+        }
+
+        // A corrupted message must fail the whole batch.
+        if (padded || eAlg.isAEAD()) {
+            int last = count - 1;
+            ciphertexts[last][ciphertexts[last].length - 1] ^= 0x5a;
+            try {
+                PK11Cipher.decryptBatch(key, eAlg, ivs, ciphertexts);
+                if (eAlg.isAEAD()) {
+                    throw new Exception("Tampered batch decrypted for " + eAlg);
+                }
+            } catch (BadPaddingException e) {
+                // expected; padding is only sometimes detectably wrong
+            }
+        }
+    }
+
+    /**
+     * Checks that PK11Cipher.reinit gives the same results as initializing
+     * the cipher afresh for each message, including when messages are
+     * passed in over several calls.
+     */
+    public void reinitTest(SymmetricKey key, EncryptionAlgorithm eAlg)
+        throws Exception {
+
+        boolean padded = eAlg.getPadding() != EncryptionAlgorithm.Padding.NONE;
+        int blockSize = eAlg.getBlockSize();
+        int ivLength = eAlg.getIVLength();
+
+        PK11SecureRandom rng = new PK11SecureRandom();
+        Cipher fresh = token.getCipherContext(eAlg);
+        PK11Cipher encryptor = (PK11Cipher) token.getCipherContext(eAlg);
+        PK11Cipher decryptor = (PK11Cipher) token.getCipherContext(eAlg);
+
+        for (int i = 0; i < 12; i++) {
+            // Unpadded modes need whole blocks.
+            int length = padded ? i * 5 : (i % 4) * blockSize;
+            int split = padded ? i * 2 : (i % 2) * blockSize;
+            byte[] input = new byte[length];
+            rng.nextBytes(input);
+            byte[] iv = null;
+            if (ivLength > 0) {
+                iv = new byte[ivLength];
+                rng.nextBytes(iv);
+            }
+
+            if (iv == null) {
+                fresh.initEncrypt(key);
+            } else {
+                fresh.initEncrypt(key, new IVParameterSpec(iv));
+            }
+            byte[] expected = fresh.doFinal(input);
+
+            if (i == 0) {
+                if (iv == null) {
+                    encryptor.initEncrypt(key);
+                    decryptor.initDecrypt(key);
+                } else {
+                    encryptor.initEncrypt(key, new IVParameterSpec(iv));
+                    decryptor.initDecrypt(key, new IVParameterSpec(iv));
+                }
+            } else {
+                encryptor.reinit(iv);
+                decryptor.reinit(iv);
+            }
+
+            ByteArrayOutputStream out = new ByteArrayOutputStream();
+            out.write(encryptor.update(input, 0, split));
+            out.write(encryptor.doFinal(input, split, length - split));
+            if (!java.util.Arrays.equals(expected, out.toByteArray())) {
+                throw new Exception("Reinitialized ciphertext " + i +
+                    " differs for " + eAlg);
+            }
+
+            out.reset();
+            out.write(decryptor.update(expected, 0, split));
+            out.write(decryptor.doFinal(expected, split,
+                expected.length - split));
+            if (!java.util.Arrays.equals(input, out.toByteArray())) {
+                throw new Exception("Reinitialized plaintext " + i +
+                    " differs for " + eAlg);
+            }
+        }
+
+        // Abandon a message part way through; the next must not carry on
+        // from its chaining or stream state.
+        byte[] input = new byte[4 * blockSize];
+        rng.nextBytes(input);
+        byte[] iv = null;
+        if (ivLength > 0) {
+            iv = new byte[ivLength];
+            rng.nextBytes(iv);
+            fresh.initEncrypt(key, new IVParameterSpec(iv));
+        } else {
+            fresh.initEncrypt(key);
+        }
+        byte[] expected = fresh.doFinal(input);
+
+        encryptor.update(input, 0, 2 * blockSize);
+        encryptor.reinit(iv);
+        if (!java.util.Arrays.equals(expected, encryptor.doFinal(input))) {
+            throw new Exception("Ciphertext after an abandoned message " +
+                "differs for " + eAlg);
+        }
+
+        decryptor.update(expected, 0, 2 * blockSize);
+        decryptor.reinit(iv);
+        if (!java.util.Arrays.equals(input, decryptor.doFinal(expected))) {
+            throw new Exception("Plaintext after an abandoned message " +
+                "differs for " + eAlg);
+        }
+
+        if (ivLength > 0) {
+            try {
+                encryptor.reinit(new byte[ivLength - 1]);
+                throw new Exception("Short IV accepted for " + eAlg);
+            } catch (InvalidAlgorithmParameterException e) {
+                // expected
+            }
+        }
+
+        encryptor.close();
+        decryptor.close();
+    }
+
+    /**
+     * Checks that PK11Cipher writes straight into ByteBuffers with no more
+     * room than getRequiredOutputSize() asks for, across several updates,
+     * and that the result matches the byte array interface.
+     */
+    public void directOutputTest(SymmetricKey key, EncryptionAlgorithm eAlg)
+        throws Exception {
+
+        boolean padded = eAlg.getPadding() != EncryptionAlgorithm.Padding.NONE;
+        int blockSize = eAlg.getBlockSize();
+        IVParameterSpec iv = null;
+        if (eAlg.getIVLength() > 0) {
+            iv = genIV(eAlg.getIVLength());
+        }
+
+        byte[] input = new byte[(padded ? 5 : 6) * blockSize + (padded ? 3 : 0)];
+        new PK11SecureRandom().nextBytes(input);
+
+        Cipher fresh = token.getCipherContext(eAlg);
+        if (iv == null) {
+            fresh.initEncrypt(key);
+        } else {
+            fresh.initEncrypt(key, iv);
+        }
+        byte[] expected = fresh.doFinal(input);
+
+        PK11Cipher cipher = (PK11Cipher) token.getCipherContext(eAlg);
+        if (iv == null) {
+            cipher.initEncrypt(key);
+        } else {
+            cipher.initEncrypt(key, iv);
+        }
+        // Uneven pieces when padded, so that partial blocks are held back.
+        int piece = padded ? blockSize + 3 : 2 * blockSize;
+        byte[] encrypted = directOutput(cipher, input, piece);
+        if (!java.util.Arrays.equals(expected, encrypted)) {
+            throw new Exception("Direct ciphertext differs for " + eAlg);
+        }
+
+        if (iv == null) {
+            cipher.initDecrypt(key);
+        } else {
+            cipher.initDecrypt(key, iv);
+        }
+        byte[] decrypted = directOutput(cipher, encrypted, 2 * blockSize);
+        if (!java.util.Arrays.equals(input, decrypted)) {
+            throw new Exception("Direct plaintext differs for " + eAlg);
+        }
+
+        if (iv != null) {
+            // Again after reinit(), which applies the IV by hand.
+            cipher.initEncrypt(key, iv);
+            cipher.reinit(iv.getIV());
+            if (!java.util.Arrays.equals(expected,
+                    directOutput(cipher, input, piece))) {
+                throw new Exception("Reinitialized direct ciphertext " +
+                    "differs for " + eAlg);
+            }
+
+            cipher.initDecrypt(key, iv);
+            cipher.reinit(iv.getIV());
+            if (!java.util.Arrays.equals(input,
+                    directOutput(cipher, encrypted, blockSize + 3))) {
+                throw new Exception("Reinitialized direct plaintext " +
+                    "differs for " + eAlg);
+            }
+        }
+
+        cipher.close();
+    }
+
+    /**
+     * Passes input through cipher in pieces, giving each call an output
+     * buffer of exactly the required size; PK11Cipher throws rather than
+     * copying when that is too small.
+     */
+    private byte[] directOutput(PK11Cipher cipher, byte[] input, int piece)
+        throws Exception {
+
+        ByteArrayOutputStream out = new ByteArrayOutputStream();
+        for (int offset = 0; offset <= input.length; offset += piece) {
+            int length = Math.min(piece, input.length - offset);
+            boolean last = offset + length == input.length;
+
+            ByteBuffer src = ByteBuffer.allocateDirect(length);
+            src.put(input, offset, length).flip();
+            ByteBuffer dst = ByteBuffer.allocateDirect(
+                cipher.getRequiredOutputSize(length, last));
+            if (last) {
+                cipher.doFinal(src, dst);
+            } else {
+                cipher.update(src, dst);
+            }
+
+            byte[] result = new byte[dst.flip().remaining()];
+            dst.get(result);
+            out.write(result);
+            if (last) {
+                break;
+            }
+        }
+        return out.toByteArray();
+    }
+
     private SymKeyGen( String certDbLoc) {
         try {
             CryptoManager cm  = CryptoManager.getInstance();
@@ -274,6 +599,9 @@ public class SymKeyGen {
         skg.cipherTest(key, EncryptionAlgorithm.DES3_CBC_PAD);
         skg.cipherTest(key, EncryptionAlgorithm.DES3_CBC);
         skg.cipherTest(key, EncryptionAlgorithm.DES3_ECB);
+        skg.batchTest(key, EncryptionAlgorithm.DES3_CBC_PAD);
+        skg.batchTest(key, EncryptionAlgorithm.DES3_ECB);
+        skg.reinitTest(key, EncryptionAlgorithm.DES3_CBC_PAD);
         System.out.println("DESede key and cipher tests correct");
 
         // AES 128 key
@@ -281,6 +609,16 @@ public class SymKeyGen {
         skg.cipherTest(key, EncryptionAlgorithm.AES_128_CBC);
         skg.cipherTest(key, EncryptionAlgorithm.AES_128_ECB);
         skg.cipherTest(key, EncryptionAlgorithm.AES_128_CBC_PAD);
+        skg.batchTest(key, EncryptionAlgorithm.AES_128_CBC);
+        skg.batchTest(key, EncryptionAlgorithm.AES_128_ECB);
+        skg.batchTest(key, EncryptionAlgorithm.AES_128_CBC_PAD);
+        skg.batchTest(key, EncryptionAlgorithm.AES_128_GCM);
+        skg.reinitTest(key, EncryptionAlgorithm.AES_128_CBC);
+        skg.reinitTest(key, EncryptionAlgorithm.AES_128_ECB);
+        skg.reinitTest(key, EncryptionAlgorithm.AES_128_CBC_PAD);
+        skg.directOutputTest(key, EncryptionAlgorithm.AES_128_CBC);
+        skg.directOutputTest(key, EncryptionAlgorithm.AES_128_ECB);
+        skg.directOutputTest(key, EncryptionAlgorithm.AES_128_CBC_PAD);
         System.out.println("AES 128 key and cipher tests correct");
 
         // AES 192 key
@@ -306,6 +644,8 @@ public class SymKeyGen {
         // RC4 key
         key = skg.genSymKey(KeyGenAlgorithm.RC4, SymmetricKey.RC4, 128, 128/8);
         skg.cipherTest(key, EncryptionAlgorithm.RC4);
+        skg.batchTest(key, EncryptionAlgorithm.RC4);
+        skg.reinitTest(key, EncryptionAlgorithm.RC4);
         System.out.println("RC4 key and cipher tests correct");
 
         //Todo
@@ -1,7 +1,13 @@
 package org.mozilla.jss.tests;
 
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
+
 import org.mozilla.jss.nss.Buffer;
+import org.mozilla.jss.nss.BufferPoolStats;
 import org.mozilla.jss.nss.BufferProxy;
+import org.mozilla.jss.util.NativeProxy;
+import org.mozilla.jss.util.NativeProxyStats;
 
 public class TestBuffer {
     public static void TestCreateFree() {
@@ -71,7 +77,258 @@ public class TestBuffer {
         Buffer.Free(buf);
     }
 
-    public static void main(String[] args) {
+    public static void TestByteBuffers() {
+        BufferProxy buf = Buffer.Create(6);
+        byte[] data = { 0x01, 0x02, 0x03, 0x04 };
+        assert(buf != null);
+
+        ByteBuffer heap_src = ByteBuffer.wrap(data);
+        assert(Buffer.WriteFrom(buf, heap_src) == 4);
+        assert(heap_src.remaining() == 0);
+
+        ByteBuffer direct_dst = ByteBuffer.allocateDirect(3);
+        assert(Buffer.ReadInto(buf, direct_dst) == 3);
+        assert(direct_dst.position() == 3);
+        assert(direct_dst.get(0) == 0x01);
+        assert(direct_dst.get(2) == 0x03);
+
+        // Writing six bytes now wraps around the end of the ring but only
+        // five fit; the last must remain in the source.
+        ByteBuffer direct_src = ByteBuffer.allocateDirect(6);
+        direct_src.put(new byte[] { 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A });
+        direct_src.flip();
+        assert(Buffer.WriteFrom(buf, direct_src) == 5);
+        assert(direct_src.remaining() == 1);
+        assert(!Buffer.CanWrite(buf));
+
+        ByteBuffer heap_dst = ByteBuffer.allocate(8);
+        heap_dst.position(1);
+        assert(Buffer.ReadInto(buf, heap_dst) == 6);
+        assert(heap_dst.position() == 7);
+        assert(heap_dst.get(1) == 0x04);
+        assert(heap_dst.get(6) == 0x09);
+        assert(!Buffer.CanRead(buf));
+
+        assert(Buffer.ReadInto(buf, heap_dst) == 0);
+
+        Buffer.Free(buf);
+    }
+
+    public static void TestReadIntoReadOnly() {
+        BufferProxy buf = Buffer.Create(4);
+        byte[] data = { 0x01, 0x02, 0x03 };
+        assert(buf != null);
+
+        assert(Buffer.Write(buf, data) == 3);
+
+        // Read-only destinations are rejected without draining the buffer.
+        ByteBuffer[] dsts = {
+            ByteBuffer.allocate(3).asReadOnlyBuffer(),
+            ByteBuffer.allocateDirect(3).asReadOnlyBuffer(),
+        };
+        for (ByteBuffer dst : dsts) {
+            boolean thrown = false;
+            try {
+                Buffer.ReadInto(buf, dst);
+            } catch (ReadOnlyBufferException robe) {
+                thrown = true;
+            }
+
+            assert(thrown);
+            assert(dst.position() == 0);
+            assert(Buffer.ReadCapacity(buf) == 3);
+        }
+
+        byte[] out_data = Buffer.Read(buf, 3);
+        assert(out_data.length == 3);
+        assert(out_data[0] == data[0]);
+        assert(out_data[2] == data[2]);
+
+        Buffer.Free(buf);
+    }
+
+    public static void TestPeekCommit() {
+        BufferProxy buf = Buffer.Create(4);
+        assert(buf != null);
+
+        ByteBuffer span = Buffer.PeekWrite(buf);
+        assert(span != null);
+        assert(span.remaining() == 4);
+        span.put((byte) 0x01);
+        span.put((byte) 0x02);
+        span.put((byte) 0x03);
+        assert(!Buffer.CanRead(buf));
+        assert(Buffer.Commit(buf, 3) == 3);
+        assert(Buffer.ReadCapacity(buf) == 3);
+
+        span = Buffer.PeekRead(buf);
+        assert(span != null);
+        assert(span.remaining() == 3);
+        assert(span.get(0) == 0x01);
+        assert(Buffer.Consume(buf, 2) == 2);
+        assert(Buffer.ReadCapacity(buf) == 1);
+
+        // The writable region now wraps: one byte at the end, then two at
+        // the head of the ring. Each peek only returns the contiguous span.
+        span = Buffer.PeekWrite(buf);
+        assert(span.remaining() == 1);
+        span.put((byte) 0x04);
+        assert(Buffer.Commit(buf, 8) == 1);
+
+        span = Buffer.PeekWrite(buf);
+        assert(span.remaining() == 2);
+        span.put((byte) 0x05);
+        assert(Buffer.Commit(buf, 1) == 1);
+
+        span = Buffer.PeekRead(buf);
+        assert(span.remaining() == 2);
+        assert(span.get(0) == 0x03);
+        assert(span.get(1) == 0x04);
+        assert(Buffer.Consume(buf, 2) == 2);
+
+        span = Buffer.PeekRead(buf);
+        assert(span.remaining() == 1);
+        assert(span.get(0) == 0x05);
+        assert(Buffer.Consume(buf, 1) == 1);
+
+        assert(Buffer.PeekRead(buf) == null);
+        assert(Buffer.Consume(buf, 1) == 0);
+
+        // Once drained, the next writable span covers the whole buffer.
+        span = Buffer.PeekWrite(buf);
+        assert(span.remaining() == 4);
+
+        Buffer.Free(buf);
+    }
+
+    public static void TestElastic() {
+        // Four byte chunks, with the ceiling rounded up to 12 bytes.
+        BufferProxy buf = Buffer.CreateElastic(4, 10);
+        byte[] data = new byte[16];
+        for (int i = 0; i < data.length; i++) {
+            data[i] = (byte) i;
+        }
+
+        assert(buf != null);
+        assert(Buffer.Capacity(buf) == 12);
+        assert(Buffer.WriteCapacity(buf) == 12);
+
+        // Writes spanning several chunks stop at the ceiling.
+        assert(Buffer.Write(buf, data) == 12);
+        assert(!Buffer.CanWrite(buf));
+        assert(Buffer.ReadCapacity(buf) == 12);
+
+        // Spans never cross a chunk boundary.
+        ByteBuffer span = Buffer.PeekRead(buf);
+        assert(span != null && span.remaining() == 4);
+
+        byte[] out_data = Buffer.Read(buf, 6);
+        assert(out_data.length == 6);
+        for (int i = 0; i < out_data.length; i++) {
+            assert(out_data[i] == data[i]);
+        }
+
+        // Only the fully drained first chunk has been released.
+        assert(Buffer.WriteCapacity(buf) == 4);
+
+        out_data = Buffer.Read(buf, 16);
+        assert(out_data.length == 6);
+        for (int i = 0; i < out_data.length; i++) {
+            assert(out_data[i] == data[i + 6]);
+        }
+
+        assert(!Buffer.CanRead(buf));
+        assert(Buffer.WriteCapacity(buf) == 12);
+
+        Buffer.Free(buf);
+    }
+
+    public static void TestSPSC() {
+        assert(Buffer.CreateSPSC(0) == null);
+
+        BufferProxy buf = Buffer.CreateSPSC(4);
+        byte[] data = {0x01, 0x02, 0x03, 0x04, 0x05};
+
+        assert(buf != null);
+        assert(Buffer.Capacity(buf) == 4);
+        assert(Buffer.Write(buf, data) == 4);
+        assert(!Buffer.CanWrite(buf));
+
+        byte[] out_data = Buffer.Read(buf, 3);
+        assert(out_data.length == 3);
+        assert(Buffer.Put(buf, (byte) 0x06) == 0x06);
+
+        out_data = Buffer.Read(buf, 5);
+        assert(out_data.length == 2);
+        assert(out_data[0] == 0x04 && out_data[1] == 0x06);
+        assert(!Buffer.CanRead(buf));
+
+        Buffer.Free(buf);
+    }
+
+    public static void TestPool() {
+        BufferPoolStats before = Buffer.GetPoolStats();
+        byte[] data = {0x01, 0x02, 0x03};
+
+        BufferProxy buf = Buffer.Create(37);
+        assert(Buffer.Write(buf, data) == 3);
+        Buffer.Free(buf);
+
+        // Freed buffers are wiped before they're handed out again.
+        buf = Buffer.Create(37);
+        assert(!Buffer.CanRead(buf));
+        assert(Buffer.WriteCapacity(buf) == 37);
+
+        BufferPoolStats after = Buffer.GetPoolStats();
+        assert(after.getHits() == before.getHits() + 1);
+        assert(after.getMisses() == before.getMisses() + 1);
+        assert(after.getLeased() == before.getLeased() + 1);
+        assert(after.getLeasedHighWater() >= after.getLeased());
+        Buffer.Free(buf);
+
+        // With pooling disabled, nothing is kept idle.
+        long limit = Buffer.GetPoolLimit();
+        Buffer.SetPoolLimit(0);
+        assert(Buffer.GetPoolStats().getIdle() == 0);
+
+        Buffer.SetPoolLimit(limit);
+        assert(Buffer.GetPoolLimit() == limit);
+    }
+
+    public static void TestReclaim() throws Exception {
+        NativeProxyStats before = NativeProxy.getReclaimStats();
+
+        // Closed buffers are no longer tracked for reclamation. Buffers
+        // leaked by earlier tests might be reclaimed meanwhile, so the count
+        // can drop further.
+        BufferProxy buf = Buffer.Create(41);
+        long tracked = NativeProxy.getReclaimStats().getTracked();
+        buf.close();
+        assert(NativeProxy.getReclaimStats().getTracked() <= tracked - 1);
+
+        // Leaked buffers are returned to the pool once collected.
+        long leased = Buffer.GetPoolStats().getLeased();
+        for (int i = 0; i < 10; i++) {
+            Buffer.Create(41);
+        }
+        assert(Buffer.GetPoolStats().getLeased() <= leased + 10);
+
+        for (int i = 0; i < 100; i++) {
+            System.gc();
+            Thread.sleep(100);
+
+            if (NativeProxy.getReclaimStats().getReclaimed() >= before.getReclaimed() + 10) {
+                break;
+            }
+        }
+
+        NativeProxyStats after = NativeProxy.getReclaimStats();
+        assert(after.getReclaimed() >= before.getReclaimed() + 10);
+        assert(after.getFailed() == before.getFailed());
+        assert(Buffer.GetPoolStats().getLeased() <= leased);
+    }
+
+    public static void main(String[] args) throws Exception {
         System.loadLibrary("jss");
 
         System.out.println("Calling TestCreateFree()...");
@@ -85,5 +342,26 @@ public class TestBuffer {
 
         System.out.println("Calling TestPutGet()...");
         TestPutGet();
+
+        System.out.println("Calling TestByteBuffers()...");
+        TestByteBuffers();
+
+        System.out.println("Calling TestReadIntoReadOnly()...");
+        TestReadIntoReadOnly();
+
+        System.out.println("Calling TestPeekCommit()...");
+        TestPeekCommit();
+
+        System.out.println("Calling TestElastic()...");
+        TestElastic();
+
+        System.out.println("Calling TestSPSC()...");
+        TestSPSC();
+
+        System.out.println("Calling TestPool()...");
+        TestPool();
+
+        System.out.println("Calling TestReclaim()...");
+        TestReclaim();
     }
 }
@@ -75,6 +75,51 @@ void test_read_write(PRFileDesc *fd) {
 
 }
 
+void test_writev(PRFileDesc *fd, j_buffer *write_buf, size_t write_buf_len)
+{
+    uint8_t first[700];
+    uint8_t second[700];
+    uint8_t output[1400];
+    PRIOVec in_vec[2];
+    struct iovec out_vec[2];
+    size_t expected = sizeof(first) + sizeof(second);
+
+    memset(first, 'a', sizeof(first));
+    memset(second, 'b', sizeof(second));
+
+    in_vec[0].iov_base = (char *) first;
+    in_vec[0].iov_len = sizeof(first);
+    in_vec[1].iov_base = (char *) second;
+    in_vec[1].iov_len = sizeof(second);
+
+    if (expected > write_buf_len) {
+        expected = write_buf_len;
+    }
+
+    assert(PR_Writev(fd, in_vec, 2, PR_INTERVAL_NO_TIMEOUT) == (PRInt32) expected);
+    assert(jb_read_capacity(write_buf) == expected);
+
+    if (expected == write_buf_len) {
+        /* A full buffer must report EWOULDBLOCK rather than a zero-length
+         * write. */
+        assert(PR_Writev(fd, in_vec, 2, PR_INTERVAL_NO_TIMEOUT) == -1);
+        assert(PR_GetError() == PR_WOULD_BLOCK_ERROR);
+    }
+
+    /* Scatter the result back out across two arrays of uneven length. */
+    out_vec[0].iov_base = output;
+    out_vec[0].iov_len = 100;
+    out_vec[1].iov_base = output + 100;
+    out_vec[1].iov_len = sizeof(output) - 100;
+
+    assert(jb_readv(write_buf, out_vec, 2) == expected);
+    assert(!jb_can_read(write_buf));
+
+    for (size_t i = 0; i < expected; i++) {
+        assert(output[i] == (i < sizeof(first) ? 'a' : 'b'));
+    }
+}
+
 void test_with_buffer_size(size_t read_buf_len, size_t write_buf_len)
 {
     /* Initialize Read/Write Buffers */
@@ -85,6 +130,67 @@ void test_with_buffer_size(size_t read_buf_len, size_t write_buf_len)
                                          (uint8_t *) "localhost", 9);
 
     test_getsocketoption(fd, read_buf_len, write_buf_len);
+    test_writev(fd, write_buf, write_buf_len);
+
+    PR_Close(fd);
+    jb_free(read_buf);
+    jb_free(write_buf);
+}
+
+void test_elastic(size_t chunk_size, size_t max_capacity)
+{
+    /* Initialize elastic Read/Write Buffers */
+    j_buffer *read_buf = jb_alloc_elastic(chunk_size, max_capacity);
+    j_buffer *write_buf = jb_alloc_elastic(chunk_size, max_capacity);
+    size_t capacity = jb_capacity(write_buf);
+    uint8_t input[100];
+    uint8_t output[100];
+    size_t written = 0;
+
+    assert(capacity >= max_capacity && capacity % chunk_size == 0);
+    assert(write_buf->chunk_count == 1);
+
+    PRFileDesc *fd = newBufferPRFileDesc(read_buf, write_buf,
+                                         (uint8_t *) "localhost", 9);
+
+    test_getsocketoption(fd, capacity, capacity);
+
+    /* Fill the buffer through the PRFileDesc; it should grow a chunk at a
+     * time until it hits its ceiling. */
+    for (size_t i = 0; i < sizeof(input); i++) {
+        input[i] = (uint8_t) i;
+    }
+
+    while (jb_can_write(write_buf)) {
+        PRInt32 ret = PR_Write(fd, input, sizeof(input));
+        assert(ret > 0);
+        written += ret;
+    }
+
+    assert(written == capacity);
+    assert(write_buf->chunk_count == capacity / chunk_size);
+    assert(PR_Write(fd, input, sizeof(input)) == -1);
+    assert(PR_GetError() == PR_WOULD_BLOCK_ERROR);
+
+    /* Drain it again; data must come back in order, and the buffer should
+     * shrink back to a single chunk once idle. */
+    while (written > 0) {
+        size_t offset = capacity - written;
+        size_t amount = jb_read(write_buf, output, sizeof(output));
+        assert(amount > 0);
+
+        for (size_t i = 0; i < amount; i++) {
+            assert(output[i] == (uint8_t)((offset + i) % sizeof(input)));
+        }
+
+        written -= amount;
+    }
+
+    assert(!jb_can_read(write_buf));
+    assert(write_buf->chunk_count == 1);
+    assert(jb_write_capacity(write_buf) == capacity);
+
+    test_writev(fd, write_buf, capacity);
 
     PR_Close(fd);
     jb_free(read_buf);
@@ -102,5 +208,8 @@ int main(int argc, char** argv)
     test_with_buffer_size(2048, 1023);
     test_with_buffer_size(1023, 2048);
 
+    test_elastic(1024, 4096);
+    test_elastic(1000, 2 * (16384 + 2048 + 5));
+
     return 0;
 }
@@ -0,0 +1,176 @@
+/*
+ * Test case for the j_buffer pool located under the org.mozilla.jss.ssl.javax
+ * package. This ensures that buffers are reused, wiped between leases, and
+ * that the pool respects its limit across threads.
+ */
+
+/* Optional, for enabling asserts */
+#define DEBUG 1
+
+/* Header file under test */
+#include "j_buffer_pool.h"
+
+/* NSPR required includes */
+#include <prthread.h>
+
+/* Standard includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+void test_reuse_and_wipe()
+{
+    j_buffer_pool_stats before;
+    j_buffer_pool_stats after;
+    uint8_t data[] = { 0x01, 0x02, 0x03, 0x04 };
+
+    jb_pool_get_stats(&before);
+
+    j_buffer *buf = jb_pool_lease(16);
+    assert(buf != NULL);
+    assert(jb_capacity(buf) == 16);
+    assert(jb_write(buf, data, sizeof(data)) == sizeof(data));
+    jb_pool_return(buf);
+
+    /* The same buffer should come back, empty and zeroed. */
+    j_buffer *again = jb_pool_lease(16);
+    assert(again == buf);
+    assert(!jb_can_read(again));
+    assert(jb_write_capacity(again) == 16);
+    for (size_t i = 0; i < jb_capacity(again); i++) {
+        assert(again->contents[i] == 0);
+    }
+
+    /* A different shape mustn't be satisfied by an idle buffer. */
+    j_buffer *other = jb_pool_lease(32);
+    assert(other != buf && jb_capacity(other) == 32);
+
+    jb_pool_get_stats(&after);
+    assert(after.hits == before.hits + 1);
+    assert(after.misses == before.misses + 2);
+    assert(after.leased == before.leased + 2);
+    assert(after.leased_high_water >= 2);
+
+    jb_pool_return(again);
+    jb_pool_return(other);
+}
+
+void test_elastic()
+{
+    uint8_t data[100] = { 0 };
+
+    j_buffer *buf = jb_pool_lease_elastic(10, 45);
+    assert(buf != NULL && jb_is_elastic(buf));
+    assert(jb_capacity(buf) == 50);
+
+    /* Grow to several chunks before returning it. */
+    assert(jb_write(buf, data, sizeof(data)) == 50);
+    assert(buf->chunk_count == 5);
+    jb_pool_return(buf);
+
+    /* Leasing with the same arguments matches despite the rounding, and
+     * comes back shrunk to a single chunk. */
+    j_buffer *again = jb_pool_lease_elastic(10, 45);
+    assert(again == buf);
+    assert(again->chunk_count == 1);
+    assert(!jb_can_read(again));
+    jb_pool_return(again);
+}
+
+void test_limit()
+{
+    j_buffer *bufs[2 * JB_POOL_THREAD_CACHE + 2];
+    size_t count = sizeof(bufs) / sizeof(bufs[0]);
+    j_buffer_pool_stats stats;
+    size_t limit = jb_pool_get_limit();
+
+    jb_pool_set_limit(JB_POOL_THREAD_CACHE + 1);
+
+    for (size_t i = 0; i < count; i++) {
+        bufs[i] = jb_pool_lease(64);
+        assert(bufs[i] != NULL);
+    }
+
+    /* Only limit buffers are kept; the rest are freed on return. Past the
+     * per-thread cache, they spill into the global list. */
+    for (size_t i = 0; i < count; i++) {
+        jb_pool_return(bufs[i]);
+    }
+
+    jb_pool_get_stats(&stats);
+    assert(stats.idle <= JB_POOL_THREAD_CACHE + 1);
+
+    /* Lowering the limit trims our own cache and the global list. */
+    jb_pool_set_limit(JB_POOL_THREAD_CACHE);
+    jb_pool_get_stats(&stats);
+    assert(stats.idle <= JB_POOL_THREAD_CACHE);
+
+    jb_pool_set_limit(0);
+    jb_pool_get_stats(&stats);
+    assert(stats.idle == 0);
+
+    jb_pool_set_limit(limit);
+}
+
+static void lease_and_return(void *arg)
+{
+    for (int round = 0; round < 1000; round++) {
+        j_buffer *bufs[JB_POOL_THREAD_CACHE + 2];
+        size_t count = sizeof(bufs) / sizeof(bufs[0]);
+
+        for (size_t i = 0; i < count; i++) {
+            bufs[i] = jb_pool_lease(128);
+            assert(bufs[i] != NULL && !jb_can_read(bufs[i]));
+            assert(jb_put(bufs[i], (uint8_t) i) == (int) i);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            jb_pool_return(bufs[i]);
+        }
+    }
+}
+
+void test_threads()
+{
+    PRThread *threads[8];
+    size_t count = sizeof(threads) / sizeof(threads[0]);
+    j_buffer_pool_stats stats;
+
+    jb_pool_get_stats(&stats);
+    size_t leased = stats.leased;
+
+    for (size_t i = 0; i < count; i++) {
+        threads[i] = PR_CreateThread(PR_USER_THREAD, lease_and_return, NULL,
+                                     PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                     PR_JOINABLE_THREAD, 0);
+        assert(threads[i] != NULL);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        assert(PR_JoinThread(threads[i]) == PR_SUCCESS);
+    }
+
+    /* Every lease was returned, and exiting threads handed their cached
+     * buffers back without exceeding the limit. */
+    jb_pool_get_stats(&stats);
+    assert(stats.leased == leased);
+    assert(stats.idle <= jb_pool_get_limit());
+    assert(stats.idle_high_water <= jb_pool_get_limit());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1) {
+        fprintf(stderr, "usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    test_reuse_and_wipe();
+    test_elastic();
+    test_limit();
+    test_threads();
+
+    return 0;
+}
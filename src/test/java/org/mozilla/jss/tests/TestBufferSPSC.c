@@ -0,0 +1,182 @@
+/*
+ * Test case for the single-producer/single-consumer j_buffer mode located
+ * under the org.mozilla.jss.ssl.javax package. This ensures that one thread
+ * can write to the buffer while another concurrently reads from it, and
+ * that every byte arrives exactly once and in order.
+ */
+
+/* Optional, for enabling asserts */
+#define DEBUG 1
+
+/* Header file under test */
+#include "j_buffer.h"
+
+/* NSPR required includes */
+#include <prthread.h>
+
+/* Standard includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define TOTAL_BYTES (1 << 22)
+
+/* The byte expected at each offset of the stream; 251 is prime, so this
+ * doesn't line up with the buffer's capacity. */
+static uint8_t expected_byte(size_t offset)
+{
+    return (uint8_t)(offset % 251);
+}
+
+void test_single_threaded()
+{
+    j_buffer *buf = jb_alloc_spsc(4);
+    uint8_t data[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+    uint8_t out[5] = { 0 };
+    size_t span_size = 0;
+
+    assert(jb_alloc_spsc(0) == NULL);
+
+    assert(jb_is_spsc(buf));
+    assert(jb_capacity(buf) == 4);
+    assert(!jb_can_read(buf));
+    assert(jb_write_capacity(buf) == 4);
+
+    assert(jb_write(buf, data, sizeof(data)) == 4);
+    assert(!jb_can_write(buf));
+    assert(jb_put(buf, 0x06) == EOF);
+
+    assert(jb_read(buf, out, 3) == 3);
+    assert(out[0] == 0x01 && out[1] == 0x02 && out[2] == 0x03);
+
+    /* The writable region wraps around; the first span stops at the end of
+     * storage. */
+    assert(jb_write(buf, data + 4, 1) == 1);
+    assert(jb_peek_write(buf, &span_size) != NULL && span_size == 2);
+    assert(jb_put(buf, 0x06) == 0x06);
+
+    /* Likewise, the readable region wraps around the end of storage. */
+    assert(jb_peek_read(buf, &span_size) != NULL && span_size == 1);
+    assert(jb_read(buf, out, sizeof(out)) == 3);
+    assert(out[0] == 0x04 && out[1] == 0x05 && out[2] == 0x06);
+    assert(jb_get(buf) == EOF);
+
+    jb_clear(buf);
+    assert(!jb_can_read(buf) && jb_write_capacity(buf) == 4);
+
+    jb_free(buf);
+}
+
+static void producer(void *arg)
+{
+    j_buffer *buf = arg;
+    uint8_t chunk[97];
+    size_t offset = 0;
+    size_t round = 0;
+
+    while (offset < TOTAL_BYTES) {
+        if (round++ % 2 == 0) {
+            /* Copying writes of varying size. */
+            size_t amount = 1 + (round % sizeof(chunk));
+            if (amount > TOTAL_BYTES - offset) {
+                amount = TOTAL_BYTES - offset;
+            }
+
+            for (size_t i = 0; i < amount; i++) {
+                chunk[i] = expected_byte(offset + i);
+            }
+
+            offset += jb_write(buf, chunk, amount);
+        } else {
+            /* Zero-copy writes straight into the ring. */
+            size_t span_size = 0;
+            uint8_t *span = jb_peek_write(buf, &span_size);
+            if (span == NULL) {
+                PR_Sleep(PR_INTERVAL_NO_WAIT);
+                continue;
+            }
+
+            if (span_size > TOTAL_BYTES - offset) {
+                span_size = TOTAL_BYTES - offset;
+            }
+
+            for (size_t i = 0; i < span_size; i++) {
+                span[i] = expected_byte(offset + i);
+            }
+
+            offset += jb_commit(buf, span_size);
+        }
+    }
+}
+
+static void consumer(void *arg)
+{
+    j_buffer *buf = arg;
+    uint8_t chunk[61];
+    size_t offset = 0;
+    size_t round = 0;
+
+    while (offset < TOTAL_BYTES) {
+        if (round++ % 2 == 0) {
+            size_t amount = jb_read(buf, chunk, 1 + (round % sizeof(chunk)));
+            for (size_t i = 0; i < amount; i++) {
+                assert(chunk[i] == expected_byte(offset + i));
+            }
+
+            offset += amount;
+        } else {
+            size_t span_size = 0;
+            const uint8_t *span = jb_peek_read(buf, &span_size);
+            if (span == NULL) {
+                PR_Sleep(PR_INTERVAL_NO_WAIT);
+                continue;
+            }
+
+            for (size_t i = 0; i < span_size; i++) {
+                assert(span[i] == expected_byte(offset + i));
+            }
+
+            offset += jb_consume(buf, span_size);
+        }
+    }
+}
+
+void test_concurrent(size_t capacity)
+{
+    j_buffer *buf = jb_alloc_spsc(capacity);
+
+    PRThread *write_thread = PR_CreateThread(PR_USER_THREAD, producer, buf,
+                                             PR_PRIORITY_NORMAL,
+                                             PR_GLOBAL_THREAD,
+                                             PR_JOINABLE_THREAD, 0);
+    PRThread *read_thread = PR_CreateThread(PR_USER_THREAD, consumer, buf,
+                                            PR_PRIORITY_NORMAL,
+                                            PR_GLOBAL_THREAD,
+                                            PR_JOINABLE_THREAD, 0);
+    assert(write_thread != NULL && read_thread != NULL);
+
+    assert(PR_JoinThread(write_thread) == PR_SUCCESS);
+    assert(PR_JoinThread(read_thread) == PR_SUCCESS);
+
+    assert(!jb_can_read(buf));
+    assert(jb_write_capacity(buf) == capacity);
+
+    jb_free(buf);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1) {
+        fprintf(stderr, "usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    test_single_threaded();
+    test_concurrent(1);
+    test_concurrent(1023);
+    test_concurrent(4096);
+
+    return 0;
+}
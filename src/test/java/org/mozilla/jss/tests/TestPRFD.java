@@ -1,5 +1,7 @@
 package org.mozilla.jss.tests;
 
+import java.nio.ByteBuffer;
+
 import org.mozilla.jss.nss.PR;
 import org.mozilla.jss.nss.PRErrors;
 import org.mozilla.jss.nss.PRFDProxy;
@@ -55,6 +57,48 @@ public class TestPRFD {
         assert(PR.Close(fd) == PR.SUCCESS);
     }
 
+    public static void TestPRWritev() {
+        PRFDProxy fd = PR.Open("results/prfd_writev", 0x04 | 0x08, 00644);
+        assert(fd != null);
+
+        ByteBuffer direct = ByteBuffer.allocateDirect(4);
+        direct.put(new byte[] {0x01, 0x02, 0x03, 0x04});
+        direct.flip();
+
+        ByteBuffer heap = ByteBuffer.wrap(new byte[] {0x05, 0x06, 0x07});
+        ByteBuffer empty = ByteBuffer.allocate(0);
+        ByteBuffer readOnly = ByteBuffer.wrap(new byte[] {0x08}).asReadOnlyBuffer();
+
+        ByteBuffer[] srcs = {direct, null, empty, heap, readOnly};
+
+        // Only the first two bytes of heap fit under max_amount.
+        assert(PR.Writev(fd, srcs, 0, srcs.length, 6) == 6);
+        assert(!direct.hasRemaining());
+        assert(heap.remaining() == 1);
+        assert(readOnly.remaining() == 1);
+
+        assert(PR.Writev(fd, srcs, 0, srcs.length, 100) == 2);
+        assert(!heap.hasRemaining());
+        assert(!readOnly.hasRemaining());
+
+        // Nothing left to gather.
+        assert(PR.Writev(fd, srcs, 0, srcs.length, 100) == 0);
+
+        assert(PR.Close(fd) == PR.SUCCESS);
+
+        fd = PR.Open("results/prfd_writev", 0x04, 00644);
+        assert(fd != null);
+
+        byte[] read_data = PR.Read(fd, 16);
+        assert(read_data != null);
+        assert(read_data.length == 8);
+        for (int i = 0; i < read_data.length; i++) {
+            assert(read_data[i] == i + 1);
+        }
+
+        assert(PR.Close(fd) == PR.SUCCESS);
+    }
+
     public static void TestNewTCPSocket() {
         PRFDProxy fd = PR.NewTCPSocket();
         assert(fd != null);
@@ -98,6 +142,9 @@ public class TestPRFD {
         System.out.println("Calling TestPREmptyRead()...");
         TestPREmptyRead();
 
+        System.out.println("Calling TestPRWritev()...");
+        TestPRWritev();
+
         System.out.println("Calling TestNewTCPSocket()...");
         TestNewTCPSocket();
 
@@ -16,6 +16,8 @@ import javax.net.ssl.TrustManager;
 import javax.net.ssl.TrustManagerFactory;
 
 import org.mozilla.jss.CryptoManager;
+import org.mozilla.jss.pkcs11.PK11Cert;
+import org.mozilla.jss.pkcs11.PK11PrivKey;
 import org.mozilla.jss.provider.javax.crypto.JSSNativeTrustManager;
 import org.mozilla.jss.provider.javax.crypto.JSSTrustManager;
 import org.mozilla.jss.ssl.SSLCipher;
@@ -23,6 +25,7 @@ import org.mozilla.jss.ssl.SSLVersion;
 import org.mozilla.jss.ssl.javax.JSSEngine;
 import org.mozilla.jss.ssl.javax.JSSEngineReferenceImpl;
 import org.mozilla.jss.ssl.javax.JSSParameters;
+import org.mozilla.jss.util.ThreadAttachStats;
 
 public class TestSSLEngine {
     public static boolean debug = false;
@@ -219,9 +222,16 @@ public class TestSSLEngine {
         readQueue = new ByteBuffer[bufferCount];
         writeQueue = new ByteBuffer[bufferCount];
 
+        // Mix heap and direct buffers, as JSSEngine handles each of them
+        // differently when crossing into native code.
         for (int i = 0; i < bufferCount; i ++) {
-            readQueue[i] = ByteBuffer.allocate(buffer_size);
-            writeQueue[i] = ByteBuffer.allocate(buffer_size);
+            if (i % 2 == 0) {
+                readQueue[i] = ByteBuffer.allocate(buffer_size);
+                writeQueue[i] = ByteBuffer.allocateDirect(buffer_size);
+            } else {
+                readQueue[i] = ByteBuffer.allocateDirect(buffer_size);
+                writeQueue[i] = ByteBuffer.allocate(buffer_size);
+            }
         }
 
         String clientMessage = "Cooking MCs";
@@ -978,6 +988,310 @@ public class TestSSLEngine {
         }
     }
 
+    public static void testModelTemplateHandshake(SSLContext ctx, String client_alias, String server_alias, String protocol) throws Exception {
+        JSSEngine client_eng = (JSSEngine) ctx.createSSLEngine();
+        client_eng.setSSLParameters(createParameters(client_alias));
+        client_eng.setUseClientMode(true);
+        client_eng.setEnabledProtocols(new String[] { protocol });
+
+        JSSEngine server_eng = (JSSEngine) ctx.createSSLEngine();
+        server_eng.setSSLParameters(createParameters(server_alias));
+        server_eng.setUseClientMode(false);
+        server_eng.setEnabledProtocols(new String[] { protocol });
+
+        try {
+            testBasicHandshake(client_eng, server_eng, false);
+        } catch (Exception e) {
+            client_eng.cleanup();
+            server_eng.cleanup();
+            throw e;
+        }
+    }
+
+    public static void testModelTemplates(SSLContext ctx, String client_alias, String server_alias) throws Exception {
+        // Engines with the same configuration share a model socket.
+        testModelTemplateHandshake(ctx, client_alias, server_alias, "TLSv1.2");
+        long hits = JSSEngine.getModelTemplateHits();
+        long misses = JSSEngine.getModelTemplateMisses();
+        testModelTemplateHandshake(ctx, client_alias, server_alias, "TLSv1.2");
+        assert(JSSEngine.getModelTemplateHits() == hits + 2);
+        assert(JSSEngine.getModelTemplateMisses() == misses);
+
+        // With room for a single model, the client and server models keep
+        // evicting each other, and handshakes still succeed.
+        int max = JSSEngine.getMaxModelTemplates();
+        JSSEngine.setMaxModelTemplates(1);
+        try {
+            for (int i = 0; i < 2; i++) {
+                misses = JSSEngine.getModelTemplateMisses();
+                testModelTemplateHandshake(ctx, client_alias, server_alias, "TLSv1.3");
+                assert(JSSEngine.getModelTemplateMisses() == misses + 2);
+            }
+        } finally {
+            JSSEngine.setMaxModelTemplates(max);
+        }
+    }
+
+    public static void testThreadAttach(SSLContext ctx, String client_alias, String server_alias) throws Exception {
+        // NSS runs the engines' alert and handshake callbacks on this
+        // thread. Once it has been seen by one callback, later callbacks
+        // are hits and never attach it again.
+        testModelTemplateHandshake(ctx, client_alias, server_alias, "TLSv1.2");
+        ThreadAttachStats before = CryptoManager.getThreadAttachStats();
+        testModelTemplateHandshake(ctx, client_alias, server_alias, "TLSv1.2");
+        ThreadAttachStats after = CryptoManager.getThreadAttachStats();
+
+        if (after.getHits() <= before.getHits()) {
+            throw new RuntimeException("Expected callbacks to reuse the attached thread: " + before + " -> " + after);
+        }
+
+        if (after.getAttaches() != before.getAttaches()) {
+            throw new RuntimeException("Expected no new thread attaches: " + before + " -> " + after);
+        }
+    }
+
+    public static void testCertFingerprints(SSLContext ctx, String client_alias, String server_alias) throws Exception {
+        CryptoManager cm = CryptoManager.getInstance();
+        PK11Cert cert = (PK11Cert) cm.findCertByNickname(server_alias);
+        PK11PrivKey key = (PK11PrivKey) cm.findPrivKeyByCert(cert);
+
+        // Server engines sharing a certificate object fingerprint it once,
+        // no matter how many of them are constructed.
+        long fingerprints = 0;
+        for (int i = 0; i < 3; i++) {
+            JSSEngine client_eng = (JSSEngine) ctx.createSSLEngine();
+            client_eng.setSSLParameters(createParameters(client_alias));
+            client_eng.setUseClientMode(true);
+
+            JSSEngine server_eng = (JSSEngine) ctx.createSSLEngine();
+            server_eng.setKeyMaterials(cert, key);
+            server_eng.setUseClientMode(false);
+
+            try {
+                testBasicHandshake(client_eng, server_eng, false);
+            } catch (Exception e) {
+                client_eng.cleanup();
+                server_eng.cleanup();
+                throw e;
+            }
+
+            if (i == 0) {
+                fingerprints = JSSEngine.getCertFingerprintCount();
+            } else if (JSSEngine.getCertFingerprintCount() != fingerprints) {
+                throw new RuntimeException("Expected the server certificate to be fingerprinted once; got " + (JSSEngine.getCertFingerprintCount() - fingerprints) + " more times");
+            }
+        }
+    }
+
+    public static void testRecordSizing(SSLContext ctx, String client_alias, String server_alias) throws Exception {
+        byte[] data = new byte[8192];
+
+        for (boolean dynamic : new boolean[] { true, false }) {
+            JSSEngine client_eng = (JSSEngine) ctx.createSSLEngine();
+            client_eng.setSSLParameters(createParameters(client_alias));
+            client_eng.setUseClientMode(true);
+            client_eng.setDynamicRecordSizing(dynamic);
+
+            JSSEngine server_eng = (JSSEngine) ctx.createSSLEngine();
+            server_eng.setSSLParameters(createParameters(server_alias));
+            server_eng.setUseClientMode(false);
+
+            try {
+                testHandshake(client_eng, server_eng, false);
+
+                ByteBuffer wire = ByteBuffer.allocate(4 * client_eng.getSession().getPacketBufferSize());
+                SSLEngineResult result = client_eng.wrap(ByteBuffer.wrap(data), wire);
+                if (result.bytesConsumed() != data.length) {
+                    throw new RuntimeException("Expected to wrap all " + data.length + " bytes; wrapped " + result.bytesConsumed());
+                }
+
+                // Walk the records in wire, finding the largest one.
+                wire.flip();
+                int largest = 0;
+                while (wire.remaining() >= 5) {
+                    wire.get();
+                    wire.getShort();
+                    int record_length = wire.getShort() & 0xFFFF;
+                    largest = Math.max(largest, record_length);
+                    wire.position(wire.position() + record_length);
+                }
+
+                // Right after the handshake, dynamic record sizing should
+                // only send small records; otherwise, all of data fits in
+                // a single record.
+                if (dynamic && largest > 2048) {
+                    throw new RuntimeException("Expected only small records with dynamic record sizing; got one of " + largest + " bytes");
+                } else if (!dynamic && largest < data.length) {
+                    throw new RuntimeException("Expected a single full record without dynamic record sizing; largest was " + largest + " bytes");
+                }
+            } finally {
+                client_eng.cleanup();
+                server_eng.cleanup();
+            }
+        }
+    }
+
+    public static void stepValidationHandshake(SSLEngine eng, ByteBuffer in, ByteBuffer out, ByteBuffer app) throws Exception {
+        SSLEngineResult.HandshakeStatus state = eng.getHandshakeStatus();
+        if (state == SSLEngineResult.HandshakeStatus.NEED_WRAP) {
+            eng.wrap(empty, out);
+        } else if (state == SSLEngineResult.HandshakeStatus.NEED_UNWRAP) {
+            in.flip();
+            eng.unwrap(in, app);
+            in.compact();
+            app.clear();
+        }
+    }
+
+    public static boolean isHandshakeDone(SSLEngine eng) {
+        SSLEngineResult.HandshakeStatus state = eng.getHandshakeStatus();
+        return state == SSLEngineResult.HandshakeStatus.FINISHED || state == SSLEngineResult.HandshakeStatus.NOT_HANDSHAKING;
+    }
+
+    public static void testValidationExecutor(SSLContext ctx, String client_alias, String server_alias) throws Exception {
+        long validations = JSSEngine.getValidationCount();
+
+        // With a direct Executor, validation finishes before the engine
+        // would otherwise report NEED_TASK, so the handshake looks the same
+        // to the caller.
+        JSSEngine client_eng = (JSSEngine) ctx.createSSLEngine();
+        client_eng.setSSLParameters(createParameters(client_alias));
+        client_eng.setUseClientMode(true);
+        client_eng.setValidationExecutor(Runnable::run);
+
+        JSSEngine server_eng = (JSSEngine) ctx.createSSLEngine();
+        server_eng.setSSLParameters(createParameters(server_alias));
+        server_eng.setUseClientMode(false);
+
+        try {
+            testHandshake(client_eng, server_eng, false);
+        } finally {
+            client_eng.cleanup();
+            server_eng.cleanup();
+        }
+
+        if (JSSEngine.getValidationCount() <= validations) {
+            throw new RuntimeException("Expected validation through the executor to be counted");
+        }
+
+        // With a queueing Executor, the engine waits on validation; the
+        // delegated task it hands out meanwhile only waits for it, and the
+        // handshake continues once validation has run.
+        ArrayList<Runnable> queued = new ArrayList<Runnable>();
+
+        client_eng = (JSSEngine) ctx.createSSLEngine();
+        client_eng.setSSLParameters(createParameters(client_alias));
+        client_eng.setUseClientMode(true);
+        client_eng.setValidationExecutor(queued::add);
+
+        server_eng = (JSSEngine) ctx.createSSLEngine();
+        server_eng.setSSLParameters(createParameters(server_alias));
+        server_eng.setUseClientMode(false);
+
+        try {
+            ByteBuffer c2s = ByteBuffer.allocate(4 * client_eng.getSession().getPacketBufferSize());
+            ByteBuffer s2c = ByteBuffer.allocate(4 * server_eng.getSession().getPacketBufferSize());
+            ByteBuffer app = ByteBuffer.allocate(client_eng.getSession().getApplicationBufferSize());
+            boolean waited = false;
+
+            client_eng.beginHandshake();
+            server_eng.beginHandshake();
+
+            for (int step = 0; step < 20; step++) {
+                stepValidationHandshake(client_eng, s2c, c2s, app);
+                stepValidationHandshake(server_eng, c2s, s2c, app);
+
+                if (client_eng.getHandshakeStatus() == SSLEngineResult.HandshakeStatus.NEED_TASK) {
+                    Runnable waiter = client_eng.getDelegatedTask();
+                    if (waiter == null) {
+                        throw new RuntimeException("Expected a delegated task while validation is queued");
+                    }
+
+                    if (queued.size() != 1) {
+                        throw new RuntimeException("Expected a single queued validation; got " + queued.size());
+                    }
+
+                    SSLEngineResult r = client_eng.wrap(empty, c2s);
+                    if (r.getHandshakeStatus() != SSLEngineResult.HandshakeStatus.NEED_TASK || r.bytesProduced() != 0) {
+                        throw new RuntimeException("Expected wrap() to wait on queued validation; got " + r);
+                    }
+
+                    // The delegated task returns once the queued validation
+                    // has run elsewhere.
+                    Thread worker = new Thread(queued.remove(0));
+                    worker.start();
+                    waiter.run();
+                    worker.join();
+                    waited = true;
+
+                    if (client_eng.getHandshakeStatus() == SSLEngineResult.HandshakeStatus.NEED_TASK) {
+                        throw new RuntimeException("Expected validation to be done after running the delegated task");
+                    }
+
+                    if (client_eng.getDelegatedTask() != null) {
+                        throw new RuntimeException("Expected no delegated task once validation is done");
+                    }
+                }
+
+                if (isHandshakeDone(client_eng) && isHandshakeDone(server_eng)) {
+                    break;
+                }
+            }
+
+            if (!waited) {
+                throw new RuntimeException("Expected client validation to be queued on the executor");
+            }
+
+            if (!isHandshakeDone(client_eng) || !isHandshakeDone(server_eng)) {
+                throw new RuntimeException("Expected handshake to finish after queued validation ran");
+            }
+
+            if (JSSEngine.getValidationMaxQueueTime() <= 0) {
+                throw new RuntimeException("Expected time spent queued to be recorded");
+            }
+        } finally {
+            client_eng.cleanup();
+            server_eng.cleanup();
+        }
+
+        // With a slow asynchronous Executor, a caller running delegated
+        // tasks until there are none left blocks until validation is done
+        // rather than spinning on NEED_TASK; testHandshake(...) asserts
+        // that the status moved on after its task loop.
+        validations = JSSEngine.getValidationCount();
+
+        client_eng = (JSSEngine) ctx.createSSLEngine();
+        client_eng.setSSLParameters(createParameters(client_alias));
+        client_eng.setUseClientMode(true);
+        client_eng.setValidationExecutor(validation -> {
+            Thread worker = new Thread(() -> {
+                try {
+                    Thread.sleep(200);
+                } catch (InterruptedException ie) {
+                    Thread.currentThread().interrupt();
+                }
+                validation.run();
+            });
+            worker.setDaemon(true);
+            worker.start();
+        });
+
+        server_eng = (JSSEngine) ctx.createSSLEngine();
+        server_eng.setSSLParameters(createParameters(server_alias));
+        server_eng.setUseClientMode(false);
+
+        try {
+            testHandshake(client_eng, server_eng, false);
+        } finally {
+            client_eng.cleanup();
+            server_eng.cleanup();
+        }
+
+        if (JSSEngine.getValidationCount() <= validations) {
+            throw new RuntimeException("Expected validation through the slow executor to be counted");
+        }
+    }
+
     public static void testBasicClientServer(String[] args) throws Exception {
         SSLContext ctx = SSLContext.getInstance("TLS", "Mozilla-JSS");
         ctx.init(getKMs(), getTMs(), null);
@@ -988,6 +1302,11 @@ public class TestSSLEngine {
         testAllHandshakes(ctx, client_alias, server_alias, false);
         testAllHandshakes(ctx, client_alias, server_alias, true);
         testJSSEToJSSHandshakes(ctx, server_alias);
+        testModelTemplates(ctx, client_alias, server_alias);
+        testCertFingerprints(ctx, client_alias, server_alias);
+        testThreadAttach(ctx, client_alias, server_alias);
+        testRecordSizing(ctx, client_alias, server_alias);
+        testValidationExecutor(ctx, client_alias, server_alias);
     }
 
     public static void testNativeClientServer(String[] args) throws Exception {
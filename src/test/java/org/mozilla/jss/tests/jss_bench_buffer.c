@@ -0,0 +1,435 @@
+/*
+ * Micro-benchmark for the j_buffer and Buffer PRFileDesc implementations
+ * located under the org.mozilla.jss.ssl.javax package.
+ *
+ * Without arguments, only the j_buffer benchmarks are run. When given an
+ * NSS DB, its password, and a server certificate nickname, this also runs
+ * an in-memory TLS 1.3 client and server over newBufferPRFileDesc to
+ * measure handshake rate and bulk throughput.
+ *
+ * Results are written to stdout as CSV, one line per measurement, so they
+ * can be compared across releases:
+ *
+ *   benchmark,pattern,size,ops,ns_per_op,ops_per_sec,mb_per_sec
+ *
+ * For the j_buffer benchmarks, one op is a jb_write of size bytes followed
+ * by a jb_read of the same size. Progress and diagnostics go to stderr.
+ */
+
+/* Header files under test */
+#include "j_buffer.h"
+#include "BufferPRFD.h"
+
+/* NSPR required includes */
+#include <prio.h>
+#include <prerror.h>
+
+/* NSS includes */
+#include <nss.h>
+#include <ssl.h>
+#include <sslproto.h>
+#include <pk11pub.h>
+#include <cert.h>
+#include <keyhi.h>
+
+/* Standard includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Amount of data moved through each j_buffer benchmark. */
+#define BENCH_BUFFER_BYTES (64 * 1024 * 1024)
+
+/* Minimum and maximum number of ops per j_buffer benchmark. */
+#define BENCH_BUFFER_MIN_OPS 1024
+#define BENCH_BUFFER_MAX_OPS (4 * 1024 * 1024)
+
+/* Number of full handshakes to time. */
+#define BENCH_HANDSHAKES 200
+
+/* Amount of application data moved through the TLS connection, and the
+ * size of each PR_Write. */
+#define BENCH_TLS_BYTES (64 * 1024 * 1024)
+#define BENCH_TLS_CHUNK 16384
+
+/* Size of the buffers backing each TLS connection: large enough to hold a
+ * couple of maximally sized records. */
+#define BENCH_TLS_BUFFER (2 * (16384 + 2048 + 5))
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void report(const char *benchmark, const char *pattern, size_t size,
+                   uint64_t ops, uint64_t bytes, uint64_t elapsed_ns)
+{
+    double seconds = elapsed_ns / 1e9;
+    if (seconds <= 0) {
+        seconds = 1e-9;
+    }
+
+    printf("%s,%s,%zu,%llu,%.2f,%.2f,%.2f\n", benchmark, pattern, size,
+           (unsigned long long) ops, (double) elapsed_ns / ops,
+           ops / seconds, bytes / seconds / (1024 * 1024));
+    fflush(stdout);
+}
+
+static void fail(const char *what)
+{
+    const PRErrorCode err = PR_GetError();
+    fprintf(stderr, "error: %s failed with %d: %s\n", what, err,
+            PR_ErrorToName(err));
+    exit(1);
+}
+
+/*
+ * Time ops rounds of writing and then reading size bytes through buf. The
+ * first resident bytes are written up front and kept in the buffer, so that
+ * the read and write positions drift relative to the end of storage.
+ */
+static void bench_buffer(const char *pattern, j_buffer *buf, size_t size,
+                         size_t resident)
+{
+    uint8_t *data = calloc(size + resident, sizeof(uint8_t));
+    uint64_t ops = BENCH_BUFFER_BYTES / size;
+
+    if (ops < BENCH_BUFFER_MIN_OPS) {
+        ops = BENCH_BUFFER_MIN_OPS;
+    }
+    if (ops > BENCH_BUFFER_MAX_OPS) {
+        ops = BENCH_BUFFER_MAX_OPS;
+    }
+
+    if (data == NULL || buf == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+
+    if (jb_write(buf, data, resident) != resident) {
+        fprintf(stderr, "error: unable to prefill buffer\n");
+        exit(1);
+    }
+
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < ops; i++) {
+        if (jb_write(buf, data, size) != size ||
+                jb_read(buf, data, size) != size) {
+            fprintf(stderr, "error: short transfer in %s/%zu\n", pattern, size);
+            exit(1);
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    report("j_buffer", pattern, size, ops, ops * size, elapsed);
+
+    jb_free(buf);
+    free(data);
+}
+
+static void bench_buffers(void)
+{
+    static const size_t sizes[] = { 1, 16, 64, 256, 1024, 4096, 16384 };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t size = sizes[i];
+
+        /* Every transfer starts at the beginning of storage. */
+        bench_buffer("aligned", jb_alloc(4 * size), size, 0);
+
+        /* Capacity isn't a multiple of the transfer size, so transfers
+         * regularly wrap around the end of storage. */
+        bench_buffer("wrap", jb_alloc(4 * size + 1), size, 1);
+
+        /* Half a transfer stays resident, so every other transfer wraps. */
+        bench_buffer("half", jb_alloc(2 * size), size, size / 2);
+
+        /* Chunks are allocated and released as data comes and goes. */
+        bench_buffer("elastic", jb_alloc_elastic(1024, 4 * size), size, 0);
+
+        /* Same as wrap, but through the lock-free ring. */
+        bench_buffer("spsc", jb_alloc_spsc(4 * size + 1), size, 1);
+    }
+}
+
+static char *return_password(PK11SlotInfo *slot, PRBool retry, void *arg)
+{
+    /* Return the password passed in via arg; see TestBufferPRFDSSL.c. */
+    if (retry == PR_FALSE) {
+        return strdup((char*) arg);
+    }
+
+    fprintf(stderr, "Error: Incorrect password!\n");
+    exit(1);
+}
+
+static CERTCertificate *get_cert(char *nickname)
+{
+    /* Find the certificate in the "user" NSS database with the given
+     * nickname. */
+    CERTCertificate *result = NULL;
+    CERTCertList *clist = PK11_ListCerts(PK11CertListUser, NULL);
+    if (clist == NULL) {
+        return NULL;
+    }
+
+    for (CERTCertListNode *cln = CERT_LIST_HEAD(clist);
+         !CERT_LIST_END(cln, clist); cln = CERT_LIST_NEXT(cln)) {
+        const char *cert_nickname = (const char*)cln->appData;
+        if (!cert_nickname) {
+            cert_nickname = cln->cert->nickname;
+        }
+
+        if (cert_nickname != NULL && strcmp(nickname, cert_nickname) == 0) {
+            result = CERT_DupCertificate(cln->cert);
+            break;
+        }
+    }
+
+    CERT_DestroyCertList(clist);
+    return result;
+}
+
+static void configure_model(PRFileDesc *model)
+{
+    SSLVersionRange range = {
+        SSL_LIBRARY_VERSION_TLS_1_3, SSL_LIBRARY_VERSION_TLS_1_3
+    };
+
+    if (SSL_VersionRangeSet(model, &range) != SECSuccess) {
+        fail("SSL_VersionRangeSet");
+    }
+
+    /* Time full handshakes rather than session resumption. */
+    if (SSL_OptionSet(model, SSL_NO_CACHE, PR_TRUE) != SECSuccess) {
+        fail("SSL_OptionSet");
+    }
+}
+
+static PRFileDesc *new_model(void)
+{
+    PRFileDesc *tcp = PR_NewTCPSocket();
+    if (tcp == NULL) {
+        fail("PR_NewTCPSocket");
+    }
+
+    PRFileDesc *model = SSL_ImportFD(NULL, tcp);
+    if (model == NULL) {
+        fail("SSL_ImportFD");
+    }
+
+    configure_model(model);
+    return model;
+}
+
+/* A client and server connected through a pair of j_buffers. */
+typedef struct {
+    j_buffer *c_read_buf;
+    j_buffer *c_write_buf;
+    PRFileDesc *client;
+    PRFileDesc *server;
+} bench_conn;
+
+static void conn_open(bench_conn *conn, PRFileDesc *c_model,
+                      PRFileDesc *s_model)
+{
+    conn->c_read_buf = jb_alloc(BENCH_TLS_BUFFER);
+    conn->c_write_buf = jb_alloc(BENCH_TLS_BUFFER);
+
+    PRFileDesc *c_nspr = newBufferPRFileDesc(conn->c_read_buf,
+        conn->c_write_buf, (uint8_t*) "localhost", 9);
+    PRFileDesc *s_nspr = newBufferPRFileDesc(conn->c_write_buf,
+        conn->c_read_buf, (uint8_t*) "localhost", 9);
+    if (c_nspr == NULL || s_nspr == NULL) {
+        fail("newBufferPRFileDesc");
+    }
+
+    conn->client = SSL_ImportFD(c_model, c_nspr);
+    conn->server = SSL_ImportFD(s_model, s_nspr);
+    if (conn->client == NULL || conn->server == NULL) {
+        fail("SSL_ImportFD");
+    }
+
+    if (SSL_ResetHandshake(conn->client, PR_FALSE) != SECSuccess ||
+            SSL_ResetHandshake(conn->server, PR_TRUE) != SECSuccess) {
+        fail("SSL_ResetHandshake");
+    }
+
+    if (SSL_SetURL(conn->client, "localhost") != SECSuccess) {
+        fail("SSL_SetURL");
+    }
+}
+
+static void conn_handshake(bench_conn *conn)
+{
+    /* Step both ends until neither is waiting on the other; see
+     * TestBufferPRFDSSL.c. */
+    for (int count = 0; count < 40; count++) {
+        SECStatus c_ret = SSL_ForceHandshake(conn->client);
+        if (c_ret != SECSuccess && PR_GetError() != PR_WOULD_BLOCK_ERROR) {
+            fail("SSL_ForceHandshake (client)");
+        }
+
+        SECStatus s_ret = SSL_ForceHandshake(conn->server);
+        if (s_ret != SECSuccess && PR_GetError() != PR_WOULD_BLOCK_ERROR) {
+            fail("SSL_ForceHandshake (server)");
+        }
+
+        if (c_ret == SECSuccess && s_ret == SECSuccess) {
+            return;
+        }
+    }
+
+    fprintf(stderr, "error: handshake unable to make progress\n");
+    exit(1);
+}
+
+static void conn_close(bench_conn *conn)
+{
+    PR_Close(conn->client);
+    PR_Close(conn->server);
+
+    jb_free(conn->c_read_buf);
+    jb_free(conn->c_write_buf);
+}
+
+static void bench_handshakes(PRFileDesc *c_model, PRFileDesc *s_model)
+{
+    bench_conn conn;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_HANDSHAKES; i++) {
+        conn_open(&conn, c_model, s_model);
+        conn_handshake(&conn);
+        conn_close(&conn);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    report("tls13", "handshake", 0, BENCH_HANDSHAKES, 0, elapsed);
+}
+
+static void bench_bulk(PRFileDesc *c_model, PRFileDesc *s_model)
+{
+    bench_conn conn;
+    uint8_t *data = calloc(BENCH_TLS_CHUNK, sizeof(uint8_t));
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t writes = 0;
+
+    if (data == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+
+    conn_open(&conn, c_model, s_model);
+    conn_handshake(&conn);
+
+    uint64_t start = now_ns();
+    while (received < BENCH_TLS_BYTES) {
+        if (sent < BENCH_TLS_BYTES) {
+            PRInt32 ret = PR_Write(conn.client, data, BENCH_TLS_CHUNK);
+            if (ret > 0) {
+                sent += ret;
+                writes += 1;
+            } else if (PR_GetError() != PR_WOULD_BLOCK_ERROR) {
+                fail("PR_Write");
+            }
+        }
+
+        /* Drain everything the server can decrypt so far. */
+        for (;;) {
+            PRInt32 ret = PR_Read(conn.server, data, BENCH_TLS_CHUNK);
+            if (ret > 0) {
+                received += ret;
+            } else if (ret < 0 && PR_GetError() == PR_WOULD_BLOCK_ERROR) {
+                break;
+            } else {
+                fail("PR_Read");
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    report("tls13", "bulk", BENCH_TLS_CHUNK, writes, received, elapsed);
+
+    conn_close(&conn);
+    free(data);
+}
+
+static void bench_tls(char *database, char *password, char *nickname)
+{
+    if (NSS_Init(database) != SECSuccess) {
+        fail("NSS_Init");
+    }
+
+    PK11_SetPasswordFunc(return_password);
+
+    PK11SlotInfo *slot = PK11_GetInternalKeySlot();
+    if (slot == NULL || PK11_Authenticate(slot, PR_TRUE, password) != SECSuccess) {
+        fail("PK11_Authenticate");
+    }
+
+    CERTCertificate *cert = get_cert(nickname);
+    if (cert == NULL) {
+        fprintf(stderr, "error: no certificate with nickname %s\n", nickname);
+        exit(1);
+    }
+
+    SECKEYPrivateKey *priv_key = PK11_FindPrivateKeyFromCert(slot, cert, NULL);
+    if (priv_key == NULL) {
+        fail("PK11_FindPrivateKeyFromCert");
+    }
+
+    if (SSL_ConfigServerSessionIDCache(1, 100, 100, NULL) != SECSuccess) {
+        fail("SSL_ConfigServerSessionIDCache");
+    }
+
+    /* Configure each end once on a model socket, so that each connection
+     * only pays for the handshake itself. */
+    PRFileDesc *c_model = new_model();
+    PRFileDesc *s_model = new_model();
+    if (SSL_ConfigServerCert(s_model, cert, priv_key, NULL, 0) != SECSuccess) {
+        fail("SSL_ConfigServerCert");
+    }
+
+    fprintf(stderr, "Running TLS 1.3 benchmarks...\n");
+    bench_handshakes(c_model, s_model);
+    bench_bulk(c_model, s_model);
+
+    PR_Close(c_model);
+    PR_Close(s_model);
+
+    SECKEY_DestroyPrivateKey(priv_key);
+    CERT_DestroyCertificate(cert);
+    PK11_FreeSlot(slot);
+
+    SSL_ShutdownServerSessionIDCache();
+    NSS_Shutdown();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1 && argc != 4) {
+        fprintf(stderr, "usage: %s [/path/to/nssdb password cert-nickname]\n",
+                argv[0]);
+        return 1;
+    }
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    printf("benchmark,pattern,size,ops,ns_per_op,ops_per_sec,mb_per_sec\n");
+
+    fprintf(stderr, "Running j_buffer benchmarks...\n");
+    bench_buffers();
+
+    if (argc == 4) {
+        bench_tls(argv[1], argv[2], argv[3]);
+    }
+
+    return 0;
+}